@@ -29,6 +29,7 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <string.h>
 #include <fsl_mc_sys.h>
 #include <fsl_mc_cmd.h>
 #include <fsl_dpaiop.h>
@@ -133,6 +134,21 @@ int dpaiop_reset(struct fsl_mc_io *mc_io,
 	return mc_send_command(mc_io, &cmd);
 }
 
+int dpaiop_reset_async(struct fsl_mc_io *mc_io,
+		       uint32_t cmd_flags,
+		       uint16_t token,
+		       struct mc_command *cmd)
+{
+	/* prepare command */
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->header = mc_encode_cmd_header(DPAIOP_CMDID_RESET,
+					   cmd_flags,
+					   token);
+
+	/* submit command to mc; completion is reaped by caller */
+	return mc_submit_command(mc_io, cmd);
+}
+
 int dpaiop_set_irq_enable(struct fsl_mc_io *mc_io,
 			  uint32_t cmd_flags,
 			  uint16_t token,
@@ -310,6 +326,23 @@ int dpaiop_load(struct fsl_mc_io *mc_io,
 	return mc_send_command(mc_io, &cmd);
 }
 
+int dpaiop_load_async(struct fsl_mc_io *mc_io,
+		      uint32_t cmd_flags,
+		      uint16_t token,
+		      struct dpaiop_load_cfg *cfg,
+		      struct mc_command *cmd)
+{
+	/* prepare command */
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->header = mc_encode_cmd_header(DPAIOP_CMDID_LOAD,
+					   cmd_flags,
+					   token);
+	DPAIOP_CMD_LOAD(*cmd, cfg);
+
+	/* submit command to mc; completion is reaped by caller */
+	return mc_submit_command(mc_io, cmd);
+}
+
 int dpaiop_run(struct fsl_mc_io *mc_io,
 	       uint32_t cmd_flags,
 	       uint16_t token,
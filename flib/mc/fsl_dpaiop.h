@@ -33,6 +33,7 @@
 #define __FSL_DPAIOP_H
 
 struct fsl_mc_io;
+struct mc_command;
 
 /* Data Path AIOP API
  * Contains initialization APIs and runtime control APIs for DPAIOP
@@ -139,6 +140,21 @@ int dpaiop_destroy(struct fsl_mc_io *mc_io,
  */
 int dpaiop_reset(struct fsl_mc_io *mc_io, uint32_t cmd_flags, uint16_t token);
 
+/**
+ * dpaiop_reset_async() - Submit a DPAIOP reset without waiting for it
+ * @mc_io:	Pointer to MC portal's I/O object
+ * @cmd_flags:	Command flags; one or more of 'MC_CMD_FLAG_'
+ * @token:	Token of DPAIOP object
+ * @cmd:	Command buffer; must remain valid until the command is reaped
+ *		with mc_poll_command() or mc_wait_command()
+ *
+ * Return:	'0' if submitted; Error code otherwise.
+ */
+int dpaiop_reset_async(struct fsl_mc_io *mc_io,
+		       uint32_t cmd_flags,
+		       uint16_t token,
+		       struct mc_command *cmd);
+
 /**
  * dpaiop_set_irq_enable() - Set overall interrupt state.
  * @mc_io:	Pointer to MC portal's I/O object
@@ -308,6 +324,25 @@ int dpaiop_load(struct fsl_mc_io *mc_io,
 		uint16_t token,
 		struct dpaiop_load_cfg *cfg);
 
+/**
+ * dpaiop_load_async() - Submit an AIOP load without waiting for it
+ * @mc_io:	Pointer to MC portal's I/O object
+ * @cmd_flags:	Command flags; one or more of 'MC_CMD_FLAG_'
+ * @token:	Token of DPAIOP object
+ * @cfg:	AIOP load configurations
+ * @cmd:	Command buffer; must remain valid until the command is reaped
+ *		with mc_poll_command() or mc_wait_command()
+ *
+ * The image memory must stay mapped until the command has completed.
+ *
+ * Return:	'0' if submitted; Error code otherwise.
+ */
+int dpaiop_load_async(struct fsl_mc_io *mc_io,
+		      uint32_t cmd_flags,
+		      uint16_t token,
+		      struct dpaiop_load_cfg *cfg,
+		      struct mc_command *cmd);
+
 #define DPAIOP_RUN_OPT_DEBUG                    0x0000000000000001ULL
 
 /**
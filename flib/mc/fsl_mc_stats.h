@@ -0,0 +1,137 @@
+/* Copyright 2013-2015 Freescale Semiconductor Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the above-listed copyright holders nor the
+ * names of any contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ *
+ * ALTERNATIVELY, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") as published by the Free Software
+ * Foundation, either version 2 of that License or (at your option) any
+ * later version.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FSL_MC_STATS_H
+#define _FSL_MC_STATS_H
+
+#include <stdint.h>
+
+/**
+ * Number of distinct command IDs for which statistics are kept
+ */
+#define MC_STATS_MAX_CMDS	32
+
+/**
+ * Completion status slots: enum mc_cmd_status values and MC_STATS_TIMEOUT
+ */
+#define MC_STATS_NUM_STATUS	16
+
+/**
+ * Status slot counting commands which hit the wait policy timeout
+ */
+#define MC_STATS_TIMEOUT	(MC_STATS_NUM_STATUS - 1)
+
+/**
+ * Latency histogram: log-linear buckets (HDR style). Each power of two is
+ * split into 2^MC_STATS_HIST_SUB_BITS linear buckets, i.e. values are
+ * recorded with 12.5% precision, up to 2^MC_STATS_HIST_MAX_BITS ns.
+ */
+#define MC_STATS_HIST_SUB_BITS	3
+#define MC_STATS_HIST_MAX_BITS	40
+#define MC_STATS_HIST_BUCKETS	\
+	((MC_STATS_HIST_MAX_BITS - MC_STATS_HIST_SUB_BITS + 1) << \
+	 MC_STATS_HIST_SUB_BITS)
+
+/**
+ * struct mc_cmd_stats - statistics of one MC command ID
+ * @key: Command ID + 1; 0 while the slot is unused
+ * @count: Commands completed (any status, including timeouts)
+ * @status: Completions by enum mc_cmd_status, and MC_STATS_TIMEOUT
+ * @total_ns: Sum of latencies
+ * @min_ns: Lowest latency
+ * @max_ns: Highest latency
+ * @hist: Latency histogram, see mc_stats_bucket()
+ *
+ * Updated without locks; fields are read with relaxed atomic loads so a
+ * concurrent reader may see counters a few commands apart.
+ */
+struct mc_cmd_stats {
+	uint32_t key;
+	uint64_t count;
+	uint64_t status[MC_STATS_NUM_STATUS];
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t hist[MC_STATS_HIST_BUCKETS];
+};
+
+/**
+ * mc_stats_record() - Account one command completion
+ * @cmd_id:	Command ID from the command header
+ * @status:	enum mc_cmd_status of completion or MC_STATS_TIMEOUT
+ * @ns:		Latency from submission to completion
+ */
+void mc_stats_record(uint16_t cmd_id, unsigned int status, uint64_t ns);
+
+/**
+ * mc_stats_get() - Obtain a statistics slot
+ * @idx:	Slot index, 0..MC_STATS_MAX_CMDS-1
+ *
+ * Return:	Slot or NULL if the slot is unused
+ */
+const struct mc_cmd_stats *mc_stats_get(unsigned int idx);
+
+/**
+ * mc_stats_cmd_id() - Command ID accounted in a slot
+ * @s:		Slot returned by mc_stats_get()
+ */
+static inline uint16_t mc_stats_cmd_id(const struct mc_cmd_stats *s)
+{
+	return (uint16_t)(s->key - 1);
+}
+
+/**
+ * mc_stats_bucket() - Histogram bucket of a latency
+ * @ns:		Latency in nano-seconds
+ */
+unsigned int mc_stats_bucket(uint64_t ns);
+
+/**
+ * mc_stats_bucket_upper() - Highest latency recorded in a bucket
+ * @bucket:	Histogram bucket index
+ */
+uint64_t mc_stats_bucket_upper(unsigned int bucket);
+
+/**
+ * mc_stats_percentile() - Latency below which a share of commands completed
+ * @s:		Slot returned by mc_stats_get()
+ * @pct:	Percentile, 0..100
+ *
+ * Return:	Upper bound of the histogram bucket holding the percentile
+ */
+uint64_t mc_stats_percentile(const struct mc_cmd_stats *s, double pct);
+
+/**
+ * mc_stats_reset() - Clear all statistics
+ */
+void mc_stats_reset(void);
+
+#endif /* _FSL_MC_STATS_H */
@@ -55,6 +55,7 @@ struct fsl_mc_io {
 #include <libio.h>
 #include <stdint.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/uio.h>
 #include <linux/byteorder/little_endian.h>
 
@@ -73,10 +74,90 @@ struct fsl_mc_io {
 #define iowrite32(_v, _p)   writeq32(_v, _p)
 #define __iomem
 
+#if defined(__aarch64__)
+#define cpu_relax()	__asm__ __volatile__ ("yield" : : : "memory")
+#elif defined(__x86_64__) || defined(__i386__)
+#define cpu_relax()	__asm__ __volatile__ ("pause" : : : "memory")
+#else
+#define cpu_relax()	dmb()
+#endif
+
+/**
+ * struct mc_wait_policy - how mc_send_command waits for command completion
+ * @spin_iters: Number of portal polls done back-to-back (busy-spin)
+ * @relax_iters: Number of polls, after spinning, with a pause in between
+ * @use_yield: If set, relax phase yields the CPU instead of cpu_relax()
+ * @sleep_ns: Initial sleep between polls once relax phase is over
+ * @max_sleep_ns: Upper bound for the (doubling) sleep between polls
+ * @timeout_ns: Give up with -ETIMEDOUT after this long; 0 waits forever
+ *
+ * A command which times out is still owned by MC; the portal must not be
+ * used until MC has completed it.
+ */
+struct mc_wait_policy {
+	uint32_t spin_iters;
+	uint32_t relax_iters;
+	int use_yield;
+	uint32_t sleep_ns;
+	uint32_t max_sleep_ns;
+	uint64_t timeout_ns;
+};
+
+/**
+ * struct mc_wait_stats - cumulative wait accounting of a portal
+ * @commands: Commands completed or timed out
+ * @spins: Polls done in the busy-spin phase
+ * @relaxes: Polls done in the relax/yield phase
+ * @sleeps: Polls done after a sleep
+ * @slept_ns: Total time requested in sleeps
+ * @timeouts: Commands that hit timeout_ns
+ * @last_polls: Polls taken by the last command
+ */
+struct mc_wait_stats {
+	uint64_t commands;
+	uint64_t spins;
+	uint64_t relaxes;
+	uint64_t sleeps;
+	uint64_t slept_ns;
+	uint64_t timeouts;
+	uint64_t last_polls;
+};
+
+/**
+ * enum mc_io_lock_type - how mc_send_command serializes commands on a portal
+ * shared between threads
+ * @MC_IO_LOCK_NONE: No locking; portal used by one thread at a time
+ * @MC_IO_LOCK_SPIN: Spinlock; waiters spin through the command of the
+ *		     holder, which suits short commands (status queries)
+ * @MC_IO_LOCK_MUTEX: Mutex (futex based); waiters sleep, which suits long
+ *		      commands (load, reset)
+ */
+enum mc_io_lock_type {
+	MC_IO_LOCK_NONE = 0,
+	MC_IO_LOCK_SPIN,
+	MC_IO_LOCK_MUTEX,
+};
+
 struct fsl_mc_io {
 	void *regs;
+	enum mc_io_lock_type lock_type; /* See mc_io_lock_init */
+	union {
+		pthread_spinlock_t spin;
+		pthread_mutex_t mutex;
+	} lock;
+	const struct mc_wait_policy *wait; /* NULL: mc_default_wait_policy */
+	struct mc_wait_stats wait_stats;
+	int pending; /* A command has been submitted and not yet reaped */
+	uint16_t pending_cmd_id; /* Command ID of the pending command */
+	uint64_t submit_ns; /* Submission time, see fsl_mc_stats.h */
+	int recorded; /* Pending command already counted, as timed out, in
+		       * wait_stats and fsl_mc_stats.h; not counted again
+		       * once reaped
+		       */
 };
 
+extern const struct mc_wait_policy mc_default_wait_policy;
+
 #ifndef ENOTSUP
 #define ENOTSUP		95
 #endif
@@ -88,6 +169,74 @@ struct mc_command;
 
 int mc_send_command(struct fsl_mc_io *mc_io, struct mc_command *cmd);
 
+/**
+ * mc_io_lock_init() - Set up the lock of a portal
+ * @mc_io:	Pointer to MC portal's I/O object, not in use
+ * @type:	Lock type; MC_IO_LOCK_NONE for a portal of a single thread
+ *
+ * mc_send_command() then holds the lock from submission of a command to its
+ * completion. Callers of mc_submit_command() and friends take it with
+ * mc_io_lock() themselves.
+ *
+ * Return:	'0' on Success; error code otherwise.
+ */
+int mc_io_lock_init(struct fsl_mc_io *mc_io, enum mc_io_lock_type type);
+
+/**
+ * mc_io_lock_destroy() - Release the lock of a portal, which is left
+ * with MC_IO_LOCK_NONE
+ * @mc_io:	Pointer to MC portal's I/O object, not in use
+ */
+void mc_io_lock_destroy(struct fsl_mc_io *mc_io);
+
+/**
+ * mc_io_lock() - Take the lock of a portal, as set by mc_io_lock_init()
+ * @mc_io:	Pointer to MC portal's I/O object
+ */
+void mc_io_lock(struct fsl_mc_io *mc_io);
+
+/**
+ * mc_io_unlock() - Release the lock taken with mc_io_lock()
+ * @mc_io:	Pointer to MC portal's I/O object
+ */
+void mc_io_unlock(struct fsl_mc_io *mc_io);
+
+/**
+ * mc_submit_command() - Write a command to the portal without waiting
+ * @mc_io:	Pointer to MC portal's I/O object
+ * @cmd:	Filled command
+ *
+ * Only one command can be outstanding on a portal. If the previous command
+ * has already completed but was never reaped, its response is discarded.
+ *
+ * Return:	'0' on Success; -EBUSY if MC is still working on the previous
+ *		command of the portal.
+ */
+int mc_submit_command(struct fsl_mc_io *mc_io, struct mc_command *cmd);
+
+/**
+ * mc_poll_command() - Check, without blocking, for completion of the
+ * command submitted with mc_submit_command()
+ * @mc_io:	Pointer to MC portal's I/O object
+ * @cmd:	Buffer into which response is read on completion
+ *
+ * Return:	-EINPROGRESS while MC is working on the command; otherwise
+ *		completion status of the command ('0' on Success).
+ */
+int mc_poll_command(struct fsl_mc_io *mc_io, struct mc_command *cmd);
+
+/**
+ * mc_wait_command() - Wait, as per the portal's wait policy, for completion
+ * of the command submitted with mc_submit_command()
+ * @mc_io:	Pointer to MC portal's I/O object
+ * @cmd:	Buffer into which response is read on completion
+ *
+ * Return:	Completion status of the command ('0' on Success); -ETIMEDOUT
+ *		if the policy timeout expired, in which case the command is
+ *		still outstanding and can be polled again.
+ */
+int mc_wait_command(struct fsl_mc_io *mc_io, struct mc_command *cmd);
+
 #endif /* __linux_driver__ */
 
 #endif /* _FSL_MC_SYS_H */
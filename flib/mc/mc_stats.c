@@ -0,0 +1,188 @@
+/* Copyright 2013-2015 Freescale Semiconductor Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the above-listed copyright holders nor the
+ * names of any contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ *
+ * ALTERNATIVELY, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") as published by the Free Software
+ * Foundation, either version 2 of that License or (at your option) any
+ * later version.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <fsl_mc_stats.h>
+
+/* Slots are claimed on first use by compare-and-swap of the key, so
+ * concurrent senders (e.g. one per portal) never take a lock.
+ */
+static struct mc_cmd_stats mc_stats_table[MC_STATS_MAX_CMDS];
+
+static struct mc_cmd_stats *mc_stats_slot(uint16_t cmd_id)
+{
+	uint32_t key = (uint32_t)cmd_id + 1, cur;
+	unsigned int i, idx;
+
+	/* Command IDs are sparse; start at a hash and probe linearly */
+	idx = (cmd_id ^ (cmd_id >> 5)) % MC_STATS_MAX_CMDS;
+	for (i = 0; i < MC_STATS_MAX_CMDS; i++) {
+		struct mc_cmd_stats *s = &mc_stats_table[idx];
+
+		cur = __atomic_load_n(&s->key, __ATOMIC_ACQUIRE);
+		if (cur == key)
+			return s;
+		if (!cur) {
+			if (__atomic_compare_exchange_n(&s->key, &cur, key, 0,
+							__ATOMIC_ACQ_REL,
+							__ATOMIC_ACQUIRE))
+				return s;
+			if (cur == key)
+				return s;
+		}
+		idx = (idx + 1) % MC_STATS_MAX_CMDS;
+	}
+
+	/* Table full; command is not accounted */
+	return NULL;
+}
+
+unsigned int mc_stats_bucket(uint64_t ns)
+{
+	unsigned int msb, shift;
+
+	if (ns < (1ULL << (MC_STATS_HIST_SUB_BITS + 1)))
+		return (unsigned int)ns;
+
+	msb = 63 - __builtin_clzll(ns);
+	if (msb >= MC_STATS_HIST_MAX_BITS)
+		return MC_STATS_HIST_BUCKETS - 1;
+
+	/* Keep the MC_STATS_HIST_SUB_BITS bits below the leading one */
+	shift = msb - MC_STATS_HIST_SUB_BITS;
+	return ((shift + 1) << MC_STATS_HIST_SUB_BITS) +
+		(unsigned int)((ns >> shift) &
+			       ((1U << MC_STATS_HIST_SUB_BITS) - 1));
+}
+
+uint64_t mc_stats_bucket_upper(unsigned int bucket)
+{
+	unsigned int shift, sub;
+
+	if (bucket < (2U << MC_STATS_HIST_SUB_BITS))
+		return bucket;
+	if (bucket >= MC_STATS_HIST_BUCKETS - 1)
+		return UINT64_MAX;
+
+	shift = (bucket >> MC_STATS_HIST_SUB_BITS) - 1;
+	sub = bucket & ((1U << MC_STATS_HIST_SUB_BITS) - 1);
+	return ((((uint64_t)1 << MC_STATS_HIST_SUB_BITS) + sub + 1) << shift)
+		- 1;
+}
+
+static void mc_stats_update_min(uint64_t *p, uint64_t ns)
+{
+	uint64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+
+	while ((!cur || ns < cur) &&
+	       !__atomic_compare_exchange_n(p, &cur, ns, 1, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+static void mc_stats_update_max(uint64_t *p, uint64_t ns)
+{
+	uint64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+
+	while (ns > cur &&
+	       !__atomic_compare_exchange_n(p, &cur, ns, 1, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+void mc_stats_record(uint16_t cmd_id, unsigned int status, uint64_t ns)
+{
+	struct mc_cmd_stats *s = mc_stats_slot(cmd_id);
+
+	if (!s)
+		return;
+
+	if (status >= MC_STATS_NUM_STATUS)
+		status = MC_STATS_TIMEOUT;
+
+	/* min_ns of 0 means unset; a zero latency is stored as 1 ns */
+	if (!ns)
+		ns = 1;
+
+	__atomic_fetch_add(&s->status[status], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->total_ns, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->hist[mc_stats_bucket(ns)], 1, __ATOMIC_RELAXED);
+	mc_stats_update_min(&s->min_ns, ns);
+	mc_stats_update_max(&s->max_ns, ns);
+	__atomic_fetch_add(&s->count, 1, __ATOMIC_RELEASE);
+}
+
+const struct mc_cmd_stats *mc_stats_get(unsigned int idx)
+{
+	const struct mc_cmd_stats *s;
+
+	if (idx >= MC_STATS_MAX_CMDS)
+		return NULL;
+
+	s = &mc_stats_table[idx];
+	if (!__atomic_load_n(&s->key, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	return s;
+}
+
+uint64_t mc_stats_percentile(const struct mc_cmd_stats *s, double pct)
+{
+	uint64_t count, target, seen = 0;
+	unsigned int i;
+
+	count = __atomic_load_n(&s->count, __ATOMIC_ACQUIRE);
+	if (!count)
+		return 0;
+
+	target = (uint64_t)((double)count * pct / 100.0 + 0.5);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0; i < MC_STATS_HIST_BUCKETS; i++) {
+		seen += __atomic_load_n(&s->hist[i], __ATOMIC_RELAXED);
+		if (seen >= target) {
+			uint64_t upper = mc_stats_bucket_upper(i);
+			uint64_t max = __atomic_load_n(&s->max_ns,
+						       __ATOMIC_RELAXED);
+
+			return upper < max ? upper : max;
+		}
+	}
+
+	return __atomic_load_n(&s->max_ns, __ATOMIC_RELAXED);
+}
+
+void mc_stats_reset(void)
+{
+	/* Not atomic with respect to concurrent mc_stats_record() */
+	memset(mc_stats_table, 0, sizeof(mc_stats_table));
+}
@@ -29,8 +29,23 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <time.h>
+#include <sched.h>
 #include <fsl_mc_sys.h>
 #include <fsl_mc_cmd.h>
+#include <fsl_mc_stats.h>
+
+/* Most commands complete within a few microseconds and are served by the
+ * spin phase; long ones (load, reset) end up sleeping.
+ */
+const struct mc_wait_policy mc_default_wait_policy = {
+	.spin_iters = 1000,
+	.relax_iters = 1000,
+	.use_yield = 0,
+	.sleep_ns = 1000,		/* 1 us */
+	.max_sleep_ns = 1000000,	/* 1 ms */
+	.timeout_ns = 30000000000ULL,	/* 30 s */
+};
 
 static int mc_status_to_error(enum mc_cmd_status status)
 {
@@ -65,30 +80,241 @@ static int mc_status_to_error(enum mc_cmd_status status)
 	return -EINVAL;
 }
 
-int mc_send_command(struct fsl_mc_io *mc_io, struct mc_command *cmd)
+static uint64_t mc_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int mc_wait_completion(struct fsl_mc_io *mc_io,
+			      enum mc_cmd_status *status)
+{
+	const struct mc_wait_policy *p;
+	struct mc_wait_stats *st = &mc_io->wait_stats;
+	struct timespec ts;
+	uint64_t polls = 0, start = 0;
+	uint32_t sleep_ns;
+	int err = 0, counted = mc_io->recorded;
+
+	p = mc_io->wait ? mc_io->wait : &mc_default_wait_policy;
+	sleep_ns = p->sleep_ns;
+
+	while (1) {
+		polls++;
+		*status = MC_CMD_HDR_READ_STATUS(ioread64(mc_io->regs));
+		if (*status != MC_CMD_STATUS_READY)
+			break;
+
+		/* Busy-spin; clock is not read in this phase */
+		if (polls <= p->spin_iters) {
+			st->spins++;
+			continue;
+		}
+
+		if (!start)
+			start = mc_clock_ns();
+		else if (p->timeout_ns &&
+			 mc_clock_ns() - start >= p->timeout_ns) {
+			if (!mc_io->recorded) {
+				st->timeouts++;
+				mc_stats_record(mc_io->pending_cmd_id,
+						MC_STATS_TIMEOUT,
+						mc_clock_ns() -
+						mc_io->submit_ns);
+			}
+			mc_io->recorded = 1;
+			err = -ETIMEDOUT;
+			break;
+		}
+
+		if (polls <= (uint64_t)p->spin_iters + p->relax_iters) {
+			if (p->use_yield)
+				sched_yield();
+			else
+				cpu_relax();
+			st->relaxes++;
+			continue;
+		}
+
+		ts.tv_sec = sleep_ns / 1000000000U;
+		ts.tv_nsec = sleep_ns % 1000000000U;
+		nanosleep(&ts, NULL);
+		st->sleeps++;
+		st->slept_ns += sleep_ns;
+		if (sleep_ns < p->max_sleep_ns) {
+			sleep_ns *= 2;
+			if (sleep_ns > p->max_sleep_ns)
+				sleep_ns = p->max_sleep_ns;
+		}
+	}
+
+	if (!counted)
+		st->commands++;
+	st->last_polls = polls;
+
+	return err;
+}
+
+int mc_submit_command(struct fsl_mc_io *mc_io, struct mc_command *cmd)
 {
 	enum mc_cmd_status status;
 
 	if (!mc_io || !mc_io->regs)
 		return -EACCES;
 
-	/* --- Call lock function here in case portal is shared --- */
-	mc_write_command(mc_io->regs, cmd);
-
-	/* Spin until status changes */
-	do {
+	if (mc_io->pending) {
 		status = MC_CMD_HDR_READ_STATUS(ioread64(mc_io->regs));
+		if (status == MC_CMD_STATUS_READY)
+			return -EBUSY;
+		/* Completed but never reaped (e.g. after a timeout) */
+		mc_io->pending = 0;
+	}
 
-		/* --- Call wait function here to prevent blocking ---
-		 * Change the loop condition accordingly to exit on timeout.
-		 */
-	} while (status == MC_CMD_STATUS_READY);
+	mc_io->pending_cmd_id = (uint16_t)mc_dec(cmd->header,
+						 MC_CMD_HDR_CMDID_O,
+						 MC_CMD_HDR_CMDID_S);
+	mc_io->submit_ns = mc_clock_ns();
+	mc_io->recorded = 0;
+	mc_write_command(mc_io->regs, cmd);
+	mc_io->pending = 1;
 
+	return 0;
+}
+
+static int mc_complete_command(struct fsl_mc_io *mc_io,
+			       struct mc_command *cmd,
+			       enum mc_cmd_status status)
+{
 	/* Read the response back into the command buffer */
 	mc_read_response(mc_io->regs, cmd);
-
-	/* --- Call unlock function here in case portal is shared --- */
+	mc_io->pending = 0;
+	/* Each command is counted once; a timed out one already is */
+	if (!mc_io->recorded)
+		mc_stats_record(mc_io->pending_cmd_id, status,
+				mc_clock_ns() - mc_io->submit_ns);
 
 	return mc_status_to_error(status);
 }
 
+int mc_poll_command(struct fsl_mc_io *mc_io, struct mc_command *cmd)
+{
+	enum mc_cmd_status status;
+
+	if (!mc_io || !mc_io->regs || !mc_io->pending)
+		return -EINVAL;
+
+	status = MC_CMD_HDR_READ_STATUS(ioread64(mc_io->regs));
+	if (status == MC_CMD_STATUS_READY)
+		return -EINPROGRESS;
+
+	if (!mc_io->recorded)
+		mc_io->wait_stats.commands++;
+	return mc_complete_command(mc_io, cmd, status);
+}
+
+int mc_wait_command(struct fsl_mc_io *mc_io, struct mc_command *cmd)
+{
+	enum mc_cmd_status status;
+	int err;
+
+	if (!mc_io || !mc_io->regs || !mc_io->pending)
+		return -EINVAL;
+
+	/* Wait until status changes, as per the portal's wait policy */
+	err = mc_wait_completion(mc_io, &status);
+	if (err)
+		return err;
+
+	return mc_complete_command(mc_io, cmd, status);
+}
+
+/* Spins on a busy portal lock before yielding the CPU */
+#define MC_IO_LOCK_SPIN_ITERS	1000
+
+int mc_io_lock_init(struct fsl_mc_io *mc_io, enum mc_io_lock_type type)
+{
+	int err = 0;
+
+	if (!mc_io)
+		return -EINVAL;
+
+	switch (type) {
+	case MC_IO_LOCK_NONE:
+		break;
+	case MC_IO_LOCK_SPIN:
+		err = pthread_spin_init(&mc_io->lock.spin,
+					PTHREAD_PROCESS_PRIVATE);
+		break;
+	case MC_IO_LOCK_MUTEX:
+		err = pthread_mutex_init(&mc_io->lock.mutex, NULL);
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (err)
+		return -err;
+
+	mc_io->lock_type = type;
+	return 0;
+}
+
+void mc_io_lock_destroy(struct fsl_mc_io *mc_io)
+{
+	if (!mc_io)
+		return;
+
+	if (mc_io->lock_type == MC_IO_LOCK_SPIN)
+		pthread_spin_destroy(&mc_io->lock.spin);
+	else if (mc_io->lock_type == MC_IO_LOCK_MUTEX)
+		pthread_mutex_destroy(&mc_io->lock.mutex);
+	mc_io->lock_type = MC_IO_LOCK_NONE;
+}
+
+void mc_io_lock(struct fsl_mc_io *mc_io)
+{
+	uint32_t spins = 0;
+
+	if (mc_io->lock_type == MC_IO_LOCK_SPIN) {
+		/* Yield once spinning long enough that the holder is likely
+		 * waiting for the CPU rather than for MC
+		 */
+		while (pthread_spin_trylock(&mc_io->lock.spin)) {
+			if (++spins < MC_IO_LOCK_SPIN_ITERS)
+				cpu_relax();
+			else
+				sched_yield();
+		}
+	} else if (mc_io->lock_type == MC_IO_LOCK_MUTEX)
+		pthread_mutex_lock(&mc_io->lock.mutex);
+}
+
+void mc_io_unlock(struct fsl_mc_io *mc_io)
+{
+	if (mc_io->lock_type == MC_IO_LOCK_SPIN)
+		pthread_spin_unlock(&mc_io->lock.spin);
+	else if (mc_io->lock_type == MC_IO_LOCK_MUTEX)
+		pthread_mutex_unlock(&mc_io->lock.mutex);
+}
+
+int mc_send_command(struct fsl_mc_io *mc_io, struct mc_command *cmd)
+{
+	int err;
+
+	if (!mc_io)
+		return -EACCES;
+
+	/* Portal holds a single command; the lock is held from submission
+	 * to completion. A command that times out is left pending and the
+	 * lock released: the next submission finds the portal busy until
+	 * MC completes it.
+	 */
+	mc_io_lock(mc_io);
+	err = mc_submit_command(mc_io, cmd);
+	if (!err)
+		err = mc_wait_command(mc_io, cmd);
+	mc_io_unlock(mc_io);
+
+	return err;
+}
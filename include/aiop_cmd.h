@@ -43,7 +43,7 @@
 /** @def MAX_SUB_COMMANDS
  * @brief Max limit for number of supported sub-commands (load, reset ...)
  */
-#define MAX_SUB_COMMANDS	10
+#define MAX_SUB_COMMANDS	16
 
 /** @def MAX_CMD_STR_LEN
  * @brief MAX Length of a sub-command name
@@ -67,6 +67,12 @@
  */
 #define MAX_CONTAINER_NAME_LEN	10
 
+/** @def MAX_CONTAINER_SPEC_LEN
+ * @brief Maximum size of a container list (comma separated names and/or glob
+ * patterns) naming a fleet of containers
+ */
+#define MAX_CONTAINER_SPEC_LEN	256
+
 /** @def MAX_PATH_LEN
  * @brief Maximum length for AIOP Image file, with path; Ideally FILENAME_MAX
  */
@@ -130,20 +136,31 @@ struct global_args {
 	short int args_file_flag;
 	char args_file[MAX_PATH_LEN]; /* TODO Make it dynamic allocation */
 
+	/* AIOP arguments given inline, instead of a file: read from stdin
+	 * ('-a -') or as hex (--args-hex). Held until the tool exits.
+	 */
+	short int args_mem_flag;
+	unsigned char *args_mem;
+	size_t args_mem_sz;
+
 	/* Threads per AIOP Core (tpc) to deploy */
 	short int tpc_flag;
 	unsigned short int tpc;
 
 	/* Name of the container containing dpaiop object. This would be updated
 	 * either through user provided value (-g argument), or environment 
-	 * variable (DPRC) or default value specified in DEFAULT_DPRC_NAME
+	 * variable (DPRC) or default value specified in DEFAULT_DPRC_NAME.
+	 * It can also be a list or pattern of containers; see aiop_fleet.h
 	 */
 	short int container_name_flag;
-	char container_name[MAX_CONTAINER_NAME_LEN]; /* TODO Dynamic alloc */
+	char container_name[MAX_CONTAINER_SPEC_LEN]; /* TODO Dynamic alloc */
 
 	/* Flag specifying if reset operations should be performed or not */
 	short int reset_flag;
 
+	/* Flag specifying if load is skipped when the same image is running */
+	short int skip_flag;
+
 	/* Time of day */
 	short int tod_flag;
 	uint64_t tod_val;
@@ -160,6 +177,46 @@ struct global_args {
 	/* Verbose (INFO) enabled or disabled */
 	short int verbose_flag;
 
+	/* JSON output for sub-commands dumping data (stats) */
+	short int json_flag;
+
+	/* Control socket of the daemon. For 'serve', the socket to listen on;
+	 * for other sub-commands, the daemon to execute them through.
+	 */
+	short int socket_flag;
+	char socket_path[MAX_PATH_LEN];
+
+	/* Tile state to wait for (DPAIOP_STATE_*), and limit of the wait in
+	 * milliseconds; 0 is no limit.
+	 */
+	short int state_flag;
+	int state;
+	short int timeout_flag;
+	unsigned int timeout_ms;
+
+	/* Largest image and args accepted by load, and by loads through the
+	 * daemon ('serve'); 0 is the library default.
+	 */
+	size_t image_max;
+	size_t args_max;
+
+	/* ID of the dpaiop to operate on, in a container with several; as
+	 * given, for dump_cmdline_args
+	 */
+	short int aiop_id_flag;
+	int aiop_id;
+	char aiop_id_str[16];
+
+	/* Exporter: HTTP [address:]port to serve the metrics on, textfile to
+	 * write them to, and refresh interval in milliseconds.
+	 */
+	short int listen_flag;
+	char listen[MAX_PATH_LEN];
+	short int textfile_flag;
+	char textfile[MAX_PATH_LEN];
+	short int interval_flag;
+	unsigned int interval_ms;
+
 };
 
 /*
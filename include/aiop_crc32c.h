@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_crc32c.h
+ *
+ * @brief	CRC32C (Castagnoli) checksum of AIOP images, using the CPU CRC
+ *		instructions when available
+ *
+ */
+
+#ifndef AIOPT_CRC32C_H
+#define AIOPT_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_CRC32C_SIDECAR_EXT
+ * @brief Suffix of the file holding the expected CRC32C of an AIOP Image,
+ * e.g. aiop_app.elf.crc32c next to aiop_app.elf. The file holds the CRC as
+ * hexadecimal digits, optionally followed by other text (e.g. file name).
+ */
+#define AIOPT_CRC32C_SIDECAR_EXT	".crc32c"
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Extend a CRC32C over a buffer. The CRC of data split over several buffers
+ * is obtained by passing the result of each call to the next; start with 0.
+ * ARMv8 CRC32 instructions or SSE4.2 are used if the CPU has them, else a
+ * table driven (slicing-by-8) implementation.
+ *
+ * @param [in] crc CRC of the data so far, 0 to start
+ * @param [in] buf Data
+ * @param [in] len Length of data
+ *
+ * @return CRC of the data so far, including buf
+ */
+uint32_t aiopt_crc32c(uint32_t crc, const void *buf, size_t len);
+
+/*
+ * @brief
+ * Name of the CRC32C implementation in use
+ *
+ * @return const string, e.g. "armv8-crc", "sse4.2" or "table"
+ */
+const char *aiopt_crc32c_impl(void);
+
+#endif /* AIOPT_CRC32C_H */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_decomp.h
+ *
+ * @brief	Decompression of zstd and lz4 compressed AIOP images
+ *
+ */
+
+#ifndef AIOPT_DECOMP_H
+#define AIOPT_DECOMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_ZSTD_MAGIC, AIOPT_LZ4_MAGIC
+ * @brief Magic numbers (little-endian) starting zstd and lz4 frames
+ */
+#define AIOPT_ZSTD_MAGIC	0xFD2FB528
+#define AIOPT_LZ4_MAGIC		0x184D2204
+
+/** @def AIOPT_DECOMP_IN_SZ
+ * @brief Compressed data is read in chunks of this size
+ */
+#define AIOPT_DECOMP_IN_SZ	(128 * 1024)
+
+/* ======================================================================
+ * Structures Declarations
+ * ======================================================================*/
+
+/*
+ * @brief Compression formats of AIOP images
+ */
+enum aiopt_comp {
+	AIOPT_COMP_NONE,
+	AIOPT_COMP_ZSTD,	/**< Needs build with AIOPT_ZSTD=1 >*/
+	AIOPT_COMP_LZ4		/**< lz4 frame format; AIOPT_LZ4=1 >*/
+};
+
+/*
+ * @brief Called as decompressed data is produced
+ *
+ * @param [in] ctx Caller context
+ * @param [in] done Bytes of decompressed data in the output buffer so far
+ */
+typedef void (*aiopt_decomp_progress_t)(void *ctx, size_t done);
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Detect the compression of a file from its magic number
+ *
+ * @param [in] fd Opened file
+ * @param [in] file_sz Size of the file
+ *
+ * @return enum aiopt_comp
+ */
+int aiopt_comp_detect(int fd, size_t file_sz);
+
+/*
+ * @brief
+ * Name of a compression format
+ *
+ * @param [in] comp enum aiopt_comp
+ * @return const string
+ */
+const char *aiopt_comp_str(int comp);
+
+/*
+ * @brief
+ * Decompress a file straight into an output buffer, reading it
+ * AIOPT_DECOMP_IN_SZ at a time; no copy of the output is made. Concatenated
+ * frames are decompressed one after the other.
+ *
+ * @param [in] fd Opened compressed file
+ * @param [in] file_sz Size of the file
+ * @param [in] comp Compression, as from aiopt_comp_detect
+ * @param [out] dst Output buffer
+ * @param [in] cap Size of dst; larger output is an error
+ * @param [out] out_len Size of the decompressed data
+ * @param [in] progress Called as output is produced; can be NULL
+ * @param [in] ctx Passed to progress
+ *
+ * @return AIOPT_SUCCESS, AIOPT_EBADIMAGE if the data is corrupt, truncated,
+ *         larger than cap or of a format not built in, or AIOPT_FAILURE
+ */
+int aiopt_decompress(int fd, size_t file_sz, int comp, void *dst, size_t cap,
+		     size_t *out_len, aiopt_decomp_progress_t progress,
+		     void *ctx);
+
+#endif /* AIOPT_DECOMP_H */
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_elf.h
+ *
+ * @brief	Validation of the ELF and program headers of AIOP images
+ *
+ */
+
+#ifndef AIOPT_ELF_H
+#define AIOPT_ELF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <elf.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_ELF_CLASS, AIOPT_ELF_DATA, AIOPT_ELF_MACHINE
+ * @brief What AIOP images are built for: the AIOP cores (e200) are 32-bit,
+ * big-endian Power Architecture
+ */
+#define AIOPT_ELF_CLASS		ELFCLASS32
+#define AIOPT_ELF_DATA		ELFDATA2MSB
+#define AIOPT_ELF_MACHINE	EM_PPC
+
+/** @def AIOPT_ELF_MAX_SEGMENTS
+ * @brief Maximum number of loadable (PT_LOAD) segments in an AIOP image
+ */
+#define AIOPT_ELF_MAX_SEGMENTS	16
+
+/* ======================================================================
+ * Structures Declarations
+ * ======================================================================*/
+
+/*
+ * @brief A loadable segment of an AIOP image
+ */
+struct aiopt_elf_seg {
+	uint32_t	vaddr;
+	uint32_t	offset;		/**< In the file >*/
+	uint32_t	filesz;
+	uint32_t	memsz;
+	uint32_t	flags;		/**< PF_R, PF_W, PF_X >*/
+};
+
+typedef struct aiopt_elf_seg aiopt_elf_seg_t;
+
+/*
+ * @brief Summary of an AIOP image, as found by aiopt_elf_check
+ */
+struct aiopt_elf_info {
+	uint32_t	entry;
+	unsigned int	nsegs;		/**< PT_LOAD segments >*/
+	aiopt_elf_seg_t	segs[AIOPT_ELF_MAX_SEGMENTS];
+	uint64_t	filesz;		/**< Sum over segments >*/
+	uint64_t	memsz;		/**< Sum over segments >*/
+};
+
+typedef struct aiopt_elf_info aiopt_elf_info_t;
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Check that a file is an AIOP image: an executable ELF for the AIOP cores
+ * (AIOPT_ELF_CLASS, AIOPT_ELF_DATA, AIOPT_ELF_MACHINE) whose loadable
+ * segments lie within the file and do not overlap in memory. Only the ELF
+ * header and program headers are read, one at a time; the cost does not
+ * depend on the size of the image.
+ *
+ * @param [in] fd Opened image file
+ * @param [in] file_sz Size of the file
+ * @param [out] info Entry point and loadable segments
+ *
+ * @return AIOPT_SUCCESS, or AIOPT_EBADIMAGE naming the problem in debug output
+ */
+int aiopt_elf_check(int fd, size_t file_sz, aiopt_elf_info_t *info);
+
+/*
+ * @brief
+ * As aiopt_elf_check, for an image already in memory (e.g. decompressed)
+ *
+ * @param [in] buf Image
+ * @param [in] len Size of the image
+ * @param [out] info Entry point and loadable segments
+ *
+ * @return AIOPT_SUCCESS, or AIOPT_EBADIMAGE naming the problem in debug output
+ */
+int aiopt_elf_check_buf(const void *buf, size_t len, aiopt_elf_info_t *info);
+
+#endif /* AIOPT_ELF_H */
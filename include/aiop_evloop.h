@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_evloop.h
+ *
+ * @brief	Event loop shared by the daemon (serve) and the metrics
+ *		exporter: epoll over a listening socket, its connections and
+ *		other descriptors, with SIGINT/SIGTERM taken through a
+ *		self-pipe.
+ *
+ */
+
+#ifndef AIOPT_EVLOOP_H
+#define AIOPT_EVLOOP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_EVL_MAX_EVENTS
+ * @brief Events fetched per epoll_wait call
+ */
+#define AIOPT_EVL_MAX_EVENTS	32
+
+/** @def AIOPT_EVL_MAX_SRCS
+ * @brief Descriptors other than connections (timers, pipes) per loop
+ */
+#define AIOPT_EVL_MAX_SRCS	4
+
+/* ======================================================================
+ * Structures Declarations
+ * ======================================================================*/
+
+/*
+ * @brief Bytes queued to be sent on a connection
+ */
+struct aiopt_evl_out {
+	char		*data;
+	size_t		len;
+	size_t		off;		/**< Bytes of data already sent >*/
+	size_t		cap;
+};
+
+/*
+ * @brief A connection accepted on the listening socket. Users extend it by
+ * embedding it as the first member of their own connection state.
+ */
+struct aiopt_evl_conn {
+	int		fd;
+	unsigned int	slot;		/**< Index in aiopt_evl.conns >*/
+	unsigned int	events;		/**< As armed in epoll >*/
+	uint64_t	since_ns;	/**< Accepted at, CLOCK_MONOTONIC >*/
+	short int	closing;	/**< Close once out is flushed >*/
+	struct aiopt_evl_out out;
+	struct aiopt_evl_conn *next;	/**< In aiopt_evl.dead once closed >*/
+};
+
+typedef struct aiopt_evl aiopt_evl_t;
+
+/*
+ * @brief Handler of events on a connection; returns AIOPT_FAILURE for the
+ * connection to be closed
+ */
+typedef int (*aiopt_evl_conn_hndlr)(aiopt_evl_t *evl,
+				    struct aiopt_evl_conn *conn,
+				    unsigned int events);
+
+/*
+ * @brief Called as a connection is closed, before it is released
+ */
+typedef void (*aiopt_evl_close_hndlr)(aiopt_evl_t *evl,
+				      struct aiopt_evl_conn *conn);
+
+/*
+ * @brief Handler of a descriptor added with aiopt_evl_add, once readable
+ */
+typedef void (*aiopt_evl_src_hndlr)(aiopt_evl_t *evl, void *arg);
+
+struct aiopt_evl_src {
+	int		fd;
+	aiopt_evl_src_hndlr hndlr;
+	void		*arg;
+};
+
+/*
+ * @brief State of an event loop
+ */
+struct aiopt_evl {
+	int		epfd;
+	int		lfd;		/**< Listening socket, or -1 >*/
+	int		sfd;		/**< Read end of the signal pipe >*/
+	short int	stop;		/**< Set to leave aiopt_evl_run >*/
+	void		*arg;		/**< Of the user, e.g. daemon state >*/
+	size_t		conn_sz;	/**< Of the user's connection state >*/
+	unsigned int	max_conns;
+	unsigned int	nconns;
+	struct aiopt_evl_conn **conns;	/**< max_conns slots >*/
+	struct aiopt_evl_conn *dead;	/**< Closed; freed after the batch >*/
+	aiopt_evl_conn_hndlr on_conn;
+	aiopt_evl_close_hndlr on_close;	/**< Can be NULL >*/
+	unsigned int	nsrcs;
+	struct aiopt_evl_src srcs[AIOPT_EVL_MAX_SRCS];
+	struct sigaction old_int;
+	struct sigaction old_term;
+};
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Set up an event loop: epoll instance, and SIGINT/SIGTERM handlers which
+ * stop the loop. The signal pipe is process wide; one loop is set up at a
+ * time.
+ *
+ * @param [out] evl loop to set up
+ * @param [in] conn_sz Size of the user's connection state, which starts
+ *             with struct aiopt_evl_conn
+ * @param [in] max_conns Connections served at a time; others are dropped
+ * @param [in] on_conn Handler of events on connections
+ * @param [in] on_close Called as a connection is closed; can be NULL
+ * @param [in] arg Of the user, available as evl->arg
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_evl_init(aiopt_evl_t *evl, size_t conn_sz, unsigned int max_conns,
+		   aiopt_evl_conn_hndlr on_conn,
+		   aiopt_evl_close_hndlr on_close, void *arg);
+
+/*
+ * @brief
+ * Accept connections on a listening socket, which the loop then owns
+ *
+ * @param [in] evl loop
+ * @param [in] lfd Non-blocking listening socket
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_evl_listen(aiopt_evl_t *evl, int lfd);
+
+/*
+ * @brief
+ * Call a handler whenever a descriptor (e.g. timerfd, pipe) is readable.
+ * The descriptor stays owned by the caller.
+ *
+ * @param [in] evl loop
+ * @param [in] fd descriptor
+ * @param [in] hndlr handler
+ * @param [in] arg passed to hndlr
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_evl_add(aiopt_evl_t *evl, int fd, aiopt_evl_src_hndlr hndlr,
+		  void *arg);
+
+/*
+ * @brief
+ * Run the loop until SIGINT, SIGTERM or evl->stop is set by a handler
+ *
+ * @param [in] evl loop
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if epoll_wait failed
+ */
+int aiopt_evl_run(aiopt_evl_t *evl);
+
+/*
+ * @brief
+ * Close a connection, on_close being called first. It is released once
+ * the events already taken by the loop are handled; until then its fd is -1
+ * and further events of it are dropped.
+ *
+ * @param [in] evl loop
+ * @param [in] conn connection
+ * @return void
+ */
+void aiopt_evl_close(aiopt_evl_t *evl, struct aiopt_evl_conn *conn);
+
+/*
+ * @brief
+ * Close all connections
+ *
+ * @param [in] evl loop
+ * @return void
+ */
+void aiopt_evl_close_all(aiopt_evl_t *evl);
+
+/*
+ * @brief
+ * Release the loop: connections, listening socket, epoll instance and
+ * signal pipe; the earlier SIGINT/SIGTERM handlers are restored
+ *
+ * @param [in] evl loop set up by aiopt_evl_init
+ * @return void
+ */
+void aiopt_evl_fini(aiopt_evl_t *evl);
+
+/*
+ * @brief
+ * Queue formatted bytes to be sent
+ *
+ * @param [in] o output of a connection, or any other to be copied to one
+ * @param [in] fmt printf style format
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if memory could not be allocated
+ */
+int aiopt_evl_printf(struct aiopt_evl_out *o, const char *fmt, ...);
+
+/*
+ * @brief
+ * Queue bytes to be sent
+ *
+ * @param [in] o output
+ * @param [in] data bytes
+ * @param [in] len number of bytes
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if memory could not be allocated
+ */
+int aiopt_evl_write(struct aiopt_evl_out *o, const void *data, size_t len);
+
+/*
+ * @brief
+ * Send as much of the queued output as the socket takes. EPOLLOUT is armed
+ * while output remains, and EPOLLIN if the caller wants input and the
+ * connection is not closing.
+ *
+ * @param [in] evl loop
+ * @param [in] conn connection
+ * @param [in] want_in TRUE to keep reading from the connection
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the connection is broken
+ */
+int aiopt_evl_flush(aiopt_evl_t *evl, struct aiopt_evl_conn *conn,
+		    short int want_in);
+
+#endif /* AIOPT_EVLOOP_H */
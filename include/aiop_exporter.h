@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_exporter.h
+ *
+ * @brief	AIOP Tool metrics exporter (exporter sub-command): tile state,
+ *		versions, time of day skew and MC command latencies in
+ *		OpenMetrics / Prometheus text format
+ *
+ */
+
+#ifndef AIOPT_EXPORTER_H
+#define AIOPT_EXPORTER_H
+
+#include <aiop_lib.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_EXP_DEF_INTERVAL_MS
+ * @brief Interval at which the metrics are refreshed when none is provided
+ */
+#define AIOPT_EXP_DEF_INTERVAL_MS	5000
+
+/** @def AIOPT_EXP_MIN_INTERVAL_MS
+ * @brief Shortest refresh interval accepted
+ */
+#define AIOPT_EXP_MIN_INTERVAL_MS	100
+
+/** @def AIOPT_EXP_METRICS_PATH
+ * @brief HTTP path the metrics are served on
+ */
+#define AIOPT_EXP_METRICS_PATH		"/metrics"
+
+/** @def AIOPT_EXP_MAX_CLIENTS
+ * @brief Maximum number of simultaneously connected HTTP clients
+ */
+#define AIOPT_EXP_MAX_CLIENTS		64
+
+/** @def AIOPT_EXP_REQ_MAX
+ * @brief Maximum size of an HTTP request head (request line and headers)
+ */
+#define AIOPT_EXP_REQ_MAX		4096
+
+/** @def AIOPT_EXP_CLIENT_TIMEOUT_MS
+ * @brief HTTP clients which have not sent a complete request in this time
+ * are dropped, at the next refresh
+ */
+#define AIOPT_EXP_CLIENT_TIMEOUT_MS	10000
+
+/*
+ * Metrics are rendered once per refresh interval, from one aiopt_snapshot
+ * call on the handle, into an OpenMetrics 1.0 page and a Prometheus text
+ * 0.0.4 page. A scrape only copies the page matching its Accept header; no
+ * MC command is sent on behalf of a scraper. The textfile (for the textfile
+ * collector of node_exporter) is written in Prometheus text format, which is
+ * what the collector parses, by rename of a temporary file.
+ *
+ *	aiop_up				1 if the last snapshot was complete
+ *	aiop_tile_state			stateset, by DPAIOP_STATE_* name
+ *	aiop_service_layer_info		Service Layer version
+ *	aiop_api_info			dpaiop API version
+ *	aiop_irq_status			pending events of the dpaiop IRQ
+ *	aiop_tod_skew_seconds		tile time of day minus host time
+ *	aiop_snapshot_duration_seconds	time taken by the MC commands
+ *	aiop_exporter_refreshes_total	refreshes, and those which failed
+ *	aiop_exporter_refresh_errors_total
+ *	aiop_mc_command_latency_seconds	histogram, by MC command
+ *	aiop_mc_command_errors_total	completions not OK, by command/status
+ *
+ * Samples carry container and dpaiop labels.
+ */
+
+/* ======================================================================
+ * Structures Declarations
+ * ======================================================================*/
+
+/*
+ * @brief Configuration of the exporter
+ */
+struct aiopt_exporter_conf {
+	const char	*container;	/**< Container of the handle; label >*/
+	const char	*listen;	/**< HTTP [address:]port, or NULL >*/
+	const char	*textfile;	/**< Textfile collector file, or NULL >*/
+	unsigned int	interval_ms;	/**< Refresh interval; 0 for default >*/
+};
+
+typedef struct aiopt_exporter_conf aiopt_exporter_conf_t;
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Export the metrics of the AIOP Tile of an initialized handle until SIGINT
+ * or SIGTERM, over HTTP and/or to a textfile, refreshing them every
+ * interval. At least one of listen and textfile must be given. The textfile
+ * is removed on exit, so that stale metrics are not collected.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf Exporter configuration
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_export(aiopt_handle_t handle, const aiopt_exporter_conf_t *conf);
+
+#endif /* AIOPT_EXPORTER_H */
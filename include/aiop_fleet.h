@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_fleet.h
+ *
+ * @brief	Fleet operations: one AIOP Tool operation executed on the AIOP
+ *		tiles of many containers in parallel
+ *
+ */
+
+#ifndef AIOPT_FLEET_H
+#define AIOPT_FLEET_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <aiop_lib.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_FLEET_MAX_MEMBERS
+ * @brief Maximum number of containers in a fleet
+ */
+#define AIOPT_FLEET_MAX_MEMBERS		64
+
+/** @def AIOPT_FLEET_NAME_LEN
+ * @brief Maximum length of a container name in a fleet, including NUL
+ */
+#define AIOPT_FLEET_NAME_LEN		32
+
+/** @def AIOPT_FLEET_DEF_WORKERS
+ * @brief Default number of worker threads; overridden by AIOPT_FLEET_WORKERS
+ * environment variable
+ */
+#define AIOPT_FLEET_DEF_WORKERS		8
+#define AIOPT_FLEET_WORKERS_ENV		"AIOPT_FLEET_WORKERS"
+
+/** @def AIOPT_FLEET_POLL_US
+ * @brief Interval at which resets submitted on the members are polled
+ */
+#define AIOPT_FLEET_POLL_US		100
+
+/** @def AIOPT_FLEET_SYSFS_DEVICES
+ * @brief Directory against which container globs are matched
+ */
+#define AIOPT_FLEET_SYSFS_DEVICES	"/sys/bus/fsl-mc/devices/"
+
+/* ======================================================================
+ * Structures Declarations
+ * ======================================================================*/
+
+/*
+ * @brief Operations which can be executed on a fleet
+ */
+enum aiopt_fleet_op {
+	AIOPT_FLEET_LOAD,
+	AIOPT_FLEET_STATUS,
+	AIOPT_FLEET_RESET,
+	AIOPT_FLEET_GETTOD,
+	AIOPT_FLEET_SETTOD,
+	AIOPT_FLEET_WAIT
+};
+
+/*
+ * @brief Operation, with its arguments, to execute on every fleet member
+ */
+struct aiopt_fleet_req {
+	enum aiopt_fleet_op op;
+	const char	*image_file;	/**< LOAD >*/
+	const char	*args_file;	/**< LOAD, optional >*/
+	const void	*args_mem;	/**< LOAD, args inline instead >*/
+	size_t		args_mem_sz;	/**< LOAD >*/
+	short int	reset;		/**< LOAD >*/
+	short int	skip;		/**< LOAD, see aiopt_set_load_skip >*/
+	size_t		image_max;	/**< LOAD, see aiopt_set_load_limits >*/
+	size_t		args_max;	/**< LOAD >*/
+	unsigned short int tpc;		/**< LOAD >*/
+	uint64_t	tod;		/**< SETTOD >*/
+	int		state;		/**< WAIT, state to wait for >*/
+	unsigned int	timeout_ms;	/**< LOAD, RESET, WAIT >*/
+};
+
+typedef struct aiopt_fleet_req aiopt_fleet_req_t;
+
+/*
+ * @brief A container of the fleet and the result of the last operation on it
+ */
+struct aiopt_fleet_member {
+	char		name[AIOPT_FLEET_NAME_LEN];
+	aiopt_handle_t	handle;		/**< Opened on first operation >*/
+	int		ret;		/**< AIOPT_SUCCESS or error >*/
+	short int	init_failed;	/**< handle could not be opened >*/
+	aiopt_status_t	status;		/**< STATUS; state only for LOAD,
+					  WAIT >*/
+	uint64_t	tod;		/**< GETTOD >*/
+	short int	skipped;	/**< LOAD, image was already running >*/
+	short int	reset_done;	/**< RESET, LOAD; reset ahead of the
+					  operation completed by MC >*/
+	uint64_t	elapsed_ns;	/**< Time taken, including init >*/
+};
+
+typedef struct aiopt_fleet_member aiopt_fleet_member_t;
+
+/*
+ * @brief Set of containers operated upon together
+ */
+struct aiopt_fleet {
+	unsigned int	count;
+	aiopt_fleet_member_t members[AIOPT_FLEET_MAX_MEMBERS];
+};
+
+typedef struct aiopt_fleet aiopt_fleet_t;
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Check if a container argument names more than one container, i.e. is a
+ * comma separated list or a glob pattern
+ *
+ * @param [in] spec container argument
+ * @return TRUE or FALSE
+ */
+int aiopt_fleet_is_spec(const char *spec);
+
+/*
+ * @brief
+ * Create a fleet from a comma separated list of container names and/or glob
+ * patterns (e.g. "dprc.2,dprc.3" or "dprc.*"). Patterns are matched against
+ * the fsl-mc bus devices in sysfs; duplicates are dropped. No container is
+ * opened until aiopt_fleet_run.
+ *
+ * @param [in] spec container list
+ * @return fleet or NULL if spec is invalid or matches nothing
+ */
+aiopt_fleet_t *aiopt_fleet_create(const char *spec);
+
+/*
+ * @brief
+ * Execute an operation on all members of the fleet, from a pool of worker
+ * threads. Members not yet opened are initialized (aiopt_init) by the
+ * workers as part of the operation; handles are kept open for subsequent
+ * operations.
+ * A reset (RESET, or LOAD with reset) is not run by the workers: once they
+ * have opened the members, the caller's thread submits it to MC on every
+ * member and polls them all until MC is done (aiopt_reset_submit,
+ * aiopt_poll). The load follows from the workers.
+ *
+ * @param [in] fleet fleet created by aiopt_fleet_create
+ * @param [in] req operation to execute
+ * @param [in] workers number of worker threads; 0 for the default
+ *
+ * @return AIOPT_SUCCESS if the operation succeeded on every member, else
+ *         AIOPT_FAILURE. Per member results are in fleet->members.
+ */
+int aiopt_fleet_run(aiopt_fleet_t *fleet, const aiopt_fleet_req_t *req,
+		    unsigned int workers);
+
+/*
+ * @brief
+ * Print the results of the last operation as a table, one row per member,
+ * followed by a summary line
+ *
+ * @param [in] fleet fleet
+ * @param [in] req operation last executed
+ * @param [in] fp stream to write to
+ * @return void
+ */
+void aiopt_fleet_print(aiopt_fleet_t *fleet, const aiopt_fleet_req_t *req,
+		       FILE *fp);
+
+/*
+ * @brief
+ * Deinitialize all opened members and release the fleet
+ *
+ * @param [in] fleet fleet
+ * @return void
+ */
+void aiopt_fleet_destroy(aiopt_fleet_t *fleet);
+
+#endif /* AIOPT_FLEET_H */
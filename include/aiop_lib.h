@@ -35,6 +35,8 @@
 #ifndef AIOPT_LIB_H
 #define AIOPT_LIB_H
 
+#include <stdio.h>
+
 /* Flib and VFIO Headers */
 #include <fsl_vfio.h>
 
@@ -50,22 +52,29 @@
 /** @def MAX_DPOBJ_DEVICES
  * @brief Number of devices which would be stored in the dpobj_type structure
  */
-#define MAX_DPOBJ_DEVICES	2 /**< Only dpmcp and dpaiop, single 
-					instance of each are supported >*/
+#define MAX_DPOBJ_DEVICES	2 /**< The dpmcp and dpaiop in use; see
+					aiopt_obj for all objects >*/
 
 /** @def MAX_AIOP_IMAGE_FILE_SZ
- * @breif Maximum size of an AIOP Image
+ * @breif Default maximum size of an AIOP Image, see aiopt_set_load_limits
  *
  */
 #define MAX_AIOP_IMAGE_FILE_SZ	(8 * 1024 * 1024) /**< 8 MB max size of AIOP
 							image file >*/
 
 /** @def MAX_AIOP_ARGS_FILE_SZ
- * @breif Maximum size of an AIOP Arguments
+ * @breif Default maximum size of an AIOP Arguments, see
+ * aiopt_set_load_limits
  *
  */
 #define MAX_AIOP_ARGS_FILE_SZ	(512) /**< 512 Bytes >*/
 
+/** @def AIOPT_MC_MAX_LOAD_SZ
+ * @brief Largest image or arguments MC can be handed: img_size of
+ * dpaiop_load and args_size of dpaiop_run are 32 bit wide
+ */
+#define AIOPT_MC_MAX_LOAD_SZ	((size_t)UINT32_MAX)
+
 
 /** @def AIOPT_INVALID_HANDLE
  * @brief Invalid AIOPT Handle
@@ -78,14 +87,129 @@
  */
 #define AIOPT_ALIGNED_PAGE_SZ	4096
 
+/** @def AIOPT_ALIGN_PAGE
+ * @brief Round a length up to AIOPT_ALIGNED_PAGE_SZ
+ */
+#define AIOPT_ALIGN_PAGE(_len)	\
+	(((_len) + AIOPT_ALIGNED_PAGE_SZ - 1) & \
+	 ~((size_t)AIOPT_ALIGNED_PAGE_SZ - 1))
+
+/** @def AIOPT_MAX_HUGEPAGE_SZ
+ * @brief Largest huge page used for the DMA arena. Larger default huge pages
+ * (e.g. 512MB with 64K base pages) would waste memory; normal pages are used
+ * instead.
+ */
+#define AIOPT_MAX_HUGEPAGE_SZ	(32 * 1024 * 1024)
+
+/** @def AIOPT_PORTAL_LOCK_DEF
+ * @brief Lock with which MC commands on the portal of a handle are
+ * serialized, until changed with aiopt_set_portal_lock. A mutex costs little
+ * when uncontended and lets waiters sleep through long commands.
+ */
+#define AIOPT_PORTAL_LOCK_DEF	MC_IO_LOCK_MUTEX
+
+/** @def AIOPT_MAX_PORTALS
+ * @brief Most dpmcp objects (MC portals) of a container used by a handle
+ */
+#define AIOPT_MAX_PORTALS	8
+
+/** @def AIOPT_AIOP_ID_ANY
+ * @brief For aiopt_init_aiop: the dpaiop of the container with the lowest ID
+ */
+#define AIOPT_AIOP_ID_ANY	(-1)
+
+/** @def AIOPT_HUGEPAGE_MIN_SZ
+ * @brief Smallest DMA arena backed by huge pages. A smaller one, rounded up
+ * to a whole huge page, would mostly be wasted; normal pages are used.
+ */
+#define AIOPT_HUGEPAGE_MIN_SZ	(1024 * 1024)
+
+/** @def AIOPT_AIOP_IRQ_INDEX
+ * @brief Index of the dpaiop IRQ signalling tile events (state changes)
+ */
+#define AIOPT_AIOP_IRQ_INDEX	0
+
+/** @def AIOPT_WAIT_FOREVER
+ * @brief Timeout of aiopt_wait_state for waiting without a limit
+ */
+#define AIOPT_WAIT_FOREVER	0
+
+/** @def AIOPT_WAIT_POLL_MS
+ * @brief Interval at which aiopt_wait_state polls the tile state when the
+ * dpaiop IRQ is not available
+ */
+#define AIOPT_WAIT_POLL_MS	10
+
+/** @def AIOPT_WAIT_IRQ_MAX_MS
+ * @brief Longest aiopt_wait_state blocks on the IRQ before re-reading the
+ * state anyway, in case an event was lost
+ */
+#define AIOPT_WAIT_IRQ_MAX_MS	1000
+
+/** @def AIOPT_LOAD_DEF_TIMEOUT_MS
+ * @brief Default limit for aiopt_load to take the tile from reset to RUNNING
+ */
+#define AIOPT_LOAD_DEF_TIMEOUT_MS	30000
+
+/** @def AIOPT_LOAD_POLL_US
+ * @brief Interval at which aiopt_load polls MC for completion of dpaiop_load
+ */
+#define AIOPT_LOAD_POLL_US	100
+
+/** @def AIOPT_LOAD_MAX_BUFS
+ * @brief Per-load buffers of the non-arena load path; image and arguments
+ * share one
+ */
+#define AIOPT_LOAD_MAX_BUFS	1
+
+/** @def AIOPT_IMAGE_CACHE_DIR
+ * @brief Directory holding, per tile, the key of the image last loaded on it.
+ * Being under /var/run, the records do not survive a reboot of the board.
+ * The simulator build keeps its records apart, so that they are never taken
+ * for those of a real tile.
+ */
+#ifdef AIOPT_MC_SIM
+#define AIOPT_IMAGE_CACHE_DIR	"/var/run/aiop_tool_sim"
+#else
+#define AIOPT_IMAGE_CACHE_DIR	"/var/run/aiop_tool"
+#endif
+
+/** @def AIOPT_CACHE_DIR_ENV
+ * @brief Environment variable which, if set, names the directory used instead
+ * of AIOPT_IMAGE_CACHE_DIR for image and topology records, e.g. by tests.
+ */
+#define AIOPT_CACHE_DIR_ENV	"AIOPT_CACHE_DIR"
+
+/** @def AIOPT_TOPO_CACHE_ENV
+ * @brief Environment variable which, set to 1, has aiopt_init also keep the
+ * topology of a container in AIOPT_IMAGE_CACHE_DIR/topo.<container>, for
+ * later runs of the tool. Within a process it is always kept in memory.
+ */
+#define AIOPT_TOPO_CACHE_ENV	"AIOPT_TOPO_CACHE"
+
+/** @def AIOPT_TOPO_CACHE_SZ
+ * @brief Containers whose topology is kept in memory
+ */
+#define AIOPT_TOPO_CACHE_SZ	16
+
+/** @def AIOPT_OBJ_NAME_MAX
+ * @brief Longest container or object name held in a topology record
+ */
+#define AIOPT_OBJ_NAME_MAX	32
+
+/** @def AIOPT_TOPO_MAX_OBJS
+ * @brief Most dpmcp and dpaiop objects of a container taken by aiopt_init
+ */
+#define AIOPT_TOPO_MAX_OBJS	64
+
 /* ======================================================================
  * Structures Declarations
  * ======================================================================*/
 
 /*
  * @brief Type of MC Devices supported by AIOP Tool
- * At present only dpmcp and dpaiop are supported (single instance of each)
- */ 
+ * At present only dpmcp and dpaiop are supported
+ */
 enum dpobj_type_list {
 	MCP_TYPE,
 	AIOP_TYPE,
@@ -99,6 +223,7 @@ typedef enum dpobj_type_list dpobj_type_list_t;
  */
 struct dpobj_type {
 	char *name; 			/**< Name of the device >*/
+	dpobj_type_list_t type;		/**< dpmcp or dpaiop >*/
 	unsigned short int token;	/**< Unique token for context XXX >*/
 	int id;				/**< Hardware ID of the device >*/
 	int fd;				/**< fd of the device in sysfs >*/
@@ -107,6 +232,161 @@ struct dpobj_type {
 
 typedef struct dpobj_type dpobj_type_t;
 
+/*
+ * @brief An MC portal (dpmcp) of a handle with the dpaiop session opened on
+ * it. Each MC command leases a portal of the handle for its duration, so
+ * that commands of several threads are issued on different portals.
+ */
+struct aiopt_portal {
+	char		*name;		/**< Name of the dpmcp object >*/
+	void		*addr;		/**< Portal, as mapped >*/
+	size_t		map_len;	/**< Mapped length; 0 if not mmap'd >*/
+	struct fsl_mc_io *mc_io;	/**< MC portal I/O for the session >*/
+	unsigned short int token;	/**< dpaiop session on this portal >*/
+	short int	session_open;	/**< TRUE if token is valid >*/
+	short int	leased;		/**< TRUE while a command uses it >*/
+};
+
+typedef struct aiopt_portal aiopt_portal_t;
+
+/*
+ * @brief DMA arena: a buffer DMA mapped once, into which images and their
+ * arguments are read on every load, avoiding a map/unmap per load.
+ */
+struct aiopt_dma_arena {
+	void		*addr;		/**< Start of arena, NULL if not set up >*/
+	uint64_t	iova;		/**< Device address of addr >*/
+	size_t		size;		/**< Mapped length >*/
+	size_t		page_sz;	/**< Huge page size, or base page size >*/
+	short int	hugepage;	/**< TRUE if backed by hugetlbfs >*/
+	unsigned long	loads;		/**< Loads served from the arena >*/
+};
+
+typedef struct aiopt_dma_arena aiopt_dma_arena_t;
+
+/*
+ * @brief A DMA mapped buffer, as used for a single load
+ */
+struct aiopt_dma_buf {
+	void		*addr;		/**< Start of buffer, NULL if unused >*/
+	uint64_t	iova;		/**< Device address of addr >*/
+	size_t		len;		/**< Mapped length >*/
+};
+
+typedef struct aiopt_dma_buf aiopt_dma_buf_t;
+
+/*
+ * @brief Objects of a container, as found in sysfs by aiopt_init. A record
+ * holds as long as the devices directory of the IOMMU group keeps its inode
+ * and modification time.
+ */
+struct aiopt_topo {
+	char		container[AIOPT_OBJ_NAME_MAX];
+	int		groupid;	/**< IOMMU group of the container >*/
+	unsigned long	ino;		/**< Of SYSFS_IOMMU_PATH_VSTR >*/
+	struct timespec	mtime;		/**< Of SYSFS_IOMMU_PATH_VSTR >*/
+	unsigned int	nobjs;
+	/* dpaiop objects, then dpmcp objects, each by ID */
+	char		objs[AIOPT_TOPO_MAX_OBJS][AIOPT_OBJ_NAME_MAX];
+};
+
+typedef struct aiopt_topo aiopt_topo_t;
+
+/*
+ * @brief Where the topology of the container came from in aiopt_init
+ */
+enum aiopt_topo_src {
+	AIOPT_TOPO_SCANNED,		/**< sysfs, no valid record >*/
+	AIOPT_TOPO_MEMORY,		/**< Record of an earlier aiopt_init >*/
+	AIOPT_TOPO_DISK			/**< Record of an earlier run, see
+					  AIOPT_TOPO_CACHE_ENV >*/
+};
+
+/*
+ * @brief Time taken by the phases of aiopt_init, in nanoseconds
+ */
+struct aiopt_init_report {
+	uint64_t	vfio_ns;	/**< IOMMU group and VFIO container >*/
+	uint64_t	topology_ns;	/**< Finding the dpmcp/dpaiop objects >*/
+	uint64_t	devices_ns;	/**< dpaiop device fd and info >*/
+	uint64_t	portals_ns;	/**< Mapping the MC portals >*/
+	uint64_t	sessions_ns;	/**< Opening dpaiop on every portal >*/
+	uint64_t	irq_ns;		/**< Setting up the dpaiop IRQ >*/
+	uint64_t	total_ns;
+	int		topo_src;	/**< enum aiopt_topo_src >*/
+};
+
+typedef struct aiopt_init_report aiopt_init_report_t;
+
+/*
+ * @brief An object of the container of a handle, as listed by aiopt_list
+ */
+struct aiopt_dpobj_info {
+	char		name[AIOPT_OBJ_NAME_MAX];
+	int		type;		/**< dpobj_type_list_t >*/
+	int		id;
+	int		num_irqs;	/**< As reported by VFIO; -1 if not
+					  known >*/
+	int		state;		/**< Tile state of a dpaiop; -1 if not
+					  read, or not a dpaiop >*/
+	short int	in_use;		/**< TRUE for the dpaiop of the handle
+					  and the portals it uses >*/
+};
+
+typedef struct aiopt_dpobj_info aiopt_dpobj_info_t;
+
+/*
+ * @brief Timeline of an aiopt_load. Timestamps are in nanoseconds since
+ * aiopt_load was called; 0 if the phase was not reached.
+ */
+struct aiopt_load_report {
+	uint64_t	prepared_ns;	/**< Image and args read, DMA mapped >*/
+	uint64_t	reset_ns;	/**< Tile in RESET_DONE, if reset >*/
+	uint64_t	loaded_ns;	/**< Tile in LOAD_DONE >*/
+	uint64_t	booting_ns;	/**< dpaiop_run accepted >*/
+	uint64_t	running_ns;	/**< Tile in RUNNING >*/
+	uint64_t	total_ns;	/**< aiopt_load returned >*/
+	int		state;		/**< Last tile state seen, or -1 >*/
+	short int	skipped;	/**< TRUE if the same image was
+					  already RUNNING, see
+					  aiopt_set_load_skip >*/
+};
+
+typedef struct aiopt_load_report aiopt_load_report_t;
+
+/*
+ * @brief Identity of a load: hash over the image and arguments contents,
+ * along with their sizes and the threads per core. The hash is fast, not
+ * cryptographic; it tells apart builds, not deliberately forged images.
+ */
+struct aiopt_image_key {
+	uint64_t	hash;		/**< Over image, then arguments >*/
+	uint64_t	image_sz;
+	uint64_t	args_sz;	/**< 0 without arguments >*/
+	unsigned int	tpc;
+};
+
+typedef struct aiopt_image_key aiopt_image_key_t;
+
+/*
+ * @brief Largest image and arguments aiopt_load accepts on a handle, see
+ * aiopt_set_load_limits. The image limit applies to a compressed image once
+ * decompressed.
+ */
+struct aiopt_load_limits {
+	size_t		image_max;	/**< Bytes, MAX_AIOP_IMAGE_FILE_SZ
+					  by default >*/
+	size_t		args_max;	/**< Bytes, MAX_AIOP_ARGS_FILE_SZ by
+					  default >*/
+};
+
+typedef struct aiopt_load_limits aiopt_load_limits_t;
+
+struct fsl_mc_io;
+struct mc_wait_policy;
+struct aiopt_mcsim;
+struct aiopt_async;
+
 /*
  * @brief Container for all internally used objects for AIOP lib
  * This would be exposed by aiopt_handle_t
@@ -118,6 +398,51 @@ struct aiopt_obj {
 		int64_t		mcp_addr64;
 	};
 	dpobj_type_t devices[MAX_DPOBJ_DEVICES];
+	dpobj_type_t	*objs;		/**< Every dpaiop and dpmcp object of
+					  the container, as in aiopt_topo >*/
+	unsigned int	num_objs;
+	/* MC portals of the container, each with a dpaiop session opened in
+	 * aiopt_init and held until aiopt_deinit. portals[0] is
+	 * devices[MCP_TYPE], mapped at mcp_addr.
+	 */
+	aiopt_portal_t	portals[AIOPT_MAX_PORTALS];
+	unsigned int	num_portals;	/**< Portals with a session open >*/
+	pthread_mutex_t	pool_lock;	/**< Guards leased flags of portals >*/
+	pthread_cond_t	pool_cond;	/**< Signalled as a portal is
+					  returned >*/
+	struct aiopt_mcsim *sim;	/**< MC simulator serving the portal,
+					  NULL on hardware >*/
+	aiopt_dma_arena_t arena;	/**< Optional, see
+					  aiopt_dma_arena_setup >*/
+	int		irq_fd;		/**< eventfd signalled by the dpaiop
+					  IRQ; -1 if IRQ is not set up >*/
+	pthread_mutex_t	irq_lock;	/**< Guards irq_seq, irq_polling >*/
+	pthread_cond_t	irq_cond;	/**< Signalled as irq_seq changes or
+					  irq_polling is cleared >*/
+	uint64_t	irq_seq;	/**< IRQ events acknowledged >*/
+	short int	irq_polling;	/**< A waiter polls irq_fd >*/
+	unsigned int	load_timeout_ms; /**< See aiopt_set_load_timeout >*/
+	aiopt_load_report_t load_report; /**< Of the last aiopt_load >*/
+	aiopt_dma_buf_t	held_bufs[AIOPT_LOAD_MAX_BUFS]; /**< Buffers of a load
+					  which did not complete, possibly
+					  still read by MC; released once it
+					  is done (see load_pending) >*/
+	short int	load_pending;	/**< TRUE from dpaiop_load until the
+					  tile is RUNNING; the buffer of the
+					  load (arena or held_bufs) is in use
+					  while the tile is LOAD_ONGOING or
+					  BOOT_ONGOING >*/
+	short int	load_skip;	/**< See aiopt_set_load_skip >*/
+	struct aiopt_async *async;	/**< Command submitted with
+					  aiopt_reset_submit, until reaped
+					  by aiopt_poll; NULL if none >*/
+	short int	image_key_valid; /**< TRUE if image_key is that of the
+					  image RUNNING on the tile >*/
+	aiopt_image_key_t image_key;	/**< Kept in memory in case the
+					  record under AIOPT_IMAGE_CACHE_DIR
+					  cannot be written >*/
+	aiopt_load_limits_t limits;	/**< See aiopt_set_load_limits >*/
+	aiopt_init_report_t init_report; /**< See aiopt_get_init_report >*/
 };
 
 typedef struct aiopt_obj aiopt_obj_t;
@@ -142,34 +467,286 @@ struct aiopt_status {
 
 typedef struct aiopt_status aiopt_status_t;
 
+/** @def AIOPT_SNAP_*
+ * @brief Fields of an aiopt_snapshot_t read from MC; see its valid member
+ */
+#define AIOPT_SNAP_STATE	0x01
+#define AIOPT_SNAP_SL_VERSION	0x02
+#define AIOPT_SNAP_API_VERSION	0x04
+#define AIOPT_SNAP_ATTR		0x08
+#define AIOPT_SNAP_IRQ		0x10
+#define AIOPT_SNAP_TOD		0x20
+#define AIOPT_SNAP_ALL		0x3f
+
+/*
+ * @brief Telemetry of the AIOP Tile, read by aiopt_snapshot in a single
+ * batch of MC commands on one session
+ */
+struct aiopt_snapshot {
+	unsigned int	valid;		/**< AIOPT_SNAP_* fields read >*/
+	int		state;		/**< dpaiop_get_state >*/
+	int		id;		/**< dpaiop_get_attributes >*/
+	int		major_v;	/**< dpaiop_get_api_version >*/
+	int		minor_v;
+	int		sl_major_v;	/**< dpaiop_get_sl_version >*/
+	int		sl_minor_v;
+	int		sl_revision;
+	uint32_t	irq_status;	/**< Pending events of the dpaiop IRQ;
+					  not cleared by the read >*/
+	uint64_t	tod;		/**< Time of day of the tile >*/
+	uint64_t	taken_ns;	/**< CLOCK_MONOTONIC at the first command >*/
+	uint64_t	mc_ns;		/**< Time taken by the batch >*/
+};
+
+typedef struct aiopt_snapshot aiopt_snapshot_t;
+
 /* ======================================================================
  * Externally available Function Declarations
  * ======================================================================*/
 
-/* Initialization and deinitalization routines */
+/* Initialization and deinitalization routines.
+ * aiopt_init opens the dpaiop session which is used by all command handlers
+ * on the handle; aiopt_deinit closes it.
+ * When built with AIOPT_MC_SIM, aiopt_init does not touch VFIO or sysfs; the
+ * handle is served by the software MC simulator (aiop_mc_sim.h), whose
+ * objects stand for those of the container. The container name only names
+ * its topology record.
+ */
 aiopt_handle_t aiopt_init(const char *container_name);
 int aiopt_deinit(aiopt_handle_t obj);
 
+/*
+ * @brief
+ * As aiopt_init, for the dpaiop of the container with ID aiop_id, in a
+ * container holding several. aiopt_init takes the one with the lowest ID.
+ *
+ * @param [in] container_name Name of the container
+ * @param [in] aiop_id ID of the dpaiop, or AIOPT_AIOP_ID_ANY
+ *
+ * @return Handle, or AIOPT_INVALID_HANDLE if there is no such dpaiop
+ */
+aiopt_handle_t aiopt_init_aiop(const char *container_name, int aiop_id);
+
 /* Command handlers */
 /*
  * @brief
  * AIOPT load call for loading an AIOP Image on a dpaiop object belonging to
  * provided (or default) container.
+ * The call returns once the tile is RUNNING, has failed (LOAD_ERROR or
+ * BOOT_ERROR) or the load timeout (aiopt_set_load_timeout) has expired; the
+ * tile state is followed through RESET_ONGOING, LOAD_ONGOING and
+ * BOOT_ONGOING with aiopt_wait_state. Image and arguments stay DMA mapped
+ * until then, as MC and the booting tile read them. If the call returns
+ * before (e.g. AIOPT_ETIMEDOUT), their buffer stays reserved until the tile
+ * has left LOAD_ONGOING and BOOT_ONGOING, or has been reset: a load meanwhile
+ * fails with AIOPT_EBUSY, unless with reset, which resets the tile first.
+ * The timeline of the load is available from aiopt_get_load_report.
+ * The ELF and program headers of the image are checked first
+ * (aiopt_elf_check). If the image has a sidecar digest file
+ * (AIOPT_CRC32C_SIDECAR_EXT), the CRC32C of the image, computed as it is
+ * read, must match it. Images failing either check do not touch the tile.
  *
  * @param [in] handle aiopt_handle_t type valid object
  * @param [in] ifile AIOP Image file name, with path
  * @param [in] reset Flag to state if reset is to be done before load operation
  * @param [in] tpc threads per AIOP core configuration
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBADIMAGE,
+ *         AIOPT_EBUSY or AIOPT_FAILURE
  */
 int aiopt_load(aiopt_handle_t handle, const char *ifile,
 	       const char *afile, short int reset, unsigned short int tpc);
 
+/*
+ * @brief
+ * As aiopt_load, with the arguments taken from memory rather than a file;
+ * e.g. generated by the caller. They are copied, and may be released once
+ * the call returns.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] ifile AIOP Image file name, with path
+ * @param [in] args Arguments; NULL for none
+ * @param [in] args_sz Size of args
+ * @param [in] reset Flag to state if reset is to be done before load operation
+ * @param [in] tpc threads per AIOP core configuration
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBADIMAGE,
+ *         AIOPT_EBUSY or AIOPT_FAILURE
+ */
+int aiopt_load_args_mem(aiopt_handle_t handle, const char *ifile,
+			const void *args, size_t args_sz, short int reset,
+			unsigned short int tpc);
+
+/*
+ * @brief
+ * As aiopt_load, with the image and arguments held in memory by the caller.
+ * Both are copied, into the DMA arena if set up, else into one buffer DMA
+ * mapped for the load, and may be released once the call returns. The image
+ * must be an uncompressed ELF; it has no CRC sidecar.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] image AIOP Image
+ * @param [in] image_sz Size of image
+ * @param [in] args Arguments; NULL for none
+ * @param [in] args_sz Size of args
+ * @param [in] reset Flag to state if reset is to be done before load operation
+ * @param [in] tpc threads per AIOP core configuration
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBADIMAGE,
+ *         AIOPT_EBUSY or AIOPT_FAILURE
+ */
+int aiopt_load_mem(aiopt_handle_t handle, const void *image, size_t image_sz,
+		   const void *args, size_t args_sz, short int reset,
+		   unsigned short int tpc);
+
+/*
+ * @brief
+ * Set the limit for aiopt_load to take the tile to RUNNING, including the
+ * reset, load and boot of the tile.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] timeout_ms Limit in milliseconds, or AIOPT_WAIT_FOREVER.
+ *             Default is AIOPT_LOAD_DEF_TIMEOUT_MS.
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_set_load_timeout(aiopt_handle_t handle, unsigned int timeout_ms);
+
+/*
+ * @brief
+ * Make aiopt_load skip images which are already running. Every successful
+ * load records the key (aiopt_image_key_t) of the image, arguments and tpc
+ * for the tile, under AIOPT_IMAGE_CACHE_DIR and on the handle. With skipping
+ * enabled, aiopt_load hashes the image and arguments and, if the key matches
+ * the record and the tile is RUNNING, returns without reset, DMA mapping or
+ * MC load; the report of the load is then marked skipped.
+ * The record is dropped on reset and before loading; tiles loaded by other
+ * means than aiopt_load are not seen.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] skip TRUE to skip loading an image already running, FALSE
+ *             (default) to always load
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_set_load_skip(aiopt_handle_t handle, short int skip);
+
+/*
+ * @brief
+ * Set the largest image and arguments aiopt_load accepts on the handle.
+ * Limits are checked against what MC can be handed (AIOPT_MC_MAX_LOAD_SZ).
+ * If the handle has a DMA arena too small for the new limits, it is grown;
+ * should that fail, loads map their buffers per load instead.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] image_max Bytes; 0 for MAX_AIOP_IMAGE_FILE_SZ
+ * @param [in] args_max Bytes; 0 for MAX_AIOP_ARGS_FILE_SZ
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if a limit is out of range
+ */
+int aiopt_set_load_limits(aiopt_handle_t handle, size_t image_max,
+			  size_t args_max);
+
+/*
+ * @brief
+ * Obtain the load limits of the handle
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] limits Limits in force
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_get_load_limits(aiopt_handle_t handle,
+			  aiopt_load_limits_t *limits);
+
+/*
+ * @brief
+ * Set the IOVA window from which DMA mappings of the handle take their
+ * device addresses; by default FSL_IOVA_DEF_SIZE bytes at FSL_IOVA_DEF_BASE.
+ * The window is per VFIO container and can only be changed while nothing
+ * is mapped in it, i.e. before aiopt_dma_arena_setup or the first load.
+ * It must lie within what the SMMU translates and clear of the MSI region.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] base Start of the window, page aligned
+ * @param [in] size Length of the window, page aligned
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_set_iova_window(aiopt_handle_t handle, uint64_t base,
+			  uint64_t size);
+
+/*
+ * @brief
+ * Obtain the timeline of the last aiopt_load on the handle
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] report Timeline and final tile state
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_get_load_report(aiopt_handle_t handle, aiopt_load_report_t *report);
+
+/*
+ * @brief
+ * Print a load timeline, as obtained from aiopt_get_load_report
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] report Timeline to print
+ *
+ * @return void
+ */
+void aiopt_dump_load_report(FILE *fp, const aiopt_load_report_t *report);
+
+/*
+ * @brief
+ * Fetch the time taken by the phases of aiopt_init for the handle
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] report Filled with the phases of aiopt_init
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_get_init_report(aiopt_handle_t handle, aiopt_init_report_t *report);
+
+/*
+ * @brief
+ * Print the phases of aiopt_init, as obtained from aiopt_get_init_report
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] report Phases to print
+ *
+ * @return void
+ */
+void aiopt_dump_init_report(FILE *fp, const aiopt_init_report_t *report);
+
+/*
+ * @brief
+ * Set up the DMA arena of the handle. The arena is allocated from huge pages
+ * (hugetlbfs) when available, else from normal pages, and DMA mapped once.
+ * Subsequent aiopt_load calls read the image and arguments straight into it
+ * rather than mapping the files and DMA mapping them on every load. The arena
+ * is released by aiopt_deinit.
+ * Calling again with a size which fits the existing arena is a no-op; a
+ * larger one replaces it, unless an earlier load may still read it (see
+ * aiopt_load).
+ * Huge pages are only used for an arena of AIOPT_HUGEPAGE_MIN_SZ or more.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] size Bytes to reserve; 0 to fit the largest image and
+ *             arguments allowed by the load limits of the handle
+ *
+ * @return AIOPT_SUCCESS, AIOPT_EBUSY or AIOPT_FAILURE
+ */
+int aiopt_dma_arena_setup(aiopt_handle_t handle, size_t size);
+
 /*
  * @brief
  * AIOPT Status call. Returns information about State of AIOP Tile, Version
- * information and Service Layer Version information
+ * information and Service Layer Version information. Only State and Service
+ * Layer Version are required; ID and API Version are best-effort: if MC
+ * does not return them, id is the dpaiop of the handle and major_v/minor_v
+ * are -1.
  *
  * @param [in] handle aiopt_handle_t type valid object
  * @param [out] s aiopt_status_t instance object which would be filled in
@@ -178,6 +755,52 @@ int aiopt_load(aiopt_handle_t handle, const char *ifile,
  */
 int aiopt_status(aiopt_handle_t handle, aiopt_status_t *s);
 
+/*
+ * @brief
+ * Read all the telemetry of the AIOP Tile in one call: state, Service Layer
+ * and API versions, attributes, IRQ status and time of day. The commands are
+ * issued back to back on a single leased portal and its open session; if MC
+ * has expired the token, the session is re-opened once and the batch
+ * re-issued. Meant to be called on every scrape of an exporter.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] snap Filled in; valid tells which fields were read
+ *
+ * @return AIOPT_SUCCESS if every field was read, else AIOPT_FAILURE
+ */
+int aiopt_snapshot(aiopt_handle_t handle, aiopt_snapshot_t *snap);
+
+/*
+ * @brief
+ * List every dpaiop and dpmcp object of the container of the handle, with
+ * its IRQ count and, for a dpaiop, its tile state. Objects are queried in
+ * parallel, over the portals of the handle; a dpaiop other than that of the
+ * handle is opened for the query and closed again.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] info Filled with up to max objects; dpaiop objects first,
+ *              each type by ID
+ * @param [in] max Size of info; 0 to only count the objects
+ * @param [out] count Number of objects in the container
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_list(aiopt_handle_t handle, aiopt_dpobj_info_t *info,
+	       unsigned int max, unsigned int *count);
+
+/*
+ * @brief
+ * Print objects, as obtained from aiopt_list, one per line
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] info Objects to print
+ * @param [in] count Number of objects in info
+ *
+ * @return void
+ */
+void aiopt_dump_list(FILE *fp, const aiopt_dpobj_info_t *info,
+		     unsigned int count);
+
 /*
  * @brief
  * AIOPT Reset call for performing Reset of a AIOP Tile.
@@ -189,6 +812,36 @@ int aiopt_status(aiopt_handle_t handle, aiopt_status_t *s);
  */
 int aiopt_reset(aiopt_handle_t handle);
 
+/*
+ * @brief
+ * Submit a reset of the AIOP tile to MC and return at once, leaving MC to
+ * work on it. The caller is free to service other handles meanwhile, and
+ * reaps the command with aiopt_poll. A portal of the handle stays leased
+ * until then; one such command can be outstanding per handle.
+ * As with aiopt_reset, the tile is RESET_DONE some time after the command
+ * completes (see aiopt_wait_state).
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ *
+ * @return AIOPT_SUCCESS if submitted, AIOPT_EBUSY if a command submitted
+ *         earlier is not reaped yet, or AIOPT_FAILURE
+ */
+int aiopt_reset_submit(aiopt_handle_t handle);
+
+/*
+ * @brief
+ * Check, without blocking, for completion of the command submitted with
+ * aiopt_reset_submit. Once it is complete, its portal is returned to the
+ * handle.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ *
+ * @return AIOPT_EINPROGRESS while MC is working on the command;
+ *         AIOPT_SUCCESS or AIOPT_FAILURE once it is done, or if no command
+ *         was submitted
+ */
+int aiopt_poll(aiopt_handle_t handle);
+
 /*
  * @brief
  * Convert MC State to String
@@ -198,6 +851,37 @@ int aiopt_reset(aiopt_handle_t handle);
  */
 const char *aiopt_get_state_str(int state);
 
+/*
+ * @brief
+ * Convert a State name to MC State. Names are matched without case, with or
+ * without the DPAIOP_STATE_ prefix (e.g. "RUNNING", "dpaiop_state_running").
+ *
+ * @param [in] str State name
+ * @return State as returned by dpaiop_get_state, or AIOPT_FAILURE if str
+ *         names no State
+ */
+int aiopt_get_state_from_str(const char *str);
+
+/*
+ * @brief
+ * Wait for the AIOP Tile to reach a State. The tile state is re-read each
+ * time the dpaiop IRQ fires (tile events are routed to an eventfd by
+ * aiopt_init); if the IRQ could not be set up, it is polled every
+ * AIOPT_WAIT_POLL_MS instead.
+ * Waiting stops early if the tile reaches LOAD_ERROR or BOOT_ERROR, unless
+ * that is the State waited for.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] state State to wait for, as returned by dpaiop_get_state
+ * @param [in] timeout_ms Time limit in milliseconds, or AIOPT_WAIT_FOREVER
+ * @param [out] cur_state Last State read from the tile; can be NULL
+ *
+ * @return AIOPT_SUCCESS once State is reached, AIOPT_ETIMEDOUT if it is not
+ *         reached in time, else AIOPT_FAILURE
+ */
+int aiopt_wait_state(aiopt_handle_t handle, int state,
+		     unsigned int timeout_ms, int *cur_state);
+
 /*
  * @brief
  * AIOPT Get Time of Day
@@ -220,4 +904,69 @@ int aiopt_gettod(aiopt_handle_t, uint64_t *tod);
  */
 int aiopt_settod(aiopt_handle_t, uint64_t tod);
 
+/*
+ * @brief
+ * Set the policy with which MC command completion is waited upon (busy-spin,
+ * relax/yield, sleep back-off and timeout). Counters of how the wait was
+ * spent are dumped in debug output on aiopt_deinit.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] policy Wait policy; NULL restores the default. Must stay valid
+ *             for the lifetime of the handle.
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_set_wait_policy(aiopt_handle_t handle,
+			  const struct mc_wait_policy *policy);
+
+/*
+ * @brief
+ * Set how MC commands issued on an MC portal of the handle are serialized
+ * (AIOPT_PORTAL_LOCK_DEF by default). A command holds the lock from
+ * submission to completion. Commands of the handle lease a portal each, from
+ * all the dpmcp objects of the container, so the lock only matters to
+ * commands issued on its portal otherwise. Only to be called while no other
+ * thread uses the handle.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] type MC_IO_LOCK_MUTEX, MC_IO_LOCK_SPIN for short commands
+ *             only, or MC_IO_LOCK_NONE for a handle of a single thread
+ *             (see fsl_mc_sys.h)
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_set_portal_lock(aiopt_handle_t handle, int type);
+
+/*
+ * @brief
+ * Dump the per-command-ID MC statistics: count, completions by MC status and
+ * latency (min/avg/percentiles/max, from an HDR-style histogram). Statistics
+ * are process-wide and cover every MC command sent since start.
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] json TRUE for a JSON document, FALSE for a text table
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_mc_stats_dump(FILE *fp, short int json);
+
+/*
+ * @brief
+ * Convert an MC command ID to a printable name
+ *
+ * @param [in] cmd_id Command ID as found in the MC command header
+ * @return const string naming the command
+ */
+const char *aiopt_mc_cmd_str(uint16_t cmd_id);
+
+/*
+ * @brief
+ * Convert an MC command completion status, as counted by the MC statistics,
+ * to a printable name
+ *
+ * @param [in] status enum mc_cmd_status value or MC_STATS_TIMEOUT
+ * @return const string naming the status
+ */
+const char *aiopt_mc_status_str(unsigned int status);
+
 #endif /* AIOPT_LIB_H */
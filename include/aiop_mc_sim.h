@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file	aiop_mc_sim.h
+ *
+ * @brief	Software MC portal simulator for running AIOP Tool without
+ *		hardware
+ *
+ */
+
+#ifndef AIOPT_MC_SIM_H
+#define AIOPT_MC_SIM_H
+
+#include <stdint.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_MCSIM_MAX_PORTALS
+ * @brief Maximum number of dpmcp portals served by a simulator instance
+ */
+#define AIOPT_MCSIM_MAX_PORTALS		16
+
+/** @def AIOPT_MCSIM_MAX_AIOPS
+ * @brief Maximum number of dpaiop objects modelled by a simulator instance
+ */
+#define AIOPT_MCSIM_MAX_AIOPS		16
+
+/** @def AIOPT_MCSIM_MAX_SESSIONS
+ * @brief Maximum number of dpaiop_open tokens outstanding at a time
+ */
+#define AIOPT_MCSIM_MAX_SESSIONS	64
+
+/** @def AIOPT_MCSIM_IRQ_STATE_CHANGE
+ * @brief IRQ status bit raised by the simulator on every tile state change
+ */
+#define AIOPT_MCSIM_IRQ_STATE_CHANGE	0x00000001
+
+/* ======================================================================
+ * Structures Declarations
+ * ======================================================================*/
+
+/*
+ * @brief Configuration of the simulated MC
+ * Latencies are in micro-seconds. Commands are answered after cmd_latency,
+ * except dpaiop_load and dpaiop_reset which take load_latency and
+ * reset_latency. After dpaiop_run the tile stays in BOOT_ONGOING for
+ * boot_latency.
+ */
+struct aiopt_mcsim_conf {
+	unsigned int num_portals;	/**< dpmcp objects (portals) >*/
+	unsigned int num_aiops;		/**< dpaiop objects, id 0..n-1 >*/
+	unsigned int cmd_latency;	/**< Latency of a command, us >*/
+	unsigned int load_latency;	/**< Latency of dpaiop_load, us >*/
+	unsigned int boot_latency;	/**< BOOT_ONGOING duration, us >*/
+	unsigned int reset_latency;	/**< Latency of dpaiop_reset, us >*/
+	unsigned int fail_state;	/**< DPAIOP_STATE_LOAD_ERROR or
+					  DPAIOP_STATE_BOOT_ERROR to inject a
+					  failure; 0 for none >*/
+	unsigned int token_lifetime;	/**< Commands after which MC rejects a
+					  token (AUTH_ERR); 0 for never >*/
+	unsigned int check_image;	/**< Fail load if image is not ELF >*/
+};
+
+typedef struct aiopt_mcsim_conf aiopt_mcsim_conf_t;
+
+/*
+ * @brief Opaque simulator instance
+ */
+typedef struct aiopt_mcsim aiopt_mcsim_t;
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Fill conf with default values and override them from the environment:
+ * AIOPT_SIM_PORTALS, AIOPT_SIM_AIOPS, AIOPT_SIM_CMD_US, AIOPT_SIM_LOAD_US,
+ * AIOPT_SIM_BOOT_US, AIOPT_SIM_RESET_US, AIOPT_SIM_FAIL (load|boot),
+ * AIOPT_SIM_TOKEN_LIFETIME and AIOPT_SIM_CHECK_IMAGE.
+ *
+ * @param [out] conf configuration to fill
+ * @return void
+ */
+void aiopt_mcsim_conf_init(aiopt_mcsim_conf_t *conf);
+
+/*
+ * @brief
+ * Create the simulated portals and start the thread serving them.
+ * In-process only: image and args IOVA passed to MC are treated as virtual
+ * addresses of the calling process.
+ *
+ * @param [in] conf simulator configuration
+ * @return simulator instance or NULL on failure
+ */
+aiopt_mcsim_t *aiopt_mcsim_start(const aiopt_mcsim_conf_t *conf);
+
+/*
+ * @brief
+ * Stop the serving thread and release the simulated portals
+ *
+ * @param [in] sim simulator instance
+ * @return void
+ */
+void aiopt_mcsim_stop(aiopt_mcsim_t *sim);
+
+/*
+ * @brief
+ * Obtain the memory region of a simulated portal. This is what
+ * struct fsl_mc_io.regs is pointed at.
+ *
+ * @param [in] sim simulator instance
+ * @param [in] idx index of the portal, 0..num_portals-1
+ * @return portal address or NULL if idx is out of range
+ */
+void *aiopt_mcsim_portal(aiopt_mcsim_t *sim, unsigned int idx);
+
+/*
+ * @brief
+ * Configuration the simulator was started with, e.g. to list the objects it
+ * simulates
+ *
+ * @param [in] sim simulator instance
+ * @param [out] conf configuration
+ * @return void
+ */
+void aiopt_mcsim_get_conf(aiopt_mcsim_t *sim, aiopt_mcsim_conf_t *conf);
+
+/*
+ * @brief
+ * Route the IRQ of a simulated dpaiop to an eventfd; the simulator's
+ * counterpart of VFIO_DEVICE_SET_IRQS. The eventfd is signalled whenever an
+ * event unmasked by dpaiop_set_irq_mask is raised while the IRQ is enabled
+ * with dpaiop_set_irq_enable. Tile state changes raise
+ * AIOPT_MCSIM_IRQ_STATE_CHANGE.
+ *
+ * @param [in] sim simulator instance
+ * @param [in] aiop id of the dpaiop, 0..num_aiops-1
+ * @param [in] fd eventfd to signal, or -1 to detach
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if aiop is out of range
+ */
+int aiopt_mcsim_set_irq_fd(aiopt_mcsim_t *sim, unsigned int aiop, int fd);
+
+#endif /* AIOPT_MC_SIM_H */
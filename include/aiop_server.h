@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_server.h
+ *
+ * @brief	AIOP Tool daemon (serve sub-command) and its thin client
+ *
+ */
+
+#ifndef AIOPT_SERVER_H
+#define AIOPT_SERVER_H
+
+#include <aiop_tool.h>
+#include <aiop_lib.h>
+
+/* ======================================================================
+ * Macros and Static Declarations
+ * ======================================================================*/
+
+/** @def AIOPT_SOCKET_ENV_VAR
+ * @brief Environment variable holding the control socket path. When set,
+ * sub-commands are sent to the daemon listening on it.
+ */
+#define AIOPT_SOCKET_ENV_VAR	"AIOPT_SOCKET"
+
+/** @def AIOPT_DEF_SOCKET_PATH
+ * @brief Control socket used by 'serve' when no path is provided
+ */
+#define AIOPT_DEF_SOCKET_PATH	"/var/run/aiop_tool.sock"
+
+/** @def AIOPT_SRV_LINE_MAX
+ * @brief Maximum length of a request line, including the newline
+ */
+#define AIOPT_SRV_LINE_MAX	1024
+
+/** @def AIOPT_SRV_MAX_CLIENTS
+ * @brief Maximum number of simultaneously connected clients
+ */
+#define AIOPT_SRV_MAX_CLIENTS	256
+
+/** @def AIOPT_SRV_WAIT_MAX_MS
+ * @brief Longest a 'wait' request is served for. A wait holds up the later
+ * requests of its client, and the daemon when stopped.
+ */
+#define AIOPT_SRV_WAIT_MAX_MS	60000
+
+/*
+ * Wire protocol: line based, over a SOCK_STREAM Unix domain socket. A client
+ * may send any number of requests on a connection; they are answered in
+ * order. Each request is one line of space separated words:
+ *
+ *	ping
+ *	status
+ *	gettod
+ *	settod <time in ms>
+ *	reset
+ *	load <image path> [args=<args path>] [reset] [tpc=<n>]
+ *	     [timeout=<ms>] [skip]
+ *	stats [json]
+ *	wait <state name> [<timeout in ms>]
+ *	list
+ *
+ * Paths are opened by the daemon, so must be absolute and must not contain
+ * spaces. Each response is zero or more data lines, starting with "+ ",
+ * followed by a line "OK" or "ERR <code> <text>". Data lines are:
+ *
+ *	status:	"+ version <id> <major> <minor>",
+ *		"+ sl_version <major> <minor> <revision>", "+ state <state>"
+ *	gettod:	"+ tod <time in ms>"
+ *	stats:	the aiopt_mc_stats_dump output, one line per data line
+ *	list:	the aiopt_dump_list output, one line per data line
+ *	load:	"+ load_report <state> <prepared> <reset> <loaded> <booting>
+ *		<running> <total> <skipped>", times in ns as in
+ *		aiopt_load_report_t, also on error
+ *	wait:	"+ state <state>", also on error
+ *
+ * A wait is limited to AIOPT_SRV_WAIT_MAX_MS; ERR code is AIOPT_ETIMEDOUT if
+ * the state was not reached in time.
+ */
+
+/* ======================================================================
+ * Externally available Function Declarations
+ * ======================================================================*/
+
+/*
+ * @brief
+ * Serve requests on a Unix domain socket, on an initialized handle, until
+ * SIGINT or SIGTERM. Many clients are multiplexed with epoll, and their
+ * requests executed by the event loop, except for load, reset and wait
+ * which are executed on worker threads (one load or reset at a time) so as
+ * not to hold up other clients. Requests of a client are answered in
+ * order. On stop, requests in progress are let to complete.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] path Socket path; NULL for AIOPT_DEF_SOCKET_PATH
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_serve(aiopt_handle_t handle, const char *path);
+
+/*
+ * @brief
+ * Execute a sub-command through the daemon listening on conf->socket and
+ * print its result the same way the sub-command does when run locally.
+ *
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int aiopt_client_run(aiopt_conf_t *conf);
+
+#endif /* AIOPT_SERVER_H */
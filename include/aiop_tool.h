@@ -45,6 +45,10 @@
 #define AIOPT_SUCCESS	0	/**< Success of a Method/Function >*/
 #define AIOPT_FAILURE	(-1)	/**< Failure of a Method/Function >*/
 #define AIOPT_ENOMEM	(-ENOMEM) /**< NO Memory to allocate >*/
+#define AIOPT_ETIMEDOUT	(-ETIMEDOUT) /**< Operation did not complete in time >*/
+#define AIOPT_EBADIMAGE	(-EBADMSG) /**< AIOP Image failed verification >*/
+#define AIOPT_EBUSY	(-EBUSY) /**< An earlier load or command is in progress >*/
+#define AIOPT_EINPROGRESS (-EINPROGRESS) /**< MC is working on a command >*/
 
 #define FALSE		0
 #define TRUE		1
@@ -52,6 +56,11 @@
 /* Error Codes */
 #define AIOPT_INT_ERROR	AIOPT_FAILURE	/**< Internal Failure of tool > */
 
+/* Exit status of the tool when a sub-command times out (AIOPT_ETIMEDOUT);
+ * same as timeout(1). Other failures exit with a non-zero status too.
+ */
+#define AIOPT_EXIT_TIMEOUT	124
+
 #include <fsl_vfio.h>
 
 /* ===========================================================================
@@ -67,12 +76,26 @@ struct aiop_tool_conf {
 	char		*container; /**< Container Name string >*/
 	char		*image_file; /**< AIOP Image file for Load command >*/
 	char		*args_file; /**< AIOP Arguments file for Load command >*/
+	const void	*args_mem; /**< Or inline AIOP Arguments, or NULL >*/
+	size_t		args_mem_sz; /**< Size of args_mem >*/
 	unsigned short int reset_flag; /**< Reset option for Load command >*/
+	unsigned short int skip_flag; /**< Skip Load of a running image >*/
 	unsigned short int debug_flag; /**< DEBUG Output, DEBUG/DEV >*/
 	unsigned short int verbose_flag; /**< verbose Output, INFO >*/
 	unsigned short int tpc; /**< threads per AIOP core >*/
 	unsigned short int tpc_flag; /**< Enabled if tpc provided by user >*/
 	uint64_t	tod; /**< Time of Day, for settod >*/
+	unsigned short int json_flag; /**< JSON output, for stats >*/
+	char		*socket; /**< Daemon control socket, or NULL >*/
+	int		wait_state; /**< Tile state to wait for, for wait >*/
+	unsigned int	timeout_ms; /**< Wait/load limit; 0 for no limit >*/
+	unsigned short int timeout_flag; /**< Enabled if timeout provided >*/
+	size_t		image_max; /**< Load limit of image; 0 for default >*/
+	size_t		args_max; /**< Load limit of args; 0 for default >*/
+	int		aiop_id; /**< dpaiop to use, or AIOPT_AIOP_ID_ANY >*/
+	char		*listen; /**< Exporter HTTP address, or NULL >*/
+	char		*textfile; /**< Exporter textfile, or NULL >*/
+	unsigned int	interval_ms; /**< Exporter refresh; 0 for default >*/
 };
 
 typedef struct aiop_tool_conf aiopt_conf_t;
@@ -54,5 +54,10 @@ int dummy_perform_aiop_reset(fsl_vfio_t handle, aiopt_conf_t *conf);
 int dummy_perform_aiop_get_status(fsl_vfio_t handle, aiopt_conf_t *conf);
 int dummy_perform_aiop_gettod(fsl_vfio_t handle, aiopt_conf_t *conf);
 int dummy_perform_aiop_settod(fsl_vfio_t handle, aiopt_conf_t *conf);
+int dummy_perform_aiop_stats(fsl_vfio_t handle, aiopt_conf_t *conf);
+int dummy_perform_aiop_serve(fsl_vfio_t handle, aiopt_conf_t *conf);
+int dummy_perform_aiop_wait(fsl_vfio_t handle, aiopt_conf_t *conf);
+int dummy_perform_aiop_list(fsl_vfio_t handle, aiopt_conf_t *conf);
+int dummy_perform_aiop_exporter(fsl_vfio_t handle, aiopt_conf_t *conf);
 
 #endif
@@ -49,6 +49,10 @@
 #include <aiop_cmd.h>
 #include <aiop_tool.h>
 #include <aiop_logger.h>
+#include <aiop_lib.h>
+#include <aiop_server.h>
+#include <aiop_exporter.h>
+#include <aiop_fleet.h>
 
 /* For unit Testing of Command Line Handling */
 #include <aiop_tool_dummy.h>
@@ -64,6 +68,11 @@ int reset_cmd_hndlr(int argc, char **argv);
 int status_cmd_hndlr(int argc, char **argv);
 int gettod_cmd_hndlr(int argc, char **argv);
 int settod_cmd_hndlr(int argc, char **argv);
+int stats_cmd_hndlr(int argc, char **argv);
+int serve_cmd_hndlr(int argc, char **argv);
+int wait_cmd_hndlr(int argc, char **argv);
+int list_cmd_hndlr(int argc, char **argv);
+int exporter_cmd_hndlr(int argc, char **argv);
 static inline void usage(const char *tool_name, const char *error_str);
 
 /* ===========================================================================
@@ -77,6 +86,11 @@ struct command cmd_table[MAX_SUB_COMMANDS] = {
 	{"status", status_cmd_hndlr},
 	{"gettod", gettod_cmd_hndlr},
 	{"settod", settod_cmd_hndlr},
+	{"stats", stats_cmd_hndlr},
+	{"serve", serve_cmd_hndlr},
+	{"wait", wait_cmd_hndlr},
+	{"list", list_cmd_hndlr},
+	{"exporter", exporter_cmd_hndlr},
 	{NULL, NULL}
 };
 
@@ -113,16 +127,35 @@ dump_cmdline_args(void)
 		"    Container Name: %s\n"
 		"    Image File: %s\n"
 		"    Args File: %s\n"
+		"    Inline Args: %lu bytes\n"
 		"    Time of Day: %lu\n"
 		"    Threads per core: %u\n"
 		"    Reset Flag: %s\n"
+		"    Skip If Same: %s\n"
+		"    Max Image/Args Size: %lu/%lu\n"
+		"    JSON Output: %s\n"
+		"    Daemon Socket: %s\n"
+		"    AIOP ID: %s\n"
+		"    Exporter Listen/Textfile: %s/%s\n"
+		"    Refresh Interval: %u ms\n"
 		"    Debug: %s\n",
 		gvars.container_name ? gvars.container_name : NULL,
 		gvars.image_file ? gvars.image_file : NULL,
 		gvars.args_file,
+		gvars.args_mem_sz,
 		gvars.tod_val,
 		gvars.tpc_flag ? gvars.tpc : DEFAULT_THREAD_PER_CORE,
 		gvars.reset_flag ? "Yes" : "No",
+		gvars.skip_flag ? "Yes" : "No",
+		gvars.image_max ? gvars.image_max : MAX_AIOP_IMAGE_FILE_SZ,
+		gvars.args_max ? gvars.args_max : MAX_AIOP_ARGS_FILE_SZ,
+		gvars.json_flag ? "Yes" : "No",
+		gvars.socket_flag ? gvars.socket_path : "None",
+		gvars.aiop_id_flag ? gvars.aiop_id_str : "Lowest",
+		gvars.listen_flag ? gvars.listen : "None",
+		gvars.textfile_flag ? gvars.textfile : "None",
+		gvars.interval_flag ? gvars.interval_ms :
+				      AIOPT_EXP_DEF_INTERVAL_MS,
 		gvars.debug_flag ? "Yes" : "No");
 	if (gvars.container_name_flag > 0 &&
 			gvars.container_name_flag < sizeof(container_from))
@@ -175,13 +208,17 @@ check_if_valid_arg(const char *str, char c)
 static inline void
 container_name_from_args(const char *arg)
 {
-	int c_len;
+	int c_len, max_len;
+
+	/* A list/pattern of containers is split and validated by the fleet */
+	max_len = aiopt_fleet_is_spec(arg) ? MAX_CONTAINER_SPEC_LEN :
+					     MAX_CONTAINER_NAME_LEN;
 
 	c_len = strlen(arg);
-	if (c_len >= MAX_CONTAINER_NAME_LEN || c_len <= 0) {
+	if (c_len >= max_len || c_len <= 0) {
 		/* Exceeds max container name length */
 		AIOPT_ERR("Container name length incorrect: "
-			"(%d)(max:%d)\n", c_len, MAX_CONTAINER_NAME_LEN);
+			"(%d)(max:%d)\n", c_len, max_len);
 		/* Container name provided by User is ignored*/
 		return;
 	}
@@ -255,10 +292,118 @@ error_out:
 	return AIOPT_FAILURE;
 }
 
+/*
+ * @brief
+ * Helper to read AIOP command-line argument data from stdin, against
+ * '-a -'
+ *
+ * @param void
+ * @return AIOPT_SUCCESS, or AIOPT_FAILURE if stdin could not be read
+ */
+static int
+args_from_stdin(void)
+{
+	unsigned char *buf = NULL, *tmp;
+	size_t len = 0, cap = 0;
+	ssize_t n;
+
+	for (;;) {
+		if (len == cap) {
+			cap = cap ? cap * 2 : AIOPT_ALIGNED_PAGE_SZ;
+			if (cap > AIOPT_MC_MAX_LOAD_SZ) {
+				AIOPT_ERR("Args on stdin larger than MC "
+					  "accepts.\n");
+				goto error_out;
+			}
+			tmp = realloc(buf, cap);
+			if (!tmp) {
+				AIOPT_ERR("Unable to allocate memory for "
+					  "args.\n");
+				goto error_out;
+			}
+			buf = tmp;
+		}
+
+		n = read(STDIN_FILENO, buf + len, cap - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			AIOPT_ERR("Unable to read args from stdin (err=%d)\n",
+				  errno);
+			goto error_out;
+		}
+		if (n == 0)
+			break;
+		len += n;
+	}
+
+	if (!len) {
+		AIOPT_ERR("No args on stdin.\n");
+		goto error_out;
+	}
+
+	gvars.args_mem = buf;
+	gvars.args_mem_sz = len;
+	gvars.args_mem_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+
+error_out:
+	free(buf);
+	return AIOPT_FAILURE;
+}
+
+/*
+ * @brief
+ * Helper to extract AIOP command-line argument data given as a string of
+ * hex digits (optionally prefixed 0x), against --args-hex
+ *
+ * @param [in] hex string passed by user
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not an even number of hex digits
+ */
+static int
+args_hex_from_args(const char *hex)
+{
+	size_t i, len;
+	unsigned int byte;
+	unsigned char *buf;
+
+	if (gvars.args_file_flag || gvars.args_mem_flag) {
+		AIOPT_ERR("Args given more than once.\n");
+		return AIOPT_FAILURE;
+	}
+
+	if (!strncmp(hex, "0x", 2) || !strncmp(hex, "0X", 2))
+		hex += 2;
+
+	len = strlen(hex);
+	if (!len || len % 2 || strspn(hex, "0123456789abcdefABCDEF") != len) {
+		AIOPT_ERR("Incorrect hex args: (%s)\n", hex);
+		return AIOPT_FAILURE;
+	}
+
+	buf = malloc(len / 2);
+	if (!buf) {
+		AIOPT_ERR("Unable to allocate memory for args.\n");
+		return AIOPT_FAILURE;
+	}
+
+	for (i = 0; i < len / 2; i++) {
+		sscanf(hex + 2 * i, "%2x", &byte);
+		buf[i] = byte;
+	}
+
+	gvars.args_mem = buf;
+	gvars.args_mem_sz = len / 2;
+	gvars.args_mem_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
 /*
  * @brief
  * Helper to extract the name of file containing AIOP command-line argument data
- * from argument list
+ * from argument list. '-' reads the data from stdin instead.
  *
  * @param [in] args file string passed as argument by user, against -a option
  * @return AIOPT_SUCCESS if string can be extracted, else AIOPT_FAILURE.
@@ -280,6 +425,14 @@ args_file_from_args(const char *args_file)
 		goto error_out;
 	}
 
+	if (gvars.args_file_flag || gvars.args_mem_flag) {
+		AIOPT_ERR("Args given more than once.\n");
+		goto error_out;
+	}
+
+	if (!strcmp(args_file, "-"))
+		return args_from_stdin();
+
 	file_len = strlen(args_file);
 	if (file_len <= 0 || file_len > MAX_PATH_LEN) {
 		AIOPT_ERR("Filename provided longer than allowed.\n");
@@ -397,6 +550,232 @@ verbose_flag_from_args(void)
 	gvars.verbose_flag = TRUE;
 }
 
+/*
+ * @brief
+ * Helper to extract JSON output toggle against argument -j
+ *
+ * @param void
+ * @return void
+ */
+static void inline
+json_flag_from_args(void)
+{
+	/* Machine readable output for sub-commands which dump data */
+	gvars.json_flag = TRUE;
+}
+
+/*
+ * @brief
+ * Helper to extract the daemon control socket path against argument -s
+ *
+ * @param [in] path socket path passed by user
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if path is too long
+ */
+static int
+socket_path_from_args(const char *path)
+{
+	int len;
+
+	len = strlen(path);
+	if (len <= 0 || len >= MAX_PATH_LEN) {
+		AIOPT_ERR("Socket path length incorrect: (%d)(max:%d)\n",
+			len, MAX_PATH_LEN);
+		return AIOPT_FAILURE;
+	}
+
+	strcpy(gvars.socket_path, path);
+	gvars.socket_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Helper to extract the tile state to wait for against argument -S
+ *
+ * @param [in] name state name passed by user, e.g. RUNNING
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if name is not a tile state
+ */
+static int
+state_from_args(const char *name)
+{
+	int state;
+
+	state = aiopt_get_state_from_str(name);
+	if (state == AIOPT_FAILURE) {
+		AIOPT_ERR("Unknown AIOP Tile state: (%s)\n", name);
+		return AIOPT_FAILURE;
+	}
+
+	gvars.state = state;
+	gvars.state_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Helper to extract/update skip flag against argument -k passed by user
+ *
+ * @param void
+ * @return void
+ */
+static void inline
+skip_flag_from_args(void)
+{
+	/* Load is skipped if the image, args and tpc are those the tile is
+	 * already running
+	 */
+	gvars.skip_flag = TRUE;
+}
+
+/*
+ * @brief
+ * Helper to extract the time limit, in milliseconds, against argument -T
+ *
+ * @param [in] timestr time limit passed by user
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not a number
+ */
+static int
+timeout_from_args(const char *timestr)
+{
+	char *err_str;
+	unsigned long timeout;
+
+	errno = 0;
+	timeout = strtoul(timestr, &err_str, 10);
+	if (errno != 0 || *err_str != '\0' || timeout > UINT_MAX) {
+		AIOPT_ERR("Incorrect timeout: (%s)\n", timestr);
+		return AIOPT_FAILURE;
+	}
+
+	gvars.timeout_ms = timeout;
+	gvars.timeout_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Helper to extract the ID of the dpaiop to operate on, against argument -i
+ *
+ * @param [in] idstr ID passed by user
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not an ID
+ */
+static int
+aiop_id_from_args(const char *idstr)
+{
+	char *err_str;
+	unsigned long id;
+
+	errno = 0;
+	id = strtoul(idstr, &err_str, 10);
+	if (errno != 0 || err_str == idstr || *err_str != '\0' ||
+	    id > INT_MAX || strlen(idstr) >= sizeof(gvars.aiop_id_str)) {
+		AIOPT_ERR("Incorrect AIOP ID: (%s)\n", idstr);
+		return AIOPT_FAILURE;
+	}
+
+	gvars.aiop_id = id;
+	strcpy(gvars.aiop_id_str, idstr);
+	gvars.aiop_id_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Helper to extract a path or address against arguments -l and -o
+ *
+ * @param [in] str path or address passed by user
+ * @param [out] dst buffer of MAX_PATH_LEN bytes
+ * @param [out] flag set once dst is filled
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if str is too long
+ */
+static int
+exporter_str_from_args(const char *str, char *dst, short int *flag)
+{
+	int len;
+
+	len = strlen(str);
+	if (len <= 0 || len >= MAX_PATH_LEN) {
+		AIOPT_ERR("Argument length incorrect: (%d)(max:%d)\n",
+			len, MAX_PATH_LEN);
+		return AIOPT_FAILURE;
+	}
+
+	strcpy(dst, str);
+	*flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Helper to extract the refresh interval, in milliseconds, against
+ * argument -I
+ *
+ * @param [in] intervalstr interval passed by user
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not a number, or too short
+ */
+static int
+interval_from_args(const char *intervalstr)
+{
+	char *err_str;
+	unsigned long interval;
+
+	errno = 0;
+	interval = strtoul(intervalstr, &err_str, 10);
+	if (errno != 0 || err_str == intervalstr || *err_str != '\0' ||
+	    interval > UINT_MAX || interval < AIOPT_EXP_MIN_INTERVAL_MS) {
+		AIOPT_ERR("Incorrect interval: (%s)(min:%d)\n", intervalstr,
+			AIOPT_EXP_MIN_INTERVAL_MS);
+		return AIOPT_FAILURE;
+	}
+
+	gvars.interval_ms = interval;
+	gvars.interval_flag = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Helper to extract a size in bytes, against arguments -M and -m. A K or M
+ * suffix multiplies by 1024 or 1024*1024.
+ *
+ * @param [in] sizestr size passed by user
+ * @param [out] size size in bytes
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not a size
+ */
+static int
+size_from_args(const char *sizestr, size_t *size)
+{
+	char *err_str;
+	unsigned long val;
+	unsigned int shift = 0;
+
+	errno = 0;
+	val = strtoul(sizestr, &err_str, 10);
+	if (*err_str == 'K' || *err_str == 'k') {
+		shift = 10;
+		err_str++;
+	} else if (*err_str == 'M' || *err_str == 'm') {
+		shift = 20;
+		err_str++;
+	}
+
+	if (errno != 0 || err_str == sizestr || *err_str != '\0' ||
+	    val > (ULONG_MAX >> shift)) {
+		AIOPT_ERR("Incorrect size: (%s)\n", sizestr);
+		return AIOPT_FAILURE;
+	}
+
+	*size = (size_t)val << shift;
+
+	return AIOPT_SUCCESS;
+}
+
 /*
  * @brief
  * Helper to extract Time of day passed as argument to -t option
@@ -472,7 +851,8 @@ get_container_from_env(void)
 
 	/* Else, if env variable is available, copy-in */
 	len = strlen(c_name);
-	if (len >= MAX_CONTAINER_NAME_LEN) {
+	if (len >= (aiopt_fleet_is_spec(c_name) ? MAX_CONTAINER_SPEC_LEN :
+						  MAX_CONTAINER_NAME_LEN)) {
 		AIOPT_DEBUG("Len of env variable larger than expected\n");
 		return;
 	}
@@ -489,6 +869,35 @@ get_container_from_env(void)
 	return;
 }
 
+/*
+ * @brief
+ * Helper to extract the daemon control socket path if set as environment
+ * variable. A path provided with -s overrides it.
+ *
+ * @param void
+ * @return void
+ */
+static void
+get_socket_from_env(void)
+{
+	char *path = NULL;
+
+	path = getenv(AIOPT_SOCKET_ENV_VAR);
+	if (!path || !strlen(path))
+		return;
+
+	if (strlen(path) >= MAX_PATH_LEN) {
+		AIOPT_DEBUG("Len of env variable larger than expected\n");
+		return;
+	}
+
+	strcpy(gvars.socket_path, path);
+	gvars.socket_flag = TRUE;
+
+	AIOPT_DEBUG("Daemon socket found set in env: %s\n",
+			gvars.socket_path);
+}
+
 /*
  * @brief
  * A generic command handler. For all command handlers, the options are parsed
@@ -508,7 +917,7 @@ generic_cmd_hndlr(int argc, char **argv, char *valid_args)
 {
 	int ret = AIOPT_SUCCESS;
 	int opt;
-	char *opt_str = "+g:f:a:t:rdvc:";
+	char *opt_str = "+g:f:a:t:rdvc:js:S:T:kM:m:x:i:l:o:I:";
 
 	static struct option longopts[] = {
 		{"container", required_argument, NULL, 'g'},
@@ -519,6 +928,18 @@ generic_cmd_hndlr(int argc, char **argv, char *valid_args)
 		{"debug", no_argument, NULL, 'd'},
 		{"verbose", no_argument, NULL, 'v'},
 		{"threadpercore", required_argument, NULL, 'c'},
+		{"json", no_argument, NULL, 'j'},
+		{"socket", required_argument, NULL, 's'},
+		{"state", required_argument, NULL, 'S'},
+		{"timeout", required_argument, NULL, 'T'},
+		{"skip-if-same", no_argument, NULL, 'k'},
+		{"max-image-size", required_argument, NULL, 'M'},
+		{"max-args-size", required_argument, NULL, 'm'},
+		{"args-hex", required_argument, NULL, 'x'},
+		{"aiop-id", required_argument, NULL, 'i'},
+		{"listen", required_argument, NULL, 'l'},
+		{"textfile", required_argument, NULL, 'o'},
+		{"interval", required_argument, NULL, 'I'},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -620,6 +1041,128 @@ generic_cmd_hndlr(int argc, char **argv, char *valid_args)
 			AIOPT_DEV("Provided with 'd' -%s-\n", optarg);
 			thread_per_core_from_args(optarg);
 			break;
+		case 'j':
+			ret = check_if_valid_arg(valid_args,'j');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'j');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'j'\n");
+			json_flag_from_args();
+			break;
+		case 's':
+			ret = check_if_valid_arg(valid_args,'s');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 's');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 's' -%s-\n", optarg);
+			ret = socket_path_from_args(optarg);
+			break;
+		case 'S':
+			ret = check_if_valid_arg(valid_args,'S');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'S');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'S' -%s-\n", optarg);
+			ret = state_from_args(optarg);
+			break;
+		case 'T':
+			ret = check_if_valid_arg(valid_args,'T');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'T');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'T' -%s-\n", optarg);
+			ret = timeout_from_args(optarg);
+			break;
+		case 'k':
+			ret = check_if_valid_arg(valid_args,'k');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'k');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'k'\n");
+			skip_flag_from_args();
+			break;
+		case 'M':
+			ret = check_if_valid_arg(valid_args,'M');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'M');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'M' -%s-\n", optarg);
+			ret = size_from_args(optarg, &gvars.image_max);
+			break;
+		case 'm':
+			ret = check_if_valid_arg(valid_args,'m');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'm');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'm' -%s-\n", optarg);
+			ret = size_from_args(optarg, &gvars.args_max);
+			break;
+		case 'x':
+			ret = check_if_valid_arg(valid_args,'x');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'x');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'x' -%s-\n", optarg);
+			ret = args_hex_from_args(optarg);
+			break;
+		case 'i':
+			ret = check_if_valid_arg(valid_args,'i');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'i');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'i' -%s-\n", optarg);
+			ret = aiop_id_from_args(optarg);
+			break;
+		case 'l':
+			ret = check_if_valid_arg(valid_args,'l');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'l');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'l' -%s-\n", optarg);
+			ret = exporter_str_from_args(optarg, gvars.listen,
+						     &gvars.listen_flag);
+			break;
+		case 'o':
+			ret = check_if_valid_arg(valid_args,'o');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'o');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'o' -%s-\n", optarg);
+			ret = exporter_str_from_args(optarg, gvars.textfile,
+						     &gvars.textfile_flag);
+			break;
+		case 'I':
+			ret = check_if_valid_arg(valid_args,'I');
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_ERR("Invalid arg (%c) provided\n", 'I');
+				break;
+			}
+
+			AIOPT_DEV("Provided with 'I' -%s-\n", optarg);
+			ret = interval_from_args(optarg);
+			break;
 		case '?':
 		default:
 			AIOPT_ERR("Incorrect or Incomplete args.\n");
@@ -689,6 +1232,11 @@ usage(const char *tool_name, const char *error_str)
 	printf("  gettod: Fetch the Time of Day.\n");
 	printf("  settod: Set the Time of Day.\n");
 	printf("  status: Status of the AIOP Tile.\n");
+	printf("  stats:  MC command counters and latency histograms.\n");
+	printf("  serve:  Run as daemon serving other invocations.\n");
+	printf("  wait:   Wait for the AIOP Tile to reach a state.\n");
+	printf("  list:   dpaiop and dpmcp objects of the container.\n");
+	printf("  exporter: Serve tile metrics for Prometheus.\n");
 	printf("Following are sub-command specific arguments\n");
 	printf("  help: No Arguments\n");
 	printf("  status:\n");
@@ -700,15 +1248,51 @@ usage(const char *tool_name, const char *error_str)
 	printf("                         Also: --file\n");
 	printf("    -a <AIOP Args Path>  Optional: Path of a valid file \n");
 	printf("                         containing AIOP command-line argument data\n");
+	printf("                         '-' reads the data from stdin.\n");
 	printf("                         Also: --args-file\n");
+	printf("    -x <Hex string>      Optional: AIOP command-line argument\n");
+	printf("                         data as hex digits, instead of -a.\n");
+	printf("                         Also: --args-hex\n");
 	printf("    -r                   Optional: Reset AIOP tile before\n");
 	printf("                         performing load. If not provided,\n");
 	printf("                         reset would not be done\n");
 	printf("                         Also: --reset\n");
 	printf("    -c                   Optional: Threads per AIOP core to execute\n");
 	printf("                         Also: --threadpercore\n");
+	printf("    -T <Timeout>         Optional: Time limit, in\n");
+	printf("                         milliseconds, for the tile to be\n");
+	printf("                         RUNNING; 0 for no limit.\n");
+	printf("                         Default: %d\n",
+		AIOPT_LOAD_DEF_TIMEOUT_MS);
+	printf("                         Also: --timeout\n");
+	printf("    -k                   Optional: Skip the load if the tile\n");
+	printf("                         is RUNNING the same image, args\n");
+	printf("                         and threads per core, as recorded\n");
+	printf("                         by an earlier load under %s\n",
+		AIOPT_IMAGE_CACHE_DIR);
+	printf("                         (or under %s, if set)\n",
+		AIOPT_CACHE_DIR_ENV);
+	printf("                         Also: --skip-if-same\n");
+	printf("    -M <Size>            Optional: Largest image, once\n");
+	printf("                         decompressed, in bytes; K and M\n");
+	printf("                         suffixes are accepted.\n");
+	printf("                         Default: %d\n", MAX_AIOP_IMAGE_FILE_SZ);
+	printf("                         Also: --max-image-size\n");
+	printf("    -m <Size>            Optional: Largest arguments file, in\n");
+	printf("                         bytes; K and M suffixes are accepted.\n");
+	printf("                         Default: %d\n", MAX_AIOP_ARGS_FILE_SZ);
+	printf("                         Also: --max-args-size\n");
+	printf("                         With -s, the limits of the daemon\n");
+	printf("                         apply instead.\n");
 	printf("  reset:\n");
 	printf("                         No mandatory arguments.\n");
+	printf("    -T <Timeout>         Optional: Time limit, in\n");
+	printf("                         milliseconds, for MC to reset the\n");
+	printf("                         tiles of multiple containers (-g);\n");
+	printf("                         0 for no limit.\n");
+	printf("                         Default: %d\n",
+		AIOPT_LOAD_DEF_TIMEOUT_MS);
+	printf("                         Also: --timeout\n");
 	printf("  gettod:\n");
 	printf("                         No mandatory arguments.\n");
 	printf("  settod:\n");
@@ -716,16 +1300,78 @@ usage(const char *tool_name, const char *error_str)
 	printf("                         Mandatory: Time, in milliseconds\n");
 	printf("                         provided as string\n");
 	printf("                         Also: --timeofday\n");
+	printf("  stats:\n");
+	printf("                         Counts the MC commands of the\n");
+	printf("                         process: give -s for those of the\n");
+	printf("                         daemon; without it, only the few\n");
+	printf("                         commands of stats itself.\n");
+	printf("    -j                   Optional: Output as JSON instead of\n");
+	printf("                         a text table.\n");
+	printf("                         Also: --json\n");
+	printf("  serve:\n");
+	printf("    -s <Socket path>     Optional: Unix socket to listen on.\n");
+	printf("                         Default: %s\n",
+		AIOPT_DEF_SOCKET_PATH);
+	printf("                         Also: --socket\n");
+	printf("    -M <Size>, -m <Size> Optional: Load limits, as for load,\n");
+	printf("                         for loads through the daemon.\n");
+	printf("  wait:\n");
+	printf("    -S <State>           Mandatory: State to wait for, e.g.\n");
+	printf("                         RUNNING, LOAD_DONE, RESET_DONE.\n");
+	printf("                         Waiting ends early on LOAD_ERROR\n");
+	printf("                         or BOOT_ERROR.\n");
+	printf("                         Also: --state\n");
+	printf("    -T <Timeout>         Optional: Time limit, in\n");
+	printf("                         milliseconds. Default: no limit\n");
+	printf("                         Also: --timeout\n");
+	printf("  list:\n");
+	printf("                         No mandatory arguments. Prints\n");
+	printf("                         every object with its ID, IRQ\n");
+	printf("                         count and, for a dpaiop, state.\n");
+	printf("  exporter:\n");
+	printf("    -l <[Address:]Port>  Serve the metrics over HTTP on\n");
+	printf("                         %s, e.g. :9100 or\n",
+		AIOPT_EXP_METRICS_PATH);
+	printf("                         127.0.0.1:9100.\n");
+	printf("                         Also: --listen\n");
+	printf("    -o <File path>       Write the metrics to the file, for\n");
+	printf("                         the textfile collector of\n");
+	printf("                         node_exporter.\n");
+	printf("                         Also: --textfile\n");
+	printf("                         At least one of -l and -o is\n");
+	printf("                         mandatory.\n");
+	printf("    -I <Interval>        Optional: Refresh interval, in\n");
+	printf("                         milliseconds. Default: %d\n",
+		AIOPT_EXP_DEF_INTERVAL_MS);
+	printf("                         Also: --interval\n");
 	printf("\n");
 	printf("Arguments valid for all sub-commands:\n");
 	printf("    -g <Container name>  Optional: Name of the container\n");
 	printf("                         containing the dpaiop object.\n");
+	printf("                         load, reset, status, gettod, settod\n");
+	printf("                         and wait also take a comma separated\n");
+	printf("                         list and/or glob of containers\n");
+	printf("                         (e.g. dprc.2,dprc.3 or 'dprc.*')\n");
+	printf("                         and run on all of them in parallel.\n");
 	printf("                         Also: --container\n");
+	printf("    -i <AIOP ID>         Optional: ID of the dpaiop to operate\n");
+	printf("                         on, in a container with several.\n");
+	printf("                         Default: the lowest. Not valid\n");
+	printf("                         with -s, nor with several\n");
+	printf("                         containers.\n");
+	printf("                         Also: --aiop-id\n");
 	printf("    -v                   Optional: Enable verbose output.\n");
 	printf("                         Also: --verbose\n");
 	printf("    -d                   Optional: Enable debug output.\n");
 	printf("                         This would also enable -v.\n");
 	printf("                         Also: --debug\n");
+	printf("    -s <Socket path>     Optional: Execute the sub-command\n");
+	printf("                         through the daemon ('serve')\n");
+	printf("                         listening on the socket. Can also\n");
+	printf("                         be set through environment\n");
+	printf("                         variable '%s'.\n",
+		AIOPT_SOCKET_ENV_VAR);
+	printf("                         Also: --socket\n");
 	printf("\n");
 	printf("Container Name can be:\n");
 	printf("    1. Provided along with sub-command using '-g' option.\n");
@@ -847,7 +1493,7 @@ int
 load_cmd_hndlr(int argc, char **argv)
 {
 	int ret = AIOPT_SUCCESS;
-	char *valid_args = "gafrdvc";
+	char *valid_args = "gafrdvcsTkMmxi";
 
 	AIOPT_DEBUG("Load Cmd: argc=%d\n", argc);
 
@@ -883,7 +1529,7 @@ int
 reset_cmd_hndlr(int argc, char **argv)
 {
 	int ret = AIOPT_SUCCESS;
-	char *valid_args = "gdv";
+	char *valid_args = "gdvsiT";
 	
 	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
 	if (ret != AIOPT_SUCCESS) {
@@ -919,7 +1565,7 @@ int
 gettod_cmd_hndlr(int argc, char **argv)
 {
 	int ret = AIOPT_SUCCESS;
-	char *valid_args = "gdv";
+	char *valid_args = "gdvsi";
 	
 	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
 	if (ret != AIOPT_SUCCESS) {
@@ -953,7 +1599,7 @@ int
 settod_cmd_hndlr(int argc, char **argv)
 {
 	int ret = AIOPT_SUCCESS;
-	char *valid_args = "gtdv";
+	char *valid_args = "gtdvsi";
 	
 	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
 	if (ret != AIOPT_SUCCESS) {
@@ -988,7 +1634,7 @@ int
 status_cmd_hndlr(int argc, char **argv)
 {
 	int ret = AIOPT_SUCCESS;
-	char *valid_args = "gdv";
+	char *valid_args = "gdvsi";
 	
 	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
 	if (ret != AIOPT_SUCCESS) {
@@ -1013,6 +1659,177 @@ status_cmd_hndlr(int argc, char **argv)
 	return AIOPT_SUCCESS;
 }
 
+/*
+ * @brief
+ * Stats sub-command handler
+ *
+ * @param [in] argc Count of arguments
+ * @param [in] argv Array of argument strings
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+stats_cmd_hndlr(int argc, char **argv)
+{
+	int ret = AIOPT_SUCCESS;
+	char *valid_args = "gjdvsi";
+
+	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
+	if (ret != AIOPT_SUCCESS) {
+		usage(argv[0], "Incomplete or Incorrect Arguments.");
+		return AIOPT_FAILURE;
+	}
+
+	if (!gvars.container_name_flag) {
+		AIOPT_DEV("Container name not provided.\n");
+		usage(argv[0], "One or more Mandatory Arguments not provided");
+		/* Parsing found issues; Abort */
+		return AIOPT_FAILURE;
+	}
+
+	optind = 1;		/* reset 'extern optind' from the getopt lib */
+
+	dump_cmdline_args();
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Serve sub-command handler
+ *
+ * @param [in] argc Count of arguments
+ * @param [in] argv Array of argument strings
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+serve_cmd_hndlr(int argc, char **argv)
+{
+	int ret = AIOPT_SUCCESS;
+	char *valid_args = "gdvsMmi";
+
+	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
+	if (ret != AIOPT_SUCCESS) {
+		usage(argv[0], "Incomplete or Incorrect Arguments.");
+		return AIOPT_FAILURE;
+	}
+
+	if (!gvars.container_name_flag) {
+		AIOPT_DEV("Container name not provided.\n");
+		usage(argv[0], "One or more Mandatory Arguments not provided");
+		/* Parsing found issues; Abort */
+		return AIOPT_FAILURE;
+	}
+
+	optind = 1;		/* reset 'extern optind' from the getopt lib */
+
+	dump_cmdline_args();
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Wait sub-command handler
+ *
+ * @param [in] argc Count of arguments
+ * @param [in] argv Array of argument strings
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+wait_cmd_hndlr(int argc, char **argv)
+{
+	int ret = AIOPT_SUCCESS;
+	char *valid_args = "gSTdvsi";
+
+	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
+	if (ret != AIOPT_SUCCESS) {
+		usage(argv[0], "Incomplete or Incorrect Arguments.");
+		return AIOPT_FAILURE;
+	}
+
+	if (!gvars.container_name_flag || !gvars.state_flag) {
+		AIOPT_DEV("Container name or State not provided.\n");
+		usage(argv[0], "One or more Mandatory Arguments not provided");
+		/* Parsing found issues; Abort */
+		return AIOPT_FAILURE;
+	}
+
+	optind = 1;		/* reset 'extern optind' from the getopt lib */
+
+	dump_cmdline_args();
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * List sub-command handler
+ *
+ * @param [in] argc Count of arguments
+ * @param [in] argv Array of argument strings
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+list_cmd_hndlr(int argc, char **argv)
+{
+	int ret = AIOPT_SUCCESS;
+	char *valid_args = "gdvsi";
+
+	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
+	if (ret != AIOPT_SUCCESS) {
+		usage(argv[0], "Incomplete or Incorrect Arguments.");
+		return AIOPT_FAILURE;
+	}
+
+	if (!gvars.container_name_flag) {
+		AIOPT_DEV("Container name not provided.\n");
+		usage(argv[0], "One or more Mandatory Arguments not provided");
+		/* Parsing found issues; Abort */
+		return AIOPT_FAILURE;
+	}
+
+	optind = 1;		/* reset 'extern optind' from the getopt lib */
+
+	dump_cmdline_args();
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Exporter sub-command handler
+ *
+ * @param [in] argc Count of arguments
+ * @param [in] argv Array of argument strings
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+exporter_cmd_hndlr(int argc, char **argv)
+{
+	int ret = AIOPT_SUCCESS;
+	char *valid_args = "gloIdvi";
+
+	ret = generic_cmd_hndlr(argc - 1, argv + 1, valid_args);
+	if (ret != AIOPT_SUCCESS) {
+		usage(argv[0], "Incomplete or Incorrect Arguments.");
+		return AIOPT_FAILURE;
+	}
+
+	if (!gvars.container_name_flag ||
+	    (!gvars.listen_flag && !gvars.textfile_flag)) {
+		AIOPT_DEV("Container name, listen address or file not "
+			  "provided.\n");
+		usage(argv[0], "One or more Mandatory Arguments not provided");
+		/* Parsing found issues; Abort */
+		return AIOPT_FAILURE;
+	}
+
+	optind = 1;		/* reset 'extern optind' from the getopt lib */
+
+	dump_cmdline_args();
+
+	return AIOPT_SUCCESS;
+}
 
 /* ===========================================================================
  * Functions Definitions
@@ -1060,6 +1877,11 @@ parse_command_line_args(int argc, char **argv)
 	 */
 	get_container_from_env();
 
+	/* Likewise, a daemon socket set in Environment makes sub-commands
+	 * thin clients, unless overwritten with -s.
+	 */
+	get_socket_from_env();
+
 	/* Calling the sub-command handler and parsing remaining arguments */
 	ret = sub_cmd_hndlr(argc, argv);
 	if (ret != AIOPT_SUCCESS) {
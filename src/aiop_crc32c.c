@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_crc32c.c
+ *
+ * @brief	CRC32C (Castagnoli) checksum of AIOP images
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_acle.h>
+#elif defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+/* AIOP Tool Specific includes */
+#include <aiop_crc32c.h>
+
+/* ========================================================================
+ * MACROs and defines
+ * ======================================================================== */
+
+/* @def CRC32C_POLY
+ * @brief Reversed CRC32C (Castagnoli) polynomial
+ */
+#define CRC32C_POLY		0x82f63b78
+
+/* ========================================================================
+ * Structures and Globals
+ * ======================================================================== */
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const unsigned char *p,
+			      size_t len);
+
+/* Tables for slicing-by-8; crc32c_table[0] is the plain byte-wise table */
+static uint32_t crc32c_table[8][256];
+
+static crc32c_fn crc32c_impl;
+static const char *crc32c_impl_name;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+/* ========================================================================
+ * Internal Functions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Portable CRC32C, eight bytes per step (slicing-by-8). The CRC is kept
+ * inverted, as by the instructions.
+ */
+static uint32_t
+crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t w;
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	while (len >= 8) {
+		memcpy(&w, p, sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		w = __builtin_bswap64(w);
+#endif
+		w ^= crc;
+		crc = crc32c_table[7][w & 0xff] ^
+		      crc32c_table[6][(w >> 8) & 0xff] ^
+		      crc32c_table[5][(w >> 16) & 0xff] ^
+		      crc32c_table[4][(w >> 24) & 0xff] ^
+		      crc32c_table[3][(w >> 32) & 0xff] ^
+		      crc32c_table[2][(w >> 40) & 0xff] ^
+		      crc32c_table[1][(w >> 48) & 0xff] ^
+		      crc32c_table[0][w >> 56];
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__aarch64__)
+/*
+ * @brief
+ * CRC32C using the ARMv8 CRC32 instructions
+ */
+__attribute__((target("+crc")))
+static uint32_t
+crc32c_armv8(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t w;
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc = __crc32cb(crc, *p++);
+		len--;
+	}
+
+	while (len >= 8) {
+		memcpy(&w, p, sizeof(w));
+		crc = __crc32cd(crc, w);
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+#elif defined(__x86_64__)
+/*
+ * @brief
+ * CRC32C using the SSE4.2 crc32 instruction
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t w, c = crc;
+
+	while (len && ((uintptr_t)p & 7)) {
+		c = _mm_crc32_u8((uint32_t)c, *p++);
+		len--;
+	}
+
+	while (len >= 8) {
+		memcpy(&w, p, sizeof(w));
+		c = _mm_crc32_u64(c, w);
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		c = _mm_crc32_u8((uint32_t)c, *p++);
+
+	return (uint32_t)c;
+}
+#endif
+
+/*
+ * @brief
+ * Build the tables of the portable implementation and pick the fastest
+ * implementation the CPU supports. Run once, through crc32c_once.
+ */
+static void
+crc32c_init(void)
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc32c_table[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++) {
+		crc = crc32c_table[0][i];
+		for (j = 1; j < 8; j++) {
+			crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+			crc32c_table[j][i] = crc;
+		}
+	}
+
+	crc32c_impl = crc32c_sw;
+	crc32c_impl_name = "table";
+
+#if defined(__aarch64__)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		crc32c_impl = crc32c_armv8;
+		crc32c_impl_name = "armv8-crc";
+	}
+#elif defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2")) {
+		crc32c_impl = crc32c_sse42;
+		crc32c_impl_name = "sse4.2";
+	}
+#endif
+}
+
+/* ==========================================================================
+ * Externally available API definitions
+ * ==========================================================================*/
+
+/*
+ * @brief
+ * Extend a CRC32C over a buffer
+ *
+ * @param [in] crc CRC of the data so far, 0 to start
+ * @param [in] buf Data
+ * @param [in] len Length of data
+ *
+ * @return CRC of the data so far, including buf
+ */
+uint32_t
+aiopt_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+
+	return ~crc32c_impl(~crc, buf, len);
+}
+
+/*
+ * @brief
+ * Name of the CRC32C implementation in use
+ *
+ * @return const string
+ */
+const char *
+aiopt_crc32c_impl(void)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+
+	return crc32c_impl_name;
+}
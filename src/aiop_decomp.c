@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_decomp.c
+ *
+ * @brief	Decompression of zstd and lz4 compressed AIOP images
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <endian.h>
+#include <unistd.h>
+
+#ifdef AIOPT_ZSTD
+#include <zstd.h>
+#endif
+#ifdef AIOPT_LZ4
+#include <lz4frame.h>
+#endif
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_logger.h>
+#include <aiop_decomp.h>
+
+/* ========================================================================
+ * Internal Functions
+ * ======================================================================== */
+
+#if defined(AIOPT_ZSTD) || defined(AIOPT_LZ4)
+/*
+ * @brief
+ * Read the next chunk of compressed data
+ *
+ * @param [in] fd Opened file
+ * @param [in] buf Buffer of AIOPT_DECOMP_IN_SZ bytes
+ * @param [in] off Offset to read from
+ * @param [in] file_sz Size of the file
+ *
+ * @return Bytes read, 0 at end of file, or AIOPT_FAILURE
+ */
+static ssize_t
+read_chunk(int fd, void *buf, size_t off, size_t file_sz)
+{
+	size_t len = file_sz - off;
+	ssize_t n;
+
+	if (len > AIOPT_DECOMP_IN_SZ)
+		len = AIOPT_DECOMP_IN_SZ;
+	if (!len)
+		return 0;
+
+	do {
+		n = pread(fd, buf, len, off);
+	} while (n < 0 && errno == EINTR);
+	if (n <= 0) {
+		AIOPT_DEBUG("Unable to read compressed image. (err=%d)\n",
+				errno);
+		return AIOPT_FAILURE;
+	}
+
+	return n;
+}
+#endif
+
+#ifdef AIOPT_ZSTD
+/*
+ * @brief
+ * Decompress zstd frames; see aiopt_decompress
+ */
+static int
+decomp_zstd(int fd, size_t file_sz, void *in_buf, void *dst, size_t cap,
+	    size_t *out_len, aiopt_decomp_progress_t progress, void *ctx)
+{
+	ZSTD_DCtx *dctx;
+	ZSTD_inBuffer in = {in_buf, 0, 0};
+	ZSTD_outBuffer out = {dst, cap, 0};
+	size_t off = 0, in_pos, out_pos, hint = 1;
+	ssize_t n;
+	short int eof = FALSE;
+	int ret = AIOPT_EBADIMAGE;
+
+	dctx = ZSTD_createDCtx();
+	if (!dctx) {
+		AIOPT_DEBUG("Unable to allocate zstd context.\n");
+		return AIOPT_FAILURE;
+	}
+
+	while (1) {
+		if (in.pos == in.size && !eof) {
+			n = read_chunk(fd, in_buf, off, file_sz);
+			if (n < 0) {
+				ret = AIOPT_FAILURE;
+				goto out;
+			}
+			eof = (n == 0);
+			off += n;
+			in.size = n;
+			in.pos = 0;
+		}
+		/* Last frame complete and flushed */
+		if (eof && hint == 0)
+			break;
+
+		in_pos = in.pos;
+		out_pos = out.pos;
+		hint = ZSTD_decompressStream(dctx, &out, &in);
+		if (ZSTD_isError(hint)) {
+			AIOPT_DEBUG("zstd: %s\n", ZSTD_getErrorName(hint));
+			goto out;
+		}
+		if (progress && out.pos != out_pos)
+			progress(ctx, out.pos);
+		if (in.pos == in_pos && out.pos == out_pos) {
+			/* Neither input consumed nor output produced */
+			AIOPT_DEBUG("zstd image %s.\n", out.pos == cap ?
+					"too large when decompressed" :
+					"truncated");
+			goto out;
+		}
+	}
+
+	*out_len = out.pos;
+	ret = AIOPT_SUCCESS;
+out:
+	ZSTD_freeDCtx(dctx);
+	return ret;
+}
+#endif
+
+#ifdef AIOPT_LZ4
+/*
+ * @brief
+ * Decompress lz4 frame format frames; see aiopt_decompress
+ */
+static int
+decomp_lz4(int fd, size_t file_sz, void *in_buf, void *dst, size_t cap,
+	   size_t *out_len, aiopt_decomp_progress_t progress, void *ctx)
+{
+	LZ4F_dctx *dctx;
+	LZ4F_errorCode_t err;
+	size_t off = 0, in_len = 0, in_pos = 0, out_pos = 0;
+	size_t src_sz, dst_sz, hint = 1;
+	ssize_t n;
+	short int eof = FALSE;
+	int ret = AIOPT_EBADIMAGE;
+
+	err = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+	if (LZ4F_isError(err)) {
+		AIOPT_DEBUG("Unable to allocate lz4 context.\n");
+		return AIOPT_FAILURE;
+	}
+
+	while (1) {
+		if (in_pos == in_len && !eof) {
+			n = read_chunk(fd, in_buf, off, file_sz);
+			if (n < 0) {
+				ret = AIOPT_FAILURE;
+				goto out;
+			}
+			eof = (n == 0);
+			off += n;
+			in_len = n;
+			in_pos = 0;
+		}
+		/* Last frame complete and flushed */
+		if (eof && hint == 0)
+			break;
+
+		src_sz = in_len - in_pos;
+		dst_sz = cap - out_pos;
+		hint = LZ4F_decompress(dctx, (char *)dst + out_pos, &dst_sz,
+				       (char *)in_buf + in_pos, &src_sz, NULL);
+		if (LZ4F_isError(hint)) {
+			AIOPT_DEBUG("lz4: %s\n", LZ4F_getErrorName(hint));
+			goto out;
+		}
+		in_pos += src_sz;
+		out_pos += dst_sz;
+		if (progress && dst_sz)
+			progress(ctx, out_pos);
+		if (!src_sz && !dst_sz) {
+			/* Neither input consumed nor output produced */
+			AIOPT_DEBUG("lz4 image %s.\n", out_pos == cap ?
+					"too large when decompressed" :
+					"truncated");
+			goto out;
+		}
+	}
+
+	*out_len = out_pos;
+	ret = AIOPT_SUCCESS;
+out:
+	LZ4F_freeDecompressionContext(dctx);
+	return ret;
+}
+#endif
+
+/* ==========================================================================
+ * Externally available API definitions
+ * ==========================================================================*/
+
+/*
+ * @brief
+ * Detect the compression of a file from its magic number
+ *
+ * @param [in] fd Opened file
+ * @param [in] file_sz Size of the file
+ *
+ * @return enum aiopt_comp
+ */
+int
+aiopt_comp_detect(int fd, size_t file_sz)
+{
+	uint32_t magic;
+
+	if (file_sz < sizeof(magic) ||
+	    pread(fd, &magic, sizeof(magic), 0) != sizeof(magic))
+		return AIOPT_COMP_NONE;
+
+	switch (le32toh(magic)) {
+	case AIOPT_ZSTD_MAGIC:
+		return AIOPT_COMP_ZSTD;
+	case AIOPT_LZ4_MAGIC:
+		return AIOPT_COMP_LZ4;
+	default:
+		return AIOPT_COMP_NONE;
+	}
+}
+
+/*
+ * @brief
+ * Name of a compression format
+ *
+ * @param [in] comp enum aiopt_comp
+ * @return const string
+ */
+const char *
+aiopt_comp_str(int comp)
+{
+	switch (comp) {
+	case AIOPT_COMP_ZSTD:
+		return "zstd";
+	case AIOPT_COMP_LZ4:
+		return "lz4";
+	default:
+		return "none";
+	}
+}
+
+/*
+ * @brief
+ * Decompress a file straight into an output buffer
+ *
+ * @return AIOPT_SUCCESS, AIOPT_EBADIMAGE or AIOPT_FAILURE
+ */
+int
+aiopt_decompress(int fd, size_t file_sz, int comp, void *dst, size_t cap,
+		 size_t *out_len, aiopt_decomp_progress_t progress, void *ctx)
+{
+	void *in_buf;
+	int ret = AIOPT_EBADIMAGE;
+
+	*out_len = 0;
+
+	in_buf = malloc(AIOPT_DECOMP_IN_SZ);
+	if (!in_buf) {
+		AIOPT_DEBUG("Unable to allocate internal memory.\n");
+		return AIOPT_ENOMEM;
+	}
+
+	switch (comp) {
+#ifdef AIOPT_ZSTD
+	case AIOPT_COMP_ZSTD:
+		ret = decomp_zstd(fd, file_sz, in_buf, dst, cap, out_len,
+				  progress, ctx);
+		break;
+#endif
+#ifdef AIOPT_LZ4
+	case AIOPT_COMP_LZ4:
+		ret = decomp_lz4(fd, file_sz, in_buf, dst, cap, out_len,
+				 progress, ctx);
+		break;
+#endif
+	default:
+		AIOPT_LIB_INFO("AIOP Image is %s compressed, which this build "
+				"does not support.\n", aiopt_comp_str(comp));
+		break;
+	}
+
+	free(in_buf);
+
+	return ret;
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_elf.c
+ *
+ * @brief	Validation of the ELF and program headers of AIOP images
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <endian.h>
+#include <unistd.h>
+#include <elf.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_logger.h>
+#include <aiop_elf.h>
+
+/* ========================================================================
+ * Structures
+ * ======================================================================== */
+
+/*
+ * @brief Where the image is checked from: a file, or a buffer if buf is set
+ */
+struct elf_src {
+	int		fd;
+	const char	*buf;
+};
+
+/* ========================================================================
+ * Internal Functions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Read len bytes at offset off of the image. Bounds are checked by the
+ * callers against the image size.
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+elf_read(const struct elf_src *src, void *buf, size_t len, off_t off)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	if (src->buf) {
+		memcpy(buf, src->buf + off, len);
+		return AIOPT_SUCCESS;
+	}
+
+	while (done < len) {
+		n = pread(src->fd, (char *)buf + done, len - done,
+			  off + done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			AIOPT_DEBUG("Unable to read ELF headers. (err=%d)\n",
+					errno);
+			return AIOPT_FAILURE;
+		}
+		done += n;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Check the ELF header against what the AIOP cores run
+ *
+ * @param [in] eh ELF header, as in the file
+ * @param [in] file_sz Size of the file
+ *
+ * @return AIOPT_SUCCESS or AIOPT_EBADIMAGE
+ */
+static int
+elf_check_ehdr(const Elf32_Ehdr *eh, size_t file_sz)
+{
+	uint32_t phoff = be32toh(eh->e_phoff);
+	uint16_t phnum = be16toh(eh->e_phnum);
+
+	if (memcmp(eh->e_ident, ELFMAG, SELFMAG)) {
+		AIOPT_DEBUG("Not an ELF file.\n");
+		return AIOPT_EBADIMAGE;
+	}
+
+	if (eh->e_ident[EI_CLASS] != AIOPT_ELF_CLASS ||
+	    eh->e_ident[EI_DATA] != AIOPT_ELF_DATA ||
+	    eh->e_ident[EI_VERSION] != EV_CURRENT) {
+		AIOPT_DEBUG("ELF class (%u), encoding (%u) or version (%u) is "
+				"not that of AIOP.\n", eh->e_ident[EI_CLASS],
+				eh->e_ident[EI_DATA],
+				eh->e_ident[EI_VERSION]);
+		return AIOPT_EBADIMAGE;
+	}
+
+	if (be16toh(eh->e_type) != ET_EXEC) {
+		AIOPT_DEBUG("ELF type (%u) is not executable.\n",
+				be16toh(eh->e_type));
+		return AIOPT_EBADIMAGE;
+	}
+
+	if (be16toh(eh->e_machine) != AIOPT_ELF_MACHINE) {
+		AIOPT_DEBUG("ELF machine (%u) is not AIOP (%u).\n",
+				be16toh(eh->e_machine), AIOPT_ELF_MACHINE);
+		return AIOPT_EBADIMAGE;
+	}
+
+	if (be16toh(eh->e_phentsize) != sizeof(Elf32_Phdr) || phnum == 0 ||
+	    phnum == PN_XNUM) {
+		AIOPT_DEBUG("No usable program headers (size=%u, num=%u).\n",
+				be16toh(eh->e_phentsize), phnum);
+		return AIOPT_EBADIMAGE;
+	}
+
+	if ((uint64_t)phoff + (uint64_t)phnum * sizeof(Elf32_Phdr) >
+	    file_sz) {
+		AIOPT_DEBUG("Program headers (offset=%u, num=%u) beyond end "
+				"of file (%lu); image truncated?\n", phoff,
+				phnum, file_sz);
+		return AIOPT_EBADIMAGE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Check a loadable segment and add it to info
+ *
+ * @param [in] ph Program header, as in the file
+ * @param [in] file_sz Size of the file
+ * @param [in,out] info Segments found so far
+ *
+ * @return AIOPT_SUCCESS or AIOPT_EBADIMAGE
+ */
+static int
+elf_add_segment(const Elf32_Phdr *ph, size_t file_sz, aiopt_elf_info_t *info)
+{
+	unsigned int i;
+	aiopt_elf_seg_t seg, *s;
+
+	seg.vaddr = be32toh(ph->p_vaddr);
+	seg.offset = be32toh(ph->p_offset);
+	seg.filesz = be32toh(ph->p_filesz);
+	seg.memsz = be32toh(ph->p_memsz);
+	seg.flags = be32toh(ph->p_flags);
+
+	if (info->nsegs == AIOPT_ELF_MAX_SEGMENTS) {
+		AIOPT_DEBUG("More than %d loadable segments.\n",
+				AIOPT_ELF_MAX_SEGMENTS);
+		return AIOPT_EBADIMAGE;
+	}
+
+	if ((uint64_t)seg.offset + seg.filesz > file_sz) {
+		AIOPT_DEBUG("Segment %u (offset=%u, size=%u) beyond end of "
+				"file (%lu); image truncated?\n", info->nsegs,
+				seg.offset, seg.filesz, file_sz);
+		return AIOPT_EBADIMAGE;
+	}
+
+	if (seg.filesz > seg.memsz ||
+	    (uint64_t)seg.vaddr + seg.memsz > UINT32_MAX + 1ULL) {
+		AIOPT_DEBUG("Segment %u has invalid sizes (vaddr=0x%08x, "
+				"filesz=%u, memsz=%u).\n", info->nsegs,
+				seg.vaddr, seg.filesz, seg.memsz);
+		return AIOPT_EBADIMAGE;
+	}
+
+	for (i = 0; i < info->nsegs && seg.memsz; i++) {
+		s = &info->segs[i];
+		if (s->memsz && seg.vaddr < (uint64_t)s->vaddr + s->memsz &&
+		    s->vaddr < (uint64_t)seg.vaddr + seg.memsz) {
+			AIOPT_DEBUG("Segment %u (0x%08x-0x%08lx) overlaps "
+					"segment %u (0x%08x-0x%08lx).\n",
+					info->nsegs, seg.vaddr,
+					(uint64_t)seg.vaddr + seg.memsz, i,
+					s->vaddr, (uint64_t)s->vaddr + s->memsz);
+			return AIOPT_EBADIMAGE;
+		}
+	}
+
+	info->segs[info->nsegs++] = seg;
+	info->filesz += seg.filesz;
+	info->memsz += seg.memsz;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Check an AIOP image from its ELF and program headers
+ *
+ * @param [in] src Image
+ * @param [in] file_sz Size of the image
+ * @param [out] info Entry point and loadable segments
+ *
+ * @return AIOPT_SUCCESS or AIOPT_EBADIMAGE
+ */
+static int
+elf_check(const struct elf_src *src, size_t file_sz, aiopt_elf_info_t *info)
+{
+	Elf32_Ehdr eh;
+	Elf32_Phdr ph;
+	uint32_t phoff;
+	unsigned int i, phnum;
+	int ret;
+
+	memset(info, 0, sizeof(*info));
+
+	if (file_sz < sizeof(eh)) {
+		AIOPT_DEBUG("Image (%lu bytes) too small for an ELF header.\n",
+				file_sz);
+		return AIOPT_EBADIMAGE;
+	}
+
+	if (elf_read(src, &eh, sizeof(eh), 0) != AIOPT_SUCCESS)
+		return AIOPT_EBADIMAGE;
+
+	ret = elf_check_ehdr(&eh, file_sz);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	info->entry = be32toh(eh.e_entry);
+	phoff = be32toh(eh.e_phoff);
+	phnum = be16toh(eh.e_phnum);
+
+	for (i = 0; i < phnum; i++) {
+		if (elf_read(src, &ph, sizeof(ph),
+			     phoff + i * sizeof(ph)) != AIOPT_SUCCESS)
+			return AIOPT_EBADIMAGE;
+		if (be32toh(ph.p_type) != PT_LOAD)
+			continue;
+		ret = elf_add_segment(&ph, file_sz, info);
+		if (ret != AIOPT_SUCCESS)
+			return ret;
+	}
+
+	if (!info->nsegs) {
+		AIOPT_DEBUG("No loadable segments.\n");
+		return AIOPT_EBADIMAGE;
+	}
+
+	for (i = 0; i < info->nsegs; i++) {
+		if (info->entry >= info->segs[i].vaddr &&
+		    info->entry - info->segs[i].vaddr < info->segs[i].memsz)
+			break;
+	}
+	if (i == info->nsegs) {
+		AIOPT_DEBUG("Entry point (0x%08x) outside of loadable "
+				"segments.\n", info->entry);
+		return AIOPT_EBADIMAGE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/* ==========================================================================
+ * Externally available API definitions
+ * ==========================================================================*/
+
+/*
+ * @brief
+ * Check that a file is an AIOP image, from its ELF and program headers
+ *
+ * @param [in] fd Opened image file
+ * @param [in] file_sz Size of the file
+ * @param [out] info Entry point and loadable segments
+ *
+ * @return AIOPT_SUCCESS or AIOPT_EBADIMAGE
+ */
+int
+aiopt_elf_check(int fd, size_t file_sz, aiopt_elf_info_t *info)
+{
+	struct elf_src src = {fd, NULL};
+
+	return elf_check(&src, file_sz, info);
+}
+
+/*
+ * @brief
+ * Check that an image in memory is an AIOP image
+ *
+ * @param [in] buf Image
+ * @param [in] len Size of the image
+ * @param [out] info Entry point and loadable segments
+ *
+ * @return AIOPT_SUCCESS or AIOPT_EBADIMAGE
+ */
+int
+aiopt_elf_check_buf(const void *buf, size_t len, aiopt_elf_info_t *info)
+{
+	struct elf_src src = {-1, buf};
+
+	return elf_check(&src, len, info);
+}
@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_evloop.c
+ *
+ * @brief	Event loop shared by the daemon (serve) and the metrics
+ *		exporter
+ *
+ */
+
+/* Generic includes */
+#define _GNU_SOURCE		/* accept4, pipe2 */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_logger.h>
+#include <aiop_evloop.h>
+
+/* ========================================================================
+ * Globals
+ * ======================================================================== */
+
+/* Self-pipe through which SIGINT/SIGTERM reach the event loop. A handler is
+ * used rather than a signalfd, as signals may be delivered to any thread
+ * (e.g. the MC simulator) which does not have them blocked.
+ */
+static int evl_sig_pipe[2] = {-1, -1};
+
+/* ========================================================================
+ * Internal Functions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+evl_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * @brief
+ * SIGINT/SIGTERM handler; wakes up the event loop
+ *
+ * @param [in] signo signal number
+ * @return void
+ */
+static void
+evl_signal_hndlr(int signo)
+{
+	int saved_errno = errno;
+	unsigned char c = (unsigned char)signo;
+
+	if (write(evl_sig_pipe[1], &c, 1) < 0)
+		; /* Pipe full; a wake-up is already pending */
+	errno = saved_errno;
+}
+
+/*
+ * @brief
+ * Accept all pending connections on the listening socket
+ *
+ * @param [in] evl loop
+ * @return void
+ */
+static void
+evl_accept(aiopt_evl_t *evl)
+{
+	int fd;
+	unsigned int slot;
+	struct aiopt_evl_conn *conn;
+	struct epoll_event ev;
+
+	while (1) {
+		fd = accept4(evl->lfd, NULL, NULL,
+			     SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				AIOPT_DEBUG("accept failed. (err=%d)\n",
+						errno);
+			return;
+		}
+
+		if (evl->nconns == evl->max_conns) {
+			AIOPT_DEBUG("Too many clients; dropping (fd=%d).\n",
+					fd);
+			close(fd);
+			continue;
+		}
+
+		conn = calloc(1, evl->conn_sz);
+		if (!conn) {
+			close(fd);
+			continue;
+		}
+
+		for (slot = 0; evl->conns[slot]; slot++)
+			;
+		conn->fd = fd;
+		conn->slot = slot;
+		conn->since_ns = evl_now_ns();
+
+		conn->events = EPOLLIN;
+		ev.events = conn->events;
+		ev.data.ptr = conn;
+		if (epoll_ctl(evl->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			close(fd);
+			free(conn);
+			continue;
+		}
+
+		evl->conns[slot] = conn;
+		evl->nconns++;
+		AIOPT_DEV("Accepted client (fd=%d).\n", fd);
+	}
+}
+
+/*
+ * @brief
+ * Release the connections closed since the last call
+ *
+ * @param [in] evl loop
+ * @return void
+ */
+static void
+evl_free_dead(aiopt_evl_t *evl)
+{
+	struct aiopt_evl_conn *conn;
+
+	while (evl->dead) {
+		conn = evl->dead;
+		evl->dead = conn->next;
+		free(conn->out.data);
+		free(conn);
+	}
+}
+
+/* ========================================================================
+ * Externally available API definitions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Set up an event loop and the SIGINT/SIGTERM handlers which stop it
+ *
+ * @param [out] evl loop to set up
+ * @param [in] conn_sz Size of the user's connection state
+ * @param [in] max_conns Connections served at a time
+ * @param [in] on_conn Handler of events on connections
+ * @param [in] on_close Called as a connection is closed; can be NULL
+ * @param [in] arg Of the user
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_evl_init(aiopt_evl_t *evl, size_t conn_sz, unsigned int max_conns,
+	       aiopt_evl_conn_hndlr on_conn, aiopt_evl_close_hndlr on_close,
+	       void *arg)
+{
+	struct sigaction sa;
+	struct epoll_event ev;
+
+	memset(evl, 0, sizeof(*evl));
+	evl->epfd = evl->lfd = evl->sfd = -1;
+	evl->conn_sz = conn_sz;
+	evl->max_conns = max_conns;
+	evl->on_conn = on_conn;
+	evl->on_close = on_close;
+	evl->arg = arg;
+
+	evl->conns = calloc(max_conns, sizeof(*evl->conns));
+	if (!evl->conns)
+		return AIOPT_FAILURE;
+
+	evl->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (evl->epfd < 0) {
+		AIOPT_DEBUG("Unable to create epoll fd. (err=%d)\n", errno);
+		goto err_out;
+	}
+
+	/* Signals are taken through the event loop */
+	if (pipe2(evl_sig_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+		AIOPT_DEBUG("Unable to create signal pipe. (err=%d)\n", errno);
+		goto err_out;
+	}
+	evl->sfd = evl_sig_pipe[0];
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = &evl->sfd;
+	if (epoll_ctl(evl->epfd, EPOLL_CTL_ADD, evl->sfd, &ev) < 0) {
+		AIOPT_DEBUG("Unable to watch signal pipe. (err=%d)\n", errno);
+		close(evl_sig_pipe[0]);
+		close(evl_sig_pipe[1]);
+		evl_sig_pipe[0] = evl_sig_pipe[1] = -1;
+		goto err_out;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = evl_signal_hndlr;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, &evl->old_int);
+	sigaction(SIGTERM, &sa, &evl->old_term);
+
+	return AIOPT_SUCCESS;
+
+err_out:
+	if (evl->epfd >= 0)
+		close(evl->epfd);
+	free(evl->conns);
+	evl->conns = NULL;
+	evl->epfd = evl->sfd = -1;
+	return AIOPT_FAILURE;
+}
+
+/*
+ * @brief
+ * Accept connections on a listening socket, which the loop then owns
+ *
+ * @param [in] evl loop
+ * @param [in] lfd Non-blocking listening socket
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_evl_listen(aiopt_evl_t *evl, int lfd)
+{
+	struct epoll_event ev;
+
+	evl->lfd = lfd;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &evl->lfd;
+	if (epoll_ctl(evl->epfd, EPOLL_CTL_ADD, lfd, &ev) < 0) {
+		AIOPT_DEBUG("Unable to watch listening socket. (err=%d)\n",
+				errno);
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Call a handler whenever a descriptor is readable
+ *
+ * @param [in] evl loop
+ * @param [in] fd descriptor
+ * @param [in] hndlr handler
+ * @param [in] arg passed to hndlr
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_evl_add(aiopt_evl_t *evl, int fd, aiopt_evl_src_hndlr hndlr,
+	      void *arg)
+{
+	struct aiopt_evl_src *src;
+	struct epoll_event ev;
+
+	if (evl->nsrcs == AIOPT_EVL_MAX_SRCS) {
+		AIOPT_DEV("Incorrect API usage. (too many sources)\n");
+		return AIOPT_FAILURE;
+	}
+
+	src = &evl->srcs[evl->nsrcs];
+	src->fd = fd;
+	src->hndlr = hndlr;
+	src->arg = arg;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = src;
+	if (epoll_ctl(evl->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		AIOPT_DEBUG("Unable to watch fd (%d). (err=%d)\n", fd, errno);
+		return AIOPT_FAILURE;
+	}
+	evl->nsrcs++;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Run the loop until SIGINT, SIGTERM or evl->stop is set by a handler
+ *
+ * @param [in] evl loop
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if epoll_wait failed
+ */
+int
+aiopt_evl_run(aiopt_evl_t *evl)
+{
+	int i, n;
+	unsigned char signo;
+	void *ptr;
+	struct aiopt_evl_src *src;
+	struct aiopt_evl_conn *conn;
+	struct epoll_event events[AIOPT_EVL_MAX_EVENTS];
+
+	while (!evl->stop) {
+		n = epoll_wait(evl->epfd, events, AIOPT_EVL_MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			AIOPT_DEBUG("epoll_wait failed. (err=%d)\n", errno);
+			return AIOPT_FAILURE;
+		}
+
+		for (i = 0; i < n; i++) {
+			ptr = events[i].data.ptr;
+			if (ptr == &evl->lfd) {
+				evl_accept(evl);
+				continue;
+			}
+
+			if (ptr == &evl->sfd) {
+				while (read(evl->sfd, &signo, 1) == 1) {
+					AIOPT_DEBUG("Signal (%u); stopping.\n",
+							signo);
+					evl->stop = TRUE;
+				}
+				continue;
+			}
+
+			/* Markers of other descriptors are in srcs */
+			src = ptr;
+			if (src >= evl->srcs && src < evl->srcs + evl->nsrcs) {
+				src->hndlr(evl, src->arg);
+				continue;
+			}
+
+			/* Closed by an earlier handler of this batch */
+			conn = ptr;
+			if (conn->fd < 0)
+				continue;
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP) &&
+			    !(events[i].events & (EPOLLIN | EPOLLOUT))) {
+				aiopt_evl_close(evl, conn);
+				continue;
+			}
+
+			if (evl->on_conn(evl, conn, events[i].events) !=
+			    AIOPT_SUCCESS)
+				aiopt_evl_close(evl, conn);
+		}
+		evl_free_dead(evl);
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Close a connection, on_close being called first. As events of it may
+ * still be pending in the batch being handled, it is only released by
+ * evl_free_dead.
+ *
+ * @param [in] evl loop
+ * @param [in] conn connection
+ * @return void
+ */
+void
+aiopt_evl_close(aiopt_evl_t *evl, struct aiopt_evl_conn *conn)
+{
+	if (conn->fd < 0)
+		return;
+
+	AIOPT_DEV("Closing client (fd=%d).\n", conn->fd);
+	if (evl->on_close)
+		evl->on_close(evl, conn);
+	epoll_ctl(evl->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	conn->fd = -1;
+	evl->conns[conn->slot] = NULL;
+	evl->nconns--;
+	conn->next = evl->dead;
+	evl->dead = conn;
+}
+
+/*
+ * @brief
+ * Close all connections
+ *
+ * @param [in] evl loop
+ * @return void
+ */
+void
+aiopt_evl_close_all(aiopt_evl_t *evl)
+{
+	unsigned int i;
+
+	for (i = 0; i < evl->max_conns && evl->nconns; i++) {
+		if (evl->conns[i])
+			aiopt_evl_close(evl, evl->conns[i]);
+	}
+}
+
+/*
+ * @brief
+ * Release the loop and restore the earlier SIGINT/SIGTERM handlers
+ *
+ * @param [in] evl loop set up by aiopt_evl_init
+ * @return void
+ */
+void
+aiopt_evl_fini(aiopt_evl_t *evl)
+{
+	aiopt_evl_close_all(evl);
+	evl_free_dead(evl);
+	free(evl->conns);
+	evl->conns = NULL;
+
+	if (evl->lfd >= 0)
+		close(evl->lfd);
+	if (evl->epfd >= 0)
+		close(evl->epfd);
+	evl->lfd = evl->epfd = -1;
+
+	sigaction(SIGINT, &evl->old_int, NULL);
+	sigaction(SIGTERM, &evl->old_term, NULL);
+	close(evl_sig_pipe[0]);
+	close(evl_sig_pipe[1]);
+	evl_sig_pipe[0] = evl_sig_pipe[1] = -1;
+	evl->sfd = -1;
+}
+
+/*
+ * @brief
+ * Queue formatted bytes to be sent
+ *
+ * @param [in] o output
+ * @param [in] fmt printf style format
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if memory could not be allocated
+ */
+int
+aiopt_evl_printf(struct aiopt_evl_out *o, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+	size_t need;
+	char *p;
+
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return AIOPT_FAILURE;
+
+	need = o->len + len + 1;
+	if (need > o->cap) {
+		size_t cap = o->cap ? o->cap : 256;
+
+		while (cap < need)
+			cap *= 2;
+		p = realloc(o->data, cap);
+		if (!p)
+			return AIOPT_FAILURE;
+		o->data = p;
+		o->cap = cap;
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(o->data + o->len, o->cap - o->len, fmt, ap);
+	va_end(ap);
+	o->len += len;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Queue bytes to be sent
+ *
+ * @param [in] o output
+ * @param [in] data bytes
+ * @param [in] len number of bytes
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if memory could not be allocated
+ */
+int
+aiopt_evl_write(struct aiopt_evl_out *o, const void *data, size_t len)
+{
+	size_t need = o->len + len;
+	char *p;
+
+	if (need > o->cap) {
+		p = realloc(o->data, need);
+		if (!p)
+			return AIOPT_FAILURE;
+		o->data = p;
+		o->cap = need;
+	}
+
+	memcpy(o->data + o->len, data, len);
+	o->len += len;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Send as much of the queued output as the socket takes, and arm the
+ * events of the connection accordingly
+ *
+ * @param [in] evl loop
+ * @param [in] conn connection
+ * @param [in] want_in TRUE to keep reading from the connection
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the connection is broken
+ */
+int
+aiopt_evl_flush(aiopt_evl_t *evl, struct aiopt_evl_conn *conn,
+		short int want_in)
+{
+	ssize_t n;
+	unsigned int events;
+	struct aiopt_evl_out *o = &conn->out;
+	struct epoll_event ev;
+
+	while (o->off < o->len) {
+		n = send(conn->fd, o->data + o->off, o->len - o->off,
+			 MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return AIOPT_FAILURE;
+		}
+		o->off += n;
+	}
+
+	if (o->off == o->len)
+		o->off = o->len = 0;
+
+	events = (want_in && !conn->closing ? EPOLLIN : 0) |
+		 (o->len ? EPOLLOUT : 0);
+	if (events != conn->events) {
+		ev.events = events;
+		ev.data.ptr = conn;
+		if (epoll_ctl(evl->epfd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+			return AIOPT_FAILURE;
+		conn->events = events;
+	}
+
+	return AIOPT_SUCCESS;
+}
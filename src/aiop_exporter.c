@@ -0,0 +1,928 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_exporter.c
+ *
+ * @brief	AIOP Tool metrics exporter: refreshes the telemetry of the AIOP
+ *		tile on a timer and serves it over HTTP and/or writes it for
+ *		the textfile collector of node_exporter.
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <strings.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_logger.h>
+#include <aiop_lib.h>
+#include <aiop_exporter.h>
+#include <aiop_evloop.h>
+
+/* MC header files */
+#include <fsl_mc_sys.h>
+#include <fsl_dpaiop.h>
+#include <fsl_mc_cmd.h>
+#include <fsl_mc_stats.h>
+
+/* ========================================================================
+ * MACROs and defines
+ * ======================================================================== */
+
+/* @def EXP_LABELS_MAX
+ * @brief Size of the label set common to all samples
+ */
+#define EXP_LABELS_MAX		128
+
+/* Content types of the two renderings of the metrics */
+#define EXP_CT_OPENMETRICS	\
+	"application/openmetrics-text; version=1.0.0; charset=utf-8"
+#define EXP_CT_TEXT		"text/plain; version=0.0.4; charset=utf-8"
+
+/* ========================================================================
+ * Structures
+ * ======================================================================== */
+
+/*
+ * @brief A rendering of the metrics, kept until the next refresh
+ */
+struct exp_page {
+	char		*buf;
+	size_t		len;
+};
+
+/*
+ * @brief State of a connected HTTP client. One request is served per
+ * connection.
+ */
+struct exp_client {
+	struct aiopt_evl_conn conn;	/**< First; closing once answered >*/
+	char		in[AIOPT_EXP_REQ_MAX]; /**< Request head >*/
+	size_t		in_len;
+};
+
+/*
+ * @brief State of the exporter
+ */
+struct exp_ctx {
+	aiopt_handle_t	handle;
+	const aiopt_exporter_conf_t *conf;
+	aiopt_evl_t	evl;		/**< HTTP clients and signals >*/
+	int		tfd;		/**< Refresh timer >*/
+	int		aiop_id;	/**< Of the handle; -1 until read >*/
+	char		labels[EXP_LABELS_MAX];
+	struct exp_page	om;		/**< OpenMetrics rendering >*/
+	struct exp_page	text;		/**< Prometheus text rendering >*/
+	unsigned long	refreshes;
+	unsigned long	refresh_errors;
+	unsigned long	scrapes;
+};
+
+/* ========================================================================
+ * Globals
+ * ======================================================================== */
+
+/* Upper bounds, in ns, of the buckets of the exported MC latency histograms.
+ * The log-linear buckets of the MC statistics are folded into these.
+ */
+static const uint64_t exp_le_ns[] = {
+	10000, 25000, 50000, 100000, 250000, 500000,
+	1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+	100000000, 250000000, 1000000000
+};
+
+/* Tile states, exported as a stateset. The labels are spelled out, rather
+ * than taken from the MC state names, which misspell LOAD_ONGOING.
+ */
+static const struct {
+	int		state;
+	const char	*label;
+} exp_states[] = {
+	{ DPAIOP_STATE_RESET_DONE,	"RESET_DONE" },
+	{ DPAIOP_STATE_RESET_ONGOING,	"RESET_ONGOING" },
+	{ DPAIOP_STATE_LOAD_DONE,	"LOAD_DONE" },
+	{ DPAIOP_STATE_LOAD_ONGIONG,	"LOAD_ONGOING" },
+	{ DPAIOP_STATE_LOAD_ERROR,	"LOAD_ERROR" },
+	{ DPAIOP_STATE_BOOT_ONGOING,	"BOOT_ONGOING" },
+	{ DPAIOP_STATE_BOOT_ERROR,	"BOOT_ERROR" },
+	{ DPAIOP_STATE_RUNNING,		"RUNNING" }
+};
+
+/* ========================================================================
+ * Helpers
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+exp_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * @brief
+ * Build the label set common to all samples: container and, once known,
+ * dpaiop ID. Label values are escaped as the exposition formats require.
+ *
+ * @param [in] ctx exporter state
+ * @return void
+ */
+static void
+exp_build_labels(struct exp_ctx *ctx)
+{
+	const char *c;
+	size_t len = 0, max = sizeof(ctx->labels) - 16;
+
+	len = snprintf(ctx->labels, max, "container=\"");
+	for (c = ctx->conf->container; c && *c && len < max - 3; c++) {
+		if (*c == '"' || *c == '\\' || *c == '\n')
+			ctx->labels[len++] = '\\';
+		ctx->labels[len++] = (*c == '\n') ? 'n' : *c;
+	}
+	ctx->labels[len++] = '"';
+	ctx->labels[len] = '\0';
+
+	if (ctx->aiop_id >= 0)
+		snprintf(ctx->labels + len, sizeof(ctx->labels) - len,
+			 ",dpaiop=\"%d\"", ctx->aiop_id);
+}
+
+/*
+ * @brief
+ * Write the TYPE, HELP and UNIT lines of a metric family. Prometheus text
+ * format has no stateset, info nor UNIT; such families are plain gauges
+ * there, and counters are named with their _total suffix.
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] name Family name; without _total for a counter, with _info
+ *             for an info
+ * @param [in] type OpenMetrics type
+ * @param [in] help Help text
+ * @param [in] om TRUE for OpenMetrics, FALSE for Prometheus text
+ * @return void
+ */
+static void
+exp_family(FILE *fp, const char *name, const char *type, const char *help,
+	   short int om)
+{
+	size_t len = strlen(name);
+	const char *suffix = "";
+
+	if (om) {
+		/* An info family is named without its _info suffix */
+		if (!strcmp(type, "info") && len > 5)
+			len -= 5;
+		fprintf(fp, "# TYPE %.*s %s\n", (int)len, name, type);
+		fprintf(fp, "# HELP %.*s %s\n", (int)len, name, help);
+		if (len > 8 && !strcmp(name + len - 8, "_seconds"))
+			fprintf(fp, "# UNIT %.*s seconds\n", (int)len, name);
+		return;
+	}
+
+	if (!strcmp(type, "counter"))
+		suffix = "_total";
+	else if (strcmp(type, "histogram"))
+		type = "gauge";
+	fprintf(fp, "# HELP %s%s %s\n", name, suffix, help);
+	fprintf(fp, "# TYPE %s%s %s\n", name, suffix, type);
+}
+
+/*
+ * @brief
+ * Render the MC command statistics of this process: a latency histogram
+ * and the completions which were not OK, by command
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] labels Common label set
+ * @param [in] om TRUE for OpenMetrics, FALSE for Prometheus text
+ * @return void
+ */
+static void
+exp_render_mc_stats(FILE *fp, const char *labels, short int om)
+{
+	const struct mc_cmd_stats *s;
+	const char *cmd;
+	uint64_t le[sizeof(exp_le_ns) / sizeof(exp_le_ns[0]) + 1];
+	uint64_t v, upper, cum;
+	unsigned int i, j, k, nle = sizeof(exp_le_ns) / sizeof(exp_le_ns[0]);
+
+	exp_family(fp, "aiop_mc_command_latency_seconds", "histogram",
+		   "Latency of the MC commands sent by the exporter.", om);
+	for (i = 0; i < MC_STATS_MAX_CMDS; i++) {
+		s = mc_stats_get(i);
+		if (!s)
+			continue;
+		cmd = aiopt_mc_cmd_str(mc_stats_cmd_id(s));
+
+		/* Fold the log-linear buckets; le[nle] is +Inf */
+		memset(le, 0, sizeof(le));
+		for (j = 0; j < MC_STATS_HIST_BUCKETS; j++) {
+			v = __atomic_load_n(&s->hist[j], __ATOMIC_RELAXED);
+			if (!v)
+				continue;
+			upper = mc_stats_bucket_upper(j);
+			for (k = 0; k < nle && exp_le_ns[k] < upper; k++)
+				;
+			le[k] += v;
+		}
+
+		for (j = 0, cum = 0; j <= nle; j++) {
+			cum += le[j];
+			if (j < nle)
+				fprintf(fp, "aiop_mc_command_latency_seconds_"
+					"bucket{%s,command=\"%s\",le=\"%g\"} "
+					"%lu\n", labels, cmd,
+					exp_le_ns[j] / 1e9, cum);
+			else
+				fprintf(fp, "aiop_mc_command_latency_seconds_"
+					"bucket{%s,command=\"%s\",le=\"+Inf\"}"
+					" %lu\n", labels, cmd, cum);
+		}
+		fprintf(fp, "aiop_mc_command_latency_seconds_count{%s,"
+			"command=\"%s\"} %lu\n", labels, cmd, cum);
+		fprintf(fp, "aiop_mc_command_latency_seconds_sum{%s,"
+			"command=\"%s\"} %.9f\n", labels, cmd,
+			__atomic_load_n(&s->total_ns, __ATOMIC_RELAXED) / 1e9);
+	}
+
+	exp_family(fp, "aiop_mc_command_errors", "counter",
+		   "Completions of MC commands with a status other than OK.",
+		   om);
+	for (i = 0; i < MC_STATS_MAX_CMDS; i++) {
+		s = mc_stats_get(i);
+		if (!s)
+			continue;
+		cmd = aiopt_mc_cmd_str(mc_stats_cmd_id(s));
+
+		for (j = 0; j < MC_STATS_NUM_STATUS; j++) {
+			if (j == MC_CMD_STATUS_OK)
+				continue;
+			v = __atomic_load_n(&s->status[j], __ATOMIC_RELAXED);
+			if (v)
+				fprintf(fp, "aiop_mc_command_errors_total{%s,"
+					"command=\"%s\",status=\"%s\"} %lu\n",
+					labels, cmd, aiopt_mc_status_str(j),
+					v);
+		}
+	}
+}
+
+/*
+ * @brief
+ * Render all metrics from a snapshot of the tile
+ *
+ * @param [in] ctx exporter state
+ * @param [in] snap Snapshot taken by this refresh
+ * @param [in] skew Tile time of day minus host time, in seconds
+ * @param [in] fp Stream to write to
+ * @param [in] om TRUE for OpenMetrics, FALSE for Prometheus text
+ * @return void
+ */
+static void
+exp_render(struct exp_ctx *ctx, const aiopt_snapshot_t *snap, double skew,
+	   FILE *fp, short int om)
+{
+	unsigned int i;
+	const char *l = ctx->labels;
+
+	exp_family(fp, "aiop_up", "gauge",
+		   "Whether the last snapshot read all telemetry of the AIOP "
+		   "tile.", om);
+	fprintf(fp, "aiop_up{%s} %d\n", l, snap->valid == AIOPT_SNAP_ALL);
+
+	if (snap->valid & AIOPT_SNAP_STATE) {
+		exp_family(fp, "aiop_tile_state", "stateset",
+			   "State of the AIOP tile.", om);
+		for (i = 0; i < sizeof(exp_states) / sizeof(exp_states[0]);
+		     i++)
+			fprintf(fp, "aiop_tile_state{%s,aiop_tile_state=\"%s\"}"
+				" %d\n", l, exp_states[i].label,
+				snap->state == exp_states[i].state);
+	}
+
+	if (snap->valid & AIOPT_SNAP_SL_VERSION) {
+		exp_family(fp, "aiop_service_layer_info", "info",
+			   "Version of the Service Layer of the AIOP tile.", om);
+		fprintf(fp, "aiop_service_layer_info{%s,version=\"%d.%d.%d\"}"
+			" 1\n", l, snap->sl_major_v, snap->sl_minor_v,
+			snap->sl_revision);
+	}
+
+	if (snap->valid & AIOPT_SNAP_API_VERSION) {
+		exp_family(fp, "aiop_api_info", "info",
+			   "Version of the dpaiop API of MC.", om);
+		fprintf(fp, "aiop_api_info{%s,version=\"%d.%d\"} 1\n", l,
+			snap->major_v, snap->minor_v);
+	}
+
+	if (snap->valid & AIOPT_SNAP_IRQ) {
+		exp_family(fp, "aiop_irq_status", "gauge",
+			   "Pending events of the dpaiop IRQ.", om);
+		fprintf(fp, "aiop_irq_status{%s} %u\n", l, snap->irq_status);
+	}
+
+	if (snap->valid & AIOPT_SNAP_TOD) {
+		exp_family(fp, "aiop_tod_skew_seconds", "gauge",
+			   "Time of day of the AIOP tile minus that of the "
+			   "host.", om);
+		fprintf(fp, "aiop_tod_skew_seconds{%s} %.3f\n", l, skew);
+	}
+
+	exp_family(fp, "aiop_snapshot_duration_seconds", "gauge",
+		   "Time taken by the MC commands of the last snapshot.", om);
+	fprintf(fp, "aiop_snapshot_duration_seconds{%s} %.9f\n", l,
+		snap->mc_ns / 1e9);
+
+	exp_family(fp, "aiop_exporter_refreshes", "counter",
+		   "Snapshots of the AIOP tile taken by the exporter.", om);
+	fprintf(fp, "aiop_exporter_refreshes_total{%s} %lu\n", l,
+		ctx->refreshes);
+	exp_family(fp, "aiop_exporter_refresh_errors", "counter",
+		   "Snapshots which did not read all telemetry.", om);
+	fprintf(fp, "aiop_exporter_refresh_errors_total{%s} %lu\n", l,
+		ctx->refresh_errors);
+
+	exp_render_mc_stats(fp, l, om);
+
+	if (om)
+		fprintf(fp, "# EOF\n");
+}
+
+/*
+ * @brief
+ * Render a page of metrics
+ *
+ * @param [in] ctx exporter state
+ * @param [in] snap Snapshot taken by this refresh
+ * @param [in] skew Tile time of day minus host time, in seconds
+ * @param [in] om TRUE for OpenMetrics, FALSE for Prometheus text
+ * @param [out] page Rendered page
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+exp_render_page(struct exp_ctx *ctx, const aiopt_snapshot_t *snap,
+		double skew, short int om, struct exp_page *page)
+{
+	FILE *fp;
+
+	page->buf = NULL;
+	page->len = 0;
+	fp = open_memstream(&page->buf, &page->len);
+	if (!fp)
+		return AIOPT_FAILURE;
+	exp_render(ctx, snap, skew, fp, om);
+	if (fclose(fp)) {
+		free(page->buf);
+		page->buf = NULL;
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Write the metrics to the textfile, by rename of a temporary file so that
+ * the collector never reads a partial one
+ *
+ * @param [in] path textfile
+ * @param [in] page Prometheus text rendering
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+exp_write_textfile(const char *path, const struct exp_page *page)
+{
+	int fd;
+	ssize_t n;
+	size_t off = 0;
+	char tmp[PATH_MAX];
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+		return AIOPT_FAILURE;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		AIOPT_DEBUG("Unable to create (%s). (err=%d)\n", tmp, errno);
+		return AIOPT_FAILURE;
+	}
+
+	while (off < page->len) {
+		n = write(fd, page->buf + off, page->len - off);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		off += n;
+	}
+	close(fd);
+
+	if (off != page->len || rename(tmp, path) < 0) {
+		AIOPT_DEBUG("Unable to write (%s). (err=%d)\n", path, errno);
+		unlink(tmp);
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Take a snapshot of the tile and render both pages of metrics from it; the
+ * pages of the previous refresh are kept if rendering fails. Writes the
+ * textfile, if any.
+ *
+ * @param [in] ctx exporter state
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the textfile was not written
+ */
+static int
+exp_refresh(struct exp_ctx *ctx)
+{
+	int ret;
+	double skew = 0;
+	uint64_t start;
+	struct timespec now;
+	aiopt_snapshot_t snap;
+	struct exp_page om, text;
+
+	start = exp_now_ns();
+
+	ret = aiopt_snapshot(ctx->handle, &snap);
+	clock_gettime(CLOCK_REALTIME, &now);
+	ctx->refreshes++;
+	if (ret != AIOPT_SUCCESS) {
+		ctx->refresh_errors++;
+		AIOPT_DEBUG("Snapshot incomplete. (read=0x%x)\n", snap.valid);
+	}
+
+	if ((snap.valid & AIOPT_SNAP_ATTR) && snap.id != ctx->aiop_id) {
+		ctx->aiop_id = snap.id;
+		exp_build_labels(ctx);
+	}
+
+	/* Time of day of the tile is in milliseconds since Epoch */
+	if (snap.valid & AIOPT_SNAP_TOD)
+		skew = snap.tod / 1e3 - (now.tv_sec + now.tv_nsec / 1e9);
+
+	if (exp_render_page(ctx, &snap, skew, TRUE, &om) != AIOPT_SUCCESS)
+		return AIOPT_SUCCESS;
+	if (exp_render_page(ctx, &snap, skew, FALSE, &text) != AIOPT_SUCCESS) {
+		free(om.buf);
+		return AIOPT_SUCCESS;
+	}
+
+	free(ctx->om.buf);
+	free(ctx->text.buf);
+	ctx->om = om;
+	ctx->text = text;
+
+	ret = AIOPT_SUCCESS;
+	if (ctx->conf->textfile)
+		ret = exp_write_textfile(ctx->conf->textfile, &ctx->text);
+
+	AIOPT_DEBUG("Refreshed metrics in %lu us (MC: %lu us).\n",
+			(exp_now_ns() - start) / 1000, snap.mc_ns / 1000);
+
+	return ret;
+}
+
+/* ========================================================================
+ * HTTP
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Drop the clients connected for longer than AIOPT_EXP_CLIENT_TIMEOUT_MS
+ *
+ * @param [in] ctx exporter state
+ * @return void
+ */
+static void
+exp_expire_clients(struct exp_ctx *ctx)
+{
+	unsigned int i;
+	uint64_t now = exp_now_ns();
+	struct aiopt_evl_conn *conn;
+
+	for (i = 0; i < ctx->evl.max_conns && ctx->evl.nconns; i++) {
+		conn = ctx->evl.conns[i];
+		if (conn && now - conn->since_ns >
+			    AIOPT_EXP_CLIENT_TIMEOUT_MS * 1000000ULL) {
+			AIOPT_DEBUG("Client timed out (fd=%d).\n", conn->fd);
+			aiopt_evl_close(&ctx->evl, conn);
+		}
+	}
+}
+
+/*
+ * @brief
+ * Queue the response to the client; the connection is closed once sent
+ *
+ * @param [in] c client
+ * @param [in] status HTTP status line, e.g. "200 OK"
+ * @param [in] ctype Content-Type of body
+ * @param [in] body Body
+ * @param [in] len Length of body
+ * @param [in] head TRUE to leave out the body (HEAD request)
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if memory could not be allocated
+ */
+static int
+exp_respond(struct exp_client *c, const char *status, const char *ctype,
+	    const char *body, size_t len, short int head)
+{
+	c->conn.closing = TRUE;
+	if (aiopt_evl_printf(&c->conn.out, "HTTP/1.1 %s\r\n"
+			     "Content-Type: %s\r\n"
+			     "Content-Length: %zu\r\n"
+			     "Connection: close\r\n\r\n", status, ctype,
+			     len) != AIOPT_SUCCESS)
+		return AIOPT_FAILURE;
+	if (head || !len)
+		return AIOPT_SUCCESS;
+
+	return aiopt_evl_write(&c->conn.out, body, len);
+}
+
+/*
+ * @brief
+ * Answer the request held in the client: the metrics page matching the
+ * Accept header on AIOPT_EXP_METRICS_PATH, an error otherwise
+ *
+ * @param [in] ctx exporter state
+ * @param [in] c client with a complete request head
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+exp_handle_request(struct exp_ctx *ctx, struct exp_client *c)
+{
+	short int head, om = FALSE;
+	char *line, *next, *method, *path, *q, *saveptr = NULL;
+	const struct exp_page *page;
+	static const char not_found[] = "Metrics are at "
+					AIOPT_EXP_METRICS_PATH "\n";
+
+	/* Headers; only Accept is of interest */
+	line = strchr(c->in, '\n');
+	for (line = line ? line + 1 : NULL; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		if (!strncasecmp(line, "Accept:", strlen("Accept:")) &&
+		    strstr(line, "application/openmetrics-text"))
+			om = TRUE;
+	}
+
+	method = strtok_r(c->in, " \r\n", &saveptr);
+	path = strtok_r(NULL, " \r\n", &saveptr);
+	if (!method || !path)
+		return exp_respond(c, "400 Bad Request", "text/plain", "", 0,
+				   FALSE);
+
+	head = !strcmp(method, "HEAD");
+	if (!head && strcmp(method, "GET"))
+		return exp_respond(c, "405 Method Not Allowed", "text/plain",
+				   "", 0, FALSE);
+
+	q = strchr(path, '?');
+	if (q)
+		*q = '\0';
+	if (strcmp(path, AIOPT_EXP_METRICS_PATH))
+		return exp_respond(c, "404 Not Found", "text/plain",
+				   not_found, strlen(not_found), head);
+
+	ctx->scrapes++;
+	page = om ? &ctx->om : &ctx->text;
+
+	return exp_respond(c, "200 OK", om ? EXP_CT_OPENMETRICS : EXP_CT_TEXT,
+			   page->buf, page->len, head);
+}
+
+/*
+ * @brief
+ * Send as much of the response as the socket takes
+ *
+ * @param [in] ctx exporter state
+ * @param [in] c client
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the connection is broken
+ */
+static int
+exp_flush(struct exp_ctx *ctx, struct exp_client *c)
+{
+	return aiopt_evl_flush(&ctx->evl, &c->conn, FALSE);
+}
+
+/*
+ * @brief
+ * Read the request head from a client, and answer it once complete
+ *
+ * @param [in] ctx exporter state
+ * @param [in] c client
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the connection is broken
+ */
+static int
+exp_read(struct exp_ctx *ctx, struct exp_client *c)
+{
+	int ret;
+	ssize_t n;
+	uint64_t start;
+
+	while (1) {
+		n = recv(c->conn.fd, c->in + c->in_len,
+			 sizeof(c->in) - 1 - c->in_len, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return AIOPT_SUCCESS;
+			return AIOPT_FAILURE;
+		}
+		if (n == 0)
+			return AIOPT_FAILURE;
+		c->in_len += n;
+		c->in[c->in_len] = '\0';
+
+		if (strstr(c->in, "\r\n\r\n") || strstr(c->in, "\n\n"))
+			break;
+
+		if (c->in_len == sizeof(c->in) - 1) {
+			ret = exp_respond(c, "431 Request Header Fields Too "
+					  "Large", "text/plain", "", 0, FALSE);
+			return (ret == AIOPT_SUCCESS) ? exp_flush(ctx, c) :
+							ret;
+		}
+	}
+
+	start = exp_now_ns();
+	ret = exp_handle_request(ctx, c);
+	if (ret == AIOPT_SUCCESS)
+		ret = exp_flush(ctx, c);
+	AIOPT_DEV("Request served in %lu us.\n",
+			(exp_now_ns() - start) / 1000);
+
+	return ret;
+}
+
+/*
+ * @brief
+ * Handle the events of a client, as called by the event loop. The client is
+ * closed once its response is sent.
+ *
+ * @param [in] evl event loop
+ * @param [in] conn client
+ * @param [in] events epoll events
+ * @return AIOPT_SUCCESS, or AIOPT_FAILURE for the client to be closed
+ */
+static int
+exp_on_conn(aiopt_evl_t *evl, struct aiopt_evl_conn *conn,
+	    unsigned int events)
+{
+	int ret;
+	struct exp_client *c = (struct exp_client *)conn;
+
+	if (!conn->closing)
+		ret = exp_read(evl->arg, c);
+	else
+		ret = exp_flush(evl->arg, c);
+
+	if (ret != AIOPT_SUCCESS || (conn->closing && !conn->out.len))
+		return AIOPT_FAILURE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Refresh timer handler, as called by the event loop
+ *
+ * @param [in] evl event loop
+ * @param [in] arg exporter state
+ * @return void
+ */
+static void
+exp_on_timer(aiopt_evl_t *evl, void *arg)
+{
+	struct exp_ctx *ctx = arg;
+	uint64_t expirations;
+
+	if (read(ctx->tfd, &expirations, sizeof(expirations)) < 0)
+		return;
+	if (exp_refresh(ctx) != AIOPT_SUCCESS)
+		AIOPT_DEBUG("Textfile not updated.\n");
+	exp_expire_clients(ctx);
+}
+
+/*
+ * @brief
+ * Create the HTTP listening socket
+ *
+ * @param [in] spec [address:]port; an IPv6 address in brackets
+ * @return socket descriptor or AIOPT_FAILURE
+ */
+static int
+exp_listen(const char *spec)
+{
+	int fd = -1, one = 1, err;
+	char buf[128], *host = NULL, *port, *c;
+	struct addrinfo hints, *res, *ai;
+
+	if (strlen(spec) >= sizeof(buf)) {
+		AIOPT_ERR("Listen address too long: (%s)\n", spec);
+		return AIOPT_FAILURE;
+	}
+	strcpy(buf, spec);
+
+	port = buf;
+	c = strrchr(buf, ':');
+	if (c) {
+		*c = '\0';
+		port = c + 1;
+		host = buf;
+		if (*host == '[' && host[strlen(host) - 1] == ']') {
+			host[strlen(host) - 1] = '\0';
+			host++;
+		}
+		if (!*host)
+			host = NULL;	/* ":port" */
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+	err = getaddrinfo(host, port, &hints, &res);
+	if (err) {
+		AIOPT_ERR("Invalid listen address: (%s) (%s)\n", spec,
+			  gai_strerror(err));
+		return AIOPT_FAILURE;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family,
+			    ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			    ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (!bind(fd, ai->ai_addr, ai->ai_addrlen) &&
+		    !listen(fd, SOMAXCONN))
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (fd < 0)
+		AIOPT_ERR("Unable to listen on (%s). (err=%d)\n", spec, errno);
+
+	return fd;
+}
+
+/* ========================================================================
+ * Externally available API definitions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Export the metrics of the AIOP Tile until SIGINT or SIGTERM
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf Exporter configuration
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_export(aiopt_handle_t handle, const aiopt_exporter_conf_t *conf)
+{
+	int lfd, ret = AIOPT_FAILURE;
+	unsigned int interval_ms;
+	struct itimerspec its;
+	struct exp_ctx *ctx;
+
+	AIOPT_DEV("Entering\n");
+
+	if (!conf || (!conf->listen && !conf->textfile)) {
+		AIOPT_DEBUG("Incorrect API Usage. (no listener or file)\n");
+		return AIOPT_FAILURE;
+	}
+
+	interval_ms = conf->interval_ms ? conf->interval_ms :
+					  AIOPT_EXP_DEF_INTERVAL_MS;
+	if (interval_ms < AIOPT_EXP_MIN_INTERVAL_MS) {
+		AIOPT_ERR("Refresh interval below %d ms.\n",
+			  AIOPT_EXP_MIN_INTERVAL_MS);
+		return AIOPT_FAILURE;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return AIOPT_FAILURE;
+	ctx->handle = handle;
+	ctx->conf = conf;
+	ctx->tfd = -1;
+	ctx->aiop_id = -1;
+	exp_build_labels(ctx);
+
+	if (aiopt_evl_init(&ctx->evl, sizeof(struct exp_client),
+			   AIOPT_EXP_MAX_CLIENTS, exp_on_conn, NULL, ctx) !=
+	    AIOPT_SUCCESS) {
+		free(ctx);
+		return AIOPT_FAILURE;
+	}
+
+	if (conf->listen) {
+		lfd = exp_listen(conf->listen);
+		if (lfd < 0 ||
+		    aiopt_evl_listen(&ctx->evl, lfd) != AIOPT_SUCCESS)
+			goto out;
+	}
+
+	ctx->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (ctx->tfd < 0) {
+		AIOPT_DEBUG("Unable to create timer. (err=%d)\n", errno);
+		goto out;
+	}
+	its.it_interval.tv_sec = interval_ms / 1000;
+	its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(ctx->tfd, 0, &its, NULL) < 0 ||
+	    aiopt_evl_add(&ctx->evl, ctx->tfd, exp_on_timer, ctx) !=
+	    AIOPT_SUCCESS)
+		goto out;
+
+	/* Metrics are available from the first scrape on */
+	if (exp_refresh(ctx) != AIOPT_SUCCESS) {
+		AIOPT_ERR("Unable to write metrics to (%s)\n", conf->textfile);
+		goto out;
+	}
+
+	if (conf->listen)
+		AIOPT_PRINT("Exporting metrics on (%s%s), every %u ms.\n",
+			    conf->listen, AIOPT_EXP_METRICS_PATH, interval_ms);
+	if (conf->textfile)
+		AIOPT_PRINT("Exporting metrics to (%s), every %u ms.\n",
+			    conf->textfile, interval_ms);
+
+	if (aiopt_evl_run(&ctx->evl) != AIOPT_SUCCESS)
+		goto out;
+
+	AIOPT_LIB_INFO("%lu refreshes (%lu incomplete), %lu scrapes.\n",
+			ctx->refreshes, ctx->refresh_errors, ctx->scrapes);
+	ret = AIOPT_SUCCESS;
+
+out:
+	aiopt_evl_fini(&ctx->evl);
+	/* Stale metrics are worse than none */
+	if (conf->textfile && ctx->text.buf)
+		unlink(conf->textfile);
+	if (ctx->tfd >= 0)
+		close(ctx->tfd);
+	free(ctx->om.buf);
+	free(ctx->text.buf);
+	free(ctx);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
@@ -0,0 +1,641 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_fleet.c
+ *
+ * @brief	Fleet operations: one AIOP Tool operation executed on the AIOP
+ *		tiles of many containers in parallel, from a worker pool
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <glob.h>
+#include <libgen.h>
+#include <pthread.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_logger.h>
+#include <aiop_lib.h>
+#include <aiop_fleet.h>
+
+/* MC header files */
+#include <fsl_dpaiop.h>
+
+/* ========================================================================
+ * Structures
+ * ======================================================================== */
+
+/*
+ * @brief State shared by the workers of one aiopt_fleet_run
+ */
+struct fleet_job {
+	aiopt_fleet_t		*fleet;
+	const aiopt_fleet_req_t	*req;
+	unsigned int		next;	/**< Next member to pick, atomic >*/
+	short int		open_only; /**< Only open the members, see
+					     fleet_reset >*/
+};
+
+/* ========================================================================
+ * Internal Functions
+ * ======================================================================== */
+
+static uint64_t
+fleet_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * @brief
+ * Add a container to the fleet, unless already in it
+ *
+ * @param [in] fleet fleet
+ * @param [in] name container name
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if name is invalid or fleet is full
+ */
+static int
+fleet_add(aiopt_fleet_t *fleet, const char *name)
+{
+	unsigned int i;
+
+	if (!strlen(name) || strlen(name) >= AIOPT_FLEET_NAME_LEN) {
+		AIOPT_ERR("Container name length incorrect: (%s)\n", name);
+		return AIOPT_FAILURE;
+	}
+
+	for (i = 0; i < fleet->count; i++) {
+		if (!strcmp(fleet->members[i].name, name))
+			return AIOPT_SUCCESS;
+	}
+
+	if (fleet->count == AIOPT_FLEET_MAX_MEMBERS) {
+		AIOPT_ERR("Too many containers (max:%d)\n",
+			  AIOPT_FLEET_MAX_MEMBERS);
+		return AIOPT_FAILURE;
+	}
+
+	strcpy(fleet->members[fleet->count].name, name);
+	fleet->count++;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Add all containers matching a glob pattern to the fleet
+ *
+ * @param [in] fleet fleet
+ * @param [in] pattern pattern on container names, e.g. dprc.*
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+fleet_add_glob(aiopt_fleet_t *fleet, const char *pattern)
+{
+	int ret;
+	size_t i;
+	glob_t g;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s%s", AIOPT_FLEET_SYSFS_DEVICES,
+		 pattern);
+
+	ret = glob(path, 0, NULL, &g);
+	if (ret == GLOB_NOMATCH) {
+		AIOPT_ERR("No container matches (%s)\n", pattern);
+		return AIOPT_FAILURE;
+	} else if (ret) {
+		AIOPT_DEBUG("glob failed on (%s). (err=%d)\n", path, ret);
+		return AIOPT_FAILURE;
+	}
+
+	for (i = 0, ret = AIOPT_SUCCESS; i < g.gl_pathc && !ret; i++)
+		ret = fleet_add(fleet, basename(g.gl_pathv[i]));
+
+	globfree(&g);
+
+	return ret;
+}
+
+/*
+ * @brief
+ * Open a member, if not opened by an earlier operation
+ *
+ * @param [in] m fleet member
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE; init_failed is set on failure
+ */
+static int
+fleet_open(aiopt_fleet_member_t *m)
+{
+	uint64_t start;
+
+	if (m->handle)
+		return AIOPT_SUCCESS;
+	if (m->init_failed)
+		return AIOPT_FAILURE;
+
+	start = fleet_clock_ns();
+	m->handle = aiopt_init(m->name);
+	m->elapsed_ns += fleet_clock_ns() - start;
+	if (AIOPT_INVALID_HANDLE == m->handle) {
+		AIOPT_DEBUG("Unable to open Container (%s)\n", m->name);
+		m->init_failed = TRUE;
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Execute the operation on one member, opening it first if required
+ *
+ * @param [in] m fleet member
+ * @param [in] req operation
+ * @return void; result is stored in the member
+ */
+static void
+fleet_exec(aiopt_fleet_member_t *m, const aiopt_fleet_req_t *req)
+{
+	uint64_t start;
+	short int reset = req->reset;
+	aiopt_load_report_t report;
+
+	if (fleet_open(m) != AIOPT_SUCCESS)
+		return;
+
+	start = fleet_clock_ns();
+	switch (req->op) {
+	case AIOPT_FLEET_LOAD:
+		/* Reset submitted by fleet_reset which MC did not complete
+		 * in time; its portal is still taken
+		 */
+		if (m->ret == AIOPT_ETIMEDOUT)
+			break;
+		aiopt_set_load_timeout(m->handle, req->timeout_ms);
+		aiopt_set_load_skip(m->handle, req->skip);
+		m->ret = aiopt_set_load_limits(m->handle, req->image_max,
+					       req->args_max);
+		if (m->ret != AIOPT_SUCCESS)
+			break;
+		/* Reset submitted by fleet_reset; MC has completed it */
+		if (m->reset_done) {
+			reset = FALSE;
+			m->ret = aiopt_wait_state(m->handle,
+						  DPAIOP_STATE_RESET_DONE,
+						  req->timeout_ms,
+						  &m->status.state);
+			if (m->ret != AIOPT_SUCCESS)
+				break;
+		}
+		if (req->args_mem)
+			m->ret = aiopt_load_args_mem(m->handle,
+						     req->image_file,
+						     req->args_mem,
+						     req->args_mem_sz,
+						     reset, req->tpc);
+		else
+			m->ret = aiopt_load(m->handle, req->image_file,
+					    req->args_file, reset, req->tpc);
+		if (aiopt_get_load_report(m->handle, &report) ==
+		    AIOPT_SUCCESS) {
+			m->status.state = report.state;
+			m->skipped = report.skipped;
+		}
+		break;
+	case AIOPT_FLEET_STATUS:
+		m->ret = aiopt_status(m->handle, &m->status);
+		break;
+	case AIOPT_FLEET_RESET:
+		/* Done by fleet_reset */
+		break;
+	case AIOPT_FLEET_GETTOD:
+		m->ret = aiopt_gettod(m->handle, &m->tod);
+		break;
+	case AIOPT_FLEET_SETTOD:
+		m->ret = aiopt_settod(m->handle, req->tod);
+		break;
+	case AIOPT_FLEET_WAIT:
+		m->status.state = -1;
+		m->ret = aiopt_wait_state(m->handle, req->state,
+					  req->timeout_ms, &m->status.state);
+		break;
+	}
+
+	m->elapsed_ns += fleet_clock_ns() - start;
+}
+
+/*
+ * @brief
+ * Reset all opened members from the calling thread: the reset is submitted
+ * to MC on every member first, then all are polled until MC has completed
+ * them. No thread is held per member while MC works.
+ *
+ * @param [in] fleet fleet, with members opened
+ * @param [in] req operation; RESET, or LOAD with reset
+ * @return void; reset_done is set on members reset, ret on failure for RESET
+ */
+static void
+fleet_reset(aiopt_fleet_t *fleet, const aiopt_fleet_req_t *req)
+{
+	int ret;
+	unsigned int i, pending = 0;
+	uint64_t start, deadline = 0;
+	unsigned int timeout_ms = req->timeout_ms;
+	short int submitted[AIOPT_FLEET_MAX_MEMBERS] = {0};
+	struct timespec ts = {0, AIOPT_FLEET_POLL_US * 1000};
+	aiopt_fleet_member_t *m;
+
+	start = fleet_clock_ns();
+	if (timeout_ms != AIOPT_WAIT_FOREVER)
+		deadline = start + timeout_ms * 1000000ULL;
+
+	for (i = 0; i < fleet->count; i++) {
+		m = &fleet->members[i];
+		if (!m->handle)
+			continue;
+		ret = aiopt_reset_submit(m->handle);
+		if (ret != AIOPT_SUCCESS) {
+			AIOPT_DEBUG("Unable to submit reset on (%s).\n",
+					m->name);
+			m->ret = ret;
+			continue;
+		}
+		submitted[i] = TRUE;
+		pending++;
+	}
+
+	while (pending) {
+		for (i = 0; i < fleet->count; i++) {
+			if (!submitted[i])
+				continue;
+			m = &fleet->members[i];
+			ret = aiopt_poll(m->handle);
+			if (ret == AIOPT_EINPROGRESS)
+				continue;
+			submitted[i] = FALSE;
+			pending--;
+			m->ret = ret;
+			m->reset_done = ret == AIOPT_SUCCESS;
+			m->elapsed_ns += fleet_clock_ns() - start;
+		}
+		if (!pending)
+			break;
+		if (deadline && fleet_clock_ns() >= deadline) {
+			AIOPT_DEBUG("%u resets not completed in %u ms.\n",
+					pending, timeout_ms);
+			break;
+		}
+		nanosleep(&ts, NULL);
+	}
+
+	/* Left to MC; reaped as the handles are deinitialized */
+	for (i = 0; i < fleet->count; i++) {
+		if (!submitted[i])
+			continue;
+		m = &fleet->members[i];
+		m->ret = AIOPT_ETIMEDOUT;
+		m->status.state = -1;
+		m->elapsed_ns += fleet_clock_ns() - start;
+	}
+
+	AIOPT_DEBUG("Fleet reset done in %lu us.\n",
+			(fleet_clock_ns() - start) / 1000);
+}
+
+/*
+ * @brief
+ * Worker thread: picks members one by one until none is left
+ *
+ * @param [in] arg struct fleet_job
+ * @return NULL
+ */
+static void *
+fleet_worker(void *arg)
+{
+	struct fleet_job *job = arg;
+	unsigned int idx;
+
+	while (1) {
+		idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (idx >= job->fleet->count)
+			break;
+		if (job->open_only)
+			fleet_open(&job->fleet->members[idx]);
+		else
+			fleet_exec(&job->fleet->members[idx], job->req);
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief
+ * Run a job on all members from a pool of worker threads, and wait for it
+ * to complete
+ *
+ * @param [in] job job; next is reset here
+ * @param [in] workers number of worker threads
+ * @param [out] tids thread ids, at least workers
+ * @return number of workers which ran the job; 0 if the caller did
+ */
+static unsigned int
+fleet_start(struct fleet_job *job, unsigned int workers, pthread_t *tids)
+{
+	unsigned int i, started = 0;
+
+	job->next = 0;
+
+	for (i = 0; i < workers; i++) {
+		if (pthread_create(&tids[i], NULL, fleet_worker, job)) {
+			AIOPT_DEBUG("Unable to create worker. (err=%d)\n",
+					errno);
+			break;
+		}
+		started++;
+	}
+
+	/* With no worker at all, the caller does the work */
+	if (!started)
+		fleet_worker(job);
+
+	for (i = 0; i < started; i++)
+		pthread_join(tids[i], NULL);
+
+	return started;
+}
+
+/* ========================================================================
+ * Externally available API definitions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Check if a container argument names more than one container
+ *
+ * @param [in] spec container argument
+ * @return TRUE or FALSE
+ */
+int
+aiopt_fleet_is_spec(const char *spec)
+{
+	if (!spec)
+		return FALSE;
+
+	return strpbrk(spec, ",*?[") != NULL;
+}
+
+/*
+ * @brief
+ * Create a fleet from a comma separated list of containers and/or patterns
+ *
+ * @param [in] spec container list
+ * @return fleet or NULL if spec is invalid or matches nothing
+ */
+aiopt_fleet_t *
+aiopt_fleet_create(const char *spec)
+{
+	int ret = AIOPT_SUCCESS;
+	char *list, *tok, *saveptr = NULL;
+	aiopt_fleet_t *fleet;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!spec)
+		return NULL;
+
+	list = strdup(spec);
+	fleet = calloc(1, sizeof(*fleet));
+	if (!list || !fleet) {
+		AIOPT_DEBUG("Unable to allocate memory for fleet.\n");
+		goto err_out;
+	}
+
+	for (tok = strtok_r(list, ",", &saveptr); tok && !ret;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		if (strpbrk(tok, "*?["))
+			ret = fleet_add_glob(fleet, tok);
+		else
+			ret = fleet_add(fleet, tok);
+	}
+
+	if (ret != AIOPT_SUCCESS || !fleet->count)
+		goto err_out;
+
+	free(list);
+	AIOPT_DEBUG("Fleet of %u containers created from (%s).\n",
+			fleet->count, spec);
+
+	return fleet;
+
+err_out:
+	free(list);
+	free(fleet);
+	return NULL;
+}
+
+/*
+ * @brief
+ * Execute an operation on all members of the fleet from a worker pool
+ *
+ * @param [in] fleet fleet created by aiopt_fleet_create
+ * @param [in] req operation to execute
+ * @param [in] workers number of worker threads; 0 for the default
+ *
+ * @return AIOPT_SUCCESS if the operation succeeded on every member, else
+ *         AIOPT_FAILURE
+ */
+int
+aiopt_fleet_run(aiopt_fleet_t *fleet, const aiopt_fleet_req_t *req,
+		unsigned int workers)
+{
+	unsigned int i, started;
+	short int with_reset;
+	char *env;
+	pthread_t tids[AIOPT_FLEET_MAX_MEMBERS];
+	struct fleet_job job;
+	aiopt_fleet_member_t *m;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!fleet || !req) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
+	}
+
+	if (!workers) {
+		env = getenv(AIOPT_FLEET_WORKERS_ENV);
+		workers = env ? atoi(env) : AIOPT_FLEET_DEF_WORKERS;
+		if (!workers)
+			workers = AIOPT_FLEET_DEF_WORKERS;
+	}
+	if (workers > fleet->count)
+		workers = fleet->count;
+
+	for (i = 0; i < fleet->count; i++) {
+		m = &fleet->members[i];
+		m->ret = AIOPT_FAILURE;
+		m->init_failed = FALSE;
+		m->skipped = FALSE;
+		m->reset_done = FALSE;
+		m->elapsed_ns = 0;
+	}
+
+	job.fleet = fleet;
+	job.req = req;
+
+	/* Resets are submitted and polled from this thread, once the workers
+	 * have opened the members
+	 */
+	with_reset = req->op == AIOPT_FLEET_RESET ||
+		     (req->op == AIOPT_FLEET_LOAD && req->reset);
+	if (with_reset) {
+		job.open_only = TRUE;
+		started = fleet_start(&job, workers, tids);
+		fleet_reset(fleet, req);
+	}
+
+	if (req->op != AIOPT_FLEET_RESET) {
+		job.open_only = FALSE;
+		started = fleet_start(&job, workers, tids);
+	}
+
+	AIOPT_DEBUG("Fleet operation done on %u containers with %u workers.\n",
+			fleet->count, started);
+
+	for (i = 0; i < fleet->count; i++) {
+		if (fleet->members[i].ret != AIOPT_SUCCESS)
+			return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Print the results of the last operation as a table
+ *
+ * @param [in] fleet fleet
+ * @param [in] req operation last executed
+ * @param [in] fp stream to write to
+ * @return void
+ */
+void
+aiopt_fleet_print(aiopt_fleet_t *fleet, const aiopt_fleet_req_t *req,
+		  FILE *fp)
+{
+	unsigned int i, ok = 0;
+	aiopt_fleet_member_t *m;
+
+	fprintf(fp, "%-16s %-8s %10s  %s\n", "Container", "Result",
+		"Time(ms)", "Details");
+
+	for (i = 0; i < fleet->count; i++) {
+		m = &fleet->members[i];
+		fprintf(fp, "%-16s %-8s %10.1f  ", m->name,
+			m->ret == AIOPT_SUCCESS ? "OK" : "FAILED",
+			m->elapsed_ns / 1000000.0);
+
+		if (m->ret == AIOPT_SUCCESS)
+			ok++;
+
+		if (m->init_failed) {
+			fprintf(fp, "Unable to open container\n");
+			continue;
+		}
+
+		if (m->ret != AIOPT_SUCCESS && (req->op == AIOPT_FLEET_WAIT ||
+						req->op == AIOPT_FLEET_LOAD)) {
+			fprintf(fp, "err=%d, %s\n", m->ret,
+				aiopt_get_state_str(m->status.state));
+			continue;
+		}
+
+		if (m->ret != AIOPT_SUCCESS) {
+			fprintf(fp, "err=%d\n", m->ret);
+			continue;
+		}
+
+		switch (req->op) {
+		case AIOPT_FLEET_STATUS:
+			fprintf(fp, "%s, SL %d.%d.%d\n",
+				aiopt_get_state_str(m->status.state),
+				m->status.sl_major_v, m->status.sl_minor_v,
+				m->status.sl_revision);
+			break;
+		case AIOPT_FLEET_GETTOD:
+			fprintf(fp, "%lu\n", m->tod);
+			break;
+		case AIOPT_FLEET_LOAD:
+		case AIOPT_FLEET_WAIT:
+			fprintf(fp, "%s%s\n",
+				aiopt_get_state_str(m->status.state),
+				m->skipped ? " (load skipped)" : "");
+			break;
+		default:
+			fprintf(fp, "-\n");
+			break;
+		}
+	}
+
+	fprintf(fp, "%u of %u containers succeeded.\n", ok, fleet->count);
+	fflush(fp);
+}
+
+/*
+ * @brief
+ * Deinitialize all opened members and release the fleet
+ *
+ * @param [in] fleet fleet
+ * @return void
+ */
+void
+aiopt_fleet_destroy(aiopt_fleet_t *fleet)
+{
+	unsigned int i;
+
+	if (!fleet)
+		return;
+
+	for (i = 0; i < fleet->count; i++) {
+		if (fleet->members[i].handle)
+			aiopt_deinit(fleet->members[i].handle);
+	}
+
+	free(fleet);
+}
@@ -44,6 +44,10 @@
 #include <unistd.h>
 #include <libgen.h>
 #include <limits.h>
+#include <time.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/eventfd.h>
 
 /* AIOP Tool Specific includes */
 #include <aiop_cmd.h>
@@ -51,12 +55,17 @@
 #include <aiop_logger.h>
 #include <aiop_tool_dummy.h>
 #include <aiop_lib.h>
+#include <aiop_mc_sim.h>
+#include <aiop_crc32c.h>
+#include <aiop_elf.h>
+#include <aiop_decomp.h>
 
 /*MC header files*/                                                            
 #include <fsl_dpaiop.h>                                                         
 #include <fsl_dpaiop_cmd.h>
 #include <fsl_mc_sys.h>
 #include <fsl_mc_cmd.h>
+#include <fsl_mc_stats.h>
 
 /* VFIO headers */
 #include <fsl_vfio.h>
@@ -70,6 +79,71 @@
  */
 #define AIOPT_RUN_CORES_ALL		0xFFFF
 
+/* @def AIOPT_FNV64_OFFSET, AIOPT_FNV64_PRIME
+ * @brief Parameters of the 64-bit FNV hash used for image keys
+ */
+#define AIOPT_FNV64_OFFSET		0xcbf29ce484222325ULL
+#define AIOPT_FNV64_PRIME		0x100000001b3ULL
+
+/* @def AIOPT_DIGEST_CHUNK_SZ
+ * @brief Image data is checksummed and hashed in chunks of this size, each
+ * right after it is read, while still in cache
+ */
+#define AIOPT_DIGEST_CHUNK_SZ		(256 * 1024)
+
+/* ========================================================================
+ * Structures
+ * ======================================================================== */
+
+/*
+ * @brief Digests computed over an AIOP Image or its arguments as they are
+ * read
+ */
+struct load_digest {
+	uint32_t	crc;	/**< CRC32C, checked against the sidecar >*/
+	uint64_t	hash;	/**< For the image key, see image_hash >*/
+};
+
+/*
+ * @brief Digests being extended over a buffer as it is filled
+ */
+struct digest_stream {
+	struct load_digest *dg;
+	const char	*buf;
+	size_t		digested;	/**< Bytes of buf digested so far >*/
+};
+
+/*
+ * @brief Image and arguments of a load, each taken from an opened file or
+ * from caller memory
+ */
+struct load_src {
+	int		fd;		/**< Image file, or -1 >*/
+	int		comp;		/**< Of the file, enum aiopt_comp >*/
+	const void	*image;		/**< Image in memory, if fd is -1 >*/
+	size_t		image_sz;	/**< Of the file or image in memory >*/
+	size_t		image_bound;	/**< Largest image_sz once read;
+					  larger than it if compressed >*/
+	int		args_fd;	/**< Args file, or -1 >*/
+	const void	*args;		/**< Args in memory, if args_fd is -1 >*/
+	size_t		args_sz;	/**< 0 without arguments >*/
+	const uint32_t	*expected_crc;	/**< NULL if not known >*/
+};
+
+/*
+ * @brief MC command submitted on a leased portal without waiting for it,
+ * see aiopt_reset_submit and perform_dpaiop_load; reaped by aiopt_poll
+ */
+struct aiopt_async {
+	aiopt_portal_t	*p;		/**< Leased until the command is
+					  reaped >*/
+	struct mc_command cmd;		/**< Command, then its response >*/
+	short int	retried;	/**< Session re-opened once already >*/
+	int		(*submit)(struct aiopt_async *as);
+					/**< (Re-)submits the command >*/
+	struct dpaiop_load_cfg load_cfg; /**< Of a load, to submit again >*/
+};
+
 /*=========================================================================
  * Internal Functions
  *=========================================================================*/
@@ -127,1138 +201,4541 @@ aiopt_get_aiop_id(aiopt_obj_t *obj)
 
 /*
  * @brief
- * Obtain MC API's token obtained after dpaiop_open call
+ * Lease a portal of the object for an MC command, waiting for one to be
+ * returned if all are in use. Portals are tried in order, so that a single
+ * thread keeps to the first one.
  *
- * @param [in] obj aiopt_obj_t type object
- * @return (int) Token value in integer
+ * @param [in] obj aiopt_obj_t type object with portals set up
+ * @return Portal leased; NULL if the object has none
  */
-static inline int
-aiopt_get_aiop_token(aiopt_obj_t *obj)
+static aiopt_portal_t *
+portal_lease(aiopt_obj_t *obj)
 {
-	if (!obj) {
-		AIOPT_DEV("Incorrect API usage.\n");
-		return 0;
-	}
-	return obj->devices[AIOP_TYPE].token;
-}
+	unsigned int i;
+	aiopt_portal_t *p = NULL;
 
-/*
- * @brief Obtain reference to MC API's token obtained after dpaiop_open call
- *
- * @param [in] obj aiopt_obj_t type object
- * @return (unsigned short int *) Pointer to Token embedded in obj
- */
-static inline unsigned short int *
-aiopt_get_aiop_token_byref(aiopt_obj_t *obj)
-{
-	if (!obj) {
-		AIOPT_DEV("Incorrect API usage.\n");
+	if (!obj->num_portals) {
+		AIOPT_DEV("No MC portal set up.\n");
 		return NULL;
 	}
-	return &(obj->devices[AIOP_TYPE].token);
+
+	pthread_mutex_lock(&obj->pool_lock);
+	while (1) {
+		for (i = 0; i < obj->num_portals; i++) {
+			if (!obj->portals[i].leased) {
+				p = &obj->portals[i];
+				break;
+			}
+		}
+		if (p)
+			break;
+		pthread_cond_wait(&obj->pool_cond, &obj->pool_lock);
+	}
+	p->leased = TRUE;
+	pthread_mutex_unlock(&obj->pool_lock);
+
+	return p;
 }
 
 /*
  * @brief
- * Cleanup of the aiopt_obj_t instance by releasing all allocated space to
- * members.
- *
- * @param [in] obj aiopt_obj_t type object for cleanup
+ * Return a portal leased with portal_lease
  *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] p Portal leased
  * @return void
  */
 static void
-cleanup_aiopt_obj(aiopt_obj_t *obj) {
-	int i = 0;
-	dpobj_type_t *dp = NULL;
-
-	for (i = 0; i < MAX_DPOBJ_DEVICES; i++) {
-		dp = &obj->devices[i];
-		if (dp->name) {
-			free(dp->name);
-			dp->name = NULL;
-		}
-	}
+portal_release(aiopt_obj_t *obj, aiopt_portal_t *p)
+{
+	pthread_mutex_lock(&obj->pool_lock);
+	p->leased = FALSE;
+	pthread_cond_signal(&obj->pool_cond);
+	pthread_mutex_unlock(&obj->pool_lock);
 }
 
 /*
  * @brief
- * Allocating and initializing MC portal through VFIO APIs
+ * Open a dpaiop session on an MC portal of the object. The token obtained is
+ * held in the portal and used by all subsequent MC commands issued on it
+ * until the session is closed.
  *
- * @param [in] obj aiopt_obj_t type handle for AIOPT
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] p Portal, already mapped
  * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
 static int
-setup_mc_portal(aiopt_obj_t *obj)
+open_aiop_session(aiopt_obj_t *obj, aiopt_portal_t *p)
 {
-	fsl_vfio_t vfio_handle;
+	int ret;
 
-	if (!obj) {
-		AIOPT_DEV("Incorrect API Usage.\n");
+	ret = dpaiop_open(p->mc_io, CMD_PRI_LOW, aiopt_get_aiop_id(obj),
+				&p->token);
+	if (ret != 0) {
+		AIOPT_DEBUG("Unable to open dpaiop on %s (MC API err=%d).\n",
+				p->name, ret);
+		p->session_open = FALSE;
 		return AIOPT_FAILURE;
 	}
 
-	vfio_handle = obj->vfio_handle;
-	/* Allocate memory for MC Portal list */
-	obj->mcp_addr64 = fsl_vfio_map_mcp_obj(vfio_handle,
-						obj->devices[MCP_TYPE].name);
-	if (obj->mcp_addr64 == (int64_t) MAP_FAILED) {
-		AIOPT_DEV("Unable to map MCP address. (%d)\n", errno);
-		return AIOPT_FAILURE;
-	}
+	p->session_open = TRUE;
+	AIOPT_DEBUG("Opened AIOP device on %s. (Token=%d)\n", p->name,
+			p->token);
 
 	return AIOPT_SUCCESS;
 }
 
 /*
  * @brief
- * Generic method for filling information into aiopt_obj_t type object from the
- * VFIO directory entry.
- *
- * @param [in] obj_p Object Name string embedded in object
- * @param [in] obj_id Object ID embedded in object
- * @param [in] dir_name constant string describing directory name
+ * Close the dpaiop session held on a portal, if any.
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ * @param [in] p Portal
+ * @return void
  */
-static int
-fill_obj_info(aiopt_obj_t *obj, dpobj_type_list_t type, const char *dir_name)
+static void
+close_aiop_session(aiopt_portal_t *p)
 {
 	int ret;
-	char *p = NULL, *t = NULL;
-	char *dir_c = NULL;
-	unsigned int id;
-	dpobj_type_t *device = NULL;
 
-	if (!obj || !dir_name || (type >= MAX_DPOBJ_DEVICES)) {
-		AIOPT_DEV("Internal error; Incorrect API usage.\n");
-		return AIOPT_FAILURE;
-	}
-
-	/* Creating a copy of dir_name as it might be modified by strtok */
-	dir_c = calloc(1, strlen(dir_name) + 1);
-	if (!dir_c) {
-		AIOPT_DEBUG("Unable to allocate internal memory.\n");
-		goto err_cleanup;
-	}
-	strcpy(dir_c, dir_name);
+	if (!p->session_open)
+		return;
 
-	p = calloc(1, strlen(dir_name) + 1);
-	if (!p) {
-		AIOPT_DEBUG("Unable to allocate memory.\n")
-		goto err_cleanup;
-	}
-	strcpy(p, dir_name);
-	t = strtok(dir_c, ".");
-	t = strtok(NULL, ".");
-	sscanf(t, "%d", &id);
+	ret = dpaiop_close(p->mc_io, CMD_PRI_LOW, p->token);
+	AIOPT_DEBUG("MC API dpaiop_close performed on %s. (err=%d)\n",
+			p->name, ret);
 
-	device = &(obj->devices[type]);
+	/* token is invalid hereafter, even if close failed */
+	p->session_open = FALSE;
+}
 
-	device->name = p;
-	device->id = id;
+/*
+ * @brief
+ * Check the result of an MC command issued on the session of a portal. If
+ * MC has rejected the token (-EACCES), the session is re-opened so that the
+ * caller can re-issue the command. This is done only once per caller. The
+ * portal is leased by the caller, so no other thread uses the session.
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] p Portal the command was issued on
+ * @param [in] err Return value of the MC command
+ * @param [in/out] retried Caller owned flag; set once a re-open is done
+ *
+ * @return TRUE if the command should be re-issued, else FALSE
+ */
+static int
+aiopt_session_expired(aiopt_obj_t *obj, aiopt_portal_t *p, int err,
+		      short int *retried)
+{
+	if (err != -EACCES || *retried)
+		return FALSE;
 
-	/* For AIOP, open and obtain device information. This is
-	 * not required for dpmcp object.
-	 */
-	if (type == AIOP_TYPE) {
-		memset(&(device->di), 0, sizeof(struct vfio_device_info));
-		device->di.argsz = sizeof(struct vfio_device_info);
-
-		/* getting the device fd*/
-		device->fd = fsl_vfio_get_dev_fd(obj->vfio_handle,
-							device->name);
-		if (device->fd < 0) {
-			AIOPT_DEBUG("Unable to obtain device FD from VFIO (%s)"
-				"; fd from group (%d)\n",
-				device->name,
-				fsl_vfio_get_group_fd(obj->vfio_handle));
-			goto err_cleanup;
-		}
+	*retried = TRUE;
+	AIOPT_DEBUG("MC rejected token (%d) on %s; re-opening dpaiop "
+			"session.\n", p->token, p->name);
 
-		/* Get Device inofrmation */
-		ret = fsl_vfio_get_device_info(obj->vfio_handle, device->name,
-						&(device->di));
-		if (ret != 0) {
-			AIOPT_DEBUG("Unable to fetch device info "
-					"(VFIO_DEVICE_FSL_MC_GET_INFO).\n");
-			goto err_cleanup;
-		}
-	}
+	/* Old token is not closed - MC has already disowned it */
+	p->session_open = FALSE;
+	if (open_aiop_session(obj, p) != AIOPT_SUCCESS)
+		return FALSE;
 
-	if (dir_c)
-		free(dir_c);
+	return TRUE;
+}
 
-	return AIOPT_SUCCESS;
+/*
+ * @brief
+ * Dump the MC command wait accounting of the portals used by the object
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @return void
+ */
+static void
+print_mc_wait_stats(aiopt_obj_t *obj)
+{
+	unsigned int i;
+	struct mc_wait_stats *st;
+
+	if (!obj)
+		return;
+
+	for (i = 0; i < obj->num_portals; i++) {
+		st = &obj->portals[i].mc_io->wait_stats;
+		AIOPT_DEBUG("MC wait (%s): commands=%lu, spins=%lu, "
+				"relaxes=%lu, sleeps=%lu, slept=%luns, "
+				"timeouts=%lu\n", obj->portals[i].name,
+				st->commands, st->spins, st->relaxes,
+				st->sleeps, st->slept_ns, st->timeouts);
+	}
+}
 
-err_cleanup:
-	if (dir_c)
-		free(dir_c);
-	if (p) {
-		free(p);
-		device->name = NULL;
+/*
+ * @brief
+ * DMA map a buffer so that AIOP/MC can access it. The IOVA is allocated by
+ * VFIO from the IOVA window of the container, see aiopt_set_iova_window. The
+ * MC simulator shares the address space, so there the IOVA is the virtual
+ * address.
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] addr Virtual address of the buffer
+ * @param [in] len Length of the buffer
+ * @param [in] align Alignment of the IOVA, 0 for the base page size
+ * @param [out] iova Device address of the buffer
+ *
+ * @return VFIO_SUCCESS or VFIO_FAILURE
+ */
+static int
+aiopt_dma_map(aiopt_obj_t *obj, void *addr, size_t len, size_t align,
+	      uint64_t *iova)
+{
+	if (obj->sim) {
+		*iova = (uint64_t)addr;
+		return VFIO_SUCCESS;
 	}
 
-	return AIOPT_FAILURE;
+	return fsl_vfio_setup_dmamap(obj->vfio_handle, (uint64_t)addr, len,
+				     align, iova);
 }
 
 /*
  * @brief
- * Wrapper around internal fill_obj_info method for MCP information. It is
- * expected that the caller has set dir_name parameter to the correct dpmcp
- * object in the sysfs directory structure.
+ * Remove a DMA mapping done by aiopt_dma_map, releasing its IOVA
  *
- * @param [in] obj aiopt_obj_t type object to fill information into
- * @param [in] dir_name constant string describing directory name
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] iova Device address returned by aiopt_dma_map
+ * @param [in] len Length of the buffer
  *
- * @return value as returned by fill_obj_info
+ * @return void
  */
-static inline int
-fill_mcp_obj_info(aiopt_obj_t *obj, const char *dir_name)
+static void
+aiopt_dma_unmap(aiopt_obj_t *obj, uint64_t iova, size_t len)
 {
-	int ret;
-
-	ret = fill_obj_info(obj, MCP_TYPE, dir_name);
-	AIOPT_DEV("fill_obj_info returns (%d).\n", ret);
+	if (obj->sim)
+		return;
 
-	return ret;
+	fsl_vfio_destroy_dmamap(obj->vfio_handle, iova, len);
 }
 
 /*
  * @brief
- * Calls internal fill_obj_info method for filling AIOP information. It is
- * expected that the caller has set dir_name parameter to the correct dpaiop
- * object in the sysfs directory structure.
- * Unlike fill_mcp_obj_info, this method also fills in device_info structure
- * and device_fd information.
+ * Find the default huge page size of the system, as used by MAP_HUGETLB
  *
- * @param [in] obj aiopt_obj_t type object to fill information into
- * @param [in] dir_name constant string describing directory name
- *
- * @return value as returned by fill_obj_info
+ * @param void
+ * @return Huge page size in bytes, or 0 if huge pages are not supported
  */
-static inline int
-fill_aiop_obj_info(aiopt_obj_t *obj, const char *dir_name)
+static size_t
+get_default_hugepage_sz(void)
 {
-	int ret;
+	FILE *fp;
+	char line[128];
+	unsigned long kb = 0;
 
-	ret = fill_obj_info(obj, AIOP_TYPE, dir_name);
-	AIOPT_DEV("fill_obj_info returns (%d).\n", ret);
+	fp = fopen("/proc/meminfo", "r");
+	if (!fp)
+		return 0;
 
-	return ret;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1)
+			break;
+	}
+	fclose(fp);
+
+	return (size_t)kb * 1024;
 }
 
 /*
  * @brief
- * Initialize the AIOP Device by calling the MC operations for dpaiop_open.
- * Takes as input a completely filled aiopt_obj_t type object, including info
- * for FD, HW ID and MC Portal Address.
- *
- * @param [IN] obj aiopt_obj_t type object containing MCP/AIOP Device info
+ * Size of a DMA arena holding the largest image and arguments allowed on the
+ * object, laid out as by load_via_dma_arena
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ * @param [in] obj aiopt_obj_t type object
+ * @return Size in bytes
  */
-static int
-init_aiop(aiopt_obj_t *obj)
+static size_t
+dma_arena_fit_sz(aiopt_obj_t *obj)
 {
-	int ret, ret_2;
-	int *hw_id;
-	unsigned short int *token;
-	struct fsl_mc_io *dpaiop = NULL;
-	struct dpaiop_sl_version sl_version = {0};
+	return AIOPT_ALIGN_PAGE(obj->limits.image_max) +
+		AIOPT_ALIGN_PAGE(obj->limits.args_max);
+}
 
-	AIOPT_DEV("Entering.\n");
+/*
+ * @brief
+ * Release the DMA arena of the object, if any
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @return void
+ */
+static void
+release_dma_arena(aiopt_obj_t *obj)
+{
+	aiopt_dma_arena_t *arena = &obj->arena;
 
-	if (!obj) {
-		AIOPT_DEBUG("Incorrect API usage.\n");
-		ret = AIOPT_FAILURE;
-		goto err;
-	}
+	if (!arena->addr)
+		return;
 
-	/* Open the nadk device via MC and save the handle for further use */
-	dpaiop = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
-	if (!dpaiop) {
-		AIOPT_DEBUG("Unable to allocate memory for dpaiop obj.\n");
-		ret = AIOPT_FAILURE;
-		goto err;
-	}
+	AIOPT_DEBUG("Releasing DMA arena (%p, %lu bytes) after %lu loads.\n",
+			arena->addr, arena->size, arena->loads);
+	aiopt_dma_unmap(obj, arena->iova, arena->size);
+	munmap(arena->addr, arena->size);
+	memset(arena, 0, sizeof(*arena));
+}
 
-	dpaiop->regs = obj->mcp_addr;
-	hw_id = &(obj->devices[AIOP_TYPE].id);
-	token = &(obj->devices[AIOP_TYPE].token);
+/*
+ * @brief
+ * Disable the dpaiop IRQ and release its eventfd, if set up. Must be called
+ * before the dpaiop sessions are closed.
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @return void
+ */
+static void
+teardown_aiop_irq(aiopt_obj_t *obj)
+{
+	aiopt_portal_t *p;
 
-	/* Opening AIOP device */
-	ret = dpaiop_open(dpaiop, CMD_PRI_LOW, *hw_id, token);
-	if (ret != 0) {
-		AIOPT_DEBUG("Opening device failed with err code: %d", ret);
-		ret = AIOPT_FAILURE;
-		goto err;
-	}
+	if (obj->irq_fd < 0)
+		return;
 
-	/* Get the device version */
-	ret = dpaiop_get_sl_version(dpaiop, CMD_PRI_LOW, *token, &sl_version);
-	if (ret != 0) {
-		AIOPT_DEV("Unable to get AIOP Version information: %d.\n",
-			ret);
-		/* This is not considered an error */
-		AIOPT_DEV("Attributes: id=%d, v.major=-NA-, v.minor=-NA-.\n",
-			*hw_id);
-	} else {
-		AIOPT_DEV("Attributes: id=%d, v.major=%d, v.minor=%d.\n",
-			*hw_id, sl_version.major, sl_version.minor);
+	if (obj->num_portals) {
+		p = portal_lease(obj);
+		dpaiop_set_irq_enable(p->mc_io, 0, p->token,
+				      AIOPT_AIOP_IRQ_INDEX, 0);
+		portal_release(obj, p);
 	}
-	AIOPT_LIB_INFO("Successfully initialized the AIOP device.\n");
-
-	/* Close the device */
-	ret_2 = dpaiop_close(dpaiop, CMD_PRI_LOW, *token);
-	if (ret_2 != 0)
-		AIOPT_DEBUG("Closing AIOP dev failed (%d).\n", ret);
 
-	/* token is invalid hereafter */
-err:
-	if (dpaiop)
-		free(dpaiop);
+	if (obj->sim)
+		aiopt_mcsim_set_irq_fd(obj->sim, aiopt_get_aiop_id(obj), -1);
+	else
+		fsl_vfio_destroy_irq(obj->vfio_handle,
+				     obj->devices[AIOP_TYPE].fd,
+				     AIOPT_AIOP_IRQ_INDEX);
 
-	AIOPT_DEV("Exiting (%d)\n", ret);
-	return ret;
+	close(obj->irq_fd);
+	obj->irq_fd = -1;
 }
 
 /*
  * @brief
- * Initialize the MCP and AIOP objects present in the container and tag them
- * into an internal data structure.
- *
- * @param [in] obj aiopt_obj_t type object to populate
+ * Route the dpaiop IRQ to an eventfd (through VFIO, or the simulator) and
+ * enable it for all tile events, so that aiopt_wait_state can block on tile
+ * state changes. Requires the dpaiop session to be open.
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ * @param [in] obj aiopt_obj_t type object
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE; obj->irq_fd stays -1 on failure
  */
 static int
-setup_aiopt_device(aiopt_obj_t *obj)
+setup_aiop_irq(aiopt_obj_t *obj)
 {
-	int ret;
-	unsigned char mcp_avail = FALSE, aiop_avail = FALSE;
-
-	DIR *d;
-	struct dirent *dir;
-	char path[VFIO_PATH_MAX];
+	int ret, fd;
+	aiopt_portal_t *p;
 
-	if (!obj) {
-		AIOPT_DEV("Incorrect API usage.\n");
+	if (!obj->sim && !obj->devices[AIOP_TYPE].di.num_irqs) {
+		AIOPT_DEBUG("dpaiop has no IRQ.\n");
 		return AIOPT_FAILURE;
 	}
 
-	sprintf(path, SYSFS_IOMMU_PATH_VSTR,
-			fsl_vfio_get_group_id(obj->vfio_handle));
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0) {
+		AIOPT_DEBUG("Unable to create eventfd. (err=%d)\n", errno);
+		return AIOPT_FAILURE;
+	}
 
-	AIOPT_LIB_INFO("VFIO Devices path = %s\n", path);
-	d = opendir(path);
-	if (!d) {
-		AIOPT_DEBUG("Unable to open VFIO directory: %s\n", path);
+	if (obj->sim)
+		ret = aiopt_mcsim_set_irq_fd(obj->sim, aiopt_get_aiop_id(obj),
+					     fd);
+	else
+		ret = fsl_vfio_setup_irq(obj->vfio_handle,
+					 obj->devices[AIOP_TYPE].fd,
+					 AIOPT_AIOP_IRQ_INDEX, fd);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_DEBUG("Unable to route dpaiop IRQ to eventfd.\n");
+		close(fd);
 		return AIOPT_FAILURE;
 	}
+	obj->irq_fd = fd;
 
-	/* Finding and extracting MCP and AIOP Objects.
-	 * XXX only the first occurences of each are taken - if there are
-	 * multiple instances of any (AIOP/MC), they are not looked for.
+	/* Event bits are not individually defined by MC; every event is
+	 * unmasked and the waiter re-reads the state on each.
 	 */
-	while ((dir = readdir(d)) != NULL) {
-		if (!(dir->d_type == DT_LNK))
-			continue;
-		if (!strncmp("dpmcp", dir->d_name, 5) && !mcp_avail) {
-			ret = fill_mcp_obj_info(obj, dir->d_name);
-			if (ret != AIOPT_SUCCESS) {
-				goto err_cleanup;
-			}
-			/* Only the first instance of MC and AIOP is taken */
-			mcp_avail = TRUE;
-		}
-		if (!strncmp("dpaiop", dir->d_name, 6) && !aiop_avail) {
-			ret = fill_aiop_obj_info(obj, dir->d_name);
-			if (ret != AIOPT_SUCCESS) {
-				goto err_cleanup;
-			}
-			/* Only the first instance of MC and AIOP is taken */
-			aiop_avail = TRUE;
-		}
+	p = portal_lease(obj);
+	ret = dpaiop_set_irq_mask(p->mc_io, 0, p->token,
+				  AIOPT_AIOP_IRQ_INDEX, 0xFFFFFFFF);
+	if (!ret)
+		ret = dpaiop_clear_irq_status(p->mc_io, 0, p->token,
+					      AIOPT_AIOP_IRQ_INDEX, 0xFFFFFFFF);
+	if (!ret)
+		ret = dpaiop_set_irq_enable(p->mc_io, 0, p->token,
+					    AIOPT_AIOP_IRQ_INDEX, 1);
+	portal_release(obj, p);
+	if (ret) {
+		AIOPT_DEBUG("Unable to enable dpaiop IRQ. (MC API err=%d)\n",
+				ret);
+		teardown_aiop_irq(obj);
+		return AIOPT_FAILURE;
 	}
-	closedir(d);
 
-	AIOPT_DEV("In Container, MCP=%s, AIOP=%s\n",
-			mcp_avail ? "TRUE": "FALSE",
-			aiop_avail ? "TRUE": "FALSE");
-	if (!mcp_avail) {
-		AIOPT_DEBUG("MCP Object not Found in container.\n");
+	AIOPT_LIB_INFO("dpaiop IRQ routed to eventfd (%d).\n", fd);
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+aiopt_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * @brief
+ * Acknowledge the dpaiop IRQ: drain the eventfd and clear the pending events
+ * in MC, so that the next event signals the eventfd again.
+ *
+ * @param [in] obj aiopt_obj_t type object with IRQ set up
+ * @return void
+ */
+static void
+ack_aiop_irq(aiopt_obj_t *obj)
+{
+	int ret;
+	uint64_t count;
+	uint32_t status = 0;
+	aiopt_portal_t *p;
+
+	if (read(obj->irq_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		AIOPT_DEBUG("Unable to read IRQ eventfd. (err=%d)\n", errno);
+
+	p = portal_lease(obj);
+	ret = dpaiop_get_irq_status(p->mc_io, 0, p->token,
+				    AIOPT_AIOP_IRQ_INDEX, &status);
+	if (!ret && status)
+		ret = dpaiop_clear_irq_status(p->mc_io, 0, p->token,
+					      AIOPT_AIOP_IRQ_INDEX, status);
+	portal_release(obj, p);
+	if (ret)
+		AIOPT_DEBUG("Unable to clear dpaiop IRQ. (MC API err=%d)\n",
+				ret);
+
+	pthread_mutex_lock(&obj->irq_lock);
+	obj->irq_seq++;
+	pthread_cond_broadcast(&obj->irq_cond);
+	pthread_mutex_unlock(&obj->irq_lock);
+}
+
+/*
+ * @brief
+ * Number of dpaiop IRQ events acknowledged so far, for wait_aiop_irq
+ *
+ * @param [in] obj aiopt_obj_t type object with IRQ set up
+ * @return Events acknowledged
+ */
+static uint64_t
+aiop_irq_seq(aiopt_obj_t *obj)
+{
+	uint64_t seq;
+
+	pthread_mutex_lock(&obj->irq_lock);
+	seq = obj->irq_seq;
+	pthread_mutex_unlock(&obj->irq_lock);
+
+	return seq;
+}
+
+/*
+ * @brief
+ * Wait for a dpaiop IRQ event after the first seen ones, for at most
+ * wait_ms. Threads of a handle may wait at the same time: one polls the
+ * eventfd and acknowledges the event, the others wait for it to be counted,
+ * so that none misses an event consumed by another.
+ *
+ * @param [in] obj aiopt_obj_t type object with IRQ set up
+ * @param [in] seen Events acknowledged (aiop_irq_seq) before the tile State
+ * was last read
+ * @param [in] wait_ms Time limit in milliseconds
+ * @return void
+ */
+static void
+wait_aiop_irq(aiopt_obj_t *obj, uint64_t seen, int wait_ms)
+{
+	int ret;
+	uint64_t deadline, now;
+	struct timespec ts;
+	struct pollfd pfd;
+
+	deadline = aiopt_now_ns() + (uint64_t)wait_ms * 1000000;
+	ts.tv_sec = deadline / 1000000000;
+	ts.tv_nsec = deadline % 1000000000;
+
+	pthread_mutex_lock(&obj->irq_lock);
+	while (obj->irq_seq == seen) {
+		if (obj->irq_polling) {
+			if (pthread_cond_timedwait(&obj->irq_cond,
+						   &obj->irq_lock, &ts) ==
+			    ETIMEDOUT)
+				break;
+			continue;
+		}
+
+		now = aiopt_now_ns();
+		if (now >= deadline)
+			break;
+		obj->irq_polling = TRUE;
+		pthread_mutex_unlock(&obj->irq_lock);
+
+		pfd.fd = obj->irq_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		ret = poll(&pfd, 1, (deadline - now + 999999) / 1000000);
+		if (ret < 0 && errno != EINTR)
+			AIOPT_DEBUG("Unable to wait on IRQ eventfd. (err=%d)\n",
+					errno);
+		if (ret > 0)
+			ack_aiop_irq(obj);
+
+		pthread_mutex_lock(&obj->irq_lock);
+		obj->irq_polling = FALSE;
+		/* Another waiter may take over polling */
+		pthread_cond_broadcast(&obj->irq_cond);
+		if (ret < 0 && errno != EINTR)
+			break;
+	}
+	pthread_mutex_unlock(&obj->irq_lock);
+}
+
+/*
+ * @brief
+ * Read the State of the AIOP Tile
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [out] state State as returned by dpaiop_get_state
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+read_tile_state(aiopt_obj_t *obj, unsigned int *state)
+{
+	int ret;
+	short int retried = FALSE;
+	aiopt_portal_t *p;
+
+	p = portal_lease(obj);
+	do {
+		ret = dpaiop_get_state(p->mc_io, 0, p->token, state);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	portal_release(obj, p);
+	if (ret) {
+		AIOPT_DEBUG("Unable to fetch AIOP Tile state. (err=%d).\n",
+				ret);
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Release the buffers of a load which timed out (see aiopt_load)
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @return void
+ */
+static void
+release_held_bufs(aiopt_obj_t *obj)
+{
+	int i;
+	aiopt_dma_buf_t *buf;
+
+	for (i = 0; i < AIOPT_LOAD_MAX_BUFS; i++) {
+		buf = &obj->held_bufs[i];
+		if (!buf->addr)
+			continue;
+		AIOPT_DEBUG("Releasing buffer (%p, %lu bytes) of an earlier "
+				"load.\n", buf->addr, buf->len);
+		aiopt_dma_unmap(obj, buf->iova, buf->len);
+		munmap(buf->addr, buf->len);
+		buf->addr = NULL;
+		buf->iova = 0;
+		buf->len = 0;
+	}
+}
+
+/*
+ * @brief
+ * Cleanup of the aiopt_obj_t instance by releasing all allocated space to
+ * members.
+ *
+ * @param [in] obj aiopt_obj_t type object for cleanup
+ *
+ * @return void
+ */
+static void
+cleanup_aiopt_obj(aiopt_obj_t *obj) {
+	int i = 0;
+	dpobj_type_t *dp = NULL;
+	aiopt_portal_t *p;
+
+	/* MC has to be done with a submitted command before its portal goes */
+	if (obj->async) {
+		mc_wait_command(obj->async->p->mc_io, &obj->async->cmd);
+		portal_release(obj, obj->async->p);
+		free(obj->async);
+		obj->async = NULL;
+	}
+
+	release_dma_arena(obj);
+	release_held_bufs(obj);
+
+	teardown_aiop_irq(obj);
+	obj->num_portals = 0;
+	for (i = 0; i < AIOPT_MAX_PORTALS; i++) {
+		p = &obj->portals[i];
+		if (p->mc_io) {
+			close_aiop_session(p);
+			mc_io_lock_destroy(p->mc_io);
+			free(p->mc_io);
+			p->mc_io = NULL;
+		}
+		if (p->map_len) {
+			munmap(p->addr, p->map_len);
+			p->map_len = 0;
+		}
+		p->addr = NULL;
+		if (p->name) {
+			free(p->name);
+			p->name = NULL;
+		}
+	}
+	obj->mcp_addr = NULL;
+
+	for (i = 0; i < MAX_DPOBJ_DEVICES; i++) {
+		dp = &obj->devices[i];
+		if (dp->fd > 0) {
+			close(dp->fd);
+			dp->fd = -1;
+		}
+		if (dp->name) {
+			free(dp->name);
+			dp->name = NULL;
+		}
+	}
+
+	for (i = 0; i < obj->num_objs; i++)
+		free(obj->objs[i].name);
+	free(obj->objs);
+	obj->objs = NULL;
+	obj->num_objs = 0;
+}
+
+/*
+ * @brief
+ * Release the object itself once cleanup_aiopt_obj is done with its members:
+ * the VFIO group and container (and with the last handle on them, the DMA
+ * window and MSI mapping) or the MC simulator, the portal pool primitives and
+ * the memory of obj.
+ *
+ * @param [in] obj aiopt_obj_t type object, not used after the call
+ *
+ * @return void
+ */
+static void
+free_aiopt_obj(aiopt_obj_t *obj)
+{
+	if (FSL_VFIO_INVALID_HANDLE != obj->vfio_handle) {
+		fsl_vfio_destroy(obj->vfio_handle);
+		obj->vfio_handle = FSL_VFIO_INVALID_HANDLE;
+	}
+	if (obj->sim) {
+		aiopt_mcsim_stop(obj->sim);
+		obj->sim = NULL;
+	}
+	pthread_cond_destroy(&obj->pool_cond);
+	pthread_mutex_destroy(&obj->pool_lock);
+	pthread_cond_destroy(&obj->irq_cond);
+	pthread_mutex_destroy(&obj->irq_lock);
+	free(obj);
+}
+
+/*
+ * @brief
+ * Allocating and initializing MC portals through VFIO APIs. The first
+ * portal is required; others which cannot be mapped are left out. With the
+ * MC simulator, the portals are those it serves.
+ *
+ * @param [in] obj aiopt_obj_t type handle for AIOPT
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+#ifdef AIOPT_MC_SIM
+static int
+setup_mc_portal(aiopt_obj_t *obj)
+{
+	int i;
+	unsigned int id;
+
+	for (i = 0; i < AIOPT_MAX_PORTALS && obj->portals[i].name; i++) {
+		if (sscanf(obj->portals[i].name, "dpmcp.%u", &id) == 1)
+			obj->portals[i].addr = aiopt_mcsim_portal(obj->sim,
+								  id);
+		if (!obj->portals[i].addr) {
+			AIOPT_DEV("%s not simulated.\n",
+					obj->portals[i].name);
+			if (!i)
+				return AIOPT_FAILURE;
+		}
+	}
+	obj->mcp_addr = obj->portals[0].addr;
+
+	return AIOPT_SUCCESS;
+}
+#else
+static int
+setup_mc_portal(aiopt_obj_t *obj)
+{
+	int i;
+	int64_t addr;
+	fsl_vfio_t vfio_handle;
+
+	if (!obj) {
+		AIOPT_DEV("Incorrect API Usage.\n");
+		return AIOPT_FAILURE;
+	}
+
+	vfio_handle = obj->vfio_handle;
+	/* Allocate memory for MC Portal list */
+	for (i = 0; i < AIOPT_MAX_PORTALS && obj->portals[i].name; i++) {
+		addr = fsl_vfio_map_mcp_obj(vfio_handle,
+					    obj->portals[i].name,
+					    &obj->portals[i].map_len);
+		if (addr == (int64_t) MAP_FAILED) {
+			AIOPT_DEV("Unable to map MCP address of %s. (%d)\n",
+					obj->portals[i].name, errno);
+			if (!i)
+				return AIOPT_FAILURE;
+			continue;
+		}
+		obj->portals[i].addr = (void *)addr;
+	}
+	obj->mcp_addr = obj->portals[0].addr;
+
+	return AIOPT_SUCCESS;
+}
+#endif
+
+/*
+ * @brief
+ * Type and ID of an object, from its name (<type>.<id>)
+ *
+ * @param [in] name Object name, e.g. dpaiop.0
+ * @param [out] type MCP_TYPE or AIOP_TYPE
+ * @param [out] id ID of the object
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not a dpmcp or dpaiop name
+ */
+static int
+dpobj_parse(const char *name, dpobj_type_list_t *type, unsigned int *id)
+{
+	char c;
+
+	if (!strncmp(name, "dpmcp.", 6)) {
+		*type = MCP_TYPE;
+		name += 6;
+	} else if (!strncmp(name, "dpaiop.", 7)) {
+		*type = AIOP_TYPE;
+		name += 7;
+	} else {
+		return AIOPT_FAILURE;
+	}
+
+	/* Nothing may follow the ID */
+	if (sscanf(name, "%u%c", id, &c) != 1)
+		return AIOPT_FAILURE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Order of objects in a topology record: dpaiop objects first, each type by
+ * ID. For qsort.
+ */
+static int
+dpobj_name_cmp(const void *a, const void *b)
+{
+	dpobj_type_list_t ta, tb;
+	unsigned int ia, ib;
+
+	/* Names are only recorded once parsed */
+	dpobj_parse(a, &ta, &ia);
+	dpobj_parse(b, &tb, &ib);
+	if (ta != tb)
+		return ta == AIOP_TYPE ? -1 : 1;
+
+	return ia < ib ? -1 : ia > ib;
+}
+
+/*
+ * @brief
+ * Set up the table of all objects of the container from its topology record
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] topo Record of the container
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+fill_obj_table(aiopt_obj_t *obj, const aiopt_topo_t *topo)
+{
+	unsigned int i, id;
+	dpobj_type_t *dp;
+
+	obj->objs = calloc(topo->nobjs, sizeof(*obj->objs));
+	if (!obj->objs) {
+		AIOPT_DEBUG("Unable to allocate internal memory.\n");
+		return AIOPT_FAILURE;
+	}
+
+	for (i = 0; i < topo->nobjs; i++) {
+		dp = &obj->objs[i];
+		dp->fd = -1;
+		dp->name = strdup(topo->objs[i]);
+		if (!dp->name) {
+			AIOPT_DEBUG("Unable to allocate internal memory.\n");
+			return AIOPT_FAILURE;
+		}
+		dpobj_parse(dp->name, &dp->type, &id);
+		dp->id = id;
+		obj->num_objs++;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Find an object of the container in the table set up by fill_obj_table
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] type MCP_TYPE or AIOP_TYPE
+ * @param [in] id ID, or AIOPT_AIOP_ID_ANY for the first of type
+ *
+ * @return Object found, or NULL
+ */
+static dpobj_type_t *
+find_obj(aiopt_obj_t *obj, dpobj_type_list_t type, int id)
+{
+	unsigned int i;
+
+	for (i = 0; i < obj->num_objs; i++) {
+		if (obj->objs[i].type == type &&
+		    (id == AIOPT_AIOP_ID_ANY || obj->objs[i].id == id))
+			return &obj->objs[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief
+ * Open the VFIO device of a dpaiop and obtain its information. With the MC
+ * simulator there is no device; the dpaiop only has to be simulated.
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in, out] device Device, with name and id set
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+#ifdef AIOPT_MC_SIM
+static int
+open_aiop_device(aiopt_obj_t *obj, dpobj_type_t *device)
+{
+	aiopt_mcsim_conf_t conf;
+
+	device->fd = -1;
+	aiopt_mcsim_get_conf(obj->sim, &conf);
+	if (device->id < 0 || (unsigned int)device->id >= conf.num_aiops) {
+		AIOPT_DEBUG("%s not simulated.\n", device->name);
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+#else
+static int
+open_aiop_device(aiopt_obj_t *obj, dpobj_type_t *device)
+{
+	int ret;
+
+	memset(&(device->di), 0, sizeof(struct vfio_device_info));
+	device->di.argsz = sizeof(struct vfio_device_info);
+
+	/* getting the device fd*/
+	device->fd = fsl_vfio_get_dev_fd(obj->vfio_handle, device->name);
+	if (device->fd < 0) {
+		AIOPT_DEBUG("Unable to obtain device FD from VFIO (%s)"
+			"; fd from group (%d)\n",
+			device->name,
+			fsl_vfio_get_group_fd(obj->vfio_handle));
+		return AIOPT_FAILURE;
+	}
+
+	/* Get Device inofrmation */
+	ret = fsl_vfio_get_device_info(obj->vfio_handle, device->name,
+					&(device->di));
+	if (ret != 0) {
+		AIOPT_DEBUG("Unable to fetch device info "
+				"(VFIO_DEVICE_FSL_MC_GET_INFO).\n");
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+#endif
+
+/*
+ * @brief
+ * Generic method for filling information into aiopt_obj_t type object from the
+ * VFIO directory entry.
+ *
+ * @param [in] obj_p Object Name string embedded in object
+ * @param [in] obj_id Object ID embedded in object
+ * @param [in] dir_name constant string describing directory name
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+fill_obj_info(aiopt_obj_t *obj, dpobj_type_list_t type, const char *dir_name)
+{
+	dpobj_type_list_t name_type;
+	unsigned int id;
+	dpobj_type_t *device = NULL;
+
+	if (!obj || !dir_name || (type >= MAX_DPOBJ_DEVICES)) {
+		AIOPT_DEV("Internal error; Incorrect API usage.\n");
+		return AIOPT_FAILURE;
+	}
+
+	if (dpobj_parse(dir_name, &name_type, &id) != AIOPT_SUCCESS ||
+	    name_type != type) {
+		AIOPT_DEBUG("Unexpected object name (%s).\n", dir_name);
+		return AIOPT_FAILURE;
+	}
+
+	device = &(obj->devices[type]);
+	device->name = strdup(dir_name);
+	if (!device->name) {
+		AIOPT_DEBUG("Unable to allocate internal memory.\n");
+		return AIOPT_FAILURE;
+	}
+	device->type = type;
+	device->id = id;
+
+	/* For AIOP, open and obtain device information. This is
+	 * not required for dpmcp object.
+	 */
+	if (type == AIOP_TYPE &&
+	    open_aiop_device(obj, device) != AIOPT_SUCCESS)
+		goto err_cleanup;
+
+	return AIOPT_SUCCESS;
+
+err_cleanup:
+	free(device->name);
+	device->name = NULL;
+
+	return AIOPT_FAILURE;
+}
+
+/*
+ * @brief
+ * Wrapper around internal fill_obj_info method for MCP information. It is
+ * expected that the caller has set dir_name parameter to the correct dpmcp
+ * object in the sysfs directory structure.
+ *
+ * @param [in] obj aiopt_obj_t type object to fill information into
+ * @param [in] dir_name constant string describing directory name
+ *
+ * @return value as returned by fill_obj_info
+ */
+static inline int
+fill_mcp_obj_info(aiopt_obj_t *obj, const char *dir_name)
+{
+	int ret;
+
+	ret = fill_obj_info(obj, MCP_TYPE, dir_name);
+	AIOPT_DEV("fill_obj_info returns (%d).\n", ret);
+
+	return ret;
+}
+
+/*
+ * @brief
+ * Calls internal fill_obj_info method for filling AIOP information. It is
+ * expected that the caller has set dir_name parameter to the correct dpaiop
+ * object in the sysfs directory structure.
+ * Unlike fill_mcp_obj_info, this method also fills in device_info structure
+ * and device_fd information.
+ *
+ * @param [in] obj aiopt_obj_t type object to fill information into
+ * @param [in] dir_name constant string describing directory name
+ *
+ * @return value as returned by fill_obj_info
+ */
+static inline int
+fill_aiop_obj_info(aiopt_obj_t *obj, const char *dir_name)
+{
+	int ret;
+
+	ret = fill_obj_info(obj, AIOP_TYPE, dir_name);
+	AIOPT_DEV("fill_obj_info returns (%d).\n", ret);
+
+	return ret;
+}
+
+/*
+ * @brief
+ * Set up the MC portal I/O object of a mapped portal and open the dpaiop
+ * session on it
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] p Portal, with addr mapped
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+setup_portal_session(aiopt_obj_t *obj, aiopt_portal_t *p)
+{
+	int ret;
+
+	/* MC Portal I/O object, kept for the lifetime of the handle */
+	p->mc_io = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
+	if (!p->mc_io) {
+		AIOPT_DEBUG("Unable to allocate memory for dpaiop obj.\n");
+		return AIOPT_FAILURE;
+	}
+	p->mc_io->regs = p->addr;
+
+	/* Leases keep threads to different portals; the lock guards a
+	 * portal shared all the same, see aiopt_set_portal_lock
+	 */
+	ret = mc_io_lock_init(p->mc_io, AIOPT_PORTAL_LOCK_DEF);
+	if (ret) {
+		AIOPT_DEBUG("Unable to set up portal lock. (err=%d)\n", ret);
+		goto err;
+	}
+
+	ret = open_aiop_session(obj, p);
+	if (ret != AIOPT_SUCCESS) {
+		mc_io_lock_destroy(p->mc_io);
+		goto err;
+	}
+
+	return AIOPT_SUCCESS;
+
+err:
+	free(p->mc_io);
+	p->mc_io = NULL;
+	return AIOPT_FAILURE;
+}
+
+/*
+ * @brief
+ * Initialize the AIOP Device by calling the MC operations for dpaiop_open.
+ * Takes as input a completely filled aiopt_obj_t type object, including info
+ * for FD, HW ID and MC Portal Addresses.
+ * The dpaiop sessions opened here, one per portal, are held in the object
+ * for the lifetime of the handle and closed in aiopt_deinit.
+ *
+ * @param [IN] obj aiopt_obj_t type object containing MCP/AIOP Device info
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+init_aiop(aiopt_obj_t *obj)
+{
+	int ret;
+	unsigned int i;
+	short int retried = FALSE;
+	struct dpaiop_sl_version sl_version = {0};
+	aiopt_portal_t *p;
+	uint64_t start;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!obj) {
+		AIOPT_DEBUG("Incorrect API usage.\n");
+		ret = AIOPT_FAILURE;
+		goto err;
+	}
+
+	/* Opening AIOP device on each portal mapped; those on which it
+	 * cannot be opened are left out of the pool
+	 */
+	start = aiopt_now_ns();
+	for (i = 0; i < AIOPT_MAX_PORTALS; i++) {
+		p = &obj->portals[i];
+		if (p->addr && setup_portal_session(obj, p) == AIOPT_SUCCESS) {
+			/* Portals in use are kept first */
+			if (i != obj->num_portals) {
+				obj->portals[obj->num_portals] = *p;
+				memset(p, 0, sizeof(*p));
+			}
+			obj->num_portals++;
+			continue;
+		}
+		free(p->name);
+		memset(p, 0, sizeof(*p));
+	}
+	if (!obj->num_portals) {
+		AIOPT_DEBUG("Unable to open AIOP device on any MC portal.\n");
+		ret = AIOPT_FAILURE;
+		goto err;
+	}
+	obj->mcp_addr = obj->portals[0].addr;
+	AIOPT_DEBUG("%u MC portal(s) in use.\n", obj->num_portals);
+
+	/* Get the device version */
+	p = portal_lease(obj);
+	do {
+		ret = dpaiop_get_sl_version(p->mc_io, CMD_PRI_LOW, p->token,
+					    &sl_version);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	portal_release(obj, p);
+	if (ret != 0) {
+		AIOPT_DEV("Unable to get AIOP Version information: %d.\n",
+			ret);
+		/* This is not considered an error */
+		AIOPT_DEV("Attributes: id=%d, v.major=-NA-, v.minor=-NA-.\n",
+			aiopt_get_aiop_id(obj));
+	} else {
+		AIOPT_DEV("Attributes: id=%d, v.major=%d, v.minor=%d.\n",
+			aiopt_get_aiop_id(obj), sl_version.major,
+			sl_version.minor);
+	}
+
+	obj->init_report.sessions_ns = aiopt_now_ns() - start;
+
+	/* Not an error either: aiopt_wait_state polls without the IRQ */
+	start = aiopt_now_ns();
+	if (setup_aiop_irq(obj) != AIOPT_SUCCESS)
+		AIOPT_DEBUG("dpaiop IRQ not available; tile state would be "
+				"polled.\n");
+	obj->init_report.irq_ns = aiopt_now_ns() - start;
+
+	AIOPT_LIB_INFO("Successfully initialized the AIOP device.\n");
+	ret = AIOPT_SUCCESS;
+
+err:
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Directory of the image and topology records: AIOPT_CACHE_DIR_ENV if set,
+ * else AIOPT_IMAGE_CACHE_DIR
+ *
+ * @return const string
+ */
+static const char *
+cache_dir(void)
+{
+	const char *env = getenv(AIOPT_CACHE_DIR_ENV);
+
+	return (env && env[0]) ? env : AIOPT_IMAGE_CACHE_DIR;
+}
+
+/* Topology records kept in memory, see topo_cache_lookup */
+static aiopt_topo_t topo_cache[AIOPT_TOPO_CACHE_SZ];
+static unsigned int topo_cache_next;
+static pthread_mutex_t topo_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * @brief
+ * Check if topology records are also kept on disk, see AIOPT_TOPO_CACHE_ENV
+ *
+ * @return TRUE or FALSE
+ */
+static short int
+topo_cache_on_disk(void)
+{
+	const char *env = getenv(AIOPT_TOPO_CACHE_ENV);
+
+	return (env && !strcmp(env, "1")) ? TRUE : FALSE;
+}
+
+/*
+ * @brief
+ * Path of the on-disk topology record of a container
+ *
+ * @param [in] container Name of the container
+ * @param [out] path Buffer of PATH_MAX bytes
+ *
+ * @return void
+ */
+static void
+topo_cache_path(const char *container, char *path)
+{
+	snprintf(path, PATH_MAX, "%s/topo.%s", cache_dir(), container);
+}
+
+/*
+ * @brief
+ * Read the on-disk topology record of a container
+ *
+ * @param [in] container Name of the container
+ * @param [out] topo Record read
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if there is no readable record
+ */
+static int
+topo_cache_read(const char *container, aiopt_topo_t *topo)
+{
+	FILE *fp;
+	char path[PATH_MAX];
+	long sec, nsec;
+	int ret;
+	dpobj_type_list_t type;
+	unsigned int id;
+	short int has[MAX_DPOBJ_DEVICES] = {FALSE};
+
+	topo_cache_path(container, path);
+	fp = fopen(path, "r");
+	if (!fp)
+		return AIOPT_FAILURE;
+
+	memset(topo, 0, sizeof(*topo));
+	strcpy(topo->container, container);
+	ret = fscanf(fp, "group=%d ino=%lu mtime=%ld.%ld", &topo->groupid,
+		     &topo->ino, &sec, &nsec);
+	/* Names are read up to AIOPT_OBJ_NAME_MAX - 1 characters */
+	while (ret == 4 && topo->nobjs < AIOPT_TOPO_MAX_OBJS &&
+	       fscanf(fp, " obj=%31s", topo->objs[topo->nobjs]) == 1) {
+		if (dpobj_parse(topo->objs[topo->nobjs], &type, &id) !=
+		    AIOPT_SUCCESS) {
+			ret = AIOPT_FAILURE;
+			break;
+		}
+		has[type] = TRUE;
+		topo->nobjs++;
+	}
+	fclose(fp);
+
+	if (ret != 4 || !has[MCP_TYPE] || !has[AIOP_TYPE]) {
+		AIOPT_DEBUG("Ignoring malformed topology record (%s).\n",
+				path);
+		return AIOPT_FAILURE;
+	}
+	topo->mtime.tv_sec = sec;
+	topo->mtime.tv_nsec = nsec;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Write the on-disk topology record of a container. As with image records,
+ * it is written to a temporary file and renamed. Failing to write it is not
+ * an error.
+ *
+ * @param [in] topo Record to write
+ *
+ * @return void
+ */
+static void
+topo_cache_write(const aiopt_topo_t *topo)
+{
+	FILE *fp;
+	char path[PATH_MAX], tmp[PATH_MAX + 4];
+	unsigned int i;
+	int ret;
+
+	if (mkdir(cache_dir(), 0755) != 0 && errno != EEXIST) {
+		AIOPT_DEBUG("Unable to create (%s). (err=%d)\n",
+				cache_dir(), errno);
+		return;
+	}
+
+	topo_cache_path(topo->container, path);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		AIOPT_DEBUG("Unable to write topology record (%s). (err=%d)\n",
+				tmp, errno);
+		return;
+	}
+	fprintf(fp, "group=%d ino=%lu mtime=%ld.%09ld\n", topo->groupid,
+		topo->ino, (long)topo->mtime.tv_sec, topo->mtime.tv_nsec);
+	for (i = 0; i < topo->nobjs; i++)
+		fprintf(fp, "obj=%s\n", topo->objs[i]);
+	ret = fclose(fp);
+	if (ret != 0 || rename(tmp, path) != 0) {
+		AIOPT_DEBUG("Unable to write topology record (%s). (err=%d)\n",
+				path, errno);
+		unlink(tmp);
+		return;
+	}
+	AIOPT_DEV("Topology record (%s) written.\n", path);
+}
+
+/*
+ * @brief
+ * Keep the topology record of a container in memory, replacing any earlier
+ * one of it, or else the oldest
+ *
+ * @param [in] topo Record to keep
+ *
+ * @return void
+ */
+static void
+topo_cache_put(const aiopt_topo_t *topo)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&topo_cache_lock);
+	for (i = 0; i < AIOPT_TOPO_CACHE_SZ; i++) {
+		if (!strcmp(topo_cache[i].container, topo->container))
+			break;
+	}
+	if (i == AIOPT_TOPO_CACHE_SZ) {
+		i = topo_cache_next;
+		topo_cache_next = (topo_cache_next + 1) % AIOPT_TOPO_CACHE_SZ;
+	}
+	topo_cache[i] = *topo;
+	pthread_mutex_unlock(&topo_cache_lock);
+}
+
+/*
+ * @brief
+ * Drop the topology records of a container, in memory and on disk
+ *
+ * @param [in] container Name of the container
+ *
+ * @return void
+ */
+static void
+topo_cache_forget(const char *container)
+{
+	unsigned int i;
+	char path[PATH_MAX];
+
+	pthread_mutex_lock(&topo_cache_lock);
+	for (i = 0; i < AIOPT_TOPO_CACHE_SZ; i++) {
+		if (!strcmp(topo_cache[i].container, container))
+			topo_cache[i].container[0] = '\0';
+	}
+	pthread_mutex_unlock(&topo_cache_lock);
+
+	if (!topo_cache_on_disk())
+		return;
+	topo_cache_path(container, path);
+	if (unlink(path) != 0 && errno != ENOENT)
+		AIOPT_DEBUG("Unable to remove topology record (%s). (err=%d)\n",
+				path, errno);
+}
+
+/*
+ * @brief
+ * Stat the devices directory of an IOMMU group, whose inode and modification
+ * time tell whether a topology record still holds
+ *
+ * @param [in] groupid IOMMU group
+ * @param [out] ino Inode of the directory
+ * @param [out] mtime Modification time of the directory
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+#ifdef AIOPT_MC_SIM
+static int
+topo_stat_group(int groupid, unsigned long *ino, struct timespec *mtime)
+{
+	/* The simulated container has no group and never changes; its
+	 * records only turn out wrong through their objects
+	 */
+	*ino = 0;
+	mtime->tv_sec = 0;
+	mtime->tv_nsec = 0;
+
+	return AIOPT_SUCCESS;
+}
+#else
+static int
+topo_stat_group(int groupid, unsigned long *ino, struct timespec *mtime)
+{
+	char path[VFIO_PATH_MAX];
+	struct stat st;
+
+	snprintf(path, sizeof(path), SYSFS_IOMMU_PATH_VSTR, groupid);
+	if (stat(path, &st) != 0)
+		return AIOPT_FAILURE;
+	*ino = st.st_ino;
+	*mtime = st.st_mtim;
+
+	return AIOPT_SUCCESS;
+}
+#endif
+
+/*
+ * @brief
+ * Find a valid topology record of a container, from an earlier aiopt_init of
+ * the process or else, if kept on disk, of an earlier run. A record is valid
+ * while the devices directory of its IOMMU group has the same inode and
+ * modification time; an invalid one is dropped.
+ *
+ * @param [in] container Name of the container
+ * @param [out] topo Record found
+ *
+ * @return enum aiopt_topo_src; AIOPT_TOPO_SCANNED if no valid record
+ */
+static int
+topo_cache_lookup(const char *container, aiopt_topo_t *topo)
+{
+	unsigned int i;
+	int src = AIOPT_TOPO_SCANNED;
+	unsigned long ino;
+	struct timespec mtime;
+
+	if (strlen(container) >= AIOPT_OBJ_NAME_MAX || strchr(container, '/'))
+		return AIOPT_TOPO_SCANNED;
+
+	pthread_mutex_lock(&topo_cache_lock);
+	for (i = 0; i < AIOPT_TOPO_CACHE_SZ; i++) {
+		if (!strcmp(topo_cache[i].container, container)) {
+			*topo = topo_cache[i];
+			src = AIOPT_TOPO_MEMORY;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&topo_cache_lock);
+
+	if (src == AIOPT_TOPO_SCANNED) {
+		if (!topo_cache_on_disk() ||
+		    topo_cache_read(container, topo) != AIOPT_SUCCESS)
+			return AIOPT_TOPO_SCANNED;
+		src = AIOPT_TOPO_DISK;
+	}
+
+	if (topo_stat_group(topo->groupid, &ino, &mtime) != AIOPT_SUCCESS ||
+	    ino != topo->ino || mtime.tv_sec != topo->mtime.tv_sec ||
+	    mtime.tv_nsec != topo->mtime.tv_nsec) {
+		AIOPT_DEBUG("Topology record of (%s) outdated.\n", container);
+		topo_cache_forget(container);
+		return AIOPT_TOPO_SCANNED;
+	}
+
+	if (src == AIOPT_TOPO_DISK)
+		topo_cache_put(topo);
+	AIOPT_DEV("Topology of (%s) from %s record.\n", container,
+			src == AIOPT_TOPO_DISK ? "on-disk" : "in-memory");
+
+	return src;
+}
+
+/*
+ * @brief
+ * Find the MCP and AIOP objects of the container in the devices directory of
+ * its IOMMU group, and record them, up to AIOPT_TOPO_MAX_OBJS.
+ *
+ * @param [in] obj aiopt_obj_t type object, with the VFIO handle set up
+ * @param [in, out] topo Record, with container set, to fill
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+#ifdef AIOPT_MC_SIM
+static int
+scan_container_topo(aiopt_obj_t *obj, aiopt_topo_t *topo)
+{
+	unsigned int i;
+	aiopt_mcsim_conf_t conf;
+
+	/* Objects as simulated (AIOPT_SIM_AIOPS, AIOPT_SIM_PORTALS), in
+	 * place of the devices directory of an IOMMU group
+	 */
+	aiopt_mcsim_get_conf(obj->sim, &conf);
+	topo->groupid = 0;
+	topo->nobjs = 0;
+	topo_stat_group(topo->groupid, &topo->ino, &topo->mtime);
+	for (i = 0; i < conf.num_aiops && topo->nobjs < AIOPT_TOPO_MAX_OBJS;
+	     i++)
+		snprintf(topo->objs[topo->nobjs++], AIOPT_OBJ_NAME_MAX,
+			 "dpaiop.%u", i);
+	for (i = 0; i < conf.num_portals && topo->nobjs < AIOPT_TOPO_MAX_OBJS;
+	     i++)
+		snprintf(topo->objs[topo->nobjs++], AIOPT_OBJ_NAME_MAX,
+			 "dpmcp.%u", i);
+	qsort(topo->objs, topo->nobjs, sizeof(topo->objs[0]), dpobj_name_cmp);
+
+	if (topo->container[0]) {
+		topo_cache_put(topo);
+		if (topo_cache_on_disk())
+			topo_cache_write(topo);
+	}
+
+	return AIOPT_SUCCESS;
+}
+#else
+static int
+scan_container_topo(aiopt_obj_t *obj, aiopt_topo_t *topo)
+{
+	DIR *d;
+	struct dirent *dir;
+	char path[VFIO_PATH_MAX];
+	int stat_ret;
+	dpobj_type_list_t type;
+	unsigned int id, found[MAX_DPOBJ_DEVICES] = {0};
+
+	topo->groupid = fsl_vfio_get_group_id(obj->vfio_handle);
+	topo->nobjs = 0;
+
+	/* Before reading the directory, so that a change while reading it
+	 * outdates the record
+	 */
+	stat_ret = topo_stat_group(topo->groupid, &topo->ino, &topo->mtime);
+
+	sprintf(path, SYSFS_IOMMU_PATH_VSTR, topo->groupid);
+
+	AIOPT_LIB_INFO("VFIO Devices path = %s\n", path);
+	d = opendir(path);
+	if (!d) {
+		AIOPT_DEBUG("Unable to open VFIO directory: %s\n", path);
+		return AIOPT_FAILURE;
+	}
+
+	while ((dir = readdir(d)) != NULL) {
+		if (!(dir->d_type == DT_LNK) ||
+		    strlen(dir->d_name) >= AIOPT_OBJ_NAME_MAX ||
+		    dpobj_parse(dir->d_name, &type, &id) != AIOPT_SUCCESS)
+			continue;
+		if (topo->nobjs == AIOPT_TOPO_MAX_OBJS) {
+			AIOPT_DEBUG("More than %d objects in container; "
+					"(%s) left out.\n",
+					AIOPT_TOPO_MAX_OBJS, dir->d_name);
+			continue;
+		}
+		strcpy(topo->objs[topo->nobjs++], dir->d_name);
+		found[type]++;
+	}
+	closedir(d);
+
+	AIOPT_DEV("In Container, MCP=%u, AIOP=%u\n", found[MCP_TYPE],
+			found[AIOP_TYPE]);
+	if (!found[MCP_TYPE]) {
+		AIOPT_DEBUG("MCP Object not Found in container.\n");
+		return AIOPT_FAILURE;
+	}
+	if (!found[AIOP_TYPE]) {
+		AIOPT_DEBUG("AIOP Object not Found in container.\n");
+		return AIOPT_FAILURE;
+	}
+
+	/* readdir order is that of creation; IDs are stable across runs */
+	qsort(topo->objs, topo->nobjs, sizeof(topo->objs[0]), dpobj_name_cmp);
+
+	/* Not recorded if the directory could not be stat'ed, or the name of
+	 * the container does not fit
+	 */
+	if (stat_ret == AIOPT_SUCCESS && topo->container[0]) {
+		topo_cache_put(topo);
+		if (topo_cache_on_disk())
+			topo_cache_write(topo);
+	}
+
+	return AIOPT_SUCCESS;
+}
+#endif
+
+/*
+ * @brief
+ * Initialize the MCP and AIOP objects present in the container and tag them
+ * into an internal data structure. The objects are taken from the topology
+ * record found by aiopt_init, if any, else found in sysfs. Should the record
+ * turn out wrong, it is dropped and sysfs scanned.
+ * The dpmcp objects with the lowest IDs, up to AIOPT_MAX_PORTALS, are taken
+ * as portals of the handle.
+ *
+ * @param [in] obj aiopt_obj_t type object to populate
+ * @param [in, out] topo Record of the container; its container must be set
+ * @param [in] aiop_id ID of the dpaiop to use, or AIOPT_AIOP_ID_ANY
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+setup_aiopt_device(aiopt_obj_t *obj, aiopt_topo_t *topo, int aiop_id)
+{
+	int ret;
+	unsigned int i, nmcp;
+	uint64_t start;
+	aiopt_init_report_t *r;
+	dpobj_type_t *aiop;
+
+	if (!obj || !topo) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
+	}
+	r = &obj->init_report;
+
+rescan:
+	/* Portals are taken afresh from the objects found; those of a wrong
+	 * record were released by cleanup_aiopt_obj
+	 */
+	nmcp = 0;
+	start = aiopt_now_ns();
+	if (r->topo_src == AIOPT_TOPO_SCANNED) {
+		ret = scan_container_topo(obj, topo);
+		r->topology_ns += aiopt_now_ns() - start;
+		if (ret != AIOPT_SUCCESS)
+			goto err_cleanup;
+		start = aiopt_now_ns();
+	}
+
+	ret = fill_obj_table(obj, topo);
+	if (ret != AIOPT_SUCCESS)
+		goto err_cleanup;
+
+	aiop = find_obj(obj, AIOP_TYPE, aiop_id);
+	if (!aiop) {
+		AIOPT_DEBUG("dpaiop.%d not Found in container.\n", aiop_id);
+		goto err_stale;
+	}
+
+	/* First portal is also described in devices[MCP_TYPE] */
+	for (i = 0; i < obj->num_objs && nmcp < AIOPT_MAX_PORTALS; i++) {
+		if (obj->objs[i].type != MCP_TYPE)
+			continue;
+		if (!nmcp) {
+			ret = fill_mcp_obj_info(obj, obj->objs[i].name);
+			if (ret != AIOPT_SUCCESS)
+				goto err_stale;
+		}
+		obj->portals[nmcp].name = strdup(obj->objs[i].name);
+		if (!obj->portals[nmcp].name) {
+			AIOPT_DEBUG("Unable to allocate internal memory.\n");
+			goto err_cleanup;
+		}
+		nmcp++;
+	}
+
+	ret = fill_aiop_obj_info(obj, aiop->name);
+	r->devices_ns = aiopt_now_ns() - start;
+	if (ret != AIOPT_SUCCESS)
+		goto err_stale;
+
+	print_aiopt_obj(obj);
+
+	start = aiopt_now_ns();
+	ret = setup_mc_portal(obj);
+	r->portals_ns = aiopt_now_ns() - start;
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_DEBUG("Unable to open MC Portal.\n");
+		goto err_stale;
+	}
+
+	ret = init_aiop(obj);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_DEBUG("Unable to initialize the AIOP device.\n");
 		goto err_cleanup;
 	}
-	if (!aiop_avail) {
-		AIOPT_DEBUG("AIOP Object not Found in container.\n");
-		goto err_cleanup;
+
+	return AIOPT_SUCCESS;
+
+err_stale:
+	if (r->topo_src != AIOPT_TOPO_SCANNED) {
+		/* Objects of the record are gone, though the directory of the
+		 * group looks unchanged
+		 */
+		AIOPT_DEBUG("Topology record of (%s) is wrong; rescanning.\n",
+				topo->container);
+		cleanup_aiopt_obj(obj);
+		topo_cache_forget(topo->container);
+		r->topo_src = AIOPT_TOPO_SCANNED;
+		goto rescan;
+	}
+err_cleanup:
+	cleanup_aiopt_obj(obj);
+	return AIOPT_FAILURE;
+
+}
+
+/*
+ * @brief
+ * For a given AIOP Image file, verify existence, type and return FD after
+ * opening it.
+ *
+ * @param [in] ifile AIOP ELF File name with path
+ * @param [in] max_sz Largest file size accepted
+ * @param [out] file_sz size of ELF file, if valid
+ *
+ * @return Value greater than 0 if file opened successfully or AIOPT_FAILURE
+ */
+static int
+get_aiop_image_fd(const char *ifile, size_t max_sz, size_t *file_sz)
+{
+	int fd = -1;
+	size_t filesize = 0;
+	struct stat im_stat;
+
+	AIOPT_DEV("Entering.\n");
+	memset(&im_stat, 0, sizeof(im_stat));
+	*file_sz = 0;
+
+	/* Checking Validity of the file */
+	if (!ifile || (stat(ifile, &im_stat) != 0)) {
+		AIOPT_DEBUG("Unable to stat the file (%s).\n", ifile);
+		return AIOPT_FAILURE;
+	}
+
+	/* get the file size */
+	filesize = im_stat.st_size;
+	if (filesize <= 0 || filesize > max_sz) {
+		AIOPT_LIB_INFO("Incorrect file size. Give (%lu), Max Allowed "
+				"(%lu).\n", filesize, max_sz);
+		return AIOPT_FAILURE;
+	}
+
+	/* Opening the file */
+	fd = open(ifile, O_RDONLY);
+	if (fd < 0) {
+		AIOPT_DEBUG("Failed to open Image file (%s).\n", ifile);
+		return AIOPT_FAILURE;
+	}
+
+	*file_sz = filesize;
+
+	AIOPT_DEBUG("AIOP Image File opened Successfully (fd=%d).\n", fd);
+	AIOPT_DEV("Exiting.\n");
+
+	return fd;
+}
+
+/*
+ * @brief
+ * For a given AIOP Args file, verify existence, type and return FD after
+ * opening it.
+ *
+ * @param [in]  afile AIOP args file name with path
+ * @param [in]  max_sz Largest file size accepted
+ * @param [out] file_sz size of ELF file, if valid
+ *
+ * @return Value greater than 0 if file opened successfully or AIOPT_FAILURE
+ */
+static int
+get_aiop_args_fd(const char *afile, size_t max_sz, size_t *file_sz)
+{
+	int fd = -1;
+	size_t filesize = 0;
+	struct stat im_stat;
+
+	AIOPT_DEV("Entering.\n");
+	memset(&im_stat, 0, sizeof(im_stat));
+	*file_sz = 0;
+
+	/* Checking Validity of the file */
+	if (!afile || (stat(afile, &im_stat) != 0)) {
+		AIOPT_DEBUG("Unable to stat the file (%s).\n", afile);
+		return AIOPT_FAILURE;
+	}
+
+	/* get the file size */
+	filesize = im_stat.st_size;
+	if (filesize <= 0 || filesize > max_sz) {
+		AIOPT_LIB_INFO("Incorrect file size. Give (%lu), Max Allowed "
+				"(%lu).\n", filesize, max_sz);
+		return AIOPT_FAILURE;
+	}
+
+	/* Opening the file */
+	fd = open(afile, O_RDONLY);
+	if (fd < 0) {
+		AIOPT_DEBUG("Failed to open AIOP arguments file (%s).\n", afile);
+		return AIOPT_FAILURE;
+	}
+
+	*file_sz = filesize;
+
+	AIOPT_DEBUG("AIOP Args File opened Successfully (fd=%d).\n", fd);
+	AIOPT_DEV("Exiting.\n");
+
+	return fd;
+}
+/*
+ * @brief
+ * Time left for the load started at start_ns to complete, to be passed to
+ * aiopt_wait_state. Once expired, 1ms is returned so that the tile state is
+ * still read once.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] start_ns Time at which aiopt_load was called
+ *
+ * @return Milliseconds, or AIOPT_WAIT_FOREVER
+ */
+static unsigned int
+load_time_left(aiopt_obj_t *obj, uint64_t start_ns)
+{
+	uint64_t spent_ms;
+
+	if (obj->load_timeout_ms == AIOPT_WAIT_FOREVER)
+		return AIOPT_WAIT_FOREVER;
+
+	spent_ms = (aiopt_now_ns() - start_ns) / 1000000;
+	if (spent_ms >= obj->load_timeout_ms)
+		return 1;
+
+	return obj->load_timeout_ms - spent_ms;
+}
+
+/*
+ * @brief
+ * Fold a buffer into a 64-bit FNV-1a style hash, eight bytes per step; a
+ * byte-wise FNV-1a costs too much on images of several MB. The shift brings
+ * high bits of the product back down so that every byte reaches the result.
+ *
+ * @param [in] h Hash so far, AIOPT_FNV64_OFFSET to start with
+ * @param [in] buf Data to hash
+ * @param [in] len Length of buf
+ *
+ * @return Updated hash
+ */
+static uint64_t
+image_hash(uint64_t h, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint64_t w;
+	size_t i;
+
+	for (i = 0; i + sizeof(w) <= len; i += sizeof(w)) {
+		memcpy(&w, p + i, sizeof(w));
+		h = (h ^ w) * AIOPT_FNV64_PRIME;
+		h ^= h >> 32;
+	}
+	for (; i < len; i++)
+		h = (h ^ p[i]) * AIOPT_FNV64_PRIME;
+
+	return h;
+}
+
+/*
+ * @brief
+ * Extend the digests over a buffer, AIOPT_DIGEST_CHUNK_SZ at a time
+ *
+ * @param [in,out] dg Digests so far
+ * @param [in] buf Data
+ * @param [in] len Length of data
+ *
+ * @return void
+ */
+static void
+digest_buf(struct load_digest *dg, const void *buf, size_t len)
+{
+	const char *p = buf;
+	size_t step;
+
+	while (len) {
+		step = len < AIOPT_DIGEST_CHUNK_SZ ? len : AIOPT_DIGEST_CHUNK_SZ;
+		dg->crc = aiopt_crc32c(dg->crc, p, step);
+		dg->hash = image_hash(dg->hash, p, step);
+		p += step;
+		len -= step;
+	}
+}
+
+/*
+ * @brief
+ * Extend the digests over the whole AIOPT_DIGEST_CHUNK_SZ chunks of a buffer
+ * filled so far, while they are still in cache. Whole chunks only, so that
+ * the hash does not depend on how the buffer was filled.
+ *
+ * @param [in] ctx struct digest_stream
+ * @param [in] done Bytes of the buffer filled so far
+ *
+ * @return void
+ */
+static void
+digest_progress(void *ctx, size_t done)
+{
+	struct digest_stream *ds = ctx;
+	size_t step = done - ds->digested;
+
+	step -= step % AIOPT_DIGEST_CHUNK_SZ;
+	digest_buf(ds->dg, ds->buf + ds->digested, step);
+	ds->digested += step;
+}
+
+/*
+ * @brief
+ * Extend the digests over the rest of a buffer, once filled
+ *
+ * @param [in] ds Digest stream
+ * @param [in] len Bytes of the buffer filled
+ *
+ * @return void
+ */
+static void
+digest_finish(struct digest_stream *ds, size_t len)
+{
+	digest_buf(ds->dg, ds->buf + ds->digested, len - ds->digested);
+	ds->digested = len;
+}
+
+/*
+ * @brief
+ * Read a file, from its start, into a buffer. The digests are extended over
+ * each AIOPT_DIGEST_CHUNK_SZ of data as soon as it has been read, rather than
+ * in another pass over the whole buffer.
+ *
+ * @param [in] fd File descriptor
+ * @param [in] buf Buffer to read into
+ * @param [in] len Bytes to read
+ * @param [in,out] dg Digests to extend over the file
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if file could not be read fully
+ */
+static int
+read_file_to_buf(int fd, void *buf, size_t len, struct load_digest *dg)
+{
+	struct digest_stream ds = {dg, buf, 0};
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len) {
+		n = pread(fd, (char *)buf + done, len - done, done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			AIOPT_DEBUG("Unable to read file. (read=%lu of %lu, "
+					"err=%d)\n", done, len, errno);
+			return AIOPT_FAILURE;
+		}
+		done += n;
+		digest_progress(&ds, done);
+	}
+	digest_finish(&ds, len);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Dump the loadable segments of an AIOP Image
+ *
+ * @param [in] elf Image summary from aiopt_elf_check
+ * @return void
+ */
+static void
+print_elf_info(const aiopt_elf_info_t *elf)
+{
+	unsigned int i;
+	const aiopt_elf_seg_t *seg;
+
+	AIOPT_LIB_INFO("AIOP Image: entry 0x%08x, %u segments, %lu bytes in "
+			"file, %lu bytes in memory.\n", elf->entry, elf->nsegs,
+			elf->filesz, elf->memsz);
+	for (i = 0; i < elf->nsegs; i++) {
+		seg = &elf->segs[i];
+		AIOPT_DEV("Segment %u: vaddr=0x%08x, offset=0x%x, filesz=%u, "
+				"memsz=%u, flags=%c%c%c\n", i, seg->vaddr,
+				seg->offset, seg->filesz, seg->memsz,
+				seg->flags & PF_R ? 'r' : '-',
+				seg->flags & PF_W ? 'w' : '-',
+				seg->flags & PF_X ? 'x' : '-');
+	}
+}
+
+/*
+ * @brief
+ * Bring an AIOP Image into a buffer: read as is, or decompressed straight
+ * into it, the digests being extended as data arrives. The headers of a
+ * compressed image can only be checked once it is decompressed.
+ *
+ * @param [in] fd Opened AIOP Image file
+ * @param [in] filesize Size of AIOP Image file
+ * @param [in] comp Compression of the file (enum aiopt_comp)
+ * @param [in] buf Buffer to bring the image into
+ * @param [in] cap Size of buf; at least filesize
+ * @param [out] image_sz Size of the image in buf
+ * @param [in,out] dg Digests to extend over the image
+ *
+ * @return AIOPT_SUCCESS, AIOPT_EBADIMAGE or AIOPT_FAILURE
+ */
+static int
+image_to_buf(int fd, size_t filesize, int comp, void *buf, size_t cap,
+	     size_t *image_sz, struct load_digest *dg)
+{
+	struct digest_stream ds = {dg, buf, 0};
+	aiopt_elf_info_t elf;
+	int ret;
+
+	if (comp == AIOPT_COMP_NONE) {
+		*image_sz = filesize;
+		return read_file_to_buf(fd, buf, filesize, dg);
+	}
+
+	ret = aiopt_decompress(fd, filesize, comp, buf, cap, image_sz,
+			       digest_progress, &ds);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_LIB_INFO("Unable to decompress (%s) AIOP Image.\n",
+				aiopt_comp_str(comp));
+		return ret;
+	}
+	digest_finish(&ds, *image_sz);
+	AIOPT_LIB_INFO("AIOP Image decompressed (%s): %lu to %lu bytes.\n",
+			aiopt_comp_str(comp), filesize, *image_sz);
+
+	ret = aiopt_elf_check_buf(buf, *image_sz, &elf);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_LIB_INFO("Decompressed AIOP Image is not a valid AIOP "
+				"ELF.\n");
+		return ret;
+	}
+	print_elf_info(&elf);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Read the expected CRC32C of an AIOP Image from its sidecar file
+ * (AIOPT_CRC32C_SIDECAR_EXT), if there is one
+ *
+ * @param [in] ifile AIOP Image file name, with path
+ * @param [out] found TRUE if the sidecar exists
+ * @param [out] crc Expected CRC32C, if found
+ *
+ * @return AIOPT_SUCCESS, or AIOPT_EBADIMAGE if the sidecar cannot be parsed
+ */
+static int
+read_image_crc(const char *ifile, short int *found, uint32_t *crc)
+{
+	FILE *fp;
+	char path[PATH_MAX];
+	unsigned long val;
+	int ret;
+
+	*found = FALSE;
+
+	ret = snprintf(path, sizeof(path), "%s%s", ifile,
+		       AIOPT_CRC32C_SIDECAR_EXT);
+	if (ret < 0 || ret >= sizeof(path))
+		return AIOPT_SUCCESS;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		AIOPT_DEBUG("No digest file (%s); image not verified.\n",
+				path);
+		return AIOPT_SUCCESS;
+	}
+	ret = fscanf(fp, "%8lx", &val);
+	fclose(fp);
+	if (ret != 1) {
+		AIOPT_DEBUG("Digest file (%s) has no CRC32C.\n", path);
+		return AIOPT_EBADIMAGE;
+	}
+
+	*found = TRUE;
+	*crc = val;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Check the CRC32C of the image just read against its sidecar, if any
+ *
+ * @param [in] expected CRC32C from the sidecar, NULL if none
+ * @param [in] dg Digests of the image
+ *
+ * @return AIOPT_SUCCESS, or AIOPT_EBADIMAGE on mismatch
+ */
+static int
+verify_image_crc(const uint32_t *expected, const struct load_digest *dg)
+{
+	if (!expected)
+		return AIOPT_SUCCESS;
+
+	if (dg->crc != *expected) {
+		AIOPT_LIB_INFO("AIOP Image CRC32C (%08x) does not match "
+				"expected (%08x).\n", dg->crc, *expected);
+		return AIOPT_EBADIMAGE;
+	}
+	AIOPT_LIB_INFO("AIOP Image CRC32C (%08x) verified (%s).\n", dg->crc,
+			aiopt_crc32c_impl());
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Path of the image record of the tile, see cache_dir
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [out] path Buffer of PATH_MAX bytes
+ *
+ * @return void
+ */
+static void
+image_cache_path(aiopt_obj_t *obj, char *path)
+{
+	snprintf(path, PATH_MAX, "%s/dpaiop.%d", cache_dir(),
+		 aiopt_get_aiop_id(obj));
+}
+
+/*
+ * @brief
+ * Drop the image record of the tile, as its image is about to change
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @return void
+ */
+static void
+image_cache_forget(aiopt_obj_t *obj)
+{
+	char path[PATH_MAX];
+
+	obj->image_key_valid = FALSE;
+	image_cache_path(obj, path);
+	if (unlink(path) != 0 && errno != ENOENT)
+		AIOPT_DEBUG("Unable to remove image record (%s). (err=%d)\n",
+				path, errno);
+}
+
+/*
+ * @brief
+ * Record the key of the image now RUNNING on the tile. The record is written
+ * to a temporary file and renamed, so that readers never see a partial one.
+ * Failing to write it is not an error; the key is still kept on the handle.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] key Key of the load
+ *
+ * @return void
+ */
+static void
+image_cache_store(aiopt_obj_t *obj, const aiopt_image_key_t *key)
+{
+	FILE *fp;
+	char path[PATH_MAX], tmp[PATH_MAX + 4];
+	int ret;
+
+	obj->image_key = *key;
+	obj->image_key_valid = TRUE;
+
+	if (mkdir(cache_dir(), 0755) != 0 && errno != EEXIST) {
+		AIOPT_DEBUG("Unable to create (%s). (err=%d)\n",
+				cache_dir(), errno);
+		return;
+	}
+
+	image_cache_path(obj, path);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		AIOPT_DEBUG("Unable to write image record (%s). (err=%d)\n",
+				tmp, errno);
+		return;
+	}
+	fprintf(fp, "hash=%016lx image=%lu args=%lu tpc=%u\n", key->hash,
+		key->image_sz, key->args_sz, key->tpc);
+	ret = fclose(fp);
+	if (ret != 0 || rename(tmp, path) != 0) {
+		AIOPT_DEBUG("Unable to write image record (%s). (err=%d)\n",
+				path, errno);
+		unlink(tmp);
+		return;
+	}
+	AIOPT_DEV("Image record (%s) written.\n", path);
+}
+
+/*
+ * @brief
+ * Check if the load identified by key is the one RUNNING on the tile. The
+ * record written by any earlier aiopt_load is used; the one kept on the
+ * handle only if there is no readable record.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] key Key of the load
+ *
+ * @return TRUE if the same image is RUNNING, else FALSE
+ */
+static short int
+image_cache_running(aiopt_obj_t *obj, const aiopt_image_key_t *key)
+{
+	FILE *fp;
+	char path[PATH_MAX];
+	aiopt_image_key_t rec;
+	unsigned int state;
+	short int found = FALSE;
+
+	image_cache_path(obj, path);
+	fp = fopen(path, "r");
+	if (fp) {
+		found = fscanf(fp, "hash=%lx image=%lu args=%lu tpc=%u",
+			       &rec.hash, &rec.image_sz, &rec.args_sz,
+			       &rec.tpc) == 4;
+		fclose(fp);
+	} else if (obj->image_key_valid) {
+		rec = obj->image_key;
+		found = TRUE;
+	}
+
+	if (!found) {
+		AIOPT_DEBUG("No record of the image on the tile.\n");
+		return FALSE;
+	}
+
+	if (rec.hash != key->hash || rec.image_sz != key->image_sz ||
+	    rec.args_sz != key->args_sz || rec.tpc != key->tpc) {
+		AIOPT_DEBUG("Image differs from the one loaded last "
+				"(hash=%016lx).\n", rec.hash);
+		return FALSE;
+	}
+
+	if (read_tile_state(obj, &state) != AIOPT_SUCCESS ||
+	    state != DPAIOP_STATE_RUNNING) {
+		AIOPT_DEBUG("Same image, but tile is not RUNNING.\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * @brief
+ * Fill the key of a load and, if skipping is enabled and the same image is
+ * RUNNING, mark the load report skipped
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] hash Hash over the image, then the arguments
+ * @param [in] filesize Size of the image
+ * @param [in] args_filesize Size of the arguments, 0 if none
+ * @param [in] tpc threads per AIOP core
+ * @param [out] key Key of the load, to record once loaded
+ *
+ * @return TRUE if the load can be skipped, else FALSE
+ */
+static short int
+load_is_redundant(aiopt_obj_t *obj, uint64_t hash, size_t filesize,
+		  size_t args_filesize, unsigned short int tpc,
+		  aiopt_image_key_t *key)
+{
+	key->hash = hash;
+	key->image_sz = filesize;
+	key->args_sz = args_filesize;
+	key->tpc = tpc;
+	AIOPT_DEV("Image key: hash=%016lx, image=%lu, args=%lu, tpc=%u\n",
+			key->hash, key->image_sz, key->args_sz, key->tpc);
+
+	if (!obj->load_skip || !image_cache_running(obj, key))
+		return FALSE;
+
+	AIOPT_LIB_INFO("Same image already RUNNING; load skipped.\n");
+	obj->load_report.skipped = TRUE;
+	obj->load_report.state = DPAIOP_STATE_RUNNING;
+
+	return TRUE;
+}
+
+/*
+ * @brief
+ * Submit a dpaiop reset on the portal of a command, see struct aiopt_async
+ *
+ * @param [in] as Command, with a leased portal
+ * @return 0 if submitted, else MC API error
+ */
+static int
+submit_reset(struct aiopt_async *as)
+{
+	return dpaiop_reset_async(as->p->mc_io, 0, as->p->token, &as->cmd);
+}
+
+/*
+ * @brief
+ * Submit a dpaiop load on the portal of a command, see struct aiopt_async
+ *
+ * @param [in] as Command, with a leased portal and load_cfg set
+ * @return 0 if submitted, else MC API error
+ */
+static int
+submit_load(struct aiopt_async *as)
+{
+	return dpaiop_load_async(as->p->mc_io, 0, as->p->token,
+				 &as->load_cfg, &as->cmd);
+}
+
+/*
+ * @brief
+ * Lease a portal and submit a command on it, to be reaped by aiopt_poll.
+ * The caller has checked that no other command is outstanding on obj.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] as Command, allocated; owned by obj once submitted, else freed
+ * @return AIOPT_SUCCESS if submitted, else AIOPT_FAILURE
+ */
+static int
+submit_async(aiopt_obj_t *obj, struct aiopt_async *as)
+{
+	int ret;
+
+	as->p = portal_lease(obj);
+	if (!as->p) {
+		free(as);
+		return AIOPT_FAILURE;
+	}
+
+	ret = as->submit(as);
+	if (ret) {
+		AIOPT_DEBUG("Unable to submit MC command. (err=%d)\n", ret);
+		portal_release(obj, as->p);
+		free(as);
+		return AIOPT_FAILURE;
+	}
+
+	obj->async = as;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Poll the dpaiop load submitted by perform_dpaiop_load until MC has
+ * completed it or the load timeout has expired; the command is then still
+ * outstanding on obj.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] start_ns Time at which aiopt_load was called
+ * @return AIOPT_SUCCESS, AIOPT_ETIMEDOUT or AIOPT_FAILURE
+ */
+static int
+reap_load(aiopt_obj_t *obj, uint64_t start_ns)
+{
+	int ret;
+	uint64_t polls = 0, deadline = 0;
+	struct timespec ts = {0, AIOPT_LOAD_POLL_US * 1000};
+
+	if (obj->load_timeout_ms != AIOPT_WAIT_FOREVER)
+		deadline = start_ns + obj->load_timeout_ms * 1000000ULL;
+
+	while ((ret = aiopt_poll(obj)) == AIOPT_EINPROGRESS) {
+		polls++;
+		if (deadline && aiopt_now_ns() >= deadline) {
+			AIOPT_DEBUG("dpaiop_load not completed by MC within "
+					"%u ms.\n", obj->load_timeout_ms);
+			return AIOPT_ETIMEDOUT;
+		}
+		nanosleep(&ts, NULL);
+	}
+	AIOPT_DEV("dpaiop_load completed after %lu polls.\n", polls);
+
+	return ret;
+}
+
+/*
+ * @brief
+ * Internal operation interfacing with flib/mc APIs for dpaiop_load/dpaiop_run
+ * This operation should _not_ be called directly - it is wrapped around by
+ * aiopt_load()
+ * Each MC command is followed by a wait for the tile to leave the
+ * corresponding *_ONGOING state, the last being the wait for RUNNING; the
+ * timeline is recorded in obj->load_report. dpaiop_load, on which MC copies
+ * the image, is submitted and polled so that it is bound by the load
+ * timeout too.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] img_iova Device address of the image to issue dpaiop_load on
+ * @param [in] filesize Size of the image
+ * @param [in] args_iova Device address of the arguments
+ * @param [in] args_filesize Size of the arguments, 0 if none
+ * @param [in] reset flag to state if dpaiop_reset() has to be called before
+ *             dpaiop_load is called
+ * @param [in] start_ns Time at which aiopt_load was called
+ * @param [in] key Key of the load, recorded once RUNNING
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBUSY if a
+ *         command of aiopt_reset_submit is not reaped, or AIOPT_FAILURE
+ */
+static int
+perform_dpaiop_load(aiopt_obj_t *obj, uint64_t img_iova, size_t filesize,
+			uint64_t args_iova, size_t args_filesize,
+			short int reset, unsigned short int tpc,
+			uint64_t start_ns, const aiopt_image_key_t *key)
+{
+	int ret;
+	short int retried = FALSE;
+	unsigned int tile_state;
+	aiopt_load_report_t *report = &obj->load_report;
+	aiopt_portal_t *p;
+	struct aiopt_async *as;
+
+	struct dpaiop_load_cfg load_cfg = {0};
+	struct dpaiop_run_cfg run_cfg = {0};
+
+	AIOPT_DEV("Entering.\n");
+
+	report->prepared_ns = aiopt_now_ns() - start_ns;
+
+	/* Load the image on the dpaiop opened in aiopt_init */
+	load_cfg.img_iova = img_iova;
+	load_cfg.img_size = filesize;
+	load_cfg.options = 0;
+	load_cfg.tpc = tpc;
+
+	/* Whatever ends up on the tile, it is no longer the recorded image */
+	image_cache_forget(obj);
+
+	if (reset) {
+		/* Performing Reset before load */
+		AIOPT_DEV("Calling dpaiop_reset before dpaiop_load.\n");
+		/* TODO Warning to users that dpaiop_run is only for rev2 */
+		p = portal_lease(obj);
+		do {
+			ret = dpaiop_reset(p->mc_io, 0, p->token);
+		} while (aiopt_session_expired(obj, p, ret, &retried));
+		portal_release(obj, p);
+		if (ret) {
+			AIOPT_DEBUG("Unable to perform reset of AIOP tile."
+				"(err=%d).\n", ret);
+			/* Error is ignored */
+			AIOPT_LIB_INFO("AIOP Reset may not be supported on some"
+					" hardware. Please check.\n");
+			/* cleanup and return AIOPT_FAILURE */
+		} else {
+			AIOPT_LIB_INFO("AIOP Tile Reset done. (err=%d)\n", ret);
+			ret = aiopt_wait_state(obj, DPAIOP_STATE_RESET_DONE,
+					       load_time_left(obj, start_ns),
+					       &report->state);
+			if (ret != AIOPT_SUCCESS) {
+				AIOPT_DEBUG("AIOP Tile did not complete "
+						"reset.\n");
+				return ret;
+			}
+			report->reset_ns = aiopt_now_ns() - start_ns;
+		}
+	}
+	AIOPT_DEBUG("dpaiop_load call: iova=%p, size=%u\n",
+			(void *)load_cfg.img_iova, load_cfg.img_size);
+
+	/* MC API for performing AIOP Load; other portals of the handle stay
+	 * free for commands of other threads meanwhile
+	 */
+	if (obj->async) {
+		AIOPT_DEBUG("An MC command submitted earlier is not reaped.\n");
+		return AIOPT_EBUSY;
+	}
+	as = calloc(1, sizeof(*as));
+	if (!as) {
+		AIOPT_DEBUG("Unable to allocate memory for MC command.\n");
+		return AIOPT_FAILURE;
+	}
+	as->submit = submit_load;
+	as->load_cfg = load_cfg;
+	ret = submit_async(obj, as);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	/* From here the buffer is MC's, until the tile is done with it */
+	obj->load_pending = TRUE;
+	ret = reap_load(obj, start_ns);
+	if (ret != AIOPT_SUCCESS) {
+		/* dpaiop load failed, or is not complete (AIOPT_ETIMEDOUT) */
+		AIOPT_DEBUG("MC API dpaiop_load failed. (err=%d)\n", ret);
+		/* As with a command timing out in mc_send_command, it is left
+		 * pending on its portal: the next submission there finds the
+		 * portal busy until MC is done
+		 */
+		if (obj->async) {
+			portal_release(obj, obj->async->p);
+			free(obj->async);
+			obj->async = NULL;
+		}
+		if (read_tile_state(obj, &tile_state) == AIOPT_SUCCESS)
+			report->state = tile_state;
+		return ret;
+	}
+	AIOPT_LIB_INFO("MC API dpaiop_load successful. (err=%d)\n", ret);
+
+	/* MC may still be copying the image (LOAD_ONGOING) */
+	ret = aiopt_wait_state(obj, DPAIOP_STATE_LOAD_DONE,
+			       load_time_left(obj, start_ns), &report->state);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_DEBUG("AIOP Tile did not complete load.\n");
+		return ret;
+	}
+	report->loaded_ns = aiopt_now_ns() - start_ns;
+
+	/* Preparing arguments for run */
+	run_cfg.cores_mask = AIOPT_RUN_CORES_ALL;
+	run_cfg.options = 0;
+	run_cfg.args_iova = args_iova;
+	run_cfg.args_size = args_filesize;
+
+	/* Calling dpaiop_run */
+	p = portal_lease(obj);
+	do {
+		ret = dpaiop_run(p->mc_io, 0, p->token, &run_cfg);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	portal_release(obj, p);
+	if (ret != 0) {
+		AIOPT_DEBUG("MC API dpaiop_run failed. (err=%d)\n", ret);
+		if (read_tile_state(obj, &tile_state) == AIOPT_SUCCESS)
+			report->state = tile_state;
+		return AIOPT_FAILURE;
+	}
+	AIOPT_LIB_INFO("MC API dpaiop_run result: (%d).\n", ret);
+	report->booting_ns = aiopt_now_ns() - start_ns;
+
+	/* Arguments are read by the tile while it boots (BOOT_ONGOING) */
+	ret = aiopt_wait_state(obj, DPAIOP_STATE_RUNNING,
+			       load_time_left(obj, start_ns), &report->state);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_DEBUG("AIOP Tile did not boot.\n");
+		return ret;
+	}
+	report->running_ns = aiopt_now_ns() - start_ns;
+	obj->load_pending = FALSE;
+	image_cache_store(obj, key);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Copy a buffer, extending the digests over each AIOPT_DIGEST_CHUNK_SZ
+ * copied while it is still in cache
+ *
+ * @param [in] dst Buffer to copy into
+ * @param [in] src Data
+ * @param [in] len Length of data
+ * @param [in,out] dg Digests to extend over the data
+ *
+ * @return void
+ */
+static void
+copy_to_buf(void *dst, const void *src, size_t len, struct load_digest *dg)
+{
+	size_t done, step;
+
+	for (done = 0; done < len; done += step) {
+		step = len - done;
+		if (step > AIOPT_DIGEST_CHUNK_SZ)
+			step = AIOPT_DIGEST_CHUNK_SZ;
+		memcpy((char *)dst + done, (const char *)src + done, step);
+		digest_buf(dg, (char *)dst + done, step);
+	}
+}
+
+/*
+ * @brief
+ * Bring the image and arguments of a load into a buffer, from files or
+ * caller memory: the image at its start, the arguments from the next page.
+ * The image is checked against its expected CRC before the arguments are
+ * read.
+ *
+ * @param [in] src Image and arguments of the load
+ * @param [in] buf Buffer with room for image_bound, page aligned, and the
+ *             arguments
+ * @param [out] image_sz Size of the image in buf
+ * @param [out] args_addr Arguments in buf, NULL without arguments
+ * @param [out] dg Digests over the image, then the arguments
+ *
+ * @return AIOPT_SUCCESS, AIOPT_EBADIMAGE or AIOPT_FAILURE
+ */
+static int
+fill_load_buf(const struct load_src *src, void *buf, size_t *image_sz,
+	      void **args_addr, struct load_digest *dg)
+{
+	int ret;
+
+	dg->crc = 0;
+	dg->hash = AIOPT_FNV64_OFFSET;
+	*args_addr = NULL;
+
+	if (src->fd > 0) {
+		ret = image_to_buf(src->fd, src->image_sz, src->comp, buf,
+				   src->image_bound, image_sz, dg);
+		if (ret != AIOPT_SUCCESS) {
+			AIOPT_DEBUG("Unable to read AIOP Image.\n");
+			return ret;
+		}
+	} else {
+		copy_to_buf(buf, src->image, src->image_sz, dg);
+		*image_sz = src->image_sz;
+	}
+
+	ret = verify_image_crc(src->expected_crc, dg);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	if (!src->args_sz)
+		return AIOPT_SUCCESS;
+
+	/* Key hashes the arguments on from the image */
+	*args_addr = (char *)buf + AIOPT_ALIGN_PAGE(*image_sz);
+	if (src->args_fd > 0) {
+		ret = read_file_to_buf(src->args_fd, *args_addr, src->args_sz,
+				       dg);
+		if (ret != AIOPT_SUCCESS) {
+			AIOPT_DEBUG("Unable to read AIOP Args.\n");
+			return AIOPT_FAILURE;
+		}
+	} else {
+		copy_to_buf(*args_addr, src->args, src->args_sz, dg);
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Load an image and its arguments, as described by src, on the tile. Both
+ * go into one buffer: the DMA arena if it is large enough, else a buffer DMA
+ * mapped for this load only, in a single mapping.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] src Image and arguments of the load
+ * @param [in] reset flag to state if dpaiop_reset() has to be called before
+ *             dpaiop_load is called
+ * @param [in] tpc threads per AIOP core
+ * @param [in] start_ns Time at which the load was called
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBADIMAGE,
+ *         AIOPT_ENOMEM or AIOPT_FAILURE
+ */
+static int
+load_from_src(aiopt_obj_t *obj, const struct load_src *src, short int reset,
+	      unsigned short int tpc, uint64_t start_ns)
+{
+	int ret;
+	void *buf;
+	void *args_addr;
+	uint64_t iova = 0;
+	size_t buf_sz, used_sz, image_sz = 0;
+	short int from_arena;
+	aiopt_image_key_t key;
+	struct load_digest dg;
+
+	/* With a DMA arena large enough, no per-load mapping is needed */
+	buf_sz = AIOPT_ALIGN_PAGE(src->image_bound) +
+		 AIOPT_ALIGN_PAGE(src->args_sz);
+	from_arena = obj->arena.addr && buf_sz <= obj->arena.size;
+	if (from_arena) {
+		buf = obj->arena.addr;
+		iova = obj->arena.iova;
+	} else {
+		/* Pages are only allocated as the image is read in */
+		buf = mmap(NULL, buf_sz, PROT_READ|PROT_WRITE,
+			   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED) {
+			AIOPT_DEBUG("Unable to mmap internal memory. "
+					"(err=%d)\n", errno);
+			return AIOPT_ENOMEM;
+		}
+		AIOPT_DEV("mmap-ing (%lu) bytes of buffer for AIOP image and "
+				"arguments. (addr=%p)\n", buf_sz, buf);
+	}
+
+	ret = fill_load_buf(src, buf, &image_sz, &args_addr, &dg);
+	if (ret != AIOPT_SUCCESS)
+		goto out;
+
+	if (from_arena) {
+		obj->arena.loads++;
+		AIOPT_DEV("Image (%lu bytes) and args (%lu bytes) read into DMA "
+				"arena (%p).\n", image_sz, src->args_sz, buf);
+	} else {
+		/* A compressed image may have taken less than allowed */
+		used_sz = AIOPT_ALIGN_PAGE(image_sz) +
+			  AIOPT_ALIGN_PAGE(src->args_sz);
+		if (used_sz < buf_sz) {
+			munmap((char *)buf + used_sz, buf_sz - used_sz);
+			buf_sz = used_sz;
+		}
+	}
+
+	/* Image already running needs neither DMA mapping nor MC commands */
+	if (load_is_redundant(obj, dg.hash, image_sz, src->args_sz, tpc,
+			      &key)) {
+		ret = AIOPT_SUCCESS;
+		goto out;
+	}
+
+	if (!from_arena) {
+		/* Image and arguments together, in a single mapping */
+		ret = aiopt_dma_map(obj, buf, buf_sz, 0, &iova);
+		if (ret != VFIO_SUCCESS) {
+			AIOPT_DEBUG("Unable to perform DMA Mapping. (err=%d)\n",
+					ret);
+			goto out;
+		}
+		AIOPT_LIB_INFO("DMA Map of allocated memory (%p) successful "
+				"(iova=0x%lx).\n", buf, iova);
+	}
+
+	/* Arguments are at the same offset in device and virtual space */
+	ret = perform_dpaiop_load(obj, iova, image_sz,
+				  iova + ((char *)args_addr - (char *)buf),
+				  src->args_sz, reset, tpc, start_ns, &key);
+	if (ret != AIOPT_SUCCESS)
+		AIOPT_DEBUG("Error in performing aiop load.\n");
+	if (from_arena)
+		return ret;
+
+	if (obj->load_pending) {
+		/* Tile may still be reading the buffer (e.g. the load timed
+		 * out); it is kept mapped until load_settled finds the tile
+		 * done with it, or aiopt_deinit.
+		 */
+		AIOPT_DEBUG("Load not complete; holding its DMA buffer.\n");
+		obj->held_bufs[0].addr = buf;
+		obj->held_bufs[0].iova = iova;
+		obj->held_bufs[0].len = buf_sz;
+		return ret;
+	}
+	aiopt_dma_unmap(obj, iova, buf_sz);
+
+out:
+	if (!from_arena)
+		munmap(buf, buf_sz);
+	return ret;
+}
+
+/* ==========================================================================
+ * Externally available API definitions
+ * ==========================================================================*/
+
+/*
+ * @brief
+ * Convert MC State to String
+ *
+ * @param [in] state State as returned by dpaiop_get_state
+ * @return const string explaining state
+ */
+const char *
+aiopt_get_state_str(int state)
+{
+	char *p = NULL;
+
+	switch (state) {
+	case DPAIOP_STATE_RESET_DONE:
+		p = "DPAIOP_STATE_RESET_DONE";
+		break;
+	case DPAIOP_STATE_RESET_ONGOING:
+		p = "DPAIOP_STATE_RESET_ONGOING";
+		break;
+	case DPAIOP_STATE_LOAD_DONE:
+		p = "DPAIOP_STATE_LOAD_DONE";
+		break;
+	case DPAIOP_STATE_LOAD_ONGIONG:
+		p = "DPAIOP_STATE_LOAD_ONGIONG";
+		break;
+	case DPAIOP_STATE_LOAD_ERROR:
+		p = "DPAIOP_STATE_LOAD_ERROR";
+		break;
+	case DPAIOP_STATE_BOOT_ONGOING:
+		p = "DPAIOP_STATE_BOOT_ONGOING";
+		break;
+	case DPAIOP_STATE_BOOT_ERROR:
+		p = "DPAIOP_STATE_BOOT_ERROR";
+		break;
+	case DPAIOP_STATE_RUNNING:
+		p = "DPAIOP_STATE_RUNNING";
+		break;
+	default:
+		p = "Invalid MC State";
+		break;
+	}
+
+	return (const char *)p;
+}
+
+/*
+ * @brief
+ * Convert a State name to MC State
+ *
+ * @param [in] str State name, with or without DPAIOP_STATE_ prefix
+ * @return State as returned by dpaiop_get_state, or AIOPT_FAILURE
+ */
+int
+aiopt_get_state_from_str(const char *str)
+{
+	int i;
+	const char *name;
+	static const int states[] = {
+		DPAIOP_STATE_RESET_DONE, DPAIOP_STATE_RESET_ONGOING,
+		DPAIOP_STATE_LOAD_DONE, DPAIOP_STATE_LOAD_ONGIONG,
+		DPAIOP_STATE_LOAD_ERROR, DPAIOP_STATE_BOOT_ONGOING,
+		DPAIOP_STATE_BOOT_ERROR, DPAIOP_STATE_RUNNING
+	};
+
+	if (!str)
+		return AIOPT_FAILURE;
+
+	if (!strncasecmp(str, "DPAIOP_STATE_", strlen("DPAIOP_STATE_")))
+		str += strlen("DPAIOP_STATE_");
+
+	/* Correctly spelled alias of DPAIOP_STATE_LOAD_ONGIONG */
+	if (!strcasecmp(str, "LOAD_ONGOING"))
+		return DPAIOP_STATE_LOAD_ONGIONG;
+
+	for (i = 0; i < sizeof(states) / sizeof(states[0]); i++) {
+		name = aiopt_get_state_str(states[i]) +
+			strlen("DPAIOP_STATE_");
+		if (!strcasecmp(str, name))
+			return states[i];
+	}
+
+	return AIOPT_FAILURE;
+}
+
+/*
+ * @brief
+ * Wait for the AIOP Tile to reach a State, blocking on the dpaiop IRQ if
+ * available, else polling.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] state State to wait for
+ * @param [in] timeout_ms Time limit in milliseconds, or AIOPT_WAIT_FOREVER
+ * @param [out] cur_state Last State read from the tile; can be NULL
+ *
+ * @return AIOPT_SUCCESS, AIOPT_ETIMEDOUT or AIOPT_FAILURE
+ */
+int
+aiopt_wait_state(aiopt_handle_t handle, int state,
+		 unsigned int timeout_ms, int *cur_state)
+{
+	int ret, wait_ms;
+	unsigned int tile_state;
+	uint64_t now, deadline, seen = 0;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!obj || !obj->num_portals) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
+	}
+
+	now = aiopt_now_ns() / 1000000;
+	deadline = now + timeout_ms;
+
+	while (1) {
+		/* Any event after this is either seen by the state read
+		 * below, or counted for wait_aiop_irq
+		 */
+		if (obj->irq_fd >= 0)
+			seen = aiop_irq_seq(obj);
+		ret = read_tile_state(obj, &tile_state);
+		if (ret != AIOPT_SUCCESS)
+			return AIOPT_FAILURE;
+		if (cur_state)
+			*cur_state = tile_state;
+
+		AIOPT_DEV("Tile state = %s\n", aiopt_get_state_str(tile_state));
+		if (tile_state == state) {
+			AIOPT_LIB_INFO("AIOP Tile reached %s.\n",
+					aiopt_get_state_str(state));
+			return AIOPT_SUCCESS;
+		}
+		if (tile_state == DPAIOP_STATE_LOAD_ERROR ||
+		    tile_state == DPAIOP_STATE_BOOT_ERROR) {
+			AIOPT_DEBUG("AIOP Tile in %s while waiting for %s.\n",
+					aiopt_get_state_str(tile_state),
+					aiopt_get_state_str(state));
+			return AIOPT_FAILURE;
+		}
+
+		now = aiopt_now_ns() / 1000000;
+		if (timeout_ms != AIOPT_WAIT_FOREVER && now >= deadline) {
+			AIOPT_DEBUG("Timed out waiting for %s (in %s).\n",
+					aiopt_get_state_str(state),
+					aiopt_get_state_str(tile_state));
+			return AIOPT_ETIMEDOUT;
+		}
+
+		wait_ms = obj->irq_fd >= 0 ? AIOPT_WAIT_IRQ_MAX_MS :
+					     AIOPT_WAIT_POLL_MS;
+		if (timeout_ms != AIOPT_WAIT_FOREVER &&
+		    deadline - now < wait_ms)
+			wait_ms = deadline - now;
+
+		if (obj->irq_fd < 0)
+			usleep(wait_ms * 1000);
+		else
+			wait_aiop_irq(obj, seen, wait_ms);
+	}
+}
+
+/*
+ * @brief
+ * AIOPT Get Time of Day
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] tod Time of day as a unsigned long value
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_gettod(aiopt_handle_t handle, uint64_t *tod)
+{
+	int ret;
+	short int retried = FALSE;
+	aiopt_obj_t *obj = NULL;
+	aiopt_portal_t *p;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!tod) {
+		AIOPT_DEV("Incorrect API Usage. (arg==NULL).\n");
+		return AIOPT_FAILURE;
+	}
+
+	obj = (aiopt_obj_t *)handle;
+
+	p = portal_lease(obj);
+	if (!p)
+		return AIOPT_FAILURE;
+	do {
+		ret = dpaiop_get_time_of_day(p->mc_io, 0, p->token, tod);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	portal_release(obj, p);
+	if (ret) {
+		AIOPT_DEBUG("Unable to fetch Time of Day. "
+				"(err=%d)\n", ret);
+		return AIOPT_FAILURE;
+	}
+
+	AIOPT_LIB_INFO("Time of day from MC API:- (%lu)\n", *tod);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * AIOPT Set Time of Day
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] tod Time of day to set as an unsigned long value
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_settod(aiopt_handle_t handle, uint64_t tod)
+{
+	int ret;
+	short int retried = FALSE;
+	aiopt_obj_t *obj = NULL;
+	aiopt_portal_t *p;
+
+	AIOPT_DEV("Entering.\n");
+
+	obj = (aiopt_obj_t *)handle;
+
+	AIOPT_DEV("Attempting to set Time of day to %lu.\n", tod);
+
+	p = portal_lease(obj);
+	if (!p)
+		return AIOPT_FAILURE;
+	do {
+		ret = dpaiop_set_time_of_day(p->mc_io, 0, p->token, tod);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	portal_release(obj, p);
+	if (ret) {
+		AIOPT_DEBUG("Unable to set Time of Day. "
+				"(err=%d)\n", ret);
+		return AIOPT_FAILURE;
+	}
+
+	AIOPT_LIB_INFO("Setting time of day successful.\n");
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Issue the MC commands of the fields asked for and not yet in snap->valid,
+ * back to back on the session of a leased portal. A failed command does not
+ * stop the batch, unless MC has rejected the token; the remaining commands
+ * would fail the same way.
+ *
+ * @param [in] p Portal leased by the caller
+ * @param [in/out] snap Snapshot to fill in
+ * @param [in] fields AIOPT_SNAP_* fields to read
+ *
+ * @return 0, -EACCES, or the error of the first command which failed
+ */
+static int
+snapshot_batch(aiopt_portal_t *p, aiopt_snapshot_t *snap, unsigned int fields)
+{
+	int ret, err = 0;
+	uint16_t major, minor;
+	uint32_t state;
+	struct dpaiop_sl_version slv = {0};
+	struct dpaiop_attr attr = {0};
+
+	fields &= ~snap->valid;
+
+	if (fields & AIOPT_SNAP_STATE) {
+		ret = dpaiop_get_state(p->mc_io, 0, p->token, &state);
+		if (!ret) {
+			snap->state = state;
+			snap->valid |= AIOPT_SNAP_STATE;
+		} else {
+			AIOPT_DEBUG("Unable to fetch AIOP Tile state. "
+					"(err=%d)\n", ret);
+			if (ret == -EACCES)
+				return ret;
+			err = err ? err : ret;
+		}
+	}
+
+	if (fields & AIOPT_SNAP_SL_VERSION) {
+		ret = dpaiop_get_sl_version(p->mc_io, 0, p->token, &slv);
+		if (!ret) {
+			snap->sl_major_v = slv.major;
+			snap->sl_minor_v = slv.minor;
+			snap->sl_revision = slv.revision;
+			snap->valid |= AIOPT_SNAP_SL_VERSION;
+		} else {
+			AIOPT_DEBUG("Unable to fetch Service Layer Version. "
+					"(err=%d)\n", ret);
+			if (ret == -EACCES)
+				return ret;
+			err = err ? err : ret;
+		}
+	}
+
+	if (fields & AIOPT_SNAP_API_VERSION) {
+		ret = dpaiop_get_api_version(p->mc_io, 0, &major, &minor);
+		if (!ret) {
+			snap->major_v = major;
+			snap->minor_v = minor;
+			snap->valid |= AIOPT_SNAP_API_VERSION;
+		} else {
+			AIOPT_DEBUG("Unable to fetch dpaiop API Version. "
+					"(err=%d)\n", ret);
+			if (ret == -EACCES)
+				return ret;
+			err = err ? err : ret;
+		}
+	}
+
+	if (fields & AIOPT_SNAP_ATTR) {
+		ret = dpaiop_get_attributes(p->mc_io, 0, p->token, &attr);
+		if (!ret) {
+			snap->id = attr.id;
+			snap->valid |= AIOPT_SNAP_ATTR;
+		} else {
+			AIOPT_DEBUG("Unable to fetch dpaiop attributes. "
+					"(err=%d)\n", ret);
+			if (ret == -EACCES)
+				return ret;
+			err = err ? err : ret;
+		}
+	}
+
+	if (fields & AIOPT_SNAP_IRQ) {
+		ret = dpaiop_get_irq_status(p->mc_io, 0, p->token,
+					    AIOPT_AIOP_IRQ_INDEX,
+					    &snap->irq_status);
+		if (!ret) {
+			snap->valid |= AIOPT_SNAP_IRQ;
+		} else {
+			AIOPT_DEBUG("Unable to fetch dpaiop IRQ status. "
+					"(err=%d)\n", ret);
+			if (ret == -EACCES)
+				return ret;
+			err = err ? err : ret;
+		}
+	}
+
+	if (fields & AIOPT_SNAP_TOD) {
+		ret = dpaiop_get_time_of_day(p->mc_io, 0, p->token, &snap->tod);
+		if (!ret) {
+			snap->valid |= AIOPT_SNAP_TOD;
+		} else {
+			AIOPT_DEBUG("Unable to fetch Time of Day. "
+					"(err=%d)\n", ret);
+			if (ret == -EACCES)
+				return ret;
+			err = err ? err : ret;
+		}
+	}
+
+	return err;
+}
+
+/*
+ * @brief
+ * Read the fields asked for of the AIOP Tile, in one batch on one portal.
+ * If MC has expired the session token, the session is re-opened once and
+ * the batch resumed with the fields not yet read.
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [out] snap Snapshot to fill in
+ * @param [in] fields AIOPT_SNAP_* fields to read
+ *
+ * @return AIOPT_SUCCESS if every field was read, else AIOPT_FAILURE
+ */
+static int
+read_snapshot(aiopt_obj_t *obj, aiopt_snapshot_t *snap, unsigned int fields)
+{
+	int ret;
+	short int retried = FALSE;
+	aiopt_portal_t *p;
+
+	memset(snap, 0, sizeof(*snap));
+
+	p = portal_lease(obj);
+	if (!p)
+		return AIOPT_FAILURE;
+	snap->taken_ns = aiopt_now_ns();
+	do {
+		ret = snapshot_batch(p, snap, fields);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	snap->mc_ns = aiopt_now_ns() - snap->taken_ns;
+	AIOPT_DEBUG("Snapshot on %s: fields=0x%x, read=0x%x in %llu us\n",
+			p->name, fields, snap->valid,
+			(unsigned long long)(snap->mc_ns / 1000));
+	portal_release(obj, p);
+
+	return (snap->valid == fields) ? AIOPT_SUCCESS : AIOPT_FAILURE;
+}
+
+/*
+ * @brief
+ * AIOPT Status call. Returns information about State of AIOP Tile, Version
+ * information and Service Layer Version information
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] s aiopt_status_t instance object which would be filled in
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_status(aiopt_handle_t handle, aiopt_status_t *s)
+{
+	aiopt_obj_t *obj = NULL;
+	aiopt_snapshot_t snap;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!s) {
+		AIOPT_DEBUG("Incorrect API Usage. (arg==NULL).\n");
+		return AIOPT_FAILURE;
+	}
+
+	obj = (aiopt_obj_t *)handle;
+
+	/* State, Service Layer and API Versions and ID, in one batch. The
+	 * state can be converted to string using aiopt_get_state_str. Only
+	 * State and Service Layer Version are required; the others are
+	 * filled in if MC returned them.
+	 */
+	read_snapshot(obj, &snap, AIOPT_SNAP_STATE | AIOPT_SNAP_SL_VERSION |
+		      AIOPT_SNAP_API_VERSION | AIOPT_SNAP_ATTR);
+	if ((snap.valid & (AIOPT_SNAP_STATE | AIOPT_SNAP_SL_VERSION)) !=
+	    (AIOPT_SNAP_STATE | AIOPT_SNAP_SL_VERSION))
+		return AIOPT_FAILURE;
+
+	AIOPT_DEBUG("AIOP SL Attributes: major=%d, minor=%d, rev=%d\n",
+			snap.sl_major_v, snap.sl_minor_v, snap.sl_revision);
+	AIOPT_DEBUG("Obtained tile_state = %d\n", snap.state);
+
+	/* The handle knows its dpaiop, even if MC did not return it */
+	s->id = (snap.valid & AIOPT_SNAP_ATTR) ? snap.id :
+						 aiopt_get_aiop_id(obj);
+	if (snap.valid & AIOPT_SNAP_API_VERSION) {
+		s->major_v = snap.major_v;
+		s->minor_v = snap.minor_v;
+	} else {
+		AIOPT_DEBUG("dpaiop API Version not available.\n");
+		s->major_v = s->minor_v = -1;
+	}
+	s->sl_major_v = snap.sl_major_v;
+	s->sl_minor_v = snap.sl_minor_v;
+	s->sl_revision = snap.sl_revision;
+	s->state = snap.state;
+
+	AIOPT_LIB_INFO("State and Status information successfully obtained.\n");
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * AIOPT Snapshot call. Reads state, versions, attributes, IRQ status and
+ * time of day of the AIOP Tile in one batch of MC commands
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] snap aiopt_snapshot_t instance object which would be filled in
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_snapshot(aiopt_handle_t handle, aiopt_snapshot_t *snap)
+{
+	int ret;
+	aiopt_obj_t *obj = NULL;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (!snap) {
+		AIOPT_DEBUG("Incorrect API Usage. (arg==NULL).\n");
+		return AIOPT_FAILURE;
+	}
+
+	obj = (aiopt_obj_t *)handle;
+
+	ret = read_snapshot(obj, snap, AIOPT_SNAP_ALL);
+	if (ret != AIOPT_SUCCESS)
+		AIOPT_DEBUG("Snapshot incomplete. (read=0x%x)\n", snap->valid);
+
+	return ret;
+}
+
+/* Objects queried by the workers of aiopt_list */
+struct list_ctx {
+	aiopt_obj_t	*obj;
+	aiopt_dpobj_info_t *info;
+	unsigned int	count;
+	unsigned int	next;		/**< Next object to query >*/
+	pthread_mutex_t	lock;		/**< Guards next >*/
+};
+
+/*
+ * @brief
+ * Read the tile state of a dpaiop of the container other than that of the
+ * handle, on a session opened for the purpose
+ *
+ * @param [in] obj aiopt_obj_t type object
+ * @param [in] id ID of the dpaiop
+ * @param [out] state State as returned by dpaiop_get_state
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+static int
+read_other_tile_state(aiopt_obj_t *obj, int id, unsigned int *state)
+{
+	int ret;
+	uint16_t token;
+	aiopt_portal_t *p;
+
+	p = portal_lease(obj);
+	ret = dpaiop_open(p->mc_io, CMD_PRI_LOW, id, &token);
+	if (!ret) {
+		ret = dpaiop_get_state(p->mc_io, 0, token, state);
+		dpaiop_close(p->mc_io, CMD_PRI_LOW, token);
+	}
+	portal_release(obj, p);
+	if (ret) {
+		AIOPT_DEBUG("Unable to fetch state of dpaiop.%d. (err=%d).\n",
+				id, ret);
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Worker of aiopt_list: query objects until none is left
+ *
+ * @param [in] arg struct list_ctx
+ * @return NULL
+ */
+static void *
+list_worker(void *arg)
+{
+	struct list_ctx *ctx = arg;
+	aiopt_obj_t *obj = ctx->obj;
+	aiopt_dpobj_info_t *info;
+	struct vfio_device_info di;
+	unsigned int i, state;
+	int ret;
+
+	while (1) {
+		pthread_mutex_lock(&ctx->lock);
+		i = ctx->next++;
+		pthread_mutex_unlock(&ctx->lock);
+		if (i >= ctx->count)
+			break;
+		info = &ctx->info[i];
+
+		/* IRQs are only known through VFIO */
+		if (!obj->sim) {
+			memset(&di, 0, sizeof(di));
+			di.argsz = sizeof(di);
+			ret = fsl_vfio_get_device_info(obj->vfio_handle,
+					obj->objs[i].name, &di);
+			if (ret == 0)
+				info->num_irqs = di.num_irqs;
+		}
+
+		if (info->type != AIOP_TYPE)
+			continue;
+		if (info->in_use)
+			ret = read_tile_state(obj, &state);
+		else
+			ret = read_other_tile_state(obj, info->id, &state);
+		if (ret == AIOPT_SUCCESS)
+			info->state = state;
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief
+ * List the dpaiop and dpmcp objects of the container; see aiop_lib.h
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] info Objects, up to max
+ * @param [in] max Size of info
+ * @param [out] count Number of objects in the container
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_list(aiopt_handle_t handle, aiopt_dpobj_info_t *info,
+	   unsigned int max, unsigned int *count)
+{
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+	struct list_ctx ctx;
+	pthread_t tids[AIOPT_MAX_PORTALS];
+	unsigned int i, j, n, nthreads = 0;
+	dpobj_type_t *dp;
+
+	if (!obj || !count || (max && !info)) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
+	}
+
+	*count = obj->num_objs;
+	n = obj->num_objs < max ? obj->num_objs : max;
+	if (!n)
+		return AIOPT_SUCCESS;
+
+	for (i = 0; i < n; i++) {
+		dp = &obj->objs[i];
+		memset(&info[i], 0, sizeof(info[i]));
+		snprintf(info[i].name, sizeof(info[i].name), "%s", dp->name);
+		info[i].type = dp->type;
+		info[i].id = dp->id;
+		info[i].num_irqs = -1;
+		info[i].state = -1;
+		if (dp->type == AIOP_TYPE) {
+			info[i].in_use = (dp->id == aiopt_get_aiop_id(obj));
+			continue;
+		}
+		for (j = 0; j < obj->num_portals; j++) {
+			if (!strcmp(obj->portals[j].name, dp->name))
+				info[i].in_use = TRUE;
+		}
+	}
+
+	ctx.obj = obj;
+	ctx.info = info;
+	ctx.count = n;
+	ctx.next = 0;
+	pthread_mutex_init(&ctx.lock, NULL);
+
+	/* One worker per portal, the caller being one of them; more would
+	 * only wait for a portal
+	 */
+	while (nthreads + 1 < obj->num_portals && nthreads + 1 < n &&
+	       !pthread_create(&tids[nthreads], NULL, list_worker, &ctx))
+		nthreads++;
+	list_worker(&ctx);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+
+	pthread_mutex_destroy(&ctx.lock);
+	AIOPT_DEBUG("Listed %u objects with %u threads.\n", n, nthreads + 1);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Print objects as listed by aiopt_list; what is not known is printed as '-'
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] info Objects to print
+ * @param [in] count Number of objects in info
+ *
+ * @return void
+ */
+void
+aiopt_dump_list(FILE *fp, const aiopt_dpobj_info_t *info, unsigned int count)
+{
+	unsigned int i;
+	char irqs[16];
+	const char *state, *use;
+
+	fprintf(fp, "%-16s %6s %5s  %-28s %s\n", "Object", "ID", "IRQs",
+		"State", "In use");
+	for (i = 0; i < count; i++) {
+		if (info[i].num_irqs >= 0)
+			snprintf(irqs, sizeof(irqs), "%d", info[i].num_irqs);
+		else
+			snprintf(irqs, sizeof(irqs), "-");
+		if (info[i].type == AIOP_TYPE && info[i].state >= 0)
+			state = aiopt_get_state_str(info[i].state);
+		else
+			state = "-";
+		if (!info[i].in_use)
+			use = "-";
+		else
+			use = info[i].type == AIOP_TYPE ? "tile" : "portal";
+		fprintf(fp, "%-16s %6d %5s  %-28s %s\n", info[i].name,
+			info[i].id, irqs, state, use);
+	}
+}
+
+/*
+ * @brief
+ * AIOPT Reset call for performing Reset of a AIOP Tile
+ * XXX This is not supported on rev1 hardware
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_reset(aiopt_handle_t handle)
+{
+	int ret;
+	short int retried = FALSE;
+	aiopt_obj_t *obj = NULL;
+	aiopt_portal_t *p;
+
+	AIOPT_DEV("Entering.\n");
+
+	obj = (aiopt_obj_t *)handle;
+
+	p = portal_lease(obj);
+	if (!p)
+		return AIOPT_FAILURE;
+
+	image_cache_forget(obj);
+
+	do {
+		ret = dpaiop_reset(p->mc_io, 0, p->token);
+	} while (aiopt_session_expired(obj, p, ret, &retried));
+	portal_release(obj, p);
+	if (ret) {
+		AIOPT_DEBUG("Unable to reset the AIOP tile. (err=%d)\n", ret);
+		return AIOPT_FAILURE;
+	}
+
+	AIOPT_LIB_INFO("AIOP Tile Reset successful.\n");
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Submit a reset of the AIOP tile to MC and return without waiting for MC to
+ * complete it; the command is reaped by aiopt_poll.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ *
+ * @return AIOPT_SUCCESS if submitted, AIOPT_EBUSY if a command submitted
+ *         earlier is not reaped yet, or AIOPT_FAILURE
+ */
+int
+aiopt_reset_submit(aiopt_handle_t handle)
+{
+	int ret;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+	struct aiopt_async *as;
+
+	AIOPT_DEV("Entering.\n");
+
+	if (obj->async) {
+		AIOPT_DEBUG("An MC command submitted earlier is not reaped.\n");
+		return AIOPT_EBUSY;
+	}
+
+	as = calloc(1, sizeof(*as));
+	if (!as) {
+		AIOPT_DEBUG("Unable to allocate memory for MC command.\n");
+		return AIOPT_FAILURE;
+	}
+
+	image_cache_forget(obj);
+
+	as->submit = submit_reset;
+	ret = submit_async(obj, as);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_DEBUG("Unable to submit reset of the AIOP tile.\n");
+		return ret;
+	}
+	AIOPT_DEBUG("AIOP Tile Reset submitted on %s.\n",
+			obj->async->p->name);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Check, without blocking, whether MC has completed the command submitted
+ * with aiopt_reset_submit. Once it has, the portal leased for it is returned
+ * and its result is given. If MC rejected the token, the session is
+ * re-opened and the command submitted again.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ *
+ * @return AIOPT_EINPROGRESS while MC is working on the command;
+ *         AIOPT_SUCCESS or AIOPT_FAILURE once it is done, or if no command
+ *         was submitted
+ */
+int
+aiopt_poll(aiopt_handle_t handle)
+{
+	int ret;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+	struct aiopt_async *as = obj->async;
+
+	if (!as) {
+		AIOPT_DEV("No MC command submitted.\n");
+		return AIOPT_FAILURE;
+	}
+
+	ret = mc_poll_command(as->p->mc_io, &as->cmd);
+	if (ret == -EINPROGRESS)
+		return AIOPT_EINPROGRESS;
+
+	if (aiopt_session_expired(obj, as->p, ret, &as->retried)) {
+		ret = as->submit(as);
+		if (!ret)
+			return AIOPT_EINPROGRESS;
+	}
+
+	portal_release(obj, as->p);
+	free(as);
+	obj->async = NULL;
+
+	if (ret) {
+		AIOPT_DEBUG("Submitted MC command failed. (err=%d)\n", ret);
+		return AIOPT_FAILURE;
+	}
+	AIOPT_LIB_INFO("Submitted MC command completed.\n");
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Load an image file with its arguments, from a file or from memory
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in] ifile AIOP Image file name, with path
+ * @param [in] afile AIOP Args file name, with path, or NULL
+ * @param [in] args Arguments in memory, if afile is NULL; can be NULL
+ * @param [in] args_sz Size of args
+ * @param [in] reset Flag to state if reset is to be done before load operation
+ * @param [in] tpc for threads per AIOP core
+ * @param [in] start_ns Time at which the load was called
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBADIMAGE or
+ *         AIOPT_FAILURE
+ */
+static int
+load_image_file(aiopt_obj_t *obj, const char *ifile, const char *afile,
+		const void *args, size_t args_sz, short int reset,
+		unsigned short int tpc, uint64_t start_ns)
+{
+	int ret;
+	short int crc_found;
+	uint32_t crc;
+	aiopt_elf_info_t elf;
+	struct load_src src;
+
+	memset(&src, 0, sizeof(src));
+	src.args_fd = -1;
+
+	/* Get the FD of the AIOP Image file after opening it. Failure to open
+	 * is an error.
+	 */
+	src.fd = get_aiop_image_fd(ifile, obj->limits.image_max,
+				   &src.image_sz);
+	if (src.fd <= 0 ) { /* Including AIOPT_FAILURE */
+		AIOPT_DEBUG("Unable to open AIOP Image File.\n");
+		ret = AIOPT_FAILURE;
+		goto err_out;
+	}
+	AIOPT_LIB_INFO("AIOP Image file opened: (fd=%d).\n", src.fd);
+
+	/* Headers only; a bad image is refused before it is read. A
+	 * compressed image is checked once decompressed, and may take up to
+	 * the image limit of the handle then.
+	 */
+	src.comp = aiopt_comp_detect(src.fd, src.image_sz);
+	if (src.comp == AIOPT_COMP_NONE) {
+		ret = aiopt_elf_check(src.fd, src.image_sz, &elf);
+		if (ret != AIOPT_SUCCESS) {
+			AIOPT_LIB_INFO("AIOP Image (%s) is not a valid AIOP "
+					"ELF.\n", ifile);
+			goto err_out;
+		}
+		print_elf_info(&elf);
+		src.image_bound = src.image_sz;
+	} else {
+		AIOPT_LIB_INFO("AIOP Image (%s) is %s compressed.\n", ifile,
+				aiopt_comp_str(src.comp));
+		src.image_bound = obj->limits.image_max;
+	}
+
+	if (afile) {
+		src.args_fd = get_aiop_args_fd(afile, obj->limits.args_max,
+					       &src.args_sz);
+		if (src.args_fd <= 0 ) { /* Including AIOPT_FAILURE */
+			AIOPT_DEBUG("Unable to open AIOP Arguments File.\n");
+			ret = AIOPT_FAILURE;
+			goto err_out;
+		}
+		AIOPT_LIB_INFO("AIOP Arguments file opened: (fd=%d).\n",
+				src.args_fd);
+	} else if (args && args_sz) {
+		if (args_sz > obj->limits.args_max) {
+			AIOPT_LIB_INFO("Incorrect args size. Give (%lu), Max "
+					"Allowed (%lu).\n", args_sz,
+					obj->limits.args_max);
+			ret = AIOPT_FAILURE;
+			goto err_out;
+		}
+		src.args = args;
+		src.args_sz = args_sz;
+	}
+
+	ret = read_image_crc(ifile, &crc_found, &crc);
+	if (ret != AIOPT_SUCCESS)
+		goto err_out;
+	src.expected_crc = crc_found ? &crc : NULL;
+
+	ret = load_from_src(obj, &src, reset, tpc, start_ns);
+
+err_out:
+	if (src.args_fd > 0)
+		close(src.args_fd);
+	if (src.fd > 0)
+		close(src.fd);
+	return ret;
+}
+
+/*
+ * @brief
+ * Whether the buffer of an earlier load which did not complete (e.g. timed
+ * out) is free again: once the tile has left LOAD_ONGOING, in which MC reads
+ * the image, and BOOT_ONGOING, in which the tile reads the arguments. A
+ * reset also leaves both.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [out] cur_state State read from the tile, if any; can be NULL
+ * @return TRUE if no load is pending, else FALSE
+ */
+static int
+load_settled(aiopt_obj_t *obj, int *cur_state)
+{
+	unsigned int state;
+
+	if (!obj->load_pending)
+		return TRUE;
+
+	if (read_tile_state(obj, &state) != AIOPT_SUCCESS)
+		return FALSE;
+	if (cur_state)
+		*cur_state = state;
+	if (state == DPAIOP_STATE_LOAD_ONGIONG ||
+	    state == DPAIOP_STATE_BOOT_ONGOING)
+		return FALSE;
+
+	AIOPT_DEBUG("Earlier load settled in %s.\n", aiopt_get_state_str(state));
+	obj->load_pending = FALSE;
+	return TRUE;
+}
+
+/*
+ * @brief
+ * Prepare the handle for a new load. The buffer of an earlier load which
+ * did not complete is only reused or released once the tile is done with
+ * it; if it is not, and the load is with reset, the tile is reset first.
+ *
+ * @param [in] obj Pointer to valid aiopt_obj_t object
+ * @param [in,out] reset Reset flag of the load; cleared if the tile was
+ *                 reset here
+ * @param [in] start_ns Time at which the load was called
+ * @return AIOPT_SUCCESS, or AIOPT_EBUSY if an earlier load is in progress
+ */
+static int
+load_begin(aiopt_obj_t *obj, short int *reset, uint64_t start_ns)
+{
+	int ret;
+
+	memset(&obj->load_report, 0, sizeof(obj->load_report));
+	obj->load_report.state = -1;
+
+	if (!load_settled(obj, &obj->load_report.state)) {
+		if (!*reset) {
+			AIOPT_LIB_INFO("An earlier load is still in progress;"
+					" load with reset.\n");
+			return AIOPT_EBUSY;
+		}
+
+		AIOPT_DEBUG("Resetting the tile out of an earlier load.\n");
+		ret = aiopt_reset(obj);
+		if (ret == AIOPT_SUCCESS)
+			ret = aiopt_wait_state(obj, DPAIOP_STATE_RESET_DONE,
+					       load_time_left(obj, start_ns),
+					       &obj->load_report.state);
+		if (ret != AIOPT_SUCCESS) {
+			AIOPT_DEBUG("AIOP Tile did not complete reset.\n");
+			return AIOPT_EBUSY;
+		}
+		obj->load_report.reset_ns = aiopt_now_ns() - start_ns;
+		obj->load_pending = FALSE;
+		*reset = FALSE;
+	}
+
+	/* A new load supersedes one which did not complete */
+	release_held_bufs(obj);
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * AIOPT load call for loading an AIOP Image on a dpaiop object belonging to
+ * provided (or default) container
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] ifile AIOP Image file name, with path
+ * @param [in] afile AIOP Commandline arguments file name, with path
+ * @param [in] reset Flag to state if reset is to be done before load operation
+ * @param [in] tpc for threads per AIOP core
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBUSY or
+ *         AIOPT_FAILURE
+ */
+int
+aiopt_load(aiopt_handle_t handle, const char *ifile,
+	   const char *afile, short int reset,
+	   unsigned short int tpc)
+{
+	int ret;
+	uint64_t start_ns = aiopt_now_ns();
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+
+	ret = load_begin(obj, &reset, start_ns);
+	if (ret == AIOPT_SUCCESS)
+		ret = load_image_file(obj, ifile, afile, NULL, 0, reset, tpc,
+				      start_ns);
+	obj->load_report.total_ns = aiopt_now_ns() - start_ns;
+
+	return ret;
+}
+
+/*
+ * @brief
+ * AIOPT load call taking the arguments from memory instead of a file
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] ifile AIOP Image file name, with path
+ * @param [in] args Arguments; NULL for none
+ * @param [in] args_sz Size of args
+ * @param [in] reset Flag to state if reset is to be done before load operation
+ * @param [in] tpc for threads per AIOP core
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBUSY or
+ *         AIOPT_FAILURE
+ */
+int
+aiopt_load_args_mem(aiopt_handle_t handle, const char *ifile,
+		    const void *args, size_t args_sz, short int reset,
+		    unsigned short int tpc)
+{
+	int ret;
+	uint64_t start_ns = aiopt_now_ns();
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+
+	ret = load_begin(obj, &reset, start_ns);
+	if (ret == AIOPT_SUCCESS)
+		ret = load_image_file(obj, ifile, NULL, args, args_sz, reset,
+				      tpc, start_ns);
+	obj->load_report.total_ns = aiopt_now_ns() - start_ns;
+
+	return ret;
+}
+
+/*
+ * @brief
+ * AIOPT load call for an image and arguments held in memory by the caller
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] image AIOP Image
+ * @param [in] image_sz Size of image
+ * @param [in] args Arguments; NULL for none
+ * @param [in] args_sz Size of args
+ * @param [in] reset Flag to state if reset is to be done before load operation
+ * @param [in] tpc for threads per AIOP core
+ *
+ * @return AIOPT_SUCCESS once RUNNING, AIOPT_ETIMEDOUT, AIOPT_EBADIMAGE,
+ *         AIOPT_EBUSY or AIOPT_FAILURE
+ */
+int
+aiopt_load_mem(aiopt_handle_t handle, const void *image, size_t image_sz,
+	       const void *args, size_t args_sz, short int reset,
+	       unsigned short int tpc)
+{
+	int ret;
+	uint64_t start_ns = aiopt_now_ns();
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+	aiopt_elf_info_t elf;
+	struct load_src src;
+
+	if (!obj || !image) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
 	}
 
-	print_aiopt_obj(obj);
+	ret = load_begin(obj, &reset, start_ns);
+	if (ret != AIOPT_SUCCESS)
+		goto out;
 
-	ret = setup_mc_portal(obj);
-	if (ret != AIOPT_SUCCESS) {
-		AIOPT_DEBUG("Unable to open MC Portal.\n");
-		goto err_cleanup;
+	if (!image_sz || image_sz > obj->limits.image_max ||
+	    (args && args_sz > obj->limits.args_max)) {
+		AIOPT_LIB_INFO("Incorrect image or args size. Give (%lu, %lu), "
+				"Max Allowed (%lu, %lu).\n", image_sz,
+				args ? args_sz : 0, obj->limits.image_max,
+				obj->limits.args_max);
+		ret = AIOPT_FAILURE;
+		goto out;
 	}
 
-	ret = init_aiop(obj);
+	/* Compressed images are only taken from files */
+	ret = aiopt_elf_check_buf(image, image_sz, &elf);
 	if (ret != AIOPT_SUCCESS) {
-		AIOPT_DEBUG("Unable to initialize the AIOP device.\n");
-		goto err_cleanup;
+		AIOPT_LIB_INFO("AIOP Image in memory is not a valid AIOP "
+				"ELF.\n");
+		goto out;
+	}
+	print_elf_info(&elf);
+
+	memset(&src, 0, sizeof(src));
+	src.fd = -1;
+	src.image = image;
+	src.image_sz = image_sz;
+	src.image_bound = image_sz;
+	src.args_fd = -1;
+	if (args) {
+		src.args = args;
+		src.args_sz = args_sz;
 	}
 
-	return AIOPT_SUCCESS;
-
-err_cleanup:
-	cleanup_aiopt_obj(obj);
-	return AIOPT_FAILURE;
+	ret = load_from_src(obj, &src, reset, tpc, start_ns);
 
+out:
+	obj->load_report.total_ns = aiopt_now_ns() - start_ns;
+	return ret;
 }
 
 /*
  * @brief
- * For a given AIOP Image file, verify existence, type and return FD after
- * opening it.
+ * Set the limit for aiopt_load to take the tile to RUNNING
  *
- * @param [in] ifile AIOP ELF File name with path
- * @param [out] file_sz size of ELF file, if valid
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] timeout_ms Limit in milliseconds, or AIOPT_WAIT_FOREVER
  *
- * @return Value greater than 0 if file opened successfully or AIOPT_FAILURE
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
-static int
-get_aiop_image_fd(const char *ifile, size_t *file_sz)
+int
+aiopt_set_load_timeout(aiopt_handle_t handle, unsigned int timeout_ms)
 {
-	int fd = -1;
-	size_t filesize = 0;
-	struct stat im_stat;
-
-	AIOPT_DEV("Entering.\n");
-	memset(&im_stat, 0, sizeof(im_stat));
-	*file_sz = 0;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	/* Checking Validity of the file */
-	if (!ifile || (stat(ifile, &im_stat) != 0)) {
-		AIOPT_DEBUG("Unable to stat the file (%s).\n", ifile);
+	if (!obj) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
 
-	/* get the file size */
-	filesize = im_stat.st_size;
-	if (filesize <= 0 || filesize > MAX_AIOP_IMAGE_FILE_SZ) {
-		AIOPT_DEBUG("Incorrect file size. Give (%lu), Max Allowed (%d)"
-				".\n", filesize, MAX_AIOP_IMAGE_FILE_SZ);
-		return AIOPT_FAILURE;
-	}
+	obj->load_timeout_ms = timeout_ms;
 
-	/* Opening the file */
-	fd = open(ifile, O_RDONLY);
-	if (fd < 0) {
-		AIOPT_DEBUG("Failed to open Image file (%s).\n", ifile);
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Make aiopt_load skip an image which is already RUNNING
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] skip TRUE to skip, FALSE to always load
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_set_load_skip(aiopt_handle_t handle, short int skip)
+{
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+
+	if (!obj) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
 
-	*file_sz = filesize;
-
-	AIOPT_DEBUG("AIOP Image File opened Successfully (fd=%d).\n", fd);
-	AIOPT_DEV("Exiting.\n");
+	obj->load_skip = skip ? TRUE : FALSE;
 
-	return fd;
+	return AIOPT_SUCCESS;
 }
 
 /*
  * @brief
- * For a given AIOP Args file, verify existence, type and return FD after
- * opening it.
+ * Set the IOVA window for the DMA mappings of the handle
  *
- * @param [in]  afile AIOP args file name with path
- * @param [out] file_sz size of ELF file, if valid
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] base Start of the window
+ * @param [in] size Length of the window
  *
- * @return Value greater than 0 if file opened successfully or AIOPT_FAILURE
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
-static int
-get_aiop_args_fd(const char *afile, size_t *file_sz)
+int
+aiopt_set_iova_window(aiopt_handle_t handle, uint64_t base, uint64_t size)
 {
-	int fd = -1;
-	size_t filesize = 0;
-	struct stat im_stat;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	AIOPT_DEV("Entering.\n");
-	memset(&im_stat, 0, sizeof(im_stat));
-	*file_sz = 0;
+	if (!obj) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
+	}
 
-	/* Checking Validity of the file */
-	if (!afile || (stat(afile, &im_stat) != 0)) {
-		AIOPT_DEBUG("Unable to stat the file (%s).\n", afile);
+	/* Simulator uses virtual addresses as IOVA */
+	if (obj->sim)
+		return AIOPT_SUCCESS;
+
+	if (fsl_vfio_set_iova_window(obj->vfio_handle, base, size) !=
+	    VFIO_SUCCESS) {
+		AIOPT_DEBUG("Unable to set IOVA window 0x%lx+0x%lx.\n",
+				base, size);
 		return AIOPT_FAILURE;
 	}
+	AIOPT_DEBUG("IOVA window: 0x%lx+0x%lx.\n", base, size);
 
-	/* get the file size */
-	filesize = im_stat.st_size;
-	if (filesize <= 0 || filesize > MAX_AIOP_ARGS_FILE_SZ) {
-		AIOPT_DEBUG("Incorrect file size. Give (%lu), Max Allowed (%d)"
-				".\n", filesize, MAX_AIOP_ARGS_FILE_SZ);
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Set the largest image and arguments aiopt_load accepts on the handle
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] image_max Bytes; 0 for MAX_AIOP_IMAGE_FILE_SZ
+ * @param [in] args_max Bytes; 0 for MAX_AIOP_ARGS_FILE_SZ
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_set_load_limits(aiopt_handle_t handle, size_t image_max,
+		      size_t args_max)
+{
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+
+	if (!obj) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
 
-	/* Opening the file */
-	fd = open(afile, O_RDONLY);
-	if (fd < 0) {
-		AIOPT_DEBUG("Failed to open AIOP arguments file (%s).\n", afile);
+	if (!image_max)
+		image_max = MAX_AIOP_IMAGE_FILE_SZ;
+	if (!args_max)
+		args_max = MAX_AIOP_ARGS_FILE_SZ;
+
+	/* Sizes are passed to MC in 32 bit fields */
+	if (image_max > AIOPT_MC_MAX_LOAD_SZ ||
+	    args_max > AIOPT_MC_MAX_LOAD_SZ) {
+		AIOPT_LIB_INFO("Load limits (image %lu, args %lu bytes) beyond "
+				"what MC accepts (%lu bytes).\n", image_max,
+				args_max, AIOPT_MC_MAX_LOAD_SZ);
 		return AIOPT_FAILURE;
 	}
 
-	*file_sz = filesize;
+	obj->limits.image_max = image_max;
+	obj->limits.args_max = args_max;
+	AIOPT_DEBUG("Load limits: image %lu, args %lu bytes.\n",
+			image_max, args_max);
 
-	AIOPT_DEBUG("AIOP Args File opened Successfully (fd=%d).\n", fd);
-	AIOPT_DEV("Exiting.\n");
+	/* Grow the arena, if any, to hold what is now allowed */
+	if (obj->arena.addr && dma_arena_fit_sz(obj) > obj->arena.size &&
+	    aiopt_dma_arena_setup(handle, 0) != AIOPT_SUCCESS)
+		AIOPT_DEBUG("DMA arena not grown; mapping per load.\n");
 
-	return fd;
+	return AIOPT_SUCCESS;
 }
+
 /*
  * @brief
- * Internal operation interfacing with flib/mc APIs for dpaiop_load/dpaiop_run
- * This operation should _not_ be called directly - it is wrapped around by
- * aiopt_load()
+ * Obtain the load limits of the handle
  *
- * @param [in] obj Pointer to valid aiopt_obj_t object
- * @param [in] addr dma-mapped address on which dpaiop_load is to be issued
- * @param [in] filesize Size of data in addr
- * @param [in] reset flag to state if dpaiop_reset() has to be called before
- *             dpaiop_load is called
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] limits Limits in force
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE if loading fails.
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
-static int
-perform_dpaiop_load(aiopt_obj_t *obj, void *addr, size_t filesize,
-			void *args_addr, size_t args_filesize,
-			short int reset, unsigned short int tpc)
+int
+aiopt_get_load_limits(aiopt_handle_t handle, aiopt_load_limits_t *limits)
 {
-	int ret, result;
-	unsigned short int *dpaiop_token;
-
-	struct fsl_mc_io *dpaiop;
-	struct dpaiop_load_cfg load_cfg = {0};
-	struct dpaiop_run_cfg run_cfg = {0};
-
-	AIOPT_DEV("Entering.\n");
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	/* We have the device in dev, extracting mc_portal from it */
-	dpaiop = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
-	if (!dpaiop) {
-		AIOPT_DEBUG("Unable to allocate internal memory.\n");
+	if (!obj || !limits) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
 
-	dpaiop->regs = obj->mcp_addr;
-	dpaiop_token = aiopt_get_aiop_token_byref(obj);
+	*limits = obj->limits;
 
-	/* Opening the AIOP device */
-	ret = dpaiop_open(dpaiop, CMD_PRI_LOW, aiopt_get_aiop_id(obj),
-				dpaiop_token);
-	if (ret != 0) {
-		AIOPT_DEBUG("Unable to open dpaiop (MC API err=%d).\n", ret);
-		free(dpaiop);
-		return AIOPT_FAILURE;
-	}
-	AIOPT_DEBUG("Opened AIOP device. (Token=%d)\n", *dpaiop_token);
+	return AIOPT_SUCCESS;
+}
 
-	/* Now that the device dpaiop is open, load the image on it */
-	load_cfg.img_iova = (uint64_t)addr;
-	load_cfg.img_size = filesize;
-	load_cfg.options = 0;
-	load_cfg.tpc = tpc;
+/*
+ * @brief
+ * Obtain the timeline of the last aiopt_load on the handle
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] report Timeline and final tile state
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_get_load_report(aiopt_handle_t handle, aiopt_load_report_t *report)
+{
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	if (reset) {
-		/* Performing Reset before load */
-		AIOPT_DEV("Calling dpaiop_reset before dpaiop_load.\n");
-		/* TODO Warning to users that dpaiop_run is only for rev2 */
-		ret = dpaiop_reset(dpaiop, 0, *dpaiop_token);
-		if (ret) {
-			AIOPT_DEBUG("Unable to perform reset of AIOP tile."
-				"(err=%d).\n", ret);
-			/* Error is ignored */
-			AIOPT_LIB_INFO("AIOP Reset may not be supported on some"
-					" hardware. Please check.\n");
-			/* cleanup and return AIOPT_FAILURE */
-		} else {
-			AIOPT_LIB_INFO("AIOP Tile Reset done. (err=%d)\n", ret);
-		}
+	if (!obj || !report) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
 	}
-	AIOPT_DEBUG("dpaiop_load call: iova=%p, size=%u\n",
-			(void *)load_cfg.img_iova, load_cfg.img_size);
 
-	/* MC API for performing AIOP Load */
-	ret = dpaiop_load(dpaiop, 0, *dpaiop_token, &load_cfg);
-	if (ret) {
-		/* dpaiop load failed */
-		AIOPT_DEBUG("MC API dpaiop_load failed. (err=%d)\n", ret);
-	} else {
-		AIOPT_LIB_INFO("MC API dpaiop_load successful. (err=%d)\n",
-				ret);
+	*report = obj->load_report;
 
-		/* Preparing arguments for run */
-		run_cfg.cores_mask = AIOPT_RUN_CORES_ALL;
-		run_cfg.options = 0;
-		run_cfg.args_iova = (uint64_t)args_addr;
-		run_cfg.args_size = args_filesize;
-	
-		/* Calling dpaiop_run */
-		ret = dpaiop_run(dpaiop, 0, *dpaiop_token, &run_cfg);
-		if (ret != 0) {
-			AIOPT_DEBUG("MC API dpaiop_run failed. (err=%d)\n",
-					ret);
-		} else {
-			AIOPT_LIB_INFO("MC API dpaiop_run result: (%d).\n",
-					ret);
-		}
-		/* Irrespective of error or success, we have to cleanup */
-	}
+	return AIOPT_SUCCESS;
+}
 
-	/* Closing the dpaiop_device, after releasing memory allocated for
-	 * elf
-	 */
-	result = dpaiop_close(dpaiop, 0, *dpaiop_token);
-	AIOPT_DEBUG("MC API dpaiop_close performed. (err=%d)\n", result);
-	if (result != 0) {
-		AIOPT_DEBUG("MC API dpaiop_close unsuccessful. (err=%d)\n",
-				result);
-	}
-	/* Even if result from dpaiop_close was error, still returning positive
-	 * to caller.
-	 */
+/*
+ * @brief
+ * Print a load timeline; phases not reached are printed as '-'
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] report Timeline to print
+ *
+ * @return void
+ */
+void
+aiopt_dump_load_report(FILE *fp, const aiopt_load_report_t *report)
+{
+	int i;
+	const struct {
+		const char *name;
+		uint64_t ns;
+	} phases[] = {
+		{"prepared", report->prepared_ns},
+		{"reset", report->reset_ns},
+		{"loaded", report->loaded_ns},
+		{"booting", report->booting_ns},
+		{"running", report->running_ns},
+		{"total", report->total_ns}
+	};
+
+	fprintf(fp, "AIOP Tile State: %s\n", aiopt_get_state_str(report->state));
+	if (report->skipped)
+		fprintf(fp, "\t Load skipped: same image already running\n");
+	fprintf(fp, "\t Timeline (ms):-");
+	for (i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+		fprintf(fp, "%s %s: ", i ? "," : "", phases[i].name);
+		if (phases[i].ns)
+			fprintf(fp, "%.1f", phases[i].ns / 1000000.0);
+		else
+			fprintf(fp, "-");
+	}
+	fprintf(fp, "\n");
+}
 
-	/* Releasing memory for dpaiop object */
-	if (dpaiop)
-		free(dpaiop);
+/*
+ * @brief
+ * Obtain the time taken by the phases of aiopt_init for the handle
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [out] report Phases of aiopt_init
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_get_init_report(aiopt_handle_t handle, aiopt_init_report_t *report)
+{
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	/* Following doesn't return FAILURE if close failed. */
-	if (ret != 0)
+	if (!obj || !report) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
+	}
+
+	*report = obj->init_report;
 
 	return AIOPT_SUCCESS;
 }
 
-/* ==========================================================================
- * Externally available API definitions
- * ==========================================================================*/
-
 /*
  * @brief
- * Convert MC State to String
+ * Print the phases of aiopt_init; phases not gone through (as with the MC
+ * simulator) are printed as '-'
  *
- * @param [in] state State as returned by dpaiop_get_state
- * @return const string explaining state
+ * @param [in] fp Stream to write to
+ * @param [in] report Phases to print
+ *
+ * @return void
  */
-const char *
-aiopt_get_state_str(int state)
+void
+aiopt_dump_init_report(FILE *fp, const aiopt_init_report_t *report)
 {
-	char *p = NULL;
-
-	switch (state) {
-	case DPAIOP_STATE_RESET_DONE:
-		p = "DPAIOP_STATE_RESET_DONE";
-		break;
-	case DPAIOP_STATE_RESET_ONGOING:
-		p = "DPAIOP_STATE_RESET_ONGOING";
-		break;
-	case DPAIOP_STATE_LOAD_DONE:
-		p = "DPAIOP_STATE_LOAD_DONE";
-		break;
-	case DPAIOP_STATE_LOAD_ONGIONG:
-		p = "DPAIOP_STATE_LOAD_ONGIONG";
-		break;
-	case DPAIOP_STATE_LOAD_ERROR:
-		p = "DPAIOP_STATE_LOAD_ERROR";
-		break;
-	case DPAIOP_STATE_BOOT_ONGOING:
-		p = "DPAIOP_STATE_BOOT_ONGOING";
-		break;
-	case DPAIOP_STATE_BOOT_ERROR:
-		p = "DPAIOP_STATE_BOOT_ERROR";
-		break;
-	case DPAIOP_STATE_RUNNING:
-		p = "DPAIOP_STATE_RUNNING";
+	int i;
+	const char *src;
+	const struct {
+		const char *name;
+		uint64_t ns;
+	} phases[] = {
+		{"topology", report->topology_ns},
+		{"vfio", report->vfio_ns},
+		{"devices", report->devices_ns},
+		{"portals", report->portals_ns},
+		{"sessions", report->sessions_ns},
+		{"irq", report->irq_ns},
+		{"total", report->total_ns}
+	};
+
+	switch (report->topo_src) {
+	case AIOPT_TOPO_MEMORY:
+		src = "in-memory record";
 		break;
-	default:
-		p = "Invalid MC State";
+	case AIOPT_TOPO_DISK:
+		src = "on-disk record";
 		break;
+	default:
+		src = "sysfs";
 	}
 
-	return (const char *)p;
+	fprintf(fp, "Initialization (ms):-");
+	for (i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+		fprintf(fp, "%s %s: ", i ? "," : "", phases[i].name);
+		if (phases[i].ns)
+			fprintf(fp, "%.3f", phases[i].ns / 1000000.0);
+		else
+			fprintf(fp, "-");
+	}
+	fprintf(fp, "\n");
+	if (report->vfio_ns)
+		fprintf(fp, "\t Topology from %s\n", src);
 }
 
+
 /*
  * @brief
- * AIOPT Get Time of Day
- *
- * @param [in] handle aiopt_handle_t type valid object
- * @param [out] tod Time of day as a unsigned long value
+ * Convert an MC command ID to a printable name
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ * @param [in] cmd_id Command ID as found in the MC command header
+ * @return const string naming the command
  */
-int
-aiopt_gettod(aiopt_handle_t handle, uint64_t *tod)
+const char *
+aiopt_mc_cmd_str(uint16_t cmd_id)
 {
-	int ret, result;
-	aiopt_obj_t *obj = NULL;
-	unsigned short int *dpaiop_token;
-
-	struct fsl_mc_io *dpaiop = NULL;
-
-	AIOPT_DEV("Entering.\n");
-
-	if (!tod) {
-		AIOPT_DEV("Incorrect API Usage. (arg==NULL).\n");
-		return AIOPT_FAILURE;
+	switch (cmd_id) {
+	case DPAIOP_CMDID_CLOSE:
+		return "DPAIOP_CLOSE";
+	case DPAIOP_CMDID_OPEN:
+		return "DPAIOP_OPEN";
+	case DPAIOP_CMDID_GET_API_VERSION:
+		return "DPAIOP_GET_API_VERSION";
+	case DPAIOP_CMDID_GET_ATTR:
+		return "DPAIOP_GET_ATTR";
+	case DPAIOP_CMDID_RESET:
+		return "DPAIOP_RESET";
+	case DPAIOP_CMDID_SET_IRQ_ENABLE:
+		return "DPAIOP_SET_IRQ_ENABLE";
+	case DPAIOP_CMDID_GET_IRQ_ENABLE:
+		return "DPAIOP_GET_IRQ_ENABLE";
+	case DPAIOP_CMDID_SET_IRQ_MASK:
+		return "DPAIOP_SET_IRQ_MASK";
+	case DPAIOP_CMDID_GET_IRQ_MASK:
+		return "DPAIOP_GET_IRQ_MASK";
+	case DPAIOP_CMDID_GET_IRQ_STATUS:
+		return "DPAIOP_GET_IRQ_STATUS";
+	case DPAIOP_CMDID_CLEAR_IRQ_STATUS:
+		return "DPAIOP_CLEAR_IRQ_STATUS";
+	case DPAIOP_CMDID_LOAD:
+		return "DPAIOP_LOAD";
+	case DPAIOP_CMDID_RUN:
+		return "DPAIOP_RUN";
+	case DPAIOP_CMDID_GET_SL_VERSION:
+		return "DPAIOP_GET_SL_VERSION";
+	case DPAIOP_CMDID_GET_STATE:
+		return "DPAIOP_GET_STATE";
+	case DPAIOP_CMDID_SET_TIME_OF_DAY:
+		return "DPAIOP_SET_TIME_OF_DAY";
+	case DPAIOP_CMDID_GET_TIME_OF_DAY:
+		return "DPAIOP_GET_TIME_OF_DAY";
+	default:
+		break;
 	}
 
-	obj = (aiopt_obj_t *)handle;
+	return "UNKNOWN";
+}
 
-	/* We have the device in dev, extracting mc_portal from it */
-	dpaiop = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
-	if (!dpaiop) {
-		AIOPT_DEBUG("Unable to allocate internal memory.\n");
-		return AIOPT_FAILURE;
+/*
+ * @brief
+ * Convert an MC command completion status (or MC_STATS_TIMEOUT) to String
+ *
+ * @param [in] status enum mc_cmd_status value or MC_STATS_TIMEOUT
+ * @return const string naming the status
+ */
+const char *
+aiopt_mc_status_str(unsigned int status)
+{
+	switch (status) {
+	case MC_CMD_STATUS_OK:
+		return "OK";
+	case MC_CMD_STATUS_AUTH_ERR:
+		return "AUTH_ERR";
+	case MC_CMD_STATUS_NO_PRIVILEGE:
+		return "NO_PRIVILEGE";
+	case MC_CMD_STATUS_DMA_ERR:
+		return "DMA_ERR";
+	case MC_CMD_STATUS_CONFIG_ERR:
+		return "CONFIG_ERR";
+	case MC_CMD_STATUS_TIMEOUT:
+		return "TIMEOUT";
+	case MC_CMD_STATUS_NO_RESOURCE:
+		return "NO_RESOURCE";
+	case MC_CMD_STATUS_NO_MEMORY:
+		return "NO_MEMORY";
+	case MC_CMD_STATUS_BUSY:
+		return "BUSY";
+	case MC_CMD_STATUS_UNSUPPORTED_OP:
+		return "UNSUPPORTED_OP";
+	case MC_CMD_STATUS_INVALID_STATE:
+		return "INVALID_STATE";
+	case MC_STATS_TIMEOUT:
+		return "WAIT_TIMEOUT";
+	default:
+		break;
 	}
 
-	dpaiop->regs = obj->mcp_addr;
-	dpaiop_token = aiopt_get_aiop_token_byref(obj);
+	return "UNKNOWN";
+}
 
-	ret = dpaiop_open(dpaiop, CMD_PRI_LOW, aiopt_get_aiop_id(obj),
-				dpaiop_token);
-	if (ret != 0) {
-		AIOPT_DEBUG("Unable to open dpaiop (MC API err=%d).\n", ret);
-		free(dpaiop);
-		return AIOPT_FAILURE;
+/*
+ * @brief
+ * Dump statistics of a single MC command ID as a JSON object
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] s Statistics slot
+ * @return void
+ */
+static void
+dump_mc_cmd_stats_json(FILE *fp, const struct mc_cmd_stats *s)
+{
+	uint64_t count, v;
+	unsigned int i, first = TRUE;
+
+	count = __atomic_load_n(&s->count, __ATOMIC_ACQUIRE);
+
+	fprintf(fp, "{\"cmd\":\"%s\",\"cmd_id\":%u,\"count\":%lu,",
+		aiopt_mc_cmd_str(mc_stats_cmd_id(s)), mc_stats_cmd_id(s),
+		count);
+	fprintf(fp, "\"min_ns\":%lu,\"max_ns\":%lu,\"total_ns\":%lu,"
+		"\"p50_ns\":%lu,\"p90_ns\":%lu,\"p99_ns\":%lu,",
+		__atomic_load_n(&s->min_ns, __ATOMIC_RELAXED),
+		__atomic_load_n(&s->max_ns, __ATOMIC_RELAXED),
+		__atomic_load_n(&s->total_ns, __ATOMIC_RELAXED),
+		mc_stats_percentile(s, 50), mc_stats_percentile(s, 90),
+		mc_stats_percentile(s, 99));
+
+	fprintf(fp, "\"status\":{");
+	for (i = 0; i < MC_STATS_NUM_STATUS; i++) {
+		v = __atomic_load_n(&s->status[i], __ATOMIC_RELAXED);
+		if (!v)
+			continue;
+		fprintf(fp, "%s\"%s\":%lu", first ? "" : ",",
+			aiopt_mc_status_str(i), v);
+		first = FALSE;
 	}
-	AIOPT_DEBUG("Opened AIOP device. (Token=%d)\n", *dpaiop_token);
 
-	ret = dpaiop_get_time_of_day(dpaiop, 0, *dpaiop_token, tod);
-	if (ret) {
-		AIOPT_DEBUG("Unable to fetch Time of Day. "
-				"(err=%d)\n", ret);
-	} else {
-		AIOPT_LIB_INFO("Time of day from MC API:- (%lu)\n", *tod);
+	/* Only populated buckets, as [upper bound ns, count] pairs */
+	fprintf(fp, "},\"histogram\":[");
+	first = TRUE;
+	for (i = 0; i < MC_STATS_HIST_BUCKETS; i++) {
+		v = __atomic_load_n(&s->hist[i], __ATOMIC_RELAXED);
+		if (!v)
+			continue;
+		fprintf(fp, "%s[%lu,%lu]", first ? "" : ",",
+			mc_stats_bucket_upper(i), v);
+		first = FALSE;
 	}
+	fprintf(fp, "]}");
+}
 
-	/* Closing the dpaiop_device */
-	result = dpaiop_close(dpaiop, 0, *dpaiop_token);
-	AIOPT_DEBUG("MC API dpaiop_close performed. (err=%d)\n", ret);
-	if (ret != 0) {
-		AIOPT_DEBUG("MC API dpaiop_close unsuccessful. (err=%d)\n",
-				ret);
-		/* In case of failure to close, error is returned, else error
-		 * as reported by previous calls is returned.
-		 */
-		ret = result;
+/*
+ * @brief
+ * Dump statistics of a single MC command ID as text
+ *
+ * @param [in] fp Stream to write to
+ * @param [in] s Statistics slot
+ * @return void
+ */
+static void
+dump_mc_cmd_stats_text(FILE *fp, const struct mc_cmd_stats *s)
+{
+	uint64_t count, errors, v;
+	unsigned int i;
+
+	count = __atomic_load_n(&s->count, __ATOMIC_ACQUIRE);
+	if (!count)
+		return;
+
+	errors = count - __atomic_load_n(&s->status[MC_CMD_STATUS_OK],
+					 __ATOMIC_RELAXED);
+
+	fprintf(fp, "%-24s 0x%04x %8lu %6lu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+		aiopt_mc_cmd_str(mc_stats_cmd_id(s)), mc_stats_cmd_id(s),
+		count, errors,
+		__atomic_load_n(&s->min_ns, __ATOMIC_RELAXED) / 1000.0,
+		__atomic_load_n(&s->total_ns, __ATOMIC_RELAXED) / 1000.0 /
+			count,
+		mc_stats_percentile(s, 50) / 1000.0,
+		mc_stats_percentile(s, 99) / 1000.0,
+		__atomic_load_n(&s->max_ns, __ATOMIC_RELAXED) / 1000.0);
+
+	if (!errors)
+		return;
+
+	for (i = 0; i < MC_STATS_NUM_STATUS; i++) {
+		if (i == MC_CMD_STATUS_OK)
+			continue;
+		v = __atomic_load_n(&s->status[i], __ATOMIC_RELAXED);
+		if (v)
+			fprintf(fp, "%-24s   %s: %lu\n", "", aiopt_mc_status_str(i), v);
 	}
-
-	/* Releasing memory for dpaiop object */
-	if (dpaiop)
-		free(dpaiop);
-
-	if (ret != 0)
-		return AIOPT_FAILURE;
-
-	return AIOPT_SUCCESS;
-
-	
 }
 
 /*
  * @brief
- * AIOPT Set Time of Day
+ * Dump the per-command-ID MC statistics (counts, completion status and
+ * latency histogram) gathered by all portals of this process
  *
- * @param [in] handle aiopt_handle_t type valid object
- * @param [in] tod Time of day to set as an unsigned long value
+ * @param [in] fp Stream to write to
+ * @param [in] json TRUE for a JSON document, FALSE for a text table
  *
  * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
 int
-aiopt_settod(aiopt_handle_t handle, uint64_t tod)
+aiopt_mc_stats_dump(FILE *fp, short int json)
 {
-	int ret, result;
-	aiopt_obj_t *obj = NULL;
-	unsigned short int *dpaiop_token;
-
-	struct fsl_mc_io *dpaiop = NULL;
-
-	AIOPT_DEV("Entering.\n");
-
-	obj = (aiopt_obj_t *)handle;
+	const struct mc_cmd_stats *s;
+	unsigned int i, first = TRUE;
 
-	/* We have the device in dev, extracting mc_portal from it */
-	dpaiop = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
-	if (!dpaiop) {
-		AIOPT_DEBUG("Unable to allocate internal memory.\n");
+	if (!fp) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
 
-	dpaiop->regs = obj->mcp_addr;
-	dpaiop_token = aiopt_get_aiop_token_byref(obj);
-
-	ret = dpaiop_open(dpaiop, CMD_PRI_LOW, aiopt_get_aiop_id(obj),
-				dpaiop_token);
-	if (ret != 0) {
-		AIOPT_DEBUG("Unable to open dpaiop (MC API err=%d).\n", ret);
-		free(dpaiop);
-		return AIOPT_FAILURE;
-	}
-	AIOPT_LIB_INFO("Opened AIOP device. (Token=%d)\n", *dpaiop_token);
-	AIOPT_DEV("Attempting to set Time of day to %lu.\n", tod);
+	if (json)
+		fprintf(fp, "{\"commands\":[");
+	else
+		fprintf(fp, "%-24s %6s %8s %6s %9s %9s %9s %9s %9s\n",
+			"Command", "ID", "Count", "Errors", "Min(us)",
+			"Avg(us)", "P50(us)", "P99(us)", "Max(us)");
 
-	ret = dpaiop_set_time_of_day(dpaiop, 0, *dpaiop_token, tod);
-	if (ret) {
-		AIOPT_DEBUG("Unable to set Time of Day. "
-				"(err=%d)\n", ret);
-	} else {
-		AIOPT_LIB_INFO("Setting time of day successful.\n");
-	}
+	for (i = 0; i < MC_STATS_MAX_CMDS; i++) {
+		s = mc_stats_get(i);
+		if (!s)
+			continue;
 
-	/* Closing the dpaiop_device */
-	result = dpaiop_close(dpaiop, 0, *dpaiop_token);
-	AIOPT_DEV("MC API dpaiop_close performed. (err=%d)\n", ret);
-	if (ret != 0) {
-		AIOPT_DEBUG("MC API dpaiop_close unsuccessful. (err=%d)\n",
-				ret);
-		/* In case of failure to close, error is returned, else error
-		 * as reported by previous calls is returned.
-		 */
-		ret = result;
+		if (json) {
+			fprintf(fp, "%s", first ? "" : ",");
+			dump_mc_cmd_stats_json(fp, s);
+		} else {
+			dump_mc_cmd_stats_text(fp, s);
+		}
+		first = FALSE;
 	}
 
-	/* Releasing memory for dpaiop object */
-	if (dpaiop)
-		free(dpaiop);
+	if (json)
+		fprintf(fp, "]}\n");
 
-	if (ret != 0)
-		return AIOPT_FAILURE;
+	fflush(fp);
 
 	return AIOPT_SUCCESS;
-
-	
 }
 
 /*
  * @brief
- * AIOPT Status call. Returns information about State of AIOP Tile, Version
- * information and Service Layer Version information
+ * Set up the DMA arena of the handle, used by aiopt_load
  *
  * @param [in] handle aiopt_handle_t type valid object
- * @param [out] s aiopt_status_t instance object which would be filled in
+ * @param [in] size Bytes to reserve; 0 to fit the load limits
  *
- * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ * @return AIOPT_SUCCESS, AIOPT_EBUSY or AIOPT_FAILURE
  */
 int
-aiopt_status(aiopt_handle_t handle, aiopt_status_t *s)
+aiopt_dma_arena_setup(aiopt_handle_t handle, size_t size)
 {
-	int ret, result;
-	unsigned int tile_state;
-	aiopt_obj_t *obj = NULL;
-	unsigned short int *dpaiop_token;
-	struct dpaiop_sl_version dpaiop_slv = {0};
-
-	struct fsl_mc_io *dpaiop = NULL;
+	int ret;
+	void *addr = MAP_FAILED;
+	uint64_t iova;
+	size_t hp_sz, map_sz;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
+	aiopt_dma_arena_t *arena;
 
 	AIOPT_DEV("Entering.\n");
 
-	if (!s) {
-		AIOPT_DEBUG("Incorrect API Usage. (arg==NULL).\n");
-		return AIOPT_FAILURE;
-	}
-
-	obj = (aiopt_obj_t *)handle;
-
-	/* We have the device in dev, extracting mc_portal from it */
-	dpaiop = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
-	if (!dpaiop) {
-		AIOPT_DEBUG("Unable to allocate internal memory.\n");
+	if (!obj) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
 
-	dpaiop->regs = obj->mcp_addr;
-	dpaiop_token = aiopt_get_aiop_token_byref(obj);
-
-	ret = dpaiop_open(dpaiop, CMD_PRI_LOW, aiopt_get_aiop_id(obj),
-				dpaiop_token);
-	if (ret != 0) {
-		AIOPT_DEBUG("Unable to open dpaiop (MC API err=%d).\n", ret);
-		free(dpaiop);
-		return AIOPT_FAILURE;
+	arena = &obj->arena;
+	if (!size)
+		size = dma_arena_fit_sz(obj);
+
+	if (arena->addr) {
+		if (size <= arena->size)
+			return AIOPT_SUCCESS;
+		/* The buffer of a load in progress may be the arena */
+		if (!load_settled(obj, NULL)) {
+			AIOPT_DEBUG("DMA arena in use by an earlier load.\n");
+			return AIOPT_EBUSY;
+		}
+		/* Too small; replaced by a larger one */
+		release_dma_arena(obj);
 	}
-	AIOPT_LIB_INFO("Opened AIOP device. (Token=%d)\n", *dpaiop_token);
 
-	/* Getting the Service Layer Version information */
-	ret = dpaiop_get_sl_version(dpaiop, 0, *dpaiop_token, &dpaiop_slv);
-	if (ret) {
-		AIOPT_DEBUG("Unable to fetch Service Layer Version. "
-				"(err=%d)\n", ret);
-		goto close_aiop;
-	} else {
-		AIOPT_DEBUG("AIOP SL Attributes: major=%d, minor=%d, rev=%d\n",
-				dpaiop_slv.major, dpaiop_slv.minor,
-				dpaiop_slv.revision);
-		s->sl_major_v = dpaiop_slv.major;
-		s->sl_minor_v = dpaiop_slv.minor;
-		s->sl_revision = dpaiop_slv.revision; 
+	/* Small arenas (e.g. lowered limits) stay on normal pages */
+	hp_sz = get_default_hugepage_sz();
+	if (hp_sz && hp_sz <= AIOPT_MAX_HUGEPAGE_SZ &&
+	    size >= AIOPT_HUGEPAGE_MIN_SZ) {
+		map_sz = ((size + hp_sz - 1) / hp_sz) * hp_sz;
+		addr = mmap(NULL, map_sz, PROT_READ|PROT_WRITE,
+			    MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|MAP_POPULATE,
+			    -1, 0);
+		if (addr == MAP_FAILED) {
+			AIOPT_DEBUG("No huge pages for DMA arena (err=%d); "
+					"using normal pages.\n", errno);
+		} else {
+			arena->page_sz = hp_sz;
+		}
 	}
 
-	/* State of the AIOP Tile; Can be converted to string using the
-	 * aiopt_get_state_str
-	 */
-	ret = dpaiop_get_state(dpaiop, 0, *dpaiop_token, &tile_state);
-	if (ret) {
-		AIOPT_DEBUG("Unable to fetch AIOP Tile state. (err=%d).\n",
-				ret);
-		goto close_aiop;
-	} else {
-		AIOPT_DEBUG("Obtained tile_state = %d\n", tile_state);
-		s->state = tile_state;
+	if (addr == MAP_FAILED) {
+		map_sz = AIOPT_ALIGN_PAGE(size);
+		addr = mmap(NULL, map_sz, PROT_READ|PROT_WRITE,
+			    MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+		if (addr == MAP_FAILED) {
+			AIOPT_DEBUG("Unable to allocate DMA arena. (err=%d)\n",
+					errno);
+			return AIOPT_FAILURE;
+		}
+		arena->page_sz = AIOPT_ALIGNED_PAGE_SZ;
 	}
 
-	AIOPT_LIB_INFO("State and Status information successfully obtained.\n");
-
-close_aiop:
-	/* Closing the dpaiop_device */
-	result = dpaiop_close(dpaiop, 0, *dpaiop_token);
-	AIOPT_DEBUG("MC API dpaiop_close performed. (err=%d)\n", ret);
-	if (ret != 0) {
-		AIOPT_DEBUG("MC API dpaiop_close unsuccessful. (err=%d)\n",
-				ret);
-		/* In case of failure to close, error is returned, else error
-		 * as reported by previous calls is returned.
-		 */
-		ret = result;
+	/* IOVA aligned to the page size lets the SMMU use block mappings */
+	ret = aiopt_dma_map(obj, addr, map_sz, arena->page_sz, &iova);
+	if (ret != VFIO_SUCCESS) {
+		AIOPT_DEBUG("Unable to DMA map the arena. (err=%d)\n", ret);
+		munmap(addr, map_sz);
+		arena->page_sz = 0;
+		return AIOPT_FAILURE;
 	}
 
-	/* Releasing memory for dpaiop object */
-	if (dpaiop)
-		free(dpaiop);
+	arena->addr = addr;
+	arena->iova = iova;
+	arena->size = map_sz;
+	arena->hugepage = (arena->page_sz != AIOPT_ALIGNED_PAGE_SZ);
+	arena->loads = 0;
 
-	if (ret != 0)
-		return AIOPT_FAILURE;
+	AIOPT_LIB_INFO("DMA arena of %lu bytes set up at (%p, iova=0x%lx), "
+			"%s pages of %lu bytes.\n", map_sz, addr, iova,
+			arena->hugepage ? "huge" : "normal", arena->page_sz);
 
 	return AIOPT_SUCCESS;
 }
 
 /*
  * @brief
- * AIOPT Reset call for performing Reset of a AIOP Tile
- * XXX This is not supported on rev1 hardware
+ * Set the policy with which MC command completion is waited upon
  *
  * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] policy Wait policy; NULL restores the default
  *
  * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
 int
-aiopt_reset(aiopt_handle_t handle)
+aiopt_set_wait_policy(aiopt_handle_t handle,
+		      const struct mc_wait_policy *policy)
 {
-	int ret, result;
-	aiopt_obj_t *obj = NULL;
-	unsigned short int *dpaiop_token;
-
-	struct fsl_mc_io *dpaiop = NULL;
-
-	AIOPT_DEV("Entering.\n");
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	obj = (aiopt_obj_t *)handle;
-
-	/* We have the device in dev, extracting mc_portal from it */
-	dpaiop = (struct fsl_mc_io *)calloc(1, sizeof(struct fsl_mc_io));
-	if (!dpaiop) {
-		AIOPT_DEBUG("Unable to allocate internal memory.\n");
-		return AIOPT_FAILURE;
-	}
-
-	dpaiop->regs = obj->mcp_addr;
-	dpaiop_token = aiopt_get_aiop_token_byref(obj);
+	unsigned int i;
 
-	ret = dpaiop_open(dpaiop, CMD_PRI_LOW, aiopt_get_aiop_id(obj),
-				dpaiop_token);
-	if (ret != 0) {
-		AIOPT_DEBUG("Unable to open dpaiop (MC API err=%d).\n", ret);
-		free(dpaiop);
+	if (!obj || !obj->num_portals) {
+		AIOPT_DEV("Incorrect API usage.\n");
 		return AIOPT_FAILURE;
 	}
-	AIOPT_DEBUG("Opened AIOP device. (Token=%d)\n", *dpaiop_token);
 
-	ret = dpaiop_reset(dpaiop, 0, *dpaiop_token);
-	if (ret) {
-		AIOPT_DEBUG("Unable to reset the AIOP tile. (err=%d)\n", ret);
-	} else {
-		AIOPT_LIB_INFO("AIOP Tile Reset successful.\n");
-	}
-
-	/* Closing the dpaiop_device */
-	result = dpaiop_close(dpaiop, 0, *dpaiop_token);
-	AIOPT_DEBUG("MC API dpaiop_close performed. (err=%d)\n", ret);
-	if (result != 0) {
-		AIOPT_DEBUG("MC API dpaiop_close unsuccessful. (err=%d)\n",
-				result);
-	}
-
-	/* Releasing memory for dpaiop object */
-	if (dpaiop)
-		free(dpaiop);
-
-	/* Following doesn't return FAILURE if close fails */
-	if (ret != 0)
-		return AIOPT_FAILURE;
+	for (i = 0; i < obj->num_portals; i++)
+		obj->portals[i].mc_io->wait = policy;
 
 	return AIOPT_SUCCESS;
 }
 
 /*
  * @brief
- * AIOPT load call for loading an AIOP Image on a dpaiop object belonging to
- * provided (or default) container
+ * Set how MC commands issued on the handle are serialized
  *
  * @param [in] handle aiopt_handle_t type valid object
- * @param [in] ifile AIOP Image file name, with path
- * @param [in] afile AIOP Commandline arguments file name, with path
- * @param [in] reset Flag to state if reset is to be done before load operation
- * @param [in] tpc for threads per AIOP core
+ * @param [in] type MC_IO_LOCK_NONE, MC_IO_LOCK_SPIN or MC_IO_LOCK_MUTEX
  *
  * @return AIOPT_SUCCESS or AIOPT_FAILURE
  */
 int
-aiopt_load(aiopt_handle_t handle, const char *ifile,
-	   const char *afile, short int reset,
-	   unsigned short int tpc)
+aiopt_set_portal_lock(aiopt_handle_t handle, int type)
 {
-	int ret, fd;
-	size_t filesize = 0;
-	size_t aligned_size = 0;
-	void *addr = NULL;
-	aiopt_obj_t *obj = NULL;
-	int args_fd;
-	size_t args_filesize = 0;
-	size_t args_aligned_size = 0;
-	void *args_addr = NULL;
-
-	/* Get the FD of the AIOP Image file after opening it. Failure to open
-	 * is an error.
-	 */
-	fd = get_aiop_image_fd(ifile, &filesize);
-	if (fd <= 0 ) { /* Including AIOPT_FAILURE */
-		AIOPT_DEBUG("Unable to open AIOP Image File.\n");
-		ret = AIOPT_FAILURE;
-		goto err_out;
-	}
-	AIOPT_LIB_INFO("AIOP Image file opened: (fd=%d).\n", fd);
-
-	if (afile) {
-		args_fd = get_aiop_args_fd(afile, &args_filesize);
-		if (args_fd <= 0 ) { /* Including AIOPT_FAILURE */
-			AIOPT_DEBUG("Unable to open AIOP Arguments File.\n");
-			ret = AIOPT_FAILURE;
-			goto err_out;
-		}
-		AIOPT_LIB_INFO("AIOP Arguments file opened: (fd=%d).\n", args_fd);
-	}
-
-	/* Allocating memory in virtual space and dma-mapping it for loading
-	 * AIOP Image on it
-	 */
-	if (filesize % AIOPT_ALIGNED_PAGE_SZ)
-		aligned_size = ((filesize + AIOPT_ALIGNED_PAGE_SZ)/
-				AIOPT_ALIGNED_PAGE_SZ) * AIOPT_ALIGNED_PAGE_SZ;
-	else
-		aligned_size = filesize;
-
-	addr = mmap(NULL, aligned_size, PROT_READ|PROT_WRITE,
-			MAP_PRIVATE|MAP_POPULATE, fd, 0);
-	if (addr == MAP_FAILED) {
-		AIOPT_DEBUG("Unable to mmap internal memory. (err=%d)\n",
-				errno);
-		ret = AIOPT_ENOMEM;
-		goto err_out;
-	}
-
-	AIOPT_DEV("mmap-ing (%ld) bytes of aligned buffer for AIOP "
-			"image. (addr=%p)\n", aligned_size, addr);
-
-	if (afile) {
-		/* Allocating memory in virtual space and dma-mapping it for loading
-		 * AIOP arguments on it
-		 */
-		args_aligned_size =
-			((args_filesize + AIOPT_ALIGNED_PAGE_SZ)/AIOPT_ALIGNED_PAGE_SZ) \
-			* AIOPT_ALIGNED_PAGE_SZ;
-		args_addr = mmap(NULL, args_aligned_size, PROT_READ|PROT_WRITE,
-				MAP_PRIVATE|MAP_POPULATE, args_fd, 0);
-		if (args_addr == MAP_FAILED) {
-			AIOPT_DEBUG("Unable to mmap internal memory. (err=%d)\n",
-					errno);
-			ret = AIOPT_ENOMEM;
-			goto err_out;
-		}
-	
-		AIOPT_DEV("mmap-ing (%ld) bytes of aligned buffer for AIOP "
-			"arguments. (addr=%p)\n", args_aligned_size, args_addr);
-	}
+	int ret;
+	unsigned int i;
+	struct fsl_mc_io *mc_io;
+	aiopt_obj_t *obj = (aiopt_obj_t *)handle;
 
-	/* After memory allocation, dma-mapping the memory through VFIO API */
-	obj = (aiopt_obj_t *)handle;
-	ret = fsl_vfio_setup_dmamap(obj->vfio_handle, (uint64_t)addr,
-					aligned_size);
-	if (ret != VFIO_SUCCESS) {
-		AIOPT_DEBUG("Unable to perform DMA Mapping. (err=%d)\n", ret);
-		goto err_out;
+	if (!obj || !obj->num_portals) {
+		AIOPT_DEV("Incorrect API usage.\n");
+		return AIOPT_FAILURE;
 	}
-	AIOPT_LIB_INFO("DMA Map of allocated memory (%p) successful.\n", addr);
 
-	if (afile) {
-		/* After memory allocation for args, dma-mapping the memory through VFIO API */
-		obj = (aiopt_obj_t *)handle;
-		ret = fsl_vfio_setup_dmamap(obj->vfio_handle, (uint64_t)args_addr,
-						args_aligned_size);
-		if (ret != VFIO_SUCCESS) {
-			AIOPT_DEBUG("Unable to perform DMA Mapping for args. (err=%d)\n", ret);
-			goto err_cleanup_elf;
+	for (i = 0; i < obj->num_portals; i++) {
+		mc_io = obj->portals[i].mc_io;
+		if (type == mc_io->lock_type)
+			continue;
+		mc_io_lock_destroy(mc_io);
+		ret = mc_io_lock_init(mc_io, type);
+		if (ret) {
+			AIOPT_DEBUG("Unable to set portal lock %d. (err=%d)\n",
+					type, ret);
+			/* Left unlocked, as before the lock was set up */
+			return AIOPT_FAILURE;
 		}
-		AIOPT_LIB_INFO("DMA Map of allocated memory (%p) successful for args.\n", args_addr);
-	}
-
-	ret = perform_dpaiop_load(obj, addr, filesize, args_addr,
-				  args_filesize, reset, tpc);
-	if (ret != AIOPT_SUCCESS) {
-		AIOPT_DEBUG("Error in performing aiop load.\n");
-		/* Fall through to err_cleanup */
-		goto err_cleanup_args;
 	}
+	AIOPT_DEBUG("Portal lock: %s.\n",
+			type == MC_IO_LOCK_SPIN ? "spinlock" :
+			type == MC_IO_LOCK_MUTEX ? "mutex" : "none");
 
-err_cleanup_args:
-	if (afile && args_addr && args_aligned_size > 0)
-		fsl_vfio_destroy_dmamap(obj->vfio_handle,
-					(uint64_t)args_addr,
-					args_aligned_size);
-
-err_cleanup_elf:
-	if (addr && aligned_size > 0)
-		fsl_vfio_destroy_dmamap(obj->vfio_handle,
-					(uint64_t)addr,
-					aligned_size);
-
-err_out:
-	if (args_addr)
-		munmap(args_addr, args_filesize);
-	if (args_fd > 0)
-		close(args_fd);
-	if (addr)
-		munmap(addr, filesize);
-	if (fd > 0)
-		close(fd);
-	return ret;
-
+	return AIOPT_SUCCESS;
 }
 
-
 /*
  * @brief
- * Deinitialize the AIOP Object
+ * Deinitialize the AIOP Object. The dpaiop sessions held by the object are
+ * closed, its portals unmapped and its VFIO handle released; obj is freed.
  *
  * @param [in] obj aiopt_handle_t type valid object
  *
@@ -1271,7 +4748,9 @@ aiopt_deinit(aiopt_handle_t obj)
 
 	AIOPT_DEV("Entering.\n");
 	if (obj) {
+		print_mc_wait_stats((aiopt_obj_t *)obj);
 		cleanup_aiopt_obj((aiopt_obj_t *)obj);
+		free_aiopt_obj((aiopt_obj_t *)obj);
 	}
 
 	AIOPT_DEV("Exiting (%d)\n", ret);
@@ -1289,35 +4768,113 @@ aiopt_deinit(aiopt_handle_t obj)
  */
 aiopt_handle_t
 aiopt_init(const char *container_name)
+{
+	return aiopt_init_aiop(container_name, AIOPT_AIOP_ID_ANY);
+}
+
+/*
+ * @brief
+ * Initialize the handle on a given dpaiop of the container
+ *
+ * @param [in] container_name Name of the container
+ * @param [in] aiop_id ID of the dpaiop, or AIOPT_AIOP_ID_ANY
+ *
+ * @return Handle or AIOPT_INVALID_HANDLE
+ */
+aiopt_handle_t
+aiopt_init_aiop(const char *container_name, int aiop_id)
 {
 	int ret;
 	aiopt_obj_t *obj = NULL;
-
+	aiopt_topo_t topo;
+	uint64_t start, vfio_start;
+	pthread_condattr_t cattr;
+#ifdef AIOPT_MC_SIM
+	aiopt_mcsim_conf_t sim_conf;
+#endif
+
+	start = aiopt_now_ns();
 	obj = calloc(1, sizeof(aiopt_obj_t));
 	if (!obj) {
 		AIOPT_DEBUG("Unable to allocate memory for AIOP Obj\n");
 		return AIOPT_INVALID_HANDLE;
 	}
+	obj->irq_fd = -1;
+	pthread_mutex_init(&obj->pool_lock, NULL);
+	pthread_cond_init(&obj->pool_cond, NULL);
+	/* Timed waits are against aiopt_now_ns */
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&obj->irq_lock, NULL);
+	pthread_cond_init(&obj->irq_cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+	obj->load_timeout_ms = AIOPT_LOAD_DEF_TIMEOUT_MS;
+	obj->load_report.state = -1;
+	obj->limits.image_max = MAX_AIOP_IMAGE_FILE_SZ;
+	obj->limits.args_max = MAX_AIOP_ARGS_FILE_SZ;
+
+	/* IOMMU group and objects of the container, from a record of an
+	 * earlier aiopt_init if still valid (see topo_cache_lookup)
+	 */
+	memset(&topo, 0, sizeof(topo));
+	obj->init_report.topo_src = topo_cache_lookup(container_name, &topo);
+	obj->init_report.topology_ns = aiopt_now_ns() - start;
+	if (strlen(container_name) < AIOPT_OBJ_NAME_MAX)
+		strcpy(topo.container, container_name);
 
 	/* Initializing handle on the VFIO context for the container */
-	obj->vfio_handle = fsl_vfio_setup(container_name);
+	vfio_start = aiopt_now_ns();
+#ifdef AIOPT_MC_SIM
+	/* Simulated MC in its place; the name of the container only names
+	 * its topology record
+	 */
+	AIOPT_LIB_INFO("Using MC simulator for container (%s).\n",
+			container_name);
+	aiopt_mcsim_conf_init(&sim_conf);
+	obj->sim = aiopt_mcsim_start(&sim_conf);
+	obj->init_report.vfio_ns = aiopt_now_ns() - vfio_start;
+	if (!obj->sim) {
+		AIOPT_DEBUG("Unable to start MC simulator.\n");
+		goto err_out;
+	}
+#else
+	if (obj->init_report.topo_src != AIOPT_TOPO_SCANNED) {
+		obj->vfio_handle = fsl_vfio_setup_group(container_name,
+							topo.groupid);
+		if (FSL_VFIO_INVALID_HANDLE == obj->vfio_handle) {
+			AIOPT_DEBUG("Container (%s) not in IOMMU group (%d) "
+					"of its record.\n", container_name,
+					topo.groupid);
+			topo_cache_forget(container_name);
+			obj->init_report.topo_src = AIOPT_TOPO_SCANNED;
+		}
+	}
+	if (obj->init_report.topo_src == AIOPT_TOPO_SCANNED)
+		obj->vfio_handle = fsl_vfio_setup(container_name);
+	obj->init_report.vfio_ns = aiopt_now_ns() - vfio_start;
 	if (FSL_VFIO_INVALID_HANDLE == obj->vfio_handle) {
 		AIOPT_DEBUG("Unable to open VFIO. (Invalid handle).\n");
-		free(obj);
-		return AIOPT_INVALID_HANDLE;
+		goto err_out;
 	}
+#endif
 
 	/* Fetch Devices: AIOP and MC; And if these are not present, return
 	 * error
 	 */
-	ret = setup_aiopt_device(obj);
+	ret = setup_aiopt_device(obj, &topo, aiop_id);
 	if (ret != AIOPT_SUCCESS) {
 		/* Unable to initialize */
 		AIOPT_DEBUG("Initialization of AIOP failed.\n");
-		free(obj);
-		return AIOPT_INVALID_HANDLE;
+		goto err_out;
 	}
 
+	obj->init_report.total_ns = aiopt_now_ns() - start;
 	return (aiopt_handle_t)obj;
+
+err_out:
+	/* Whatever was set up before the failure */
+	cleanup_aiopt_obj(obj);
+	free_aiopt_obj(obj);
+	return AIOPT_INVALID_HANDLE;
 }
 
@@ -0,0 +1,616 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file	aiop_mc_sim.c
+ *
+ * @brief	Software MC portal simulator. A thread serves portal memory
+ *		regions the same way MC firmware serves dpmcp portals, decoding
+ *		struct mc_command headers and implementing the DPAIOP commands
+ *		with a tile state machine and configurable latencies.
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_logger.h>
+#include <aiop_mc_sim.h>
+
+/*MC header files*/
+#include <fsl_dpaiop.h>
+#include <fsl_dpaiop_cmd.h>
+#include <fsl_mc_sys.h>
+#include <fsl_mc_cmd.h>
+
+/* ========================================================================
+ * MACROs and defines
+ * ======================================================================== */
+
+/* @def MCSIM_POLL_NS
+ * @brief Interval at which the simulator thread scans the portals
+ */
+#define MCSIM_POLL_NS		2000
+
+/* Defaults for aiopt_mcsim_conf_t */
+#define MCSIM_DEF_CMD_US	10
+#define MCSIM_DEF_LOAD_US	200000
+#define MCSIM_DEF_BOOT_US	300000
+#define MCSIM_DEF_RESET_US	50000
+
+/* Service Layer version reported by the simulated tile */
+#define MCSIM_SL_MAJOR		1
+#define MCSIM_SL_MINOR		0
+#define MCSIM_SL_REVISION	0
+
+/* ========================================================================
+ * Structures
+ * ======================================================================== */
+
+/*
+ * @brief Simulator side state of a portal
+ */
+struct mcsim_portal {
+	int busy;			/**< Command taken, response pending >*/
+	uint64_t deadline;		/**< Time at which response is posted >*/
+	struct mc_command rsp;		/**< Response to post >*/
+	int aiop;			/**< Tile updated on completion, or -1 >*/
+	uint32_t done_state;		/**< State of the tile on completion >*/
+};
+
+/*
+ * @brief Simulated dpaiop object (AIOP Tile)
+ */
+struct mcsim_aiop {
+	uint32_t state;			/**< DPAIOP_STATE_* >*/
+	uint64_t next_at;		/**< Time of next transition; 0 if none >*/
+	uint32_t next_state;		/**< State after next transition >*/
+	uint8_t irq_enable;
+	uint32_t irq_mask;
+	uint32_t irq_status;
+	int irq_fd;			/**< eventfd signalled on IRQ, or -1 >*/
+	uint64_t tod;			/**< Time of day as last set >*/
+	uint64_t tod_at;		/**< Monotonic time of last set, ns >*/
+};
+
+/*
+ * @brief Token handed out by dpaiop_open
+ */
+struct mcsim_session {
+	int used;
+	uint16_t token;
+	int aiop;
+	unsigned int cmds;		/**< Commands issued with the token >*/
+};
+
+struct aiopt_mcsim {
+	aiopt_mcsim_conf_t conf;
+	struct mc_command *portals;	/**< Portal memory, one per dpmcp >*/
+	struct mcsim_portal pstate[AIOPT_MCSIM_MAX_PORTALS];
+	struct mcsim_aiop aiops[AIOPT_MCSIM_MAX_AIOPS];
+	struct mcsim_session sessions[AIOPT_MCSIM_MAX_SESSIONS];
+	uint16_t next_token;
+	pthread_t thread;
+	volatile int stop;
+};
+
+/*=========================================================================
+ * Internal Functions
+ *=========================================================================*/
+
+static uint64_t
+mcsim_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int
+mcsim_env_uint(const char *name, unsigned int def)
+{
+	char *v = getenv(name);
+
+	if (!v || !*v)
+		return def;
+	return (unsigned int)strtoul(v, NULL, 0);
+}
+
+/*
+ * @brief
+ * Assert the IRQ of the tile, i.e. signal its eventfd, if it is enabled and
+ * any pending event is unmasked
+ */
+static void
+mcsim_assert_irq(struct mcsim_aiop *a)
+{
+	uint64_t one = 1;
+	int fd = __atomic_load_n(&a->irq_fd, __ATOMIC_ACQUIRE);
+
+	if (fd < 0 || !a->irq_enable || !(a->irq_status & a->irq_mask))
+		return;
+
+	if (write(fd, &one, sizeof(one)) != sizeof(one))
+		AIOPT_DEBUG("Unable to signal IRQ eventfd. (err=%d)\n", errno);
+}
+
+/*
+ * @brief
+ * Raise an IRQ event on the tile
+ */
+static void
+mcsim_raise_irq(struct mcsim_aiop *a, uint32_t event)
+{
+	a->irq_status |= event;
+	mcsim_assert_irq(a);
+}
+
+static void
+mcsim_set_state(struct mcsim_aiop *a, uint32_t state)
+{
+	if (a->state == state)
+		return;
+	a->state = state;
+	mcsim_raise_irq(a, AIOPT_MCSIM_IRQ_STATE_CHANGE);
+}
+
+/*
+ * @brief
+ * Apply due timed transitions (e.g. BOOT_ONGOING -> RUNNING) of all tiles
+ */
+static void
+mcsim_advance(aiopt_mcsim_t *sim, uint64_t now)
+{
+	unsigned int i;
+	struct mcsim_aiop *a;
+
+	for (i = 0; i < sim->conf.num_aiops; i++) {
+		a = &sim->aiops[i];
+		if (!a->next_at || now < a->next_at)
+			continue;
+		a->next_at = 0;
+		mcsim_set_state(a, a->next_state);
+	}
+}
+
+static struct mcsim_session *
+mcsim_find_session(aiopt_mcsim_t *sim, uint16_t token)
+{
+	int i;
+
+	for (i = 0; i < AIOPT_MCSIM_MAX_SESSIONS; i++) {
+		if (sim->sessions[i].used && sim->sessions[i].token == token)
+			return &sim->sessions[i];
+	}
+	return NULL;
+}
+
+static struct mcsim_session *
+mcsim_new_session(aiopt_mcsim_t *sim, int aiop)
+{
+	int i;
+	struct mcsim_session *ses;
+
+	for (i = 0; i < AIOPT_MCSIM_MAX_SESSIONS; i++) {
+		ses = &sim->sessions[i];
+		if (ses->used)
+			continue;
+		do {
+			sim->next_token++;
+		} while (!sim->next_token ||
+			 mcsim_find_session(sim, sim->next_token));
+		ses->used = TRUE;
+		ses->token = sim->next_token;
+		ses->aiop = aiop;
+		ses->cmds = 0;
+		return ses;
+	}
+	return NULL;
+}
+
+/*
+ * @brief
+ * Execute a command taken from a portal. Fills response parameters and
+ * returns MC status; latency and deferred tile state are set on the portal.
+ */
+static enum mc_cmd_status
+mcsim_exec(aiopt_mcsim_t *sim, struct mcsim_portal *ps,
+	   struct mc_command req, uint16_t *token)
+{
+	uint16_t cmd_id;
+	int id;
+	uint8_t irq_index, en;
+	uint32_t size, mask, status;
+	uint64_t iova, tod, now;
+	struct mcsim_session *ses = NULL;
+	struct mcsim_aiop *a = NULL;
+	struct mc_command *rsp = &ps->rsp;
+
+	cmd_id = (uint16_t)mc_dec(req.header, MC_CMD_HDR_CMDID_O,
+				  MC_CMD_HDR_CMDID_S);
+	now = mcsim_now();
+
+	/* Commands which do not need an open session */
+	switch (cmd_id) {
+	case DPAIOP_CMDID_OPEN:
+		MC_RSP_OP(req, 0, 0, 32, int, id);
+		if (id < 0 || (unsigned int)id >= sim->conf.num_aiops)
+			return MC_CMD_STATUS_NO_RESOURCE;
+		ses = mcsim_new_session(sim, id);
+		if (!ses)
+			return MC_CMD_STATUS_NO_RESOURCE;
+		*token = ses->token;
+		return MC_CMD_STATUS_OK;
+	case DPAIOP_CMDID_GET_API_VERSION:
+		MC_CMD_OP(*rsp, 0, 0, 16, uint16_t, DPAIOP_VER_MAJOR);
+		MC_CMD_OP(*rsp, 0, 16, 16, uint16_t, DPAIOP_VER_MINOR);
+		return MC_CMD_STATUS_OK;
+	default:
+		break;
+	}
+
+	ses = mcsim_find_session(sim, *token);
+	if (!ses)
+		return MC_CMD_STATUS_AUTH_ERR;
+	ses->cmds++;
+	if (sim->conf.token_lifetime && ses->cmds > sim->conf.token_lifetime) {
+		/* Token expired; MC no longer recognizes it */
+		ses->used = FALSE;
+		return MC_CMD_STATUS_AUTH_ERR;
+	}
+	a = &sim->aiops[ses->aiop];
+
+	switch (cmd_id) {
+	case DPAIOP_CMDID_CLOSE:
+		ses->used = FALSE;
+		break;
+	case DPAIOP_CMDID_GET_ATTR:
+		MC_CMD_OP(*rsp, 0, 0, 32, int, ses->aiop);
+		break;
+	case DPAIOP_CMDID_RESET:
+		a->next_at = 0;
+		mcsim_set_state(a, DPAIOP_STATE_RESET_ONGOING);
+		ps->deadline = now + sim->conf.reset_latency * 1000ULL;
+		ps->aiop = ses->aiop;
+		ps->done_state = DPAIOP_STATE_RESET_DONE;
+		break;
+	case DPAIOP_CMDID_LOAD:
+		if (a->state != DPAIOP_STATE_RESET_DONE)
+			return MC_CMD_STATUS_INVALID_STATE;
+		MC_RSP_OP(req, 0, 0, 32, uint32_t, size);
+		MC_RSP_OP(req, 1, 0, 64, uint64_t, iova);
+		mcsim_set_state(a, DPAIOP_STATE_LOAD_ONGIONG);
+		ps->deadline = now + sim->conf.load_latency * 1000ULL;
+		ps->aiop = ses->aiop;
+		ps->done_state = DPAIOP_STATE_LOAD_DONE;
+		if (!iova || !size ||
+		    sim->conf.fail_state == DPAIOP_STATE_LOAD_ERROR ||
+		    (sim->conf.check_image &&
+		     (size < 4 || memcmp((void *)iova, "\177ELF", 4)))) {
+			ps->done_state = DPAIOP_STATE_LOAD_ERROR;
+			return MC_CMD_STATUS_CONFIG_ERR;
+		}
+		break;
+	case DPAIOP_CMDID_RUN:
+		if (a->state != DPAIOP_STATE_LOAD_DONE)
+			return MC_CMD_STATUS_INVALID_STATE;
+		mcsim_set_state(a, DPAIOP_STATE_BOOT_ONGOING);
+		a->next_at = now + sim->conf.boot_latency * 1000ULL;
+		if (!a->next_at)
+			a->next_at = 1;
+		a->next_state =
+			(sim->conf.fail_state == DPAIOP_STATE_BOOT_ERROR) ?
+			DPAIOP_STATE_BOOT_ERROR : DPAIOP_STATE_RUNNING;
+		break;
+	case DPAIOP_CMDID_GET_SL_VERSION:
+		MC_CMD_OP(*rsp, 0, 0, 32, uint32_t, MCSIM_SL_MAJOR);
+		MC_CMD_OP(*rsp, 0, 32, 32, uint32_t, MCSIM_SL_MINOR);
+		MC_CMD_OP(*rsp, 1, 0, 32, uint32_t, MCSIM_SL_REVISION);
+		break;
+	case DPAIOP_CMDID_GET_STATE:
+		MC_CMD_OP(*rsp, 0, 0, 32, uint32_t, a->state);
+		break;
+	case DPAIOP_CMDID_SET_TIME_OF_DAY:
+		MC_RSP_OP(req, 0, 0, 64, uint64_t, a->tod);
+		a->tod_at = now;
+		break;
+	case DPAIOP_CMDID_GET_TIME_OF_DAY:
+		/* Time of day advances in milliseconds */
+		tod = a->tod + (now - a->tod_at) / 1000000ULL;
+		MC_CMD_OP(*rsp, 0, 0, 64, uint64_t, tod);
+		break;
+	case DPAIOP_CMDID_SET_IRQ_ENABLE:
+		MC_RSP_OP(req, 0, 0, 8, uint8_t, en);
+		MC_RSP_OP(req, 0, 32, 8, uint8_t, irq_index);
+		if (irq_index)
+			return MC_CMD_STATUS_CONFIG_ERR;
+		a->irq_enable = en;
+		mcsim_assert_irq(a);
+		break;
+	case DPAIOP_CMDID_GET_IRQ_ENABLE:
+		MC_CMD_OP(*rsp, 0, 0, 8, uint8_t, a->irq_enable);
+		break;
+	case DPAIOP_CMDID_SET_IRQ_MASK:
+		MC_RSP_OP(req, 0, 0, 32, uint32_t, mask);
+		MC_RSP_OP(req, 0, 32, 8, uint8_t, irq_index);
+		if (irq_index)
+			return MC_CMD_STATUS_CONFIG_ERR;
+		a->irq_mask = mask;
+		mcsim_assert_irq(a);
+		break;
+	case DPAIOP_CMDID_GET_IRQ_MASK:
+		MC_CMD_OP(*rsp, 0, 0, 32, uint32_t, a->irq_mask);
+		break;
+	case DPAIOP_CMDID_GET_IRQ_STATUS:
+		MC_CMD_OP(*rsp, 0, 0, 32, uint32_t, a->irq_status);
+		break;
+	case DPAIOP_CMDID_CLEAR_IRQ_STATUS:
+		MC_RSP_OP(req, 0, 0, 32, uint32_t, status);
+		a->irq_status &= ~status;
+		break;
+	default:
+		return MC_CMD_STATUS_UNSUPPORTED_OP;
+	}
+
+	return MC_CMD_STATUS_OK;
+}
+
+/*
+ * @brief
+ * Take a command written to a portal and prepare its response
+ */
+static void
+mcsim_take_command(aiopt_mcsim_t *sim, unsigned int idx, uint64_t hdr)
+{
+	int i;
+	uint16_t token;
+	enum mc_cmd_status status;
+	struct mc_command req;
+	struct mcsim_portal *ps = &sim->pstate[idx];
+	struct mc_command *portal = &sim->portals[idx];
+
+	req.header = hdr;
+	for (i = 0; i < MC_CMD_NUM_OF_PARAMS; i++)
+		req.params[i] = portal->params[i];
+
+	memset(&ps->rsp, 0, sizeof(ps->rsp));
+	ps->aiop = -1;
+	ps->deadline = mcsim_now() + sim->conf.cmd_latency * 1000ULL;
+
+	token = MC_CMD_HDR_READ_TOKEN(hdr);
+	status = mcsim_exec(sim, ps, req, &token);
+
+	/* Response header is the command header with status (and token, for
+	 * open) updated
+	 */
+	hdr &= ~(mc_enc(MC_CMD_HDR_STATUS_O, MC_CMD_HDR_STATUS_S, -1) |
+		 mc_enc(MC_CMD_HDR_TOKEN_O, MC_CMD_HDR_TOKEN_S, -1));
+	hdr |= mc_enc(MC_CMD_HDR_STATUS_O, MC_CMD_HDR_STATUS_S, status);
+	hdr |= mc_enc(MC_CMD_HDR_TOKEN_O, MC_CMD_HDR_TOKEN_S, token);
+	ps->rsp.header = hdr;
+	ps->busy = TRUE;
+}
+
+/*
+ * @brief
+ * Post the prepared response of a portal once its latency has elapsed
+ */
+static void
+mcsim_post_response(aiopt_mcsim_t *sim, unsigned int idx, uint64_t now)
+{
+	int i;
+	struct mcsim_portal *ps = &sim->pstate[idx];
+	struct mc_command *portal = &sim->portals[idx];
+
+	if (now < ps->deadline)
+		return;
+
+	if (ps->aiop >= 0)
+		mcsim_set_state(&sim->aiops[ps->aiop], ps->done_state);
+
+	for (i = 0; i < MC_CMD_NUM_OF_PARAMS; i++)
+		portal->params[i] = ps->rsp.params[i];
+
+	/* Status in header is what the caller is polling for; written last */
+	__atomic_store_n(&portal->header, ps->rsp.header, __ATOMIC_RELEASE);
+	ps->busy = FALSE;
+}
+
+/*
+ * @brief
+ * Simulator thread: scans all portals for commands in READY status
+ */
+static void *
+mcsim_thread(void *arg)
+{
+	unsigned int i;
+	uint64_t hdr, now;
+	aiopt_mcsim_t *sim = (aiopt_mcsim_t *)arg;
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = MCSIM_POLL_NS };
+
+	/* Poll interval is short; default timer slack would dominate it */
+	prctl(PR_SET_TIMERSLACK, 1UL);
+
+	while (!sim->stop) {
+		now = mcsim_now();
+		mcsim_advance(sim, now);
+
+		for (i = 0; i < sim->conf.num_portals; i++) {
+			if (sim->pstate[i].busy) {
+				mcsim_post_response(sim, i, now);
+				continue;
+			}
+
+			hdr = __atomic_load_n(&sim->portals[i].header,
+					      __ATOMIC_ACQUIRE);
+			if (MC_CMD_HDR_READ_STATUS(hdr) != MC_CMD_STATUS_READY)
+				continue;
+
+			mcsim_take_command(sim, i, hdr);
+			mcsim_post_response(sim, i, mcsim_now());
+		}
+
+		nanosleep(&ts, NULL);
+	}
+
+	return NULL;
+}
+
+/* ==========================================================================
+ * Externally available API definitions
+ * ==========================================================================*/
+
+void
+aiopt_mcsim_conf_init(aiopt_mcsim_conf_t *conf)
+{
+	char *fail;
+
+	memset(conf, 0, sizeof(*conf));
+	conf->num_portals = mcsim_env_uint("AIOPT_SIM_PORTALS", 1);
+	conf->num_aiops = mcsim_env_uint("AIOPT_SIM_AIOPS", 1);
+	conf->cmd_latency = mcsim_env_uint("AIOPT_SIM_CMD_US",
+					   MCSIM_DEF_CMD_US);
+	conf->load_latency = mcsim_env_uint("AIOPT_SIM_LOAD_US",
+					    MCSIM_DEF_LOAD_US);
+	conf->boot_latency = mcsim_env_uint("AIOPT_SIM_BOOT_US",
+					    MCSIM_DEF_BOOT_US);
+	conf->reset_latency = mcsim_env_uint("AIOPT_SIM_RESET_US",
+					     MCSIM_DEF_RESET_US);
+	conf->token_lifetime = mcsim_env_uint("AIOPT_SIM_TOKEN_LIFETIME", 0);
+	conf->check_image = mcsim_env_uint("AIOPT_SIM_CHECK_IMAGE", TRUE);
+
+	fail = getenv("AIOPT_SIM_FAIL");
+	if (fail && !strcmp(fail, "load"))
+		conf->fail_state = DPAIOP_STATE_LOAD_ERROR;
+	else if (fail && !strcmp(fail, "boot"))
+		conf->fail_state = DPAIOP_STATE_BOOT_ERROR;
+}
+
+aiopt_mcsim_t *
+aiopt_mcsim_start(const aiopt_mcsim_conf_t *conf)
+{
+	unsigned int i;
+	aiopt_mcsim_t *sim = NULL;
+	struct timespec rt;
+
+	if (!conf || !conf->num_portals ||
+	    conf->num_portals > AIOPT_MCSIM_MAX_PORTALS ||
+	    !conf->num_aiops || conf->num_aiops > AIOPT_MCSIM_MAX_AIOPS) {
+		AIOPT_DEBUG("Incorrect simulator configuration.\n");
+		return NULL;
+	}
+
+	sim = calloc(1, sizeof(*sim));
+	if (!sim) {
+		AIOPT_DEBUG("Unable to allocate simulator.\n");
+		return NULL;
+	}
+	sim->conf = *conf;
+
+	/* Portals are cache line sized and aligned, like dpmcp regions */
+	sim->portals = aligned_alloc(64,
+			conf->num_portals * sizeof(struct mc_command));
+	if (!sim->portals) {
+		AIOPT_DEBUG("Unable to allocate simulated portals.\n");
+		free(sim);
+		return NULL;
+	}
+	memset(sim->portals, 0, conf->num_portals * sizeof(struct mc_command));
+
+	clock_gettime(CLOCK_REALTIME, &rt);
+	for (i = 0; i < conf->num_aiops; i++) {
+		sim->aiops[i].state = DPAIOP_STATE_RESET_DONE;
+		sim->aiops[i].irq_fd = -1;
+		sim->aiops[i].tod = (uint64_t)rt.tv_sec * 1000 +
+					rt.tv_nsec / 1000000;
+		sim->aiops[i].tod_at = mcsim_now();
+	}
+
+	if (pthread_create(&sim->thread, NULL, mcsim_thread, sim)) {
+		AIOPT_DEBUG("Unable to start simulator thread.\n");
+		free(sim->portals);
+		free(sim);
+		return NULL;
+	}
+
+	AIOPT_LIB_INFO("MC simulator started: portals=%u, aiops=%u, "
+			"latency(us): cmd=%u load=%u boot=%u reset=%u\n",
+			conf->num_portals, conf->num_aiops, conf->cmd_latency,
+			conf->load_latency, conf->boot_latency,
+			conf->reset_latency);
+
+	return sim;
+}
+
+void
+aiopt_mcsim_stop(aiopt_mcsim_t *sim)
+{
+	if (!sim)
+		return;
+
+	sim->stop = TRUE;
+	pthread_join(sim->thread, NULL);
+	free(sim->portals);
+	free(sim);
+}
+
+void *
+aiopt_mcsim_portal(aiopt_mcsim_t *sim, unsigned int idx)
+{
+	if (!sim || idx >= sim->conf.num_portals)
+		return NULL;
+
+	return &sim->portals[idx];
+}
+
+void
+aiopt_mcsim_get_conf(aiopt_mcsim_t *sim, aiopt_mcsim_conf_t *conf)
+{
+	*conf = sim->conf;
+}
+
+int
+aiopt_mcsim_set_irq_fd(aiopt_mcsim_t *sim, unsigned int aiop, int fd)
+{
+	if (!sim || aiop >= sim->conf.num_aiops)
+		return AIOPT_FAILURE;
+
+	__atomic_store_n(&sim->aiops[aiop].irq_fd, fd, __ATOMIC_RELEASE);
+
+	return AIOPT_SUCCESS;
+}
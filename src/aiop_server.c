@@ -0,0 +1,1182 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	aiop_server.c
+ *
+ * @brief	AIOP Tool daemon: keeps an aiopt_handle_t open and serves
+ *		requests from local clients over a Unix domain socket, and
+ *		the thin client used by sub-commands to reach it.
+ *
+ */
+
+/* Generic includes */
+#define _GNU_SOURCE		/* pipe2 */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_cmd.h>
+#include <aiop_logger.h>
+#include <aiop_lib.h>
+#include <aiop_server.h>
+#include <aiop_evloop.h>
+
+/* ========================================================================
+ * MACROs and defines
+ * ======================================================================== */
+
+/* @def SRV_MAX_ARGS
+ * @brief Maximum number of words in a request line
+ */
+#define SRV_MAX_ARGS		8
+
+/* @def SRV_MAX_JOBS
+ * @brief Requests executed on worker threads (load, reset, wait) at a time
+ */
+#define SRV_MAX_JOBS		16
+
+/* ========================================================================
+ * Structures
+ * ======================================================================== */
+
+struct srv_job;
+
+/*
+ * @brief State of a connected client
+ */
+struct srv_client {
+	struct aiopt_evl_conn conn;	/**< First; fd, output, closing >*/
+	char		in[AIOPT_SRV_LINE_MAX]; /**< Partial request line >*/
+	size_t		in_len;
+	struct srv_job	*job;		/**< Request in progress on a worker;
+					  later requests wait for it >*/
+};
+
+/*
+ * @brief State of the daemon
+ */
+struct srv_ctx {
+	aiopt_handle_t	handle;
+	aiopt_evl_t	evl;		/**< Clients and signals >*/
+	int		jfd[2];		/**< Jobs done, as posted by workers >*/
+	unsigned int	njobs;
+	unsigned long	requests;
+	pthread_mutex_t	load_lock;	/**< Loads and resets one at a time >*/
+	struct srv_job	*jobs[SRV_MAX_JOBS];
+};
+
+/*
+ * @brief Request handler; data lines are queued on out and the return
+ * value is reported in the final OK/ERR line.
+ */
+typedef int (*srv_req_hndlr)(struct srv_ctx *ctx,
+			     struct aiopt_evl_out *out, int argc, char **argv);
+
+struct srv_request {
+	const char	*name;
+	srv_req_hndlr	hndlr;
+	int		min_args;	/**< Words after the request name >*/
+	int		max_args;
+	short int	worker;		/**< Executed on a worker thread, as it
+					  may take long >*/
+};
+
+/*
+ * @brief A request executed on a worker thread. Its MC commands lease
+ * portals of the handle as any other, so requests executed by the event loop
+ * meanwhile are issued on other portals.
+ */
+struct srv_job {
+	struct srv_ctx	*ctx;
+	struct srv_client *c;		/**< NULL once the client is gone >*/
+	const struct srv_request *r;
+	pthread_t	thread;
+	unsigned int	slot;		/**< Index in srv_ctx.jobs >*/
+	int		argc;
+	char		*argv[SRV_MAX_ARGS + 1];
+	char		line[AIOPT_SRV_LINE_MAX]; /**< Words of argv >*/
+	struct aiopt_evl_out out;
+	int		ret;
+};
+
+/* ========================================================================
+ * Server: output
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Send as much of the queued output as the socket takes. Requests are
+ * taken from the client (EPOLLIN) neither while one of its requests is on a
+ * worker nor once it is closing.
+ *
+ * @param [in] ctx daemon state
+ * @param [in] c client
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the connection is broken
+ */
+static int
+srv_flush(struct srv_ctx *ctx, struct srv_client *c)
+{
+	return aiopt_evl_flush(&ctx->evl, &c->conn, !c->job);
+}
+
+/*
+ * @brief
+ * Whether a client is to be closed: it is closing, and neither output nor a
+ * request is left
+ *
+ * @param [in] c client
+ * @return TRUE or FALSE
+ */
+static int
+srv_done(struct srv_client *c)
+{
+	return c->conn.closing && !c->conn.out.len && !c->job;
+}
+
+/* ========================================================================
+ * Server: request handlers
+ * ======================================================================== */
+
+static int
+srv_req_ping(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	     char **argv)
+{
+	return AIOPT_SUCCESS;
+}
+
+static int
+srv_req_status(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	       char **argv)
+{
+	int ret;
+	aiopt_status_t status;
+
+	ret = aiopt_status(ctx->handle, &status);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	aiopt_evl_printf(out, "+ version %d %d %d\n", status.id, status.major_v,
+			 status.minor_v);
+	aiopt_evl_printf(out, "+ sl_version %d %d %d\n", status.sl_major_v,
+			 status.sl_minor_v, status.sl_revision);
+	aiopt_evl_printf(out, "+ state %d\n", status.state);
+
+	return AIOPT_SUCCESS;
+}
+
+static int
+srv_req_gettod(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	       char **argv)
+{
+	int ret;
+	uint64_t tod;
+
+	ret = aiopt_gettod(ctx->handle, &tod);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	aiopt_evl_printf(out, "+ tod %lu\n", tod);
+
+	return AIOPT_SUCCESS;
+}
+
+static int
+srv_req_settod(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	       char **argv)
+{
+	char *end;
+	uint64_t tod;
+
+	errno = 0;
+	tod = strtoull(argv[1], &end, 10);
+	if (errno || *end != '\0')
+		return -EINVAL;
+
+	return aiopt_settod(ctx->handle, tod);
+}
+
+static int
+srv_req_reset(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	      char **argv)
+{
+	int ret;
+
+	/* Not in the middle of a load */
+	pthread_mutex_lock(&ctx->load_lock);
+	ret = aiopt_reset(ctx->handle);
+	pthread_mutex_unlock(&ctx->load_lock);
+
+	return ret;
+}
+
+static int
+srv_req_load(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	     char **argv)
+{
+	int i, ret, tpc = DEFAULT_THREAD_PER_CORE;
+	short int reset = FALSE, skip = FALSE;
+	const char *afile = NULL;
+	char *end;
+	unsigned long timeout = AIOPT_LOAD_DEF_TIMEOUT_MS;
+	aiopt_load_report_t r;
+
+	if (argv[1][0] != '/')
+		return -EINVAL;
+
+	for (i = 2; i < argc; i++) {
+		if (!strcmp(argv[i], "reset")) {
+			reset = TRUE;
+		} else if (!strcmp(argv[i], "skip")) {
+			skip = TRUE;
+		} else if (!strncmp(argv[i], "args=", 5) &&
+			   argv[i][5] == '/') {
+			afile = argv[i] + 5;
+		} else if (!strncmp(argv[i], "tpc=", 4)) {
+			tpc = atoi(argv[i] + 4);
+			if (tpc < 0 || tpc > MAX_THREAD_PER_CORE)
+				return -EINVAL;
+		} else if (!strncmp(argv[i], "timeout=", 8)) {
+			errno = 0;
+			timeout = strtoul(argv[i] + 8, &end, 10);
+			if (errno || *end != '\0' || timeout > UINT_MAX)
+				return -EINVAL;
+		} else {
+			return -EINVAL;
+		}
+	}
+
+	/* Settings and report of the handle are those of one load */
+	pthread_mutex_lock(&ctx->load_lock);
+	aiopt_set_load_timeout(ctx->handle, timeout);
+	aiopt_set_load_skip(ctx->handle, skip);
+	ret = aiopt_load(ctx->handle, argv[1], afile, reset,
+			 (unsigned short int)tpc);
+
+	if (aiopt_get_load_report(ctx->handle, &r) == AIOPT_SUCCESS)
+		aiopt_evl_printf(out, "+ load_report %d %lu %lu %lu %lu "
+				 "%lu %lu %d\n", r.state, r.prepared_ns,
+				 r.reset_ns, r.loaded_ns, r.booting_ns,
+				 r.running_ns, r.total_ns, r.skipped);
+	pthread_mutex_unlock(&ctx->load_lock);
+
+	return ret;
+}
+
+static int
+srv_req_stats(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	      char **argv)
+{
+	FILE *fp;
+	char *buf = NULL, *line, *saveptr = NULL;
+	size_t len = 0;
+	short int json = FALSE;
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "json"))
+			return -EINVAL;
+		json = TRUE;
+	}
+
+	fp = open_memstream(&buf, &len);
+	if (!fp)
+		return -ENOMEM;
+	aiopt_mc_stats_dump(fp, json);
+	fclose(fp);
+
+	for (line = strtok_r(buf, "\n", &saveptr); line;
+	     line = strtok_r(NULL, "\n", &saveptr))
+		aiopt_evl_printf(out, "+ %s\n", line);
+
+	free(buf);
+
+	return AIOPT_SUCCESS;
+}
+
+static int
+srv_req_wait(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	     char **argv)
+{
+	int ret, state, cur_state = -1;
+	char *end;
+	unsigned long timeout = AIOPT_SRV_WAIT_MAX_MS;
+
+	state = aiopt_get_state_from_str(argv[1]);
+	if (state == AIOPT_FAILURE)
+		return -EINVAL;
+
+	if (argc > 2) {
+		errno = 0;
+		timeout = strtoul(argv[2], &end, 10);
+		if (errno || *end != '\0')
+			return -EINVAL;
+	}
+	if (timeout == AIOPT_WAIT_FOREVER || timeout > AIOPT_SRV_WAIT_MAX_MS)
+		timeout = AIOPT_SRV_WAIT_MAX_MS;
+
+	ret = aiopt_wait_state(ctx->handle, state, timeout, &cur_state);
+	aiopt_evl_printf(out, "+ state %d\n", cur_state);
+
+	return ret;
+}
+
+static int
+srv_req_list(struct srv_ctx *ctx, struct aiopt_evl_out *out, int argc,
+	     char **argv)
+{
+	int ret;
+	FILE *fp;
+	char *buf = NULL, *line, *saveptr = NULL;
+	size_t len = 0;
+	unsigned int count;
+	aiopt_dpobj_info_t *info;
+
+	ret = aiopt_list(ctx->handle, NULL, 0, &count);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	info = calloc(count, sizeof(*info));
+	if (!info)
+		return -ENOMEM;
+	ret = aiopt_list(ctx->handle, info, count, &count);
+	if (ret != AIOPT_SUCCESS) {
+		free(info);
+		return ret;
+	}
+
+	fp = open_memstream(&buf, &len);
+	if (!fp) {
+		free(info);
+		return -ENOMEM;
+	}
+	aiopt_dump_list(fp, info, count);
+	fclose(fp);
+	free(info);
+
+	for (line = strtok_r(buf, "\n", &saveptr); line;
+	     line = strtok_r(NULL, "\n", &saveptr))
+		aiopt_evl_printf(out, "+ %s\n", line);
+
+	free(buf);
+
+	return AIOPT_SUCCESS;
+}
+
+/* load, reset and wait block until MC or the tile is done; they are executed
+ * on worker threads, so that the event loop keeps serving other clients.
+ */
+static const struct srv_request srv_requests[] = {
+	{"ping", srv_req_ping, 0, 0, FALSE},
+	{"status", srv_req_status, 0, 0, FALSE},
+	{"gettod", srv_req_gettod, 0, 0, FALSE},
+	{"settod", srv_req_settod, 1, 1, FALSE},
+	{"reset", srv_req_reset, 0, 0, TRUE},
+	{"load", srv_req_load, 1, 6, TRUE},
+	{"stats", srv_req_stats, 0, 1, FALSE},
+	{"wait", srv_req_wait, 1, 2, TRUE},
+	{"list", srv_req_list, 0, 0, FALSE},
+	{NULL, NULL, 0, 0, FALSE}
+};
+
+/*
+ * @brief
+ * Queue the final line of the response to a request
+ *
+ * @param [in] o output of the client
+ * @param [in] ret value returned by the request handler
+ * @param [in] name request name
+ * @return void
+ */
+static void
+srv_reply(struct aiopt_evl_out *o, int ret, const char *name)
+{
+	if (ret == AIOPT_SUCCESS)
+		aiopt_evl_printf(o, "OK\n");
+	else if (ret == -EINVAL)
+		aiopt_evl_printf(o, "ERR %d Invalid arguments\n", ret);
+	else
+		aiopt_evl_printf(o, "ERR %d %s failed\n", ret, name);
+}
+
+/* ========================================================================
+ * Server: worker threads
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Worker thread: execute the request of a job and post the job back to the
+ * event loop
+ *
+ * @param [in] arg job
+ * @return NULL
+ */
+static void *
+srv_job_run(void *arg)
+{
+	struct srv_job *job = arg;
+	ssize_t n;
+
+	job->ret = job->r->hndlr(job->ctx, &job->out, job->argc, job->argv);
+
+	/* A pointer is written atomically; the loop reads it in one go */
+	do {
+		n = write(job->ctx->jfd[1], &job, sizeof(job));
+	} while (n < 0 && errno == EINTR);
+	if (n != sizeof(job))
+		AIOPT_DEBUG("Unable to post job. (err=%d)\n", errno);
+
+	return NULL;
+}
+
+/*
+ * @brief
+ * Execute a request on a worker thread. Further requests of the client are
+ * held until it is done, so that responses keep the order of requests.
+ *
+ * @param [in] ctx daemon state
+ * @param [in] c client
+ * @param [in] r request
+ * @param [in] argc number of words of the request
+ * @param [in] argv words of the request
+ * @return AIOPT_SUCCESS, or -EBUSY if SRV_MAX_JOBS are in progress
+ */
+static int
+srv_job_start(struct srv_ctx *ctx, struct srv_client *c,
+	      const struct srv_request *r, int argc, char **argv)
+{
+	int i, err;
+	size_t off = 0, len;
+	unsigned int slot;
+	struct srv_job *job;
+	sigset_t set, old;
+
+	if (ctx->njobs == SRV_MAX_JOBS)
+		return -EBUSY;
+
+	job = calloc(1, sizeof(*job));
+	if (!job)
+		return -ENOMEM;
+	job->ctx = ctx;
+	job->c = c;
+	job->r = r;
+	job->argc = argc;
+	/* Words are copied, as the input buffer of the client moves on */
+	for (i = 0; i < argc; i++) {
+		len = strlen(argv[i]) + 1;
+		memcpy(job->line + off, argv[i], len);
+		job->argv[i] = job->line + off;
+		off += len;
+	}
+	job->argv[argc] = NULL;
+
+	for (slot = 0; ctx->jobs[slot]; slot++)
+		;
+	job->slot = slot;
+
+	/* SIGINT/SIGTERM are left to the other threads */
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	err = pthread_create(&job->thread, NULL, srv_job_run, job);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err) {
+		AIOPT_DEBUG("Unable to create worker thread. (err=%d)\n", err);
+		free(job);
+		return -err;
+	}
+
+	ctx->jobs[slot] = job;
+	ctx->njobs++;
+	c->job = job;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Join a job posted back by its worker and free it
+ *
+ * @param [in] ctx daemon state
+ * @param [in] job job done
+ * @return void
+ */
+static void
+srv_job_free(struct srv_ctx *ctx, struct srv_job *job)
+{
+	pthread_join(job->thread, NULL);
+	ctx->jobs[job->slot] = NULL;
+	ctx->njobs--;
+	free(job->out.data);
+	free(job);
+}
+
+/*
+ * @brief
+ * Parse and execute one request line and queue its response, or hand the
+ * request to a worker thread
+ *
+ * @param [in] ctx daemon state
+ * @param [in] c client
+ * @param [in] line request, without newline; modified in place
+ * @return void
+ */
+static void
+srv_handle_line(struct srv_ctx *ctx, struct srv_client *c, char *line)
+{
+	int argc = 0, ret;
+	char *argv[SRV_MAX_ARGS + 1];
+	char *saveptr = NULL, *tok;
+	const struct srv_request *r;
+
+	for (tok = strtok_r(line, " \t\r", &saveptr); tok;
+	     tok = strtok_r(NULL, " \t\r", &saveptr)) {
+		if (argc == SRV_MAX_ARGS) {
+			aiopt_evl_printf(&c->conn.out,
+					 "ERR %d Too many arguments\n",
+					 -E2BIG);
+			return;
+		}
+		argv[argc++] = tok;
+	}
+	argv[argc] = NULL;
+
+	if (!argc)
+		return;	/* Empty lines are ignored */
+
+	ctx->requests++;
+	for (r = srv_requests; r->name; r++) {
+		if (!strcmp(r->name, argv[0]))
+			break;
+	}
+
+	if (!r->name) {
+		aiopt_evl_printf(&c->conn.out, "ERR %d Unknown request\n",
+				 -ENOSYS);
+		return;
+	}
+
+	if (argc - 1 < r->min_args || argc - 1 > r->max_args) {
+		aiopt_evl_printf(&c->conn.out, "ERR %d Invalid arguments\n",
+				 -EINVAL);
+		return;
+	}
+
+	AIOPT_DEBUG("Request (%s) on client (fd=%d).\n", argv[0], c->conn.fd);
+	if (r->worker) {
+		ret = srv_job_start(ctx, c, r, argc, argv);
+		if (ret == AIOPT_SUCCESS)
+			return;	/* Response queued once the job is done */
+	} else {
+		ret = r->hndlr(ctx, &c->conn.out, argc, argv);
+	}
+	srv_reply(&c->conn.out, ret, argv[0]);
+}
+
+/*
+ * @brief
+ * Execute the complete request lines received from a client, up to one
+ * handed to a worker thread; the rest is kept for later.
+ *
+ * @param [in] ctx daemon state
+ * @param [in] c client
+ * @return void
+ */
+static void
+srv_run_lines(struct srv_ctx *ctx, struct srv_client *c)
+{
+	char *nl, *line;
+	size_t used;
+
+	line = c->in;
+	while (!c->job &&
+	       (nl = memchr(line, '\n', c->in_len - (line - c->in)))) {
+		*nl = '\0';
+		srv_handle_line(ctx, c, line);
+		line = nl + 1;
+	}
+	used = line - c->in;
+	memmove(c->in, line, c->in_len - used);
+	c->in_len -= used;
+
+	if (!c->job && c->in_len == sizeof(c->in)) {
+		aiopt_evl_printf(&c->conn.out, "ERR %d Request too long\n",
+				 -E2BIG);
+		c->conn.closing = TRUE;
+	}
+}
+
+/* ========================================================================
+ * Server: connections
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Called by the event loop as a client is closed
+ *
+ * @param [in] evl event loop
+ * @param [in] conn client
+ * @return void
+ */
+static void
+srv_on_close(aiopt_evl_t *evl, struct aiopt_evl_conn *conn)
+{
+	struct srv_client *c = (struct srv_client *)conn;
+
+	/* A job in progress completes without it */
+	if (c->job)
+		c->job->c = NULL;
+}
+
+/*
+ * @brief
+ * Queue the responses of the jobs posted back by workers and resume the
+ * requests of their clients
+ *
+ * @param [in] evl event loop
+ * @param [in] arg daemon state
+ * @return void
+ */
+static void
+srv_jobs_done(aiopt_evl_t *evl, void *arg)
+{
+	struct srv_ctx *ctx = arg;
+	struct srv_job *job;
+	struct srv_client *c;
+
+	while (read(ctx->jfd[0], &job, sizeof(job)) == sizeof(job)) {
+		c = job->c;
+		if (c) {
+			if (job->out.len)
+				aiopt_evl_printf(&c->conn.out, "%s",
+						 job->out.data);
+			srv_reply(&c->conn.out, job->ret, job->argv[0]);
+			c->job = NULL;
+		}
+		srv_job_free(ctx, job);
+		if (!c)
+			continue;
+
+		srv_run_lines(ctx, c);
+		/* Events of the client still pending in this batch are dropped
+		 * by the loop, which frees it after the batch
+		 */
+		if (srv_flush(ctx, c) != AIOPT_SUCCESS || srv_done(c))
+			aiopt_evl_close(evl, &c->conn);
+	}
+}
+
+/*
+ * @brief
+ * Read from a client and execute every complete request line
+ *
+ * @param [in] ctx daemon state
+ * @param [in] c client
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if the connection is broken
+ */
+static int
+srv_read(struct srv_ctx *ctx, struct srv_client *c)
+{
+	ssize_t n;
+
+	while (!c->conn.closing && !c->job) {
+		n = recv(c->conn.fd, c->in + c->in_len,
+			 sizeof(c->in) - c->in_len, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return AIOPT_FAILURE;
+		}
+		if (n == 0) {
+			c->conn.closing = TRUE;
+			break;
+		}
+		c->in_len += n;
+		srv_run_lines(ctx, c);
+	}
+
+	return srv_flush(ctx, c);
+}
+
+/*
+ * @brief
+ * Handle the events of a client, as called by the event loop
+ *
+ * @param [in] evl event loop
+ * @param [in] conn client
+ * @param [in] events epoll events
+ * @return AIOPT_SUCCESS, or AIOPT_FAILURE for the client to be closed
+ */
+static int
+srv_on_conn(aiopt_evl_t *evl, struct aiopt_evl_conn *conn,
+	    unsigned int events)
+{
+	int ret;
+	struct srv_client *c = (struct srv_client *)conn;
+
+	if (events & EPOLLIN)
+		ret = srv_read(evl->arg, c);
+	else
+		ret = srv_flush(evl->arg, c);
+
+	if (ret != AIOPT_SUCCESS || srv_done(c))
+		return AIOPT_FAILURE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Create the listening socket. A stale socket file left by a daemon which
+ * did not exit cleanly is removed; a live one is an error.
+ *
+ * @param [in] path socket path
+ * @return socket descriptor or AIOPT_FAILURE
+ */
+static int
+srv_listen(const char *path)
+{
+	int fd;
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		AIOPT_ERR("Socket path too long: (%s)\n", path);
+		return AIOPT_FAILURE;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return AIOPT_FAILURE;
+
+	if (!connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		AIOPT_ERR("A daemon is already serving (%s)\n", path);
+		close(fd);
+		return AIOPT_FAILURE;
+	}
+	close(fd);
+	unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return AIOPT_FAILURE;
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, SOMAXCONN) < 0) {
+		AIOPT_ERR("Unable to listen on (%s). (err=%d)\n", path, errno);
+		close(fd);
+		return AIOPT_FAILURE;
+	}
+
+	return fd;
+}
+
+/* ========================================================================
+ * Client
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Build the request line for a sub-command
+ *
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ * @param [out] req buffer for the request, AIOPT_SRV_LINE_MAX bytes
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE if not available through the daemon
+ */
+static int
+client_build_request(aiopt_conf_t *conf, char *req)
+{
+	int len;
+	char image[PATH_MAX], args[PATH_MAX];
+
+	if (!strcmp(conf->command, "status") ||
+	    !strcmp(conf->command, "gettod") ||
+	    !strcmp(conf->command, "reset") ||
+	    !strcmp(conf->command, "list")) {
+		len = snprintf(req, AIOPT_SRV_LINE_MAX, "%s\n", conf->command);
+	} else if (!strcmp(conf->command, "settod")) {
+		len = snprintf(req, AIOPT_SRV_LINE_MAX, "settod %lu\n",
+			       conf->tod);
+	} else if (!strcmp(conf->command, "stats")) {
+		len = snprintf(req, AIOPT_SRV_LINE_MAX, "stats%s\n",
+			       conf->json_flag ? " json" : "");
+	} else if (!strcmp(conf->command, "wait")) {
+		len = snprintf(req, AIOPT_SRV_LINE_MAX, "wait %s %u\n",
+			       aiopt_get_state_str(conf->wait_state),
+			       conf->timeout_ms);
+	} else if (!strcmp(conf->command, "load")) {
+		/* Requests carry paths only; args must be in a file */
+		if (conf->args_mem) {
+			AIOPT_ERR("Inline args cannot be passed to the "
+				  "daemon; use an args file.\n");
+			return AIOPT_FAILURE;
+		}
+		/* Files are opened by the daemon, which has its own cwd */
+		if (!realpath(conf->image_file, image) ||
+		    (conf->args_file && !realpath(conf->args_file, args))) {
+			AIOPT_ERR("Unable to resolve file path. (err=%d)\n",
+				  errno);
+			return AIOPT_FAILURE;
+		}
+		if (strchr(image, ' ') ||
+		    (conf->args_file && strchr(args, ' '))) {
+			AIOPT_ERR("File paths with spaces cannot be passed to "
+				  "the daemon.\n");
+			return AIOPT_FAILURE;
+		}
+		len = snprintf(req, AIOPT_SRV_LINE_MAX,
+			       "load %s%s%s%s tpc=%u timeout=%u%s\n", image,
+			       conf->args_file ? " args=" : "",
+			       conf->args_file ? args : "",
+			       conf->reset_flag ? " reset" : "",
+			       conf->tpc_flag ? conf->tpc :
+						DEFAULT_THREAD_PER_CORE,
+			       conf->timeout_flag ? conf->timeout_ms :
+						    AIOPT_LOAD_DEF_TIMEOUT_MS,
+			       conf->skip_flag ? " skip" : "");
+	} else {
+		AIOPT_ERR("Sub-command (%s) is not served by the daemon.\n",
+			  conf->command);
+		return AIOPT_FAILURE;
+	}
+
+	if (len < 0 || len >= AIOPT_SRV_LINE_MAX) {
+		AIOPT_ERR("Request too long for the daemon.\n");
+		return AIOPT_FAILURE;
+	}
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Print the result of a sub-command executed by the daemon, as the
+ * sub-command does when run locally
+ *
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ * @param [in] fp response stream from the daemon
+ * @return AIOPT_SUCCESS, or AIOPT_FAILURE if the daemon reported an error
+ */
+static int
+client_print_response(aiopt_conf_t *conf, FILE *fp)
+{
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	int ret = AIOPT_FAILURE, err = 0;
+	int maj = 0, min = 0, rev = 0, state = -1;
+	int id = 0, api_maj = 0, api_min = 0;
+	uint64_t tod = 0;
+	short int have_report = FALSE;
+	aiopt_load_report_t r;
+
+	while ((len = getline(&line, &cap, fp)) > 0) {
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		if (!strncmp(line, "+ ", 2)) {
+			if (sscanf(line, "+ version %d %d %d",
+				   &id, &api_maj, &api_min) == 3 ||
+			    sscanf(line, "+ sl_version %d %d %d",
+				   &maj, &min, &rev) == 3 ||
+			    sscanf(line, "+ state %d", &state) == 1 ||
+			    sscanf(line, "+ tod %lu", &tod) == 1)
+				continue;
+			if (sscanf(line, "+ load_report %d %lu %lu %lu %lu %lu "
+				   "%lu %hd", &r.state, &r.prepared_ns,
+				   &r.reset_ns, &r.loaded_ns, &r.booting_ns,
+				   &r.running_ns, &r.total_ns,
+				   &r.skipped) == 8) {
+				have_report = TRUE;
+				continue;
+			}
+			AIOPT_PRINT("%s\n", line + 2);
+			continue;
+		}
+
+		if (!strcmp(line, "OK")) {
+			ret = AIOPT_SUCCESS;
+		} else {
+			sscanf(line, "ERR %d", &err);
+			AIOPT_DEBUG("Daemon: (%s)\n", line);
+		}
+		break;
+	}
+	free(line);
+
+	if (len <= 0) {
+		AIOPT_ERR("Connection to daemon closed.\n");
+		return AIOPT_FAILURE;
+	}
+
+	if (!strcmp(conf->command, "status") && ret == AIOPT_SUCCESS) {
+		AIOPT_PRINT("AIOP Tile Status:\n");
+		AIOPT_PRINT("\t dpaiop.%d:- API Major Version: %d,"
+			" API Minor Version: %d\n", id, api_maj, api_min);
+		AIOPT_PRINT("\t Service Layer:- Major Version: %d,"
+			" Minor Version: %d, Revision: %d\n", maj, min, rev);
+		AIOPT_PRINT("\t State: %s\n", aiopt_get_state_str(state));
+		AIOPT_PRINT("\n");
+	} else if (!strcmp(conf->command, "gettod")) {
+		if (ret == AIOPT_SUCCESS) {
+			AIOPT_PRINT("Time of day: %lu\n", tod);
+		} else {
+			AIOPT_PRINT("Get time of day unsuccessful. (err=%d)\n",
+				    err);
+		}
+	} else if (!strcmp(conf->command, "reset")) {
+		if (ret == AIOPT_SUCCESS) {
+			AIOPT_PRINT("AIOP Tile Reset Successful.\n");
+		} else {
+			AIOPT_PRINT("AIOPT Tile Reset Failed. (err=%d)\n", err);
+		}
+	} else if (!strcmp(conf->command, "load")) {
+		if (ret == AIOPT_SUCCESS) {
+			AIOPT_PRINT("AIOP Image (%s) with args (%s) loaded "
+				    "successfully.\n", conf->image_file,
+				    conf->args_file);
+		} else if (err == AIOPT_ETIMEDOUT) {
+			AIOPT_PRINT("AIOP Image (%s) with args (%s) not running "
+				    "in time.\n", conf->image_file,
+				    conf->args_file);
+			ret = AIOPT_ETIMEDOUT;
+		} else if (err == AIOPT_EBADIMAGE) {
+			AIOPT_PRINT("AIOP Image (%s) failed verification; not "
+				    "loaded.\n", conf->image_file);
+		} else if (err == AIOPT_EBUSY) {
+			AIOPT_PRINT("AIOP Image (%s) not loaded; an earlier load "
+				    "is still in progress. Load with reset "
+				    "(-r).\n", conf->image_file);
+		} else {
+			AIOPT_PRINT("AIOP Image (%s) with args (%s) loading "
+				    "failed. (err=%d)\n", conf->image_file,
+				    conf->args_file, err);
+		}
+		if (have_report)
+			aiopt_dump_load_report(stdout, &r);
+	} else if (!strcmp(conf->command, "wait")) {
+		if (ret == AIOPT_SUCCESS) {
+			AIOPT_PRINT("AIOP Tile State: %s\n",
+				    aiopt_get_state_str(state));
+		} else if (err == AIOPT_ETIMEDOUT) {
+			AIOPT_PRINT("Timed out waiting for %s; AIOP Tile "
+				    "State: %s\n",
+				    aiopt_get_state_str(conf->wait_state),
+				    aiopt_get_state_str(state));
+			ret = AIOPT_ETIMEDOUT;
+		} else {
+			AIOPT_PRINT("Waiting for %s failed; AIOP Tile State: "
+				    "%s\n",
+				    aiopt_get_state_str(conf->wait_state),
+				    aiopt_get_state_str(state));
+		}
+	}
+
+	return ret;
+}
+
+/* ========================================================================
+ * Externally available API definitions
+ * ======================================================================== */
+
+/*
+ * @brief
+ * Serve requests on a Unix domain socket until SIGINT or SIGTERM
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] path Socket path; NULL for AIOPT_DEF_SOCKET_PATH
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_serve(aiopt_handle_t handle, const char *path)
+{
+	int i, lfd, ret = AIOPT_FAILURE;
+	struct srv_ctx *ctx;
+
+	AIOPT_DEV("Entering\n");
+
+	if (!path)
+		path = AIOPT_DEF_SOCKET_PATH;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return AIOPT_FAILURE;
+	ctx->handle = handle;
+	pthread_mutex_init(&ctx->load_lock, NULL);
+
+	/* Jobs done are posted by workers through a pipe; only its read end
+	 * is non-blocking.
+	 */
+	if (pipe2(ctx->jfd, O_CLOEXEC) < 0) {
+		AIOPT_DEBUG("Unable to create job pipe. (err=%d)\n", errno);
+		pthread_mutex_destroy(&ctx->load_lock);
+		free(ctx);
+		return AIOPT_FAILURE;
+	}
+	fcntl(ctx->jfd[0], F_SETFL, O_NONBLOCK);
+
+	if (aiopt_evl_init(&ctx->evl, sizeof(struct srv_client),
+			   AIOPT_SRV_MAX_CLIENTS, srv_on_conn, srv_on_close,
+			   ctx) != AIOPT_SUCCESS) {
+		close(ctx->jfd[0]);
+		close(ctx->jfd[1]);
+		pthread_mutex_destroy(&ctx->load_lock);
+		free(ctx);
+		return AIOPT_FAILURE;
+	}
+
+	lfd = srv_listen(path);
+	if (lfd < 0)
+		goto out;
+
+	if (aiopt_evl_listen(&ctx->evl, lfd) != AIOPT_SUCCESS ||
+	    aiopt_evl_add(&ctx->evl, ctx->jfd[0], srv_jobs_done, ctx) !=
+	    AIOPT_SUCCESS)
+		goto out_unlink;
+
+	/* Loads through the daemon share one DMA arena */
+	if (aiopt_dma_arena_setup(handle, 0) != AIOPT_SUCCESS)
+		AIOPT_DEBUG("DMA arena not available; mapping per load.\n");
+
+	AIOPT_PRINT("Serving on (%s).\n", path);
+
+	if (aiopt_evl_run(&ctx->evl) != AIOPT_SUCCESS)
+		goto out_unlink;
+
+	AIOPT_LIB_INFO("Served %lu requests.\n", ctx->requests);
+	ret = AIOPT_SUCCESS;
+
+out_unlink:
+	unlink(path);
+out:
+	aiopt_evl_close_all(&ctx->evl);
+	/* The handle outlives the call; jobs on it are let to complete */
+	if (ctx->njobs)
+		AIOPT_LIB_INFO("Waiting for %u requests in progress.\n",
+				ctx->njobs);
+	for (i = 0; i < SRV_MAX_JOBS; i++) {
+		if (ctx->jobs[i])
+			srv_job_free(ctx, ctx->jobs[i]);
+	}
+	aiopt_evl_fini(&ctx->evl);
+	close(ctx->jfd[0]);
+	close(ctx->jfd[1]);
+	pthread_mutex_destroy(&ctx->load_lock);
+	free(ctx);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Execute a sub-command through the daemon listening on conf->socket
+ *
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return AIOPT_SUCCESS or AIOPT_FAILURE
+ */
+int
+aiopt_client_run(aiopt_conf_t *conf)
+{
+	int fd, ret;
+	size_t off, len;
+	ssize_t n;
+	char req[AIOPT_SRV_LINE_MAX];
+	struct sockaddr_un addr;
+	FILE *fp;
+
+	AIOPT_DEV("Entering\n");
+
+	ret = client_build_request(conf, req);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(conf->socket) >= sizeof(addr.sun_path)) {
+		AIOPT_ERR("Socket path too long: (%s)\n", conf->socket);
+		return AIOPT_FAILURE;
+	}
+	strcpy(addr.sun_path, conf->socket);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return AIOPT_FAILURE;
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		AIOPT_ERR("Unable to reach daemon at (%s). (err=%d)\n",
+			  conf->socket, errno);
+		close(fd);
+		return AIOPT_FAILURE;
+	}
+
+	AIOPT_DEBUG("Request to daemon: %s", req);
+	len = strlen(req);
+	for (off = 0; off < len; off += n) {
+		n = send(fd, req + off, len - off, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n < 0) {
+			AIOPT_ERR("Unable to send request. (err=%d)\n", errno);
+			close(fd);
+			return AIOPT_FAILURE;
+		}
+	}
+	shutdown(fd, SHUT_WR);
+
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return AIOPT_FAILURE;
+	}
+
+	ret = client_print_response(conf, fp);
+	fclose(fp);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
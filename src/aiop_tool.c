@@ -39,7 +39,6 @@
 #include <stdint.h>
 #include <errno.h>
 #include <getopt.h>
-#include <sys/select.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -52,6 +51,9 @@
 #include <aiop_tool.h>
 #include <aiop_logger.h>
 #include <aiop_tool_dummy.h>
+#include <aiop_server.h>
+#include <aiop_exporter.h>
+#include <aiop_fleet.h>
 
 /* Flib and VFIO Headers */
 #include <fsl_vfio.h>
@@ -72,6 +74,11 @@ int perform_aiop_reset(aiopt_handle_t handle, aiopt_conf_t *conf);
 int perform_aiop_get_status(aiopt_handle_t handle, aiopt_conf_t *conf);
 int perform_aiop_gettod(aiopt_handle_t handle, aiopt_conf_t *conf);
 int perform_aiop_settod(aiopt_handle_t handle, aiopt_conf_t *conf);
+int perform_aiop_stats(aiopt_handle_t handle, aiopt_conf_t *conf);
+int perform_aiop_serve(aiopt_handle_t handle, aiopt_conf_t *conf);
+int perform_aiop_wait(aiopt_handle_t handle, aiopt_conf_t *conf);
+int perform_aiop_list(aiopt_handle_t handle, aiopt_conf_t *conf);
+int perform_aiop_exporter(aiopt_handle_t handle, aiopt_conf_t *conf);
 /* XXX Add more operations, as required, and update the aiopt_ops */
 
 /* ===========================================================================
@@ -96,6 +103,11 @@ aiopt_ops_t aiopt_ops[MAX_SUB_COMMANDS] = {
 	{"status", perform_aiop_get_status},
 	{"gettod", perform_aiop_gettod},
 	{"settod", perform_aiop_settod},
+	{"stats", perform_aiop_stats},
+	{"serve", perform_aiop_serve},
+	{"wait", perform_aiop_wait},
+	{"list", perform_aiop_list},
+	{"exporter", perform_aiop_exporter},
 	{NULL, NULL} /* Add entries above this */
 };
 #else
@@ -106,6 +118,11 @@ aiopt_ops_t aiopt_ops[MAX_SUB_COMMANDS] = {
 	{"status", dummy_perform_aiop_get_status},
 	{"gettod", dummy_perform_aiop_gettod},
 	{"settod", dummy_perform_aiop_settod},
+	{"stats", dummy_perform_aiop_stats},
+	{"serve", dummy_perform_aiop_serve},
+	{"wait", dummy_perform_aiop_wait},
+	{"list", dummy_perform_aiop_list},
+	{"exporter", dummy_perform_aiop_exporter},
 	{NULL, NULL} /* Add entries above this */
 };
 
@@ -134,12 +151,27 @@ create_conf_inst(aiopt_conf_t *h)
 	h->container = gvars.container_name;
 	h->image_file = gvars.image_file;
 	h->args_file = gvars.args_file[0]?gvars.args_file:NULL;
+	h->args_mem = gvars.args_mem_flag ? gvars.args_mem : NULL;
+	h->args_mem_sz = gvars.args_mem_sz;
 	h->tpc = gvars.tpc;
 	h->tpc_flag = gvars.tpc_flag;
 	h->reset_flag = gvars.reset_flag;
+	h->skip_flag = gvars.skip_flag;
 	h->debug_flag = gvars.debug_flag;
 	h->verbose_flag = gvars.verbose_flag;
 	h->tod = gvars.tod_val;
+	h->json_flag = gvars.json_flag;
+	h->socket = gvars.socket_flag ? gvars.socket_path : NULL;
+	h->wait_state = gvars.state;
+	h->timeout_ms = gvars.timeout_flag ? gvars.timeout_ms :
+					     AIOPT_WAIT_FOREVER;
+	h->timeout_flag = gvars.timeout_flag;
+	h->image_max = gvars.image_max;
+	h->args_max = gvars.args_max;
+	h->aiop_id = gvars.aiop_id_flag ? gvars.aiop_id : AIOPT_AIOP_ID_ANY;
+	h->listen = gvars.listen_flag ? gvars.listen : NULL;
+	h->textfile = gvars.textfile_flag ? gvars.textfile : NULL;
+	h->interval_ms = gvars.interval_flag ? gvars.interval_ms : 0;
 }
 
 /*
@@ -188,7 +220,8 @@ get_ops_handler(char *cmd_name)
 
 /*
  * @brief
- * Wrapper over aiopt_load library call
+ * Wrapper over aiopt_load library call. Returns once the tile is RUNNING,
+ * has failed or the timeout (-T) expired, printing the load timeline.
  *
  * @param [in] handle aiopt_handle_t type valid object
  * @param [in] conf aiopt_conf_t type object filled with configuration info
@@ -199,20 +232,61 @@ int
 perform_aiop_load(aiopt_handle_t handle, aiopt_conf_t *conf)
 {
 	int ret;
+	const char *args_name;
+	aiopt_load_report_t report;
+
 	AIOPT_DEV("Entering\n");
 
-	ret = aiopt_load(handle, conf->image_file, conf->args_file,
-			 conf->reset_flag,
-			 conf->tpc_flag ? conf->tpc : DEFAULT_THREAD_PER_CORE);
+	if (conf->timeout_flag)
+		aiopt_set_load_timeout(handle, conf->timeout_ms);
+	aiopt_set_load_skip(handle, conf->skip_flag);
+	ret = aiopt_set_load_limits(handle, conf->image_max, conf->args_max);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_ERR("Unsupported image or args size limit.\n");
+		return ret;
+	}
+
+	/* Image is read into a pre-mapped DMA arena; without one, aiopt_load
+	 * maps the files for the duration of the load.
+	 */
+	ret = aiopt_dma_arena_setup(handle, 0);
+	if (ret != AIOPT_SUCCESS)
+		AIOPT_DEBUG("DMA arena not available; mapping per load.\n");
+
+	if (conf->args_mem) {
+		args_name = "inline";
+		ret = aiopt_load_args_mem(handle, conf->image_file,
+					  conf->args_mem, conf->args_mem_sz,
+					  conf->reset_flag,
+					  conf->tpc_flag ? conf->tpc :
+						DEFAULT_THREAD_PER_CORE);
+	} else {
+		args_name = conf->args_file;
+		ret = aiopt_load(handle, conf->image_file, conf->args_file,
+				 conf->reset_flag,
+				 conf->tpc_flag ? conf->tpc :
+					DEFAULT_THREAD_PER_CORE);
+	}
 	if (ret == AIOPT_SUCCESS) {
 		AIOPT_PRINT("AIOP Image (%s) with args (%s) loaded successfully.\n",
-			conf->image_file, conf->args_file);
+			conf->image_file, args_name);
+	} else if (ret == AIOPT_ETIMEDOUT) {
+		AIOPT_PRINT("AIOP Image (%s) with args (%s) not running in time.\n",
+			conf->image_file, args_name);
+	} else if (ret == AIOPT_EBADIMAGE) {
+		AIOPT_PRINT("AIOP Image (%s) failed verification; not loaded.\n",
+			conf->image_file);
+	} else if (ret == AIOPT_EBUSY) {
+		AIOPT_PRINT("AIOP Image (%s) not loaded; an earlier load is still "
+			"in progress. Load with reset (-r).\n", conf->image_file);
 	} else {
 		AIOPT_PRINT("AIOP Image (%s) with args (%s) loading failed. (err=%d)\n",
-			conf->image_file, conf->args_file, ret);
+			conf->image_file, args_name, ret);
 	}
 
-	select(1, NULL, NULL, NULL, NULL);
+	if (aiopt_get_load_report(handle, &report) == AIOPT_SUCCESS)
+		aiopt_dump_load_report(stdout, &report);
+
 	AIOPT_DEV("Exiting (%d)\n", ret);
 	return ret;
 }
@@ -264,10 +338,13 @@ perform_aiop_get_status(aiopt_handle_t handle, aiopt_conf_t *conf)
 
 	if (ret == AIOPT_SUCCESS) {
 		AIOPT_PRINT("AIOP Tile Status:\n");
+		AIOPT_PRINT("\t dpaiop.%d:- API Major Version: %d,"
+			" API Minor Version: %d\n",
+			status.id, status.major_v, status.minor_v);
 		AIOPT_PRINT("\t Service Layer:- Major Version: %d,"
 			" Minor Version: "
 			"%d, Revision: %d\n",
-			status.sl_minor_v, status.sl_major_v,
+			status.sl_major_v, status.sl_minor_v,
 			status.sl_revision);
 		AIOPT_PRINT("\t State: %s\n",
 			aiopt_get_state_str(status.state));
@@ -332,6 +409,258 @@ perform_aiop_settod(aiopt_handle_t handle, aiopt_conf_t *conf)
 	AIOPT_DEV("Exiting\n");
 	return ret;
 }
+
+/*
+ * @brief
+ * Dump MC command statistics. The statistics are kept per process, so
+ * a snapshot of the tile (see aiopt_snapshot) is taken first to sample
+ * the MC before the dump. Without a daemon socket (-s), they are only those
+ * of this invocation, which the text output notes.
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return return value from aiopt_mc_stats_dump
+ */
+int
+perform_aiop_stats(aiopt_handle_t handle, aiopt_conf_t *conf)
+{
+	int ret;
+	aiopt_snapshot_t snap;
+
+	AIOPT_DEV("Entering\n");
+
+	ret = aiopt_snapshot(handle, &snap);
+	if (ret != AIOPT_SUCCESS)
+		AIOPT_DEBUG("Snapshot query failed. (read=0x%x)\n",
+				snap.valid);
+
+	ret = aiopt_mc_stats_dump(stdout, conf->json_flag);
+	if (ret == AIOPT_SUCCESS && !conf->json_flag)
+		AIOPT_PRINT("\nNote: MC commands of this invocation only; give "
+			    "-s <Socket path> (or %s) for those of the "
+			    "daemon.\n", AIOPT_SOCKET_ENV_VAR);
+
+	AIOPT_DEV("Exiting\n");
+	return ret;
+}
+
+/*
+ * @brief
+ * Run as daemon, serving other invocations of the tool over the control
+ * socket until SIGINT/SIGTERM
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return return value from aiopt_serve
+ */
+int
+perform_aiop_serve(aiopt_handle_t handle, aiopt_conf_t *conf)
+{
+	int ret;
+
+	AIOPT_DEV("Entering\n");
+
+	/* Limits of all loads through the daemon */
+	ret = aiopt_set_load_limits(handle, conf->image_max, conf->args_max);
+	if (ret != AIOPT_SUCCESS) {
+		AIOPT_ERR("Unsupported image or args size limit.\n");
+		return ret;
+	}
+
+	ret = aiopt_serve(handle, conf->socket);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Wrapper over aiopt_wait_state library call, waiting for the AIOP Tile to
+ * reach the State provided with --state
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return return value from aiopt_wait_state
+ */
+int
+perform_aiop_wait(aiopt_handle_t handle, aiopt_conf_t *conf)
+{
+	int ret;
+	int state = -1;
+
+	AIOPT_DEV("Entering\n");
+
+	ret = aiopt_wait_state(handle, conf->wait_state, conf->timeout_ms,
+			       &state);
+	if (ret == AIOPT_SUCCESS) {
+		AIOPT_PRINT("AIOP Tile State: %s\n",
+			aiopt_get_state_str(state));
+	} else if (ret == AIOPT_ETIMEDOUT) {
+		AIOPT_PRINT("Timed out waiting for %s; AIOP Tile State: %s\n",
+			aiopt_get_state_str(conf->wait_state),
+			aiopt_get_state_str(state));
+	} else {
+		AIOPT_PRINT("Waiting for %s failed; AIOP Tile State: %s\n",
+			aiopt_get_state_str(conf->wait_state),
+			aiopt_get_state_str(state));
+	}
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Wrapper over aiopt_list library call, printing every dpaiop and dpmcp
+ * object of the container
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return return value from aiopt_list
+ */
+int
+perform_aiop_list(aiopt_handle_t handle, aiopt_conf_t *conf)
+{
+	int ret;
+	unsigned int count;
+	aiopt_dpobj_info_t *info;
+
+	AIOPT_DEV("Entering\n");
+
+	ret = aiopt_list(handle, NULL, 0, &count);
+	if (ret != AIOPT_SUCCESS)
+		return ret;
+
+	info = calloc(count, sizeof(*info));
+	if (!info) {
+		AIOPT_ERR("Unable to allocate memory.\n");
+		return AIOPT_FAILURE;
+	}
+
+	ret = aiopt_list(handle, info, count, &count);
+	if (ret == AIOPT_SUCCESS)
+		aiopt_dump_list(stdout, info, count);
+	free(info);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Wrapper over aiopt_export library call, exporting the metrics of the AIOP
+ * Tile until SIGINT/SIGTERM
+ *
+ * @param [in] handle aiopt_handle_t type valid object
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return return value from aiopt_export
+ */
+int
+perform_aiop_exporter(aiopt_handle_t handle, aiopt_conf_t *conf)
+{
+	int ret;
+	aiopt_exporter_conf_t exp_conf = {0};
+
+	AIOPT_DEV("Entering\n");
+
+	exp_conf.container = conf->container;
+	exp_conf.listen = conf->listen;
+	exp_conf.textfile = conf->textfile;
+	exp_conf.interval_ms = conf->interval_ms;
+
+	ret = aiopt_export(handle, &exp_conf);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Execute the sub-command on every container of a fleet (-g with a list or
+ * pattern of containers) in parallel and print a table of results
+ *
+ * @param [in] conf aiopt_conf_t type object filled with configuration info
+ *
+ * @return AIOPT_SUCCESS if the sub-command succeeded on all containers
+ */
+static int
+perform_fleet_op(aiopt_conf_t *conf)
+{
+	int ret;
+	aiopt_fleet_t *fleet;
+	aiopt_fleet_req_t req = {0};
+
+	AIOPT_DEV("Entering\n");
+
+	if (!strcmp(conf->command, "load")) {
+		req.op = AIOPT_FLEET_LOAD;
+		req.image_file = conf->image_file;
+		req.args_file = conf->args_file;
+		req.args_mem = conf->args_mem;
+		req.args_mem_sz = conf->args_mem_sz;
+		req.reset = conf->reset_flag;
+		req.skip = conf->skip_flag;
+		req.image_max = conf->image_max;
+		req.args_max = conf->args_max;
+		req.tpc = conf->tpc_flag ? conf->tpc : DEFAULT_THREAD_PER_CORE;
+		req.timeout_ms = conf->timeout_flag ? conf->timeout_ms :
+						      AIOPT_LOAD_DEF_TIMEOUT_MS;
+	} else if (!strcmp(conf->command, "status")) {
+		req.op = AIOPT_FLEET_STATUS;
+	} else if (!strcmp(conf->command, "reset")) {
+		req.op = AIOPT_FLEET_RESET;
+		req.timeout_ms = conf->timeout_flag ? conf->timeout_ms :
+						      AIOPT_LOAD_DEF_TIMEOUT_MS;
+	} else if (!strcmp(conf->command, "gettod")) {
+		req.op = AIOPT_FLEET_GETTOD;
+	} else if (!strcmp(conf->command, "settod")) {
+		req.op = AIOPT_FLEET_SETTOD;
+		req.tod = conf->tod;
+	} else if (!strcmp(conf->command, "wait")) {
+		req.op = AIOPT_FLEET_WAIT;
+		req.state = conf->wait_state;
+		req.timeout_ms = conf->timeout_ms;
+	} else {
+		AIOPT_ERR("Sub-command %s cannot be run on multiple "
+			  "containers\n", conf->command);
+		return AIOPT_FAILURE;
+	}
+
+	fleet = aiopt_fleet_create(conf->container);
+	if (!fleet) {
+		AIOPT_ERR("Unable to open Containers (%s)\n", conf->container);
+		return AIOPT_FAILURE;
+	}
+
+	ret = aiopt_fleet_run(fleet, &req, 0);
+	aiopt_fleet_print(fleet, &req, stdout);
+	aiopt_fleet_destroy(fleet);
+
+	AIOPT_DEV("Exiting (%d)\n", ret);
+	return ret;
+}
+
+/*
+ * @brief
+ * Exit status of the tool for the result of a sub-command
+ *
+ * @param [in] ret AIOPT_SUCCESS or error returned by the sub-command
+ * @return 0, AIOPT_EXIT_TIMEOUT or another non-zero status
+ */
+static int
+exit_status(int ret)
+{
+	if (ret == AIOPT_ETIMEDOUT)
+		return AIOPT_EXIT_TIMEOUT;
+
+	return ret;
+}
+
 /* ===========================================================================
  * Function Definitions
  * ===========================================================================
@@ -344,6 +673,7 @@ int main(int argc, char **argv)
 	aiopt_op	op = NULL;
 
 	aiopt_handle_t aiopt_handle = AIOPT_INVALID_HANDLE;
+	aiopt_init_report_t init_report;
 
 	/* TODO Signal Handling is missing */
 
@@ -371,8 +701,33 @@ int main(int argc, char **argv)
 	
 #ifndef AIOP_CMDSYS_UNIT_TEST /* If not command line sub-sys unit testing */
 
+	/* With a daemon socket, the sub-command is executed by the daemon
+	 * which holds the AIOP handle; nothing is initialized here. The
+	 * exporter, like the daemon, holds a handle of its own.
+	 */
+	if (conf.socket && strcmp(conf.command, "serve") &&
+	    strcmp(conf.command, "exporter")) {
+		/* The daemon operates on the dpaiop it was started on */
+		if (conf.aiop_id != AIOPT_AIOP_ID_ANY) {
+			AIOPT_ERR("AIOP ID cannot be given with a daemon "
+				  "socket.\n");
+			return AIOPT_FAILURE;
+		}
+		return exit_status(aiopt_client_run(&conf));
+	}
+
+	/* Multiple containers: each is initialized by the fleet workers */
+	if (aiopt_fleet_is_spec(conf.container)) {
+		if (conf.aiop_id != AIOPT_AIOP_ID_ANY) {
+			AIOPT_ERR("AIOP ID cannot be given with multiple "
+				  "containers.\n");
+			return AIOPT_FAILURE;
+		}
+		return exit_status(perform_fleet_op(&conf));
+	}
+
 	/* Initialize the AIOP library and obtain handle */
-	aiopt_handle = aiopt_init(conf.container);
+	aiopt_handle = aiopt_init_aiop(conf.container, conf.aiop_id);
 	if (AIOPT_INVALID_HANDLE == aiopt_handle) {
 		AIOPT_ERR("Unable to open Container (%s)\n", conf.container);
 		AIOPT_DEV("Handle cannot be opened/allocated.\n");
@@ -384,6 +739,9 @@ int main(int argc, char **argv)
 	 */
 	AIOPT_DEV("Obtained AIOP handle (%p).\n", aiopt_handle);
 	AIOPT_DEBUG("AIOP sub-system initialized.\n");
+	if (conf.verbose_flag &&
+	    aiopt_get_init_report(aiopt_handle, &init_report) == AIOPT_SUCCESS)
+		aiopt_dump_init_report(stdout, &init_report);
 
 	/* Handle Sub-command */
 	ret = op(aiopt_handle, &conf);
@@ -401,5 +759,5 @@ int main(int argc, char **argv)
 		ret = ret_2;
 #endif
 
-	return ret;
+	return exit_status(ret);
 }
@@ -80,3 +80,42 @@ dummy_perform_aiop_settod(fsl_vfio_t handle, aiopt_conf_t *conf)
 	return AIOPT_SUCCESS;
 }
 
+int
+dummy_perform_aiop_stats(fsl_vfio_t handle, aiopt_conf_t *conf)
+{
+	AIOPT_DEV("Entering\n");
+	AIOPT_DEV("Exiting\n");
+	return AIOPT_SUCCESS;
+}
+
+int
+dummy_perform_aiop_serve(fsl_vfio_t handle, aiopt_conf_t *conf)
+{
+	AIOPT_DEV("Entering\n");
+	AIOPT_DEV("Exiting\n");
+	return AIOPT_SUCCESS;
+}
+
+int
+dummy_perform_aiop_wait(fsl_vfio_t handle, aiopt_conf_t *conf)
+{
+	AIOPT_DEV("Entering\n");
+	AIOPT_DEV("Exiting\n");
+	return AIOPT_SUCCESS;
+}
+
+int
+dummy_perform_aiop_list(fsl_vfio_t handle, aiopt_conf_t *conf)
+{
+	AIOPT_DEV("Entering\n");
+	AIOPT_DEV("Exiting\n");
+	return AIOPT_SUCCESS;
+}
+
+int
+dummy_perform_aiop_exporter(fsl_vfio_t handle, aiopt_conf_t *conf)
+{
+	AIOPT_DEV("Entering\n");
+	AIOPT_DEV("Exiting\n");
+	return AIOPT_SUCCESS;
+}
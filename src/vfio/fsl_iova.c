@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file	fsl_iova.c
+ *
+ * @brief	Bitmap allocator of IOVA space for VFIO DMA mappings
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fsl_vfio.h>
+#include <fsl_iova.h>
+
+#define IOVA_WORD_BITS	(8 * sizeof(unsigned long))
+
+static inline int iova_test(const struct fsl_iova_space *sp, size_t i)
+{
+	return !!(sp->bitmap[i / IOVA_WORD_BITS] &
+		  (1UL << (i % IOVA_WORD_BITS)));
+}
+
+static void iova_set_range(struct fsl_iova_space *sp, size_t first,
+			   size_t n, int val)
+{
+	size_t i;
+
+	for (i = first; i < first + n; i++) {
+		if (val)
+			sp->bitmap[i / IOVA_WORD_BITS] |=
+				1UL << (i % IOVA_WORD_BITS);
+		else
+			sp->bitmap[i / IOVA_WORD_BITS] &=
+				~(1UL << (i % IOVA_WORD_BITS));
+	}
+}
+
+int fsl_iova_init(struct fsl_iova_space *sp, uint64_t base, uint64_t size)
+{
+	size_t words;
+
+	if (!size || (base | size) & (FSL_IOVA_GRANULE - 1) ||
+	    base + size < base)
+		return VFIO_FAILURE;
+
+	sp->ngranules = size / FSL_IOVA_GRANULE;
+	words = (sp->ngranules + IOVA_WORD_BITS - 1) / IOVA_WORD_BITS;
+	sp->bitmap = calloc(words, sizeof(unsigned long));
+	if (!sp->bitmap)
+		return VFIO_FAILURE;
+
+	sp->base = base;
+	sp->size = size;
+	sp->used = 0;
+
+	return VFIO_SUCCESS;
+}
+
+void fsl_iova_fini(struct fsl_iova_space *sp)
+{
+	free(sp->bitmap);
+	memset(sp, 0, sizeof(*sp));
+}
+
+int fsl_iova_alloc(struct fsl_iova_space *sp, size_t len, size_t align,
+		   uint64_t *iova)
+{
+	size_t n, step, first, i;
+	uint64_t addr;
+
+	if (!sp->bitmap || !len)
+		return VFIO_FAILURE;
+	if (align < FSL_IOVA_GRANULE)
+		align = FSL_IOVA_GRANULE;
+	if (align & (align - 1))
+		return VFIO_FAILURE;
+
+	n = (len + FSL_IOVA_GRANULE - 1) / FSL_IOVA_GRANULE;
+	step = align / FSL_IOVA_GRANULE;
+
+	/* First granule whose IOVA is aligned; the window need not be */
+	addr = (sp->base + align - 1) & ~((uint64_t)align - 1);
+	first = (addr - sp->base) / FSL_IOVA_GRANULE;
+
+	while (first + n <= sp->ngranules) {
+		/* Skip past the last allocated granule in the candidate */
+		for (i = first + n; i > first; i--) {
+			if (iova_test(sp, i - 1))
+				break;
+		}
+		if (i == first) {
+			iova_set_range(sp, first, n, 1);
+			sp->used += n;
+			*iova = sp->base + first * FSL_IOVA_GRANULE;
+			return VFIO_SUCCESS;
+		}
+		first += ((i - first) + step - 1) / step * step;
+	}
+
+	return VFIO_FAILURE;
+}
+
+void fsl_iova_free(struct fsl_iova_space *sp, uint64_t iova, size_t len)
+{
+	size_t n, first;
+
+	if (!sp->bitmap || iova < sp->base || iova >= sp->base + sp->size)
+		return;
+
+	first = (iova - sp->base) / FSL_IOVA_GRANULE;
+	n = (len + FSL_IOVA_GRANULE - 1) / FSL_IOVA_GRANULE;
+	if (first + n > sp->ngranules)
+		n = sp->ngranules - first;
+
+	iova_set_range(sp, first, n, 0);
+	sp->used -= n;
+}
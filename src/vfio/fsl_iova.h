@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _FSL_IOVA_H_
+#define _FSL_IOVA_H_
+
+/*!
+ * @file	fsl_iova.h
+ *
+ * @brief	IOVA space allocator for VFIO DMA mappings
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/***** Macros ********/
+#define FSL_IOVA_GRANULE	0x1000ULL	/* Allocation unit */
+/* Default window: above 4GB, clear of the identity mapped MSI region */
+#define FSL_IOVA_DEF_BASE	0x100000000ULL
+#define FSL_IOVA_DEF_SIZE	0x40000000ULL	/* 1GB */
+
+/***** Structures ********/
+/* A window of IOVA space, one bit per FSL_IOVA_GRANULE */
+struct fsl_iova_space {
+	uint64_t base;		/* Start of window, granule aligned */
+	uint64_t size;		/* Length of window, granule multiple */
+	unsigned long *bitmap;	/* Bit set if granule is allocated */
+	size_t ngranules;
+	size_t used;		/* Granules allocated */
+};
+
+/*
+ * Function Declarations
+ */
+
+/* Set up an empty window; base and size must be granule aligned */
+int fsl_iova_init(struct fsl_iova_space *sp, uint64_t base, uint64_t size);
+void fsl_iova_fini(struct fsl_iova_space *sp);
+/* Allocate len bytes (rounded up to the granule) at an IOVA aligned to
+ * align, a power of two; 0 for the granule. First fit.
+ */
+int fsl_iova_alloc(struct fsl_iova_space *sp, size_t len, size_t align,
+		   uint64_t *iova);
+void fsl_iova_free(struct fsl_iova_space *sp, uint64_t iova, size_t len);
+
+#endif /* _FSL_IOVA_H_ */
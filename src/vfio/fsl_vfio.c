@@ -33,6 +33,7 @@
  */
 
 #include <fsl_vfio.h>
+#include <fsl_iova.h>
 #include <aiop_logger.h>
 
 
@@ -66,23 +67,83 @@
 struct vfio_group {
 	int fd; /* /dev/vfio/"groupid" */
 	int groupid;
-	int used;
+	int used; /* Handles set up on the group */
+	int device_fd; /* DPRC device, for use in map_irq_region */
 	struct vfio_container *container;
 };
 
 struct vfio_container {
 	int fd; /* /dev/vfio/vfio */
-	int used;
-	int index; /* index in group list */
-	struct vfio_group *group_list[VFIO_MAX_GRP];
+	int ngroups; /* Groups connected to the container */
+	pthread_mutex_t lock; /* For IOVA allocator and IRQ region below */
+	uint32_t *msi_intr_vaddr; /* IRQ region mapped in this container */
+	void *msi_region; /* mmap of the IRQ region, released with container */
+	uint64_t iova_base; /* Window for iova, set before first DMA map */
+	uint64_t iova_size;
+	struct fsl_iova_space iova; /* Allocator over the window */
+};
+
+/* Table of groups or containers; grown as needed. Entries are allocated
+ * separately so that handles stay valid as the table grows.
+ */
+struct vfio_table {
+	void **slots;
+	int max;
 };
 
 /***** Global Variables ********/
-/* Number of VFIO containers & groups with in */
-struct vfio_group vfio_groups[VFIO_MAX_GRP];
-struct vfio_container vfio_containers[VFIO_MAX_CONTAINERS];
-int container_device_fd;
-uint32_t *msi_intr_vaddr;
+/* VFIO containers & groups in use by the process, e.g. one group per DPRC
+ * controlled
+ */
+static struct vfio_table vfio_groups;
+static struct vfio_table vfio_containers;
+/* Serializes setup/teardown of groups and containers, which may be done
+ * from multiple threads (one per AIOP tile). DMA maps only take the lock of
+ * their container.
+ */
+static pthread_mutex_t vfio_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Add entry to a free slot of table, growing it if full. Called with
+ * vfio_lock held.
+ */
+static int vfio_table_add(struct vfio_table *table, void *entry)
+{
+	void **slots;
+	int i, max;
+
+	for (i = 0; i < table->max; i++) {
+		if (!table->slots[i]) {
+			table->slots[i] = entry;
+			return VFIO_SUCCESS;
+		}
+	}
+
+	max = table->max ? table->max * 2 : VFIO_TABLE_MIN_SZ;
+	slots = realloc(table->slots, max * sizeof(*slots));
+	if (!slots) {
+		ERROR("vfio: Unable to grow table to %d entries\n", max);
+		return VFIO_FAILURE;
+	}
+	memset(slots + table->max, 0, (max - table->max) * sizeof(*slots));
+	slots[table->max] = entry;
+	table->slots = slots;
+	table->max = max;
+
+	return VFIO_SUCCESS;
+}
+
+/* Remove entry from table, if present. Called with vfio_lock held. */
+static void vfio_table_del(struct vfio_table *table, void *entry)
+{
+	int i;
+
+	for (i = 0; i < table->max; i++) {
+		if (table->slots[i] == entry) {
+			table->slots[i] = NULL;
+			return;
+		}
+	}
+}
 
 static int vfio_connect_container(struct vfio_group *vfio_group)
 {
@@ -90,70 +151,70 @@ static int vfio_connect_container(struct vfio_group *vfio_group)
 	int i, fd, ret;
 
 	/* Try connecting to vfio container already created */
-	for (i = 0; i < VFIO_MAX_CONTAINERS; i++) {
-		container = &vfio_containers[i];
+	for (i = 0; i < vfio_containers.max; i++) {
+		container = vfio_containers.slots[i];
+		if (!container)
+			continue;
 		if (!ioctl(vfio_group->fd, VFIO_GROUP_SET_CONTAINER,
 				&container->fd)) {
 			ERROR("Container pre-exists with FD[0x%x]"
 					" for this group\n", container->fd);
+			container->ngroups++;
 			vfio_group->container = container;
 			return VFIO_SUCCESS;
 		}
 	}
 
+	container = calloc(1, sizeof(*container));
+	if (!container) {
+		ERROR("vfio error: Unable to allocate container\n");
+		return VFIO_FAILURE;
+	}
+
 	/* Opens main vfio file descriptor which represents the "container" */
 	fd = open("/dev/vfio/vfio", O_RDWR);
 	if (fd < 0) {
 		ERROR("vfio: error opening VFIO Container\n");
-		return VFIO_FAILURE;
+		goto fail_free;
 	}
 	ret = ioctl(fd, VFIO_GET_API_VERSION);
-	if (ret != VFIO_API_VERSION) {
-		close(fd);
-		return VFIO_FAILURE;
-	}
+	if (ret != VFIO_API_VERSION)
+		goto fail_close;
 	/* Check whether support for SMMU type IOMMU prresent or not */
 	if (ioctl(fd, VFIO_CHECK_EXTENSION, VFIO_TYPE1_IOMMU)) {
 		/* Connect group to container */
 		if (ioctl(vfio_group->fd, VFIO_GROUP_SET_CONTAINER, &fd)) {
 			ERROR("VFIO_GROUP_SET_CONTAINER failed.\n");
-			close(fd);
-			return VFIO_FAILURE;
+			goto fail_close;
 		}
 		/* Initialize SMMU */
 		if (ioctl(fd, VFIO_SET_IOMMU, VFIO_TYPE1_IOMMU)) {
 			ERROR("VFIO_SET_IOMMU failed.\n");
-			close(fd);
-			return VFIO_FAILURE;
+			goto fail_unset;
 		}
 		DEBUG("VFIO_TYPE1_IOMMU Supported\n");
 	} else {
 		ERROR("vfio error: No supported IOMMU\n");
-		close(fd);
-		return VFIO_FAILURE;
+		goto fail_close;
 	}
 
 	/* Configure the Container private data structure */
-	container = NULL;
-	for (i = 0; i < VFIO_MAX_CONTAINERS; i++) {
-		if (vfio_containers[i].used)
-			continue;
-		DEBUG("Found unused container at index %d\n", i);
-		container = &vfio_containers[i];
-	}
-	if (!container) {
-		ERROR("vfio error: No Free Container Found\n");
-		close(fd);
-		return VFIO_FAILURE;
-	}
-	container->used = 1;
+	if (vfio_table_add(&vfio_containers, container) != VFIO_SUCCESS)
+		goto fail_unset;
 	container->fd = fd;
-	container->group_list[container->index] = vfio_group;
-	DEBUG("Assigning Group to index group_list[%d]\n", container->index);
+	container->ngroups = 1;
+	pthread_mutex_init(&container->lock, NULL);
 
 	vfio_group->container = container;
-	container->index++;
 	return VFIO_SUCCESS;
+
+fail_unset:
+	ioctl(vfio_group->fd, VFIO_GROUP_UNSET_CONTAINER, &fd);
+fail_close:
+	close(fd);
+fail_free:
+	free(container);
+	return VFIO_FAILURE;
 }
 
 static void vfio_disconnect_container(struct vfio_group *group)
@@ -170,34 +231,30 @@ static void vfio_disconnect_container(struct vfio_group *group)
 
 	group->container = NULL;
 
+	/* Container is released with the last group in it */
+	if (--container->ngroups > 0)
+		return;
+
+	/* Closing the container drops its IOMMU mappings, the IRQ region
+	 * included
+	 */
 	close(container->fd);
-	container->fd = 0; /* In case container reused */
+	if (container->msi_region)
+		munmap(container->msi_region, 0x1000);
+	fsl_iova_fini(&container->iova);
+	pthread_mutex_destroy(&container->lock);
+	vfio_table_del(&vfio_containers, container);
+	free(container);
 }
 
-/* TODO - The below two API's are provided as a W.A.. as VFIO currently
+/* TODO - The below API is provided as a W.A.. as VFIO currently
    does not add the mapping of the interrupt region to SMMU. This should
    be removed once the support is added in the Kernel.
+   The region is mapped once per container, by the first DMA map or IRQ set
+   up, and stays mapped until the container is released: mapping and
+   unmapping it around every DMA map would cost two more ioctls, and IOTLB
+   invalidations, per load. Called with the container lock held.
 */
-static void vfio_unmap_irq_region(struct vfio_group *group)
-{
-	int ret;
-	struct vfio_iommu_type1_dma_unmap unmap = {
-		.argsz = sizeof(unmap),
-		.flags = 0,
-		.iova = 0x6030000,
-		.size = 0x1000,
-	};
-
-	/* Attempting unmap only if msi_intr_vaddr has non zero value */
-	if (msi_intr_vaddr) {
-		ret = ioctl(group->container->fd, VFIO_IOMMU_UNMAP_DMA, &unmap);
-		if (ret)
-			ERROR("Error in vfio_dma_unmap (errno = %d)", errno);
-	}
-
-	msi_intr_vaddr = 0;
-}
-
 static int vfio_map_irq_region(struct vfio_group *group)
 {
 	int ret;
@@ -210,54 +267,216 @@ static int vfio_map_irq_region(struct vfio_group *group)
 		.size = 0x1000,
 	};
 
-	if (msi_intr_vaddr) {
+	if (group->container->msi_intr_vaddr) {
 		/* IRQ region already mapped; Preventing multiple calls */
 		return VFIO_SUCCESS;
 	}
 
 	vaddr = (unsigned long *)mmap(NULL, 0x1000, PROT_WRITE |
-		PROT_READ, MAP_SHARED, container_device_fd, 0x6030000);
+		PROT_READ, MAP_SHARED, group->device_fd, 0x6030000);
 	if (vaddr == MAP_FAILED) {
 		ERROR("Error mapping GITS region (errno = %d)", errno);
 		return -errno;
 	}
 
-	msi_intr_vaddr = (uint32_t *)((char *)(vaddr) + 64);
 	map.vaddr = (unsigned long)vaddr;
 	ret = ioctl(group->container->fd, VFIO_IOMMU_MAP_DMA, &map);
-	if (ret == 0)
+	if (ret == 0) {
+		group->container->msi_region = vaddr;
+		group->container->msi_intr_vaddr =
+			(uint32_t *)((char *)(vaddr) + 64);
 		return VFIO_SUCCESS;
+	}
 
+	ret = -errno;
 	ERROR("vfio_map_irq_region fails (errno = %d)", errno);
-	return -errno;
+	munmap(vaddr, 0x1000);
+	return ret;
+}
+
+/* Check the IOVA window against the ranges the IOMMU can translate, where
+ * the kernel reports them
+ */
+static int vfio_check_iova_window(struct vfio_container *container)
+{
+#ifdef VFIO_IOMMU_TYPE1_INFO_CAP_IOVA_RANGE
+	struct vfio_iommu_type1_info *info;
+	struct vfio_info_cap_header *hdr;
+	struct vfio_iommu_type1_info_cap_iova_range *cap;
+	uint64_t last = container->iova_base + container->iova_size - 1;
+	uint32_t argsz = sizeof(*info);
+	unsigned int i;
+	int ret = VFIO_SUCCESS;
+
+	/* First call reports the size needed for the capabilities */
+	info = calloc(1, argsz);
+	if (!info)
+		return VFIO_FAILURE;
+	info->argsz = argsz;
+	if (ioctl(container->fd, VFIO_IOMMU_GET_INFO, info) ||
+	    info->argsz <= argsz) {
+		/* No capabilities: the window cannot be checked */
+		free(info);
+		return VFIO_SUCCESS;
+	}
+	argsz = info->argsz;
+	free(info);
+	info = calloc(1, argsz);
+	if (!info)
+		return VFIO_FAILURE;
+	info->argsz = argsz;
+	if (ioctl(container->fd, VFIO_IOMMU_GET_INFO, info) ||
+	    !(info->flags & VFIO_IOMMU_INFO_CAPS)) {
+		free(info);
+		return VFIO_SUCCESS;
+	}
+
+	for (hdr = (void *)((char *)info + info->cap_offset);;
+	     hdr = (void *)((char *)info + hdr->next)) {
+		if (hdr->id == VFIO_IOMMU_TYPE1_INFO_CAP_IOVA_RANGE) {
+			cap = (void *)hdr;
+			ret = VFIO_FAILURE;
+			for (i = 0; i < cap->nr_iovas; i++) {
+				if (container->iova_base >=
+				    cap->iova_ranges[i].start &&
+				    last <= cap->iova_ranges[i].end) {
+					ret = VFIO_SUCCESS;
+					break;
+				}
+			}
+			break;
+		}
+		if (!hdr->next)
+			break;
+	}
+	free(info);
+
+	if (ret != VFIO_SUCCESS)
+		ERROR("vfio: IOVA window 0x%lx-0x%lx outside IOMMU range.\n",
+			container->iova_base, last);
+	return ret;
+#else
+	(void)container;
+	return VFIO_SUCCESS;
+#endif
+}
+
+/* Set up the IOVA allocator of the container, on first DMA map. Called with
+ * the container lock held.
+ */
+static int vfio_setup_iova(struct vfio_container *container)
+{
+	if (container->iova.bitmap)
+		return VFIO_SUCCESS;
+
+	if (!container->iova_size) {
+		container->iova_base = FSL_IOVA_DEF_BASE;
+		container->iova_size = FSL_IOVA_DEF_SIZE;
+	}
+
+	if (vfio_check_iova_window(container) != VFIO_SUCCESS)
+		return VFIO_FAILURE;
+
+	if (fsl_iova_init(&container->iova, container->iova_base,
+			  container->iova_size) != VFIO_SUCCESS) {
+		ERROR("vfio: Unable to set up IOVA window 0x%lx+0x%lx.\n",
+			container->iova_base, container->iova_size);
+		return VFIO_FAILURE;
+	}
+	DEBUG("vfio: IOVA window 0x%lx+0x%lx\n", container->iova_base,
+		container->iova_size);
+
+	return VFIO_SUCCESS;
 }
 
-int32_t fsl_vfio_setup_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len)
+int fsl_vfio_set_iova_window(fsl_vfio_t handle, uint64_t base, uint64_t size)
+{
+	struct vfio_group *group;
+	struct vfio_container *container;
+	int ret = VFIO_FAILURE;
+
+	if (!handle) {
+		ERROR("vfio: Incorrect handle passed\n");
+		return VFIO_FAILURE;
+	}
+	group = (struct vfio_group *)handle;
+
+	/* Must be granule aligned, and leave the MSI region alone */
+	if (!size || (base | size) & (FSL_IOVA_GRANULE - 1) ||
+	    base + size < base ||
+	    (base < 0x6030000 + 0x1000 && base + size > 0x6030000)) {
+		ERROR("vfio: Invalid IOVA window 0x%lx+0x%lx.\n", base, size);
+		return VFIO_FAILURE;
+	}
+
+	container = group->container;
+	if (!container) {
+		ERROR("vfio: Group not in a container.\n");
+		return VFIO_FAILURE;
+	}
+
+	pthread_mutex_lock(&container->lock);
+	if (container->iova.used) {
+		/* Window cannot move under existing mappings */
+		ERROR("vfio: IOVA window in use.\n");
+	} else {
+		fsl_iova_fini(&container->iova);
+		container->iova_base = base;
+		container->iova_size = size;
+		ret = VFIO_SUCCESS;
+	}
+	pthread_mutex_unlock(&container->lock);
+
+	return ret;
+}
+
+int32_t fsl_vfio_setup_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len,
+			      size_t align, uint64_t *iova)
 {
 	int ret;
 	struct vfio_group *group;
+	struct vfio_container *container;
 	struct vfio_iommu_type1_dma_map dma_map = {
 		.argsz = sizeof(dma_map),
 		.flags = VFIO_DMA_MAP_FLAG_READ | VFIO_DMA_MAP_FLAG_WRITE,
 	};
 
-	if (!handle) {
+	if (!handle || !iova) {
 		ERROR("vfio: Incorrect handle passed\n");
 		return VFIO_FAILURE;
 	}
 	group = (struct vfio_group *)handle;
+	container = group->container;
+
+	/* IOVA from the window of the container, whatever the vaddr. Aligned
+	 * as asked (e.g. to the huge page of the buffer) so that the SMMU can
+	 * use block mappings.
+	 */
+	pthread_mutex_lock(&container->lock);
+	ret = vfio_setup_iova(container);
+	if (ret == VFIO_SUCCESS)
+		ret = fsl_iova_alloc(&container->iova, len, align, iova);
+	pthread_mutex_unlock(&container->lock);
+	if (ret != VFIO_SUCCESS) {
+		ERROR("vfio: No IOVA space for 0x%lx bytes.\n", len);
+		return VFIO_FAILURE;
+	}
 
 	dma_map.vaddr = addr;
 	dma_map.size = len;
-	dma_map.iova = dma_map.vaddr;
+	dma_map.iova = *iova;
 
 	/* SET DMA MAP for IOMMU */
 	DEBUG("vfio: -- Initial SHM Virtual ADDR %llX\n", dma_map.vaddr);
-	DEBUG("vfio: -- DMA size 0x%llX\n", dma_map.size);
+	DEBUG("vfio: -- DMA size 0x%llX, IOVA 0x%llX\n", dma_map.size,
+		dma_map.iova);
 
-	ret = ioctl(group->container->fd, VFIO_IOMMU_MAP_DMA, &dma_map);
+	ret = ioctl(container->fd, VFIO_IOMMU_MAP_DMA, &dma_map);
 	if (ret) {
 		ERROR("VFIO_IOMMU_MAP_DMA API Error %d.\n", errno);
+		pthread_mutex_lock(&container->lock);
+		fsl_iova_free(&container->iova, *iova, len);
+		pthread_mutex_unlock(&container->lock);
 		return VFIO_FAILURE;
 	}
 	DEBUG("vfio: >> dma_map.vaddr = 0x%llX\n", dma_map.vaddr);
@@ -265,13 +484,16 @@ int32_t fsl_vfio_setup_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len)
 	/* TODO - This is a W.A. as VFIO currently does not add the mapping of
 	    the interrupt region to SMMU. This should be removed once the
 	    support is added in the Kernel.
+	    Only the first map of the container maps it.
 	 */
+	pthread_mutex_lock(&container->lock);
 	vfio_map_irq_region(group);
+	pthread_mutex_unlock(&container->lock);
 
 	return VFIO_SUCCESS;
 }
 
-void fsl_vfio_destroy_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len)
+void fsl_vfio_destroy_dmamap(fsl_vfio_t handle, uint64_t iova, size_t len)
 {
 	int ret;
 	struct vfio_group *group;
@@ -286,17 +508,23 @@ void fsl_vfio_destroy_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len)
 	}
 	group = (struct vfio_group *)handle;
 
-	dma_unmap.iova = addr;
+	dma_unmap.iova = iova;
 	dma_unmap.size = len;
 
 	DEBUG("vfio: -- DMA-UNMAP IOVA ADDR %llX\n", dma_unmap.iova);
 	DEBUG("vfio: -- DMA-UNMAP size 0x%llX\n", dma_unmap.size);
 
+	/* IRQ region stays mapped; see vfio_map_irq_region */
 	ret = ioctl(group->container->fd, VFIO_IOMMU_UNMAP_DMA, &dma_unmap);
-	if (ret)
+	if (ret) {
+		/* IOVA is not reused while it may still be mapped */
 		ERROR("VFIO_IOMMU_UNMAP_DMA API Error %d.\n", errno);
+		return;
+	}
 
-	vfio_unmap_irq_region(group);
+	pthread_mutex_lock(&group->container->lock);
+	fsl_iova_free(&group->container->iova, iova, len);
+	pthread_mutex_unlock(&group->container->lock);
 }
 
 static int vfio_set_group(struct vfio_group *group, int groupid)
@@ -329,7 +557,6 @@ static int vfio_set_group(struct vfio_group *group, int groupid)
 	if (vfio_connect_container(group)) {
 		goto fail;
 	}
-	group->used = 1;
 	return VFIO_SUCCESS;
 fail:
 	close(group->fd);
@@ -339,22 +566,28 @@ fail:
 
 static void vfio_put_group(struct vfio_group *group)
 {
+	/* Group is shared by all handles set up on the same container */
+	if (--group->used > 0)
+		return;
+
+	if (group->device_fd > 0) {
+		close(group->device_fd);
+		group->device_fd = 0;
+	}
 	vfio_disconnect_container(group);
-	if (group->fd) {
+	if (group->fd)
 		close(group->fd);
-		group->fd = 0;
-	}
-	group->used = 0;
+	vfio_table_del(&vfio_groups, group);
+	free(group);
 }
 
-fsl_vfio_t fsl_vfio_setup(const char *vfio_container)
+int fsl_vfio_container_group(const char *vfio_container)
 {
 	char path[VFIO_PATH_MAX];
 	char iommu_group_path[VFIO_PATH_MAX], *group_name;
-	struct vfio_group *group = NULL;
 	struct stat st;
 	int groupid;
-	int ret, len, i;
+	int len;
 
 	/* Check whether LS-Container exists or not */
 	sprintf(path, "/sys/bus/fsl-mc/devices/%s", vfio_container);
@@ -383,21 +616,42 @@ fsl_vfio_t fsl_vfio_setup(const char *vfio_container)
 	}
 
 	DEBUG("vfio: IOMMU group_id = %d\n", groupid);
+	return groupid;
 
-	group = &vfio_groups[0];
+fail:
+	return -1;
+}
+
+fsl_vfio_t fsl_vfio_setup_group(const char *vfio_container, int groupid)
+{
+	struct vfio_group *group = NULL;
+	int ret, i;
+
+	pthread_mutex_lock(&vfio_lock);
 
 	/* Check if group already exists */
-	for (i = 0; i < VFIO_MAX_GRP && vfio_groups[i].used; i++) {
-		group = &vfio_groups[i];
-		if (group->groupid == groupid) {
+	for (i = 0; i < vfio_groups.max; i++) {
+		group = vfio_groups.slots[i];
+		if (group && group->groupid == groupid) {
 			DEBUG("groupid already exists %d\n", groupid);
+			group->used++;
+			pthread_mutex_unlock(&vfio_lock);
 			return (fsl_vfio_t)group;
 		}
 	}
 
-	if (i >= VFIO_MAX_GRP) {
-		ERROR("vfio: No more unused group space in container\n");
-		goto cleanup;
+	group = calloc(1, sizeof(*group));
+	if (!group) {
+		ERROR("vfio: Unable to allocate group\n");
+		pthread_mutex_unlock(&vfio_lock);
+		goto fail;
+	}
+	/* Released by vfio_put_group from here on */
+	group->used = 1;
+	if (vfio_table_add(&vfio_groups, group) != VFIO_SUCCESS) {
+		free(group);
+		pthread_mutex_unlock(&vfio_lock);
+		goto fail;
 	}
 
 	if (VFIO_SUCCESS != vfio_set_group(group, groupid)) {
@@ -414,17 +668,30 @@ fsl_vfio_t fsl_vfio_setup(const char *vfio_container)
 	}
 
 	/* For use in map_irq_region */
-	container_device_fd = ret;
-	DEBUG("vfio: Container FD is [0x%X]n", container_device_fd);
+	group->device_fd = ret;
+	DEBUG("vfio: Container FD is [0x%X]n", group->device_fd);
 
+	pthread_mutex_unlock(&vfio_lock);
 	return (fsl_vfio_t)group;
 
 cleanup:
 	vfio_put_group(group);
+	pthread_mutex_unlock(&vfio_lock);
 fail:
 	return FSL_VFIO_INVALID_HANDLE;
 };
 
+fsl_vfio_t fsl_vfio_setup(const char *vfio_container)
+{
+	int groupid;
+
+	groupid = fsl_vfio_container_group(vfio_container);
+	if (groupid < 0)
+		return FSL_VFIO_INVALID_HANDLE;
+
+	return fsl_vfio_setup_group(vfio_container, groupid);
+}
+
 int fsl_vfio_destroy(fsl_vfio_t handle)
 {
 	struct vfio_group *group = NULL;
@@ -435,12 +702,14 @@ int fsl_vfio_destroy(fsl_vfio_t handle)
 	}
 	group = (struct vfio_group *)handle;
 
+	pthread_mutex_lock(&vfio_lock);
 	vfio_put_group(group);
+	pthread_mutex_unlock(&vfio_lock);
 
 	return VFIO_SUCCESS;
 }
 
-int64_t fsl_vfio_map_mcp_obj(fsl_vfio_t handle, char *mcp_obj)
+int64_t fsl_vfio_map_mcp_obj(fsl_vfio_t handle, char *mcp_obj, size_t *size)
 {
 	int64_t v_addr = (int64_t)MAP_FAILED;
 	int32_t ret, mcp_fd;
@@ -486,6 +755,8 @@ int64_t fsl_vfio_map_mcp_obj(fsl_vfio_t handle, char *mcp_obj)
 	v_addr = (uint64_t)mmap(NULL, reg_info.size,
 		PROT_WRITE | PROT_READ, MAP_SHARED,
 		mcp_fd, reg_info.offset);
+	if (size)
+		*size = reg_info.size;
 
 mcp_failure:
 	close(mcp_fd);
@@ -555,8 +826,85 @@ fsl_vfio_get_device_info(fsl_vfio_t handle, char *dev_name,
 
 	if (ioctl(dev_fd, VFIO_DEVICE_GET_INFO, dev_info)) {
 		ERROR("vfio: VFIO_DEVICE_GET_INFO IOCTL Failed\n");
+		close(dev_fd);
 		return VFIO_FAILURE;
 	}
 
+	/* The fd was only opened for the query */
+	close(dev_fd);
 	return VFIO_SUCCESS;
 }
+
+int
+fsl_vfio_setup_irq(fsl_vfio_t handle, int dev_fd, unsigned int index,
+			int event_fd)
+{
+	int ret;
+	struct vfio_group *group;
+	struct vfio_irq_info irq_info = { .argsz = sizeof(irq_info) };
+	char buf[sizeof(struct vfio_irq_set) + sizeof(int32_t)];
+	struct vfio_irq_set *irq_set = (struct vfio_irq_set *)buf;
+
+	if (!handle || dev_fd < 0 || event_fd < 0) {
+		ERROR("vfio: Incorrect handle or fd.\n");
+		return VFIO_FAILURE;
+	}
+	group = (struct vfio_group *)handle;
+
+	irq_info.index = index;
+	if (ioctl(dev_fd, VFIO_DEVICE_GET_IRQ_INFO, &irq_info)) {
+		ERROR("vfio: VFIO_DEVICE_GET_IRQ_INFO IOCTL Failed (%d)\n",
+			errno);
+		return VFIO_FAILURE;
+	}
+	if (!(irq_info.flags & VFIO_IRQ_INFO_EVENTFD) || !irq_info.count) {
+		ERROR("vfio: IRQ %u cannot signal an eventfd.\n", index);
+		return VFIO_FAILURE;
+	}
+
+	/* MSI writes of the device go through the IRQ region; see
+	 * vfio_map_irq_region.
+	 */
+	pthread_mutex_lock(&group->container->lock);
+	ret = vfio_map_irq_region(group);
+	pthread_mutex_unlock(&group->container->lock);
+	if (ret != VFIO_SUCCESS)
+		return VFIO_FAILURE;
+
+	irq_set->argsz = sizeof(buf);
+	irq_set->flags = VFIO_IRQ_SET_DATA_EVENTFD |
+				VFIO_IRQ_SET_ACTION_TRIGGER;
+	irq_set->index = index;
+	irq_set->start = 0;
+	irq_set->count = 1;
+	memcpy(&irq_set->data, &event_fd, sizeof(int32_t));
+
+	if (ioctl(dev_fd, VFIO_DEVICE_SET_IRQS, irq_set)) {
+		ERROR("vfio: VFIO_DEVICE_SET_IRQS IOCTL Failed (%d)\n", errno);
+		return VFIO_FAILURE;
+	}
+
+	return VFIO_SUCCESS;
+}
+
+void
+fsl_vfio_destroy_irq(fsl_vfio_t handle, int dev_fd, unsigned int index)
+{
+	struct vfio_irq_set irq_set = {
+		.argsz = sizeof(irq_set),
+		.flags = VFIO_IRQ_SET_DATA_NONE | VFIO_IRQ_SET_ACTION_TRIGGER,
+		.start = 0,
+		.count = 0,
+	};
+
+	if (!handle || dev_fd < 0) {
+		ERROR("vfio: Incorrect handle or fd.\n");
+		return;
+	}
+
+	irq_set.index = index;
+	if (ioctl(dev_fd, VFIO_DEVICE_SET_IRQS, &irq_set))
+		ERROR("vfio: VFIO_DEVICE_SET_IRQS IOCTL Failed (%d)\n", errno);
+
+	/* IRQ region stays mapped until the container is released */
+}
@@ -54,8 +54,7 @@
 
 /***** Macros ********/
 #define VFIO_PATH_MAX		100
-#define VFIO_MAX_GRP		1
-#define VFIO_MAX_CONTAINERS	1
+#define VFIO_TABLE_MIN_SZ	8	/* Groups/containers, grown as needed */
 
 #define VFIO_SUCCESS		0
 #define VFIO_FAILURE		(-1)
@@ -82,14 +81,39 @@ typedef void *fsl_vfio_t;	/**< VFIO object descriptor >*/
  */
 
 fsl_vfio_t fsl_vfio_setup(const char  *vfio_container);
+/* The two steps of fsl_vfio_setup: find the IOMMU group of the container in
+ * sysfs (-1 if none), then set up the handle on that group. The latter fails
+ * if the container is not in groupid.
+ */
+int fsl_vfio_container_group(const char *vfio_container);
+fsl_vfio_t fsl_vfio_setup_group(const char *vfio_container, int groupid);
 int fsl_vfio_destroy(fsl_vfio_t handle);
-int64_t fsl_vfio_map_mcp_obj(fsl_vfio_t handle, char *mcp_obj);
+/* Map the region of a dpmcp object; its length is returned in size, for
+ * munmap.
+ */
+int64_t fsl_vfio_map_mcp_obj(fsl_vfio_t handle, char *mcp_obj, size_t *size);
 int fsl_vfio_get_group_id(fsl_vfio_t handle);
 int fsl_vfio_get_group_fd(fsl_vfio_t handle);
 int fsl_vfio_get_dev_fd(fsl_vfio_t handle, char *dev_name);
-int32_t fsl_vfio_setup_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len);
-void fsl_vfio_destroy_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len);
+/* DMA map len bytes at vaddr addr. The IOVA is allocated from the window of
+ * the container (FSL_IOVA_DEF_* unless set), aligned to align (0 for the
+ * page size), and returned in iova.
+ */
+int32_t fsl_vfio_setup_dmamap(fsl_vfio_t handle, uint64_t addr, size_t len,
+			      size_t align, uint64_t *iova);
+void fsl_vfio_destroy_dmamap(fsl_vfio_t handle, uint64_t iova, size_t len);
+/* Set the IOVA window of the container of handle; only while it has no DMA
+ * mappings.
+ */
+int fsl_vfio_set_iova_window(fsl_vfio_t handle, uint64_t base,
+			     uint64_t size);
 int fsl_vfio_get_device_info(fsl_vfio_t handle, char *dev_name,
 				struct vfio_device_info *dev_info);
+/* Route an IRQ of a device (index as per VFIO_DEVICE_GET_IRQ_INFO) to an
+ * eventfd, which becomes readable each time the device raises it.
+ */
+int fsl_vfio_setup_irq(fsl_vfio_t handle, int dev_fd, unsigned int index,
+			int event_fd);
+void fsl_vfio_destroy_irq(fsl_vfio_t handle, int dev_fd, unsigned int index);
 
 #endif /* _FSL_VFIO_H */
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015 Freescale Semiconductor, Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the above-listed copyright holders nor the
+ *     names of any contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*!
+ * @file	unit_checks.c
+ *
+ * @brief	Checks of the helpers which need no MC: CRC32C, the IOVA
+ *		allocator, the MC latency histogram buckets and the event
+ *		loop
+ *
+ */
+
+/* Generic includes */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* AIOP Tool Specific includes */
+#include <aiop_tool.h>
+#include <aiop_crc32c.h>
+#include <aiop_evloop.h>
+
+/* VFIO and MC header files */
+#include <fsl_vfio.h>
+#include <fsl_iova.h>
+#include <fsl_mc_stats.h>
+
+static int failures;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__,	\
+			       #cond);					\
+			failures++;					\
+		}							\
+	} while (0)
+
+/*
+ * @brief
+ * CRC32C check vector, and the same CRC over split and unaligned buffers
+ */
+static void
+check_crc32c(void)
+{
+	static const char vec[] = "123456789";
+	unsigned char buf[1031];
+	uint32_t crc, crc_1;
+	size_t i;
+
+	CHECK(aiopt_crc32c(0, vec, strlen(vec)) == 0xE3069283);
+	CHECK(aiopt_crc32c(0, vec, 0) == 0);
+
+	crc = aiopt_crc32c(0, vec, 4);
+	crc = aiopt_crc32c(crc, vec + 4, strlen(vec) - 4);
+	CHECK(crc == 0xE3069283);
+
+	/* Odd start and length, to go through the head and tail paths */
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (unsigned char)(i * 31 + 7);
+	crc = aiopt_crc32c(0, buf + 1, sizeof(buf) - 1);
+	crc_1 = 0;
+	for (i = 1; i < sizeof(buf); i++)
+		crc_1 = aiopt_crc32c(crc_1, buf + i, 1);
+	CHECK(crc == crc_1);
+
+	printf("crc32c (%s): done\n", aiopt_crc32c_impl());
+}
+
+/*
+ * @brief
+ * IOVA allocator: window and alignment checks, first fit past allocated
+ * granules, exhaustion and free
+ */
+static void
+check_iova(void)
+{
+	struct fsl_iova_space sp;
+	uint64_t a, b, c;
+	const uint64_t base = FSL_IOVA_DEF_BASE + FSL_IOVA_GRANULE;
+	const uint64_t align = 16 * FSL_IOVA_GRANULE;
+
+	CHECK(fsl_iova_init(&sp, base + 1, 64 * FSL_IOVA_GRANULE) ==
+	      VFIO_FAILURE);
+	CHECK(fsl_iova_init(&sp, base, 64 * FSL_IOVA_GRANULE + 1) ==
+	      VFIO_FAILURE);
+	CHECK(fsl_iova_init(&sp, base, 0) == VFIO_FAILURE);
+
+	/* Window of 64 granules, not itself aligned to align */
+	CHECK(fsl_iova_init(&sp, base, 64 * FSL_IOVA_GRANULE) ==
+	      VFIO_SUCCESS);
+
+	/* Less than a granule takes a granule, at the start */
+	CHECK(fsl_iova_alloc(&sp, 1, 0, &a) == VFIO_SUCCESS);
+	CHECK(a == base && sp.used == 1);
+
+	CHECK(fsl_iova_alloc(&sp, FSL_IOVA_GRANULE, 3 * FSL_IOVA_GRANULE,
+			     &b) == VFIO_FAILURE);
+	CHECK(fsl_iova_alloc(&sp, 0, 0, &b) == VFIO_FAILURE);
+
+	/* First aligned granule is past the start of the window */
+	CHECK(fsl_iova_alloc(&sp, 2 * FSL_IOVA_GRANULE, align, &b) ==
+	      VFIO_SUCCESS);
+	CHECK(!(b & (align - 1)) && b > base && b < base + align);
+
+	/* Aligned candidate holding b: next aligned granule is taken */
+	CHECK(fsl_iova_alloc(&sp, FSL_IOVA_GRANULE, align, &c) ==
+	      VFIO_SUCCESS);
+	CHECK(!(c & (align - 1)) && c == b + align);
+
+	/* Does not fit after the allocations above */
+	CHECK(fsl_iova_alloc(&sp, 48 * FSL_IOVA_GRANULE, 0, &a) ==
+	      VFIO_FAILURE);
+
+	fsl_iova_free(&sp, c, FSL_IOVA_GRANULE);
+	fsl_iova_free(&sp, b, 2 * FSL_IOVA_GRANULE);
+	CHECK(sp.used == 1);
+	CHECK(fsl_iova_alloc(&sp, 2 * FSL_IOVA_GRANULE, align, &c) ==
+	      VFIO_SUCCESS);
+	CHECK(c == b);
+
+	fsl_iova_fini(&sp);
+	CHECK(fsl_iova_alloc(&sp, 1, 0, &a) == VFIO_FAILURE);
+
+	printf("fsl_iova: done\n");
+}
+
+/*
+ * @brief
+ * MC latency histogram buckets: exact below the linear range, upper bounds
+ * consistent with the buckets, monotonic and saturating
+ */
+static void
+check_mc_stats_bucket(void)
+{
+	unsigned int b;
+	uint64_t ns, up;
+
+	for (ns = 0; ns < (2U << MC_STATS_HIST_SUB_BITS); ns++)
+		CHECK(mc_stats_bucket(ns) == ns);
+
+	for (b = 0; b < MC_STATS_HIST_BUCKETS - 1; b++) {
+		up = mc_stats_bucket_upper(b);
+		CHECK(mc_stats_bucket(up) == b);
+		CHECK(mc_stats_bucket(up + 1) == b + 1);
+	}
+
+	/* Within 12.5% of the latency */
+	for (ns = 1; ns < (1ULL << MC_STATS_HIST_MAX_BITS); ns = ns * 3 + 1) {
+		up = mc_stats_bucket_upper(mc_stats_bucket(ns));
+		CHECK(up >= ns && up - ns <= ns >> MC_STATS_HIST_SUB_BITS);
+	}
+
+	CHECK(mc_stats_bucket(1ULL << MC_STATS_HIST_MAX_BITS) ==
+	      MC_STATS_HIST_BUCKETS - 1);
+	CHECK(mc_stats_bucket(UINT64_MAX) == MC_STATS_HIST_BUCKETS - 1);
+	CHECK(mc_stats_bucket_upper(MC_STATS_HIST_BUCKETS - 1) == UINT64_MAX);
+
+	printf("mc_stats_bucket: done\n");
+}
+
+/*
+ * @brief
+ * Handler of check_evl_close: the first client served closes the others
+ */
+static int
+evl_close_others(aiopt_evl_t *evl, struct aiopt_evl_conn *conn,
+		 unsigned int events)
+{
+	unsigned int i, *calls = evl->arg;
+
+	(*calls)++;
+	for (i = 0; i < evl->max_conns; i++) {
+		if (evl->conns[i] && evl->conns[i] != conn)
+			aiopt_evl_close(evl, evl->conns[i]);
+	}
+	evl->stop = TRUE;
+
+	return AIOPT_SUCCESS;
+}
+
+/*
+ * @brief
+ * Event loop: a connection closed by a handler is not served again for the
+ * events already taken in the same batch
+ */
+static void
+check_evl_close(void)
+{
+	aiopt_evl_t evl;
+	struct sockaddr_un addr;
+	socklen_t len = sizeof(sa_family_t);
+	unsigned int calls = 0;
+	int lfd, cfd[2], i;
+
+	CHECK(aiopt_evl_init(&evl, sizeof(struct aiopt_evl_conn), 4,
+			     evl_close_others, NULL, &calls) == AIOPT_SUCCESS);
+
+	/* Autobound abstract address */
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	CHECK(lfd >= 0);
+	CHECK(bind(lfd, (struct sockaddr *)&addr, len) == 0);
+	len = sizeof(addr);
+	CHECK(getsockname(lfd, (struct sockaddr *)&addr, &len) == 0);
+	CHECK(listen(lfd, 4) == 0);
+	CHECK(aiopt_evl_listen(&evl, lfd) == AIOPT_SUCCESS);
+
+	/* Both are readable as soon as accepted */
+	for (i = 0; i < 2; i++) {
+		cfd[i] = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		CHECK(connect(cfd[i], (struct sockaddr *)&addr, len) == 0);
+		CHECK(write(cfd[i], "x", 1) == 1);
+	}
+
+	CHECK(aiopt_evl_run(&evl) == AIOPT_SUCCESS);
+	CHECK(calls == 1);
+	CHECK(evl.nconns == 1);
+
+	aiopt_evl_fini(&evl);
+	close(cfd[0]);
+	close(cfd[1]);
+
+	printf("evl_close: done\n");
+}
+
+int main(void)
+{
+	check_crc32c();
+	check_iova();
+	check_mc_stats_bucket();
+	check_evl_close();
+
+	printf("%s (%d failed checks)\n", failures ? "FAIL" : "PASS",
+	       failures);
+
+	return failures ? 1 : 0;
+}
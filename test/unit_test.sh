@@ -47,6 +47,235 @@ function test_status() {
 	echo
 	$BIN "status" $@
 }
+
+#===============================================================
+# Simulator (make sim) tests: no hardware needed, exit status is checked
+
+SIM_DIR="./sim_test"
+SIM_IMAGE="$SIM_DIR/aiop.elf"
+SIM_CRC_IMAGE="$SIM_DIR/crc.elf"
+SIM_BAD_IMAGE="$SIM_DIR/bad.elf"
+SIM_SHORT_IMAGE="$SIM_DIR/short.elf"
+SIM_SOCKET="$SIM_DIR/aiop_tool.sock"
+SIM_TEXTFILE="$SIM_DIR/aiop.prom"
+SIM_CACHE_DIR="$SIM_DIR/cache"
+UNIT_CHECKS="./bin/unit_checks"
+
+# Exit status of the tool for AIOPT_EBADIMAGE (-EBADMSG) and a timeout
+EXIT_EBADIMAGE=$((256 - 74))
+EXIT_TIMEOUT=124
+
+PASS_COUNTER=0
+CHECK_COUNTER=0
+
+function sim_compile() {
+	make clean
+	make sim && make unit_checks
+	return $?
+}
+
+# Smallest image the ELF checks accept: 32-bit big-endian, e_machine 20
+# (AIOP), one PT_LOAD segment of 256 bytes at 0x1000
+function sim_make_images() {
+	mkdir -p $SIM_DIR
+	{
+		printf '\x7fELF\x01\x02\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00'
+		printf '\x00\x02\x00\x14\x00\x00\x00\x01\x00\x00\x10\x00\x00\x00\x00\x34'
+		printf '\x00\x00\x00\x00\x00\x00\x00\x00\x00\x34\x00\x20\x00\x01\x00\x00'
+		printf '\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x00\x54\x00\x00\x10\x00'
+		printf '\x00\x00\x10\x00\x00\x00\x01\x00\x00\x00\x01\x00\x00\x00\x00\x05'
+		printf '\x00\x00\x00\x04'
+		head -c 256 /dev/zero
+	} > $SIM_IMAGE
+	# Same image, with a CRC32C sidecar not matching it
+	cp $SIM_IMAGE $SIM_CRC_IMAGE
+	echo "deadbeef  crc.elf" > $SIM_CRC_IMAGE.crc32c
+	# Right size, no ELF magic
+	head -c 340 /dev/zero > $SIM_BAD_IMAGE
+	# ELF header only, program headers beyond the end of the file
+	head -c 60 $SIM_IMAGE > $SIM_SHORT_IMAGE
+}
+
+# Wait up to a second for a file (socket, textfile) to appear
+function sim_wait_file() {
+	local i
+
+	for i in $(seq 1 100); do
+		[ -e "$1" ] && return 0
+		sleep 0.01
+	done
+	return 1
+}
+
+function test_sim_load() {
+	echo "Executing: $BIN load \"$@\""
+	echo
+	$BIN load $@
+}
+
+function test_sim_load_fail() {
+	echo "Executing: AIOPT_SIM_FAIL=load $BIN load \"$@\""
+	echo
+	AIOPT_SIM_FAIL=load $BIN load $@
+}
+
+# Tile takes 2s to boot
+function test_sim_load_slow() {
+	echo "Executing: AIOPT_SIM_BOOT_US=2000000 $BIN load \"$@\""
+	echo
+	AIOPT_SIM_BOOT_US=2000000 $BIN load $@
+}
+
+# MC takes 2s over the load command; the load still ends within -T
+function test_sim_load_slow_mc() {
+	local start ret
+
+	echo "Executing: AIOPT_SIM_LOAD_US=2000000 $BIN load \"$@\""
+	echo
+	start=$(date +%s%N)
+	AIOPT_SIM_LOAD_US=2000000 $BIN load $@
+	ret=$?
+	[ $(( ($(date +%s%N) - start) / 1000000 )) -lt 1000 ] || return 1
+	return $ret
+}
+
+function test_sim_wait() {
+	echo "Executing: $BIN wait \"$@\""
+	echo
+	$BIN wait $@
+}
+
+# Every object of a container of two dpaiop and two dpmcp is listed
+function test_sim_list() {
+	local out
+
+	echo "Executing: AIOPT_SIM_AIOPS=2 AIOPT_SIM_PORTALS=2 $BIN list \"$@\""
+	echo
+	out=$(AIOPT_SIM_AIOPS=2 AIOPT_SIM_PORTALS=2 $BIN list $@) || return 1
+	echo "$out"
+	[ $(echo "$out" | grep -c '^dp\(aiop\|mcp\)\.[01] ') == 4 ]
+}
+
+# status of a given dpaiop (-i) of a container of two
+function test_sim_status_id() {
+	echo "Executing: AIOPT_SIM_AIOPS=2 $BIN status \"$@\""
+	echo
+	AIOPT_SIM_AIOPS=2 $BIN status $@
+}
+
+function test_sim_stats() {
+	echo "Executing: $BIN stats \"$@\""
+	echo
+	$BIN stats $@
+}
+
+# Without a daemon socket, the text output says whose commands it counts
+function test_sim_stats_note() {
+	local out
+
+	echo "Executing: $BIN stats \"$@\""
+	echo
+	out=$($BIN stats $@) || return 1
+	echo "$out"
+	echo "$out" | grep -q '^Note: MC commands of this invocation only'
+}
+
+# Resets of two containers, which MC takes 2s over, time out after -T
+function test_sim_fleet_reset() {
+	local out
+
+	echo "Executing: AIOPT_SIM_RESET_US=2000000 $BIN reset -g dprc.2,dprc.3 \"$@\""
+	echo
+	out=$(AIOPT_SIM_RESET_US=2000000 $BIN reset -g dprc.2,dprc.3 $@)
+	echo "$out"
+	[ $(echo "$out" | grep -c '^dprc\.[23] .* err=-110$') == 2 ]
+}
+
+# status, load and wait through a daemon serving on SIM_SOCKET
+function test_sim_serve() {
+	local pid ret
+
+	echo "Executing: $BIN serve -s $SIM_SOCKET; $BIN status -s $SIM_SOCKET"
+	echo
+	rm -f $SIM_SOCKET
+	$BIN serve -s $SIM_SOCKET &
+	pid=$!
+	sim_wait_file $SIM_SOCKET || { kill -INT $pid; wait $pid; return 1; }
+
+	$BIN status -s $SIM_SOCKET && \
+		$BIN load -s $SIM_SOCKET -f $SIM_IMAGE -r $@ && \
+		$BIN wait -s $SIM_SOCKET -S RUNNING -T 1000
+	ret=$?
+
+	kill -INT $pid
+	wait $pid || ret=1
+	[ ! -e $SIM_SOCKET ] || ret=1
+	return $ret
+}
+
+# A reset of 2s through a daemon with two portals does not hold up the status
+# of another client
+function test_sim_serve_reset() {
+	local pid rpid ret
+
+	echo "Executing: AIOPT_SIM_PORTALS=2 AIOPT_SIM_RESET_US=2000000 $BIN serve -s $SIM_SOCKET; $BIN reset -s $SIM_SOCKET"
+	echo
+	rm -f $SIM_SOCKET
+	AIOPT_SIM_PORTALS=2 AIOPT_SIM_RESET_US=2000000 $BIN serve -s $SIM_SOCKET &
+	pid=$!
+	sim_wait_file $SIM_SOCKET || { kill -INT $pid; wait $pid; return 1; }
+
+	$BIN reset -s $SIM_SOCKET &
+	rpid=$!
+	sleep 0.2
+	timeout 1 $BIN status -s $SIM_SOCKET && kill -0 $rpid
+	ret=$?
+	wait $rpid || ret=1
+
+	kill -INT $pid
+	wait $pid || ret=1
+	return $ret
+}
+
+# Textfile of an exporter holds the tile metrics while it runs
+function test_sim_exporter() {
+	local pid ret
+
+	echo "Executing: $BIN exporter -o $SIM_TEXTFILE \"$@\""
+	echo
+	rm -f $SIM_TEXTFILE
+	$BIN exporter -o $SIM_TEXTFILE $@ &
+	pid=$!
+	sim_wait_file $SIM_TEXTFILE
+	grep '^aiop_up{.*} 1$' $SIM_TEXTFILE && \
+		grep 'aiop_tile_state="RESET_DONE"} 1$' $SIM_TEXTFILE && \
+		grep 'aiop_tile_state="LOAD_ONGOING"} 0$' $SIM_TEXTFILE
+	ret=$?
+
+	kill -INT $pid
+	wait $pid || ret=1
+	return $ret
+}
+
+# A kept topology record naming a portal the container no longer has is
+# rescanned and rewritten, and the load goes through
+function test_sim_stale_topo() {
+	local rec=$SIM_CACHE_DIR/topo.dprc.9
+
+	echo "Executing: DPRC=dprc.9 AIOPT_TOPO_CACHE=1 $BIN load \"$@\""
+	echo
+	mkdir -p $SIM_CACHE_DIR
+	printf 'group=0 ino=0 mtime=0.000000000\nobj=dpaiop.0\nobj=dpmcp.7\n' \
+		> $rec
+	DPRC=dprc.9 AIOPT_TOPO_CACHE=1 $BIN load $@ || return 1
+	grep '^obj=dpmcp\.0$' $rec && ! grep '^obj=dpmcp\.7$' $rec
+}
+
+function test_unit_checks() {
+	echo "Executing: $UNIT_CHECKS"
+	echo
+	$UNIT_CHECKS
+}
 #===============================================================
 
 TEST_COUNTER=0
@@ -60,8 +289,33 @@ function run_test() {
 	TEST_COUNTER=$(($TEST_COUNTER + 1))
 }
 
+# Like run_test, but the exit status of the test must be the expected one
+function run_check() {
+	local id=$1 name=$2 expected=$3 ret
+
+	echo "========================================================"
+	echo "        Running Test: ID:$id: Name:$name COUNT=$TEST_COUNTER"
+	echo "----- Expected exit status: $expected ----"
+	shift 3
+	$name "$@"
+	ret=$?
+	if [ $ret == $expected ]
+	then
+		echo "----- PASS ----"
+		PASS_COUNTER=$(($PASS_COUNTER + 1))
+	else
+		echo "----- FAIL: exit status $ret ----"
+	fi
+	echo "========================================================"
+	TEST_COUNTER=$(($TEST_COUNTER + 1))
+	CHECK_COUNTER=$(($CHECK_COUNTER + 1))
+}
+
 function usage() {
 	echo "<Test Script> <Path to the AIOP Tool>"
+	echo "<Test Script> --sim"
+	echo "    Builds aiop_tool against the MC simulator (make sim) and"
+	echo "    runs the tests needing no hardware."
 	echo
 }
 
@@ -86,10 +340,67 @@ function test_summary() {
 	echo
 }
 
+function sim_summary() {
+	echo
+	echo "==== Executed: $TEST_COUNTER; Pass: $PASS_COUNTER ==="
+	echo
+}
+
+function sim_tests() {
+	BIN="./bin/aiop_tool_sim"
+
+	sim_compile 2>$COMPILE_OUTPUT 1>&2
+	if [ $? != 0 ]
+	then
+		echo "Unable to compile. Check logs"
+		exit 1
+	fi
+
+	test_init
+	sim_make_images
+	# Image and topology records of the simulated tiles, not /var/run
+	export AIOPT_CACHE_DIR=$SIM_CACHE_DIR
+
+	### Unit Checks
+	### ID Range: 201 - 209
+	run_check 201 test_unit_checks 0
+
+	### Simulator Test
+	### ID Range: 210 - 240
+	run_check 210 test_sim_load 0 -f $SIM_IMAGE -r
+	run_check 211 test_sim_load_fail 255 -f $SIM_IMAGE
+	run_check 212 test_sim_stats 0 -j
+	run_check 213 test_sim_serve 0
+	run_check 214 test_sim_wait $EXIT_TIMEOUT -S RUNNING -T 100
+	run_check 215 test_sim_wait 0 -S RESET_DONE -T 100
+	run_check 216 test_sim_load 0 -f $SIM_IMAGE -r -c 4 -T 5000
+	run_check 217 test_sim_load_slow $EXIT_TIMEOUT -f $SIM_IMAGE -T 200
+	run_check 218 test_sim_load $EXIT_EBADIMAGE -f $SIM_CRC_IMAGE
+	run_check 219 test_sim_load $EXIT_EBADIMAGE -f $SIM_BAD_IMAGE
+	run_check 220 test_sim_load $EXIT_EBADIMAGE -f $SIM_SHORT_IMAGE
+	run_check 221 test_sim_list 0
+	run_check 222 test_sim_status_id 0 -i 1
+	run_check 223 test_sim_status_id 255 -i 2
+	run_check 224 test_sim_exporter 0 -I 100
+	run_check 225 test_sim_stale_topo 0 -f $SIM_IMAGE
+	run_check 226 test_sim_serve_reset 0
+	run_check 227 test_sim_load_slow_mc $EXIT_TIMEOUT -f $SIM_IMAGE -T 200
+	run_check 228 test_sim_stats_note 0
+	run_check 229 test_sim_fleet_reset 0 -T 200
+
+	rm -rf $SIM_DIR
+	sim_summary
+	[ $PASS_COUNTER == $CHECK_COUNTER ]
+	exit $?
+}
+
 if [ "$1" == "" ]
 then
 	usage
 	exit 1
+elif [ "$1" == "--sim" ]
+then
+	sim_tests
 else
 	BIN=$1
 fi